@@ -144,10 +144,13 @@ if (LLVM_CONFIG_EXECUTABLE)
 
 
 
-    # link libraries, currently only need core, jit and native.
+    # link libraries, currently only need core, jit and native,
+    # nativecodegen to emit the object files of model libraries, and
+    # bitreader, bitwriter and linker to combine the modules generated on
+    # multiple threads.
     # TODO: in future, replace this with something like LLVM_CORE_LIBS, LLVM_JIT_LIBS...
     execute_process(
-        COMMAND ${LLVM_CONFIG_EXECUTABLE} --libfiles core jit native
+        COMMAND ${LLVM_CONFIG_EXECUTABLE} --libfiles core jit native nativecodegen bitreader bitwriter linker
         OUTPUT_VARIABLE LLVM_LIBRARIES
         OUTPUT_STRIP_TRAILING_WHITESPACE
         )
@@ -15,6 +15,8 @@
 #include <math.h>
 #include <map>
 #include <algorithm>
+#include <limits>
+#include <sstream>
 #include <assert.h>
 #include <Poco/Logger.h>
 
@@ -95,6 +97,10 @@ mStateVector(NULL),
 mCVODE_Memory(NULL),
 mLastTimeValue(0),
 mLastEvent(0),
+mDenseVector(NULL),
+mDenseTime(0),
+mDenseRootTime(0),
+mDenseRootPending(false),
 mOneStepCount(0),
 mFollowEvents(true),
 mMaxAdamsOrder(mDefaultMaxAdamsOrder),
@@ -205,6 +211,11 @@ double CVODEIntegrator::integrate(double timeStart, double hstep)
             || (options.integratorFlags & SimulateOptions::VARIABLE_STEP))
             ? CV_ONE_STEP : CV_NORMAL;
 
+    if (itask == CV_NORMAL && (options.integratorFlags & SimulateOptions::DENSE_OUTPUT))
+    {
+        return integrateDense(timeStart, hstep);
+    }
+
     // get the original event status
     vector<unsigned char> eventStatus(mModel->getEventTriggers(0, 0, 0), false);
 
@@ -314,6 +325,147 @@ double CVODEIntegrator::integrate(double timeStart, double hstep)
 
 }
 
+double CVODEIntegrator::integrateDense(double timeStart, double hstep)
+{
+    const double tout = timeStart + hstep;
+    const double inf = std::numeric_limits<double>::infinity();
+
+    if (!haveVariables() && mModel->getNumEvents() == 0)
+    {
+        mModel->convertToAmounts();
+        mModel->getStateVectorRate(tout, 0, 0);
+        return tout;
+    }
+
+    if (mLastTimeValue > timeStart)
+    {
+        restart(timeStart);
+    }
+
+    mDenseEventStatus.resize(mModel->getEventTriggers(0, 0, 0));
+
+    const int maxSteps = options.maximumNumSteps > 0 ?
+            options.maximumNumSteps : mDefaultMaxNumSteps;
+
+    int steps = 0;
+    int strikes = 3;
+    int err;
+
+    while (true)
+    {
+        const double eventTime = mModel->getPendingEventSize() > 0 ?
+                mModel->getNextPendingEventTime(false) : inf;
+
+        if (eventTime <= tout && (mDenseRootPending ?
+                eventTime < mDenseRootTime : eventTime <= mDenseTime))
+        {
+            // a delayed event inside the last step, interpolate the state
+            // at the event time and restart cvode from there, any pending
+            // root will be found again.
+            if (eventTime < mDenseTime &&
+                    (err = CVodeGetDky(mCVODE_Memory, eventTime, 0, mStateVector)) != CV_SUCCESS)
+            {
+                handleCVODEError(err);
+            }
+
+            mModel->applyPendingEvents(NV_DATA_S(mStateVector), eventTime, tout);
+            restart(eventTime);
+        }
+        else if (mDenseRootPending && mDenseRootTime <= tout)
+        {
+            Log(Logger::LOG_DEBUG) << "--- E V E N T   ( " << mOneStepCount
+                    << ", time: " << mDenseRootTime << " ) ";
+
+            const double rootTime = mDenseRootTime;
+            handleRootsForTime(rootTime, mDenseEventStatus);
+            restart(rootTime);
+            mLastEvent = rootTime;
+
+            if (listener)
+            {
+                listener->onEvent(this, mModel, rootTime);
+            }
+        }
+        else if (tout <= mDenseTime || mDenseRootPending)
+        {
+            // the last step covers tout
+            break;
+        }
+        else
+        {
+            if (++steps > maxSteps)
+            {
+                std::stringstream ss;
+                ss << "CVODEIntegrator took " << maxSteps << " steps from time "
+                        << timeStart << " but could not reach " << tout;
+                throw IntegratorException(ss.str(), __FUNC__);
+            }
+
+            // event status before time step
+            if (mDenseEventStatus.size())
+            {
+                mModel->getEventTriggers(mDenseEventStatus.size(), 0, &mDenseEventStatus[0]);
+            }
+
+            double timeEnd = 0;
+            int nResult = CVode(mCVODE_Memory, tout, mStateVector, &timeEnd, CV_ONE_STEP);
+
+            if (nResult == CV_ROOT_RETURN && mFollowEvents)
+            {
+                bool tooCloseToStart = fabs(timeEnd - mLastEvent) > options.relative;
+
+                strikes = tooCloseToStart ? 3 : strikes - 1;
+
+                if (tooCloseToStart || strikes > 0)
+                {
+                    mDenseRootPending = true;
+                    mDenseRootTime = timeEnd;
+                }
+            }
+            else if (nResult < 0)
+            {
+                handleCVODEError(nResult);
+            }
+
+            mDenseTime = timeEnd;
+
+            if (listener)
+            {
+                mModel->setTime(timeEnd);
+                assignResultsToModel();
+                listener->onTimeStep(this, mModel, timeEnd);
+            }
+        }
+    }
+
+    if (tout < mDenseTime)
+    {
+        if ((err = CVodeGetDky(mCVODE_Memory, tout, 0, mDenseVector)) != CV_SUCCESS)
+        {
+            handleCVODEError(err);
+        }
+        mModel->setStateVector(NV_DATA_S(mDenseVector));
+    }
+    else
+    {
+        assignResultsToModel();
+    }
+
+    mModel->setTime(tout);
+    mLastTimeValue = tout;
+
+    try
+    {
+        mModel->testConstraints();
+    }
+    catch (const std::exception& e)
+    {
+        Log(Logger::LOG_WARNING) << "Constraint Violated at time = " << tout << ": " << e.what();
+    }
+
+    return tout;
+}
+
 bool CVODEIntegrator::haveVariables()
 {
     return stateVectorVariables;
@@ -355,6 +507,7 @@ void CVODEIntegrator::createCVode()
 
     // allocate and init the cvode arrays
     mStateVector = N_VNew_Serial(allocStateVectorSize);
+    mDenseVector = N_VNew_Serial(allocStateVectorSize);
     for (int i = 0; i < allocStateVectorSize; i++)
     {
         SetVector(mStateVector, i, 0.);
@@ -513,6 +666,10 @@ void CVODEIntegrator::restart(double time)
     {
         reInit(time);
     }
+
+    // nothing to interpolate until the next step
+    mDenseTime = time;
+    mDenseRootPending = false;
 }
 
 
@@ -557,8 +714,14 @@ void CVODEIntegrator::freeCVode()
         N_VDestroy_Serial(mStateVector);
     }
 
+    if(mDenseVector)
+    {
+        N_VDestroy_Serial(mDenseVector);
+    }
+
     mCVODE_Memory = 0;
     mStateVector = 0;
+    mDenseVector = 0;
 }
 
 // int (*CVRootFn)(realtype t, N_Vector y, realtype *gout, void *user_data)
@@ -84,6 +84,21 @@ private:
     double mLastTimeValue;
     double mLastEvent;
 
+    /**
+     * dense output state, cvode has integrated up to mDenseTime, and the
+     * interpolant of its last step is used to fill the output times up
+     * to there.
+     *
+     * If the last step stopped at an event root, the root is held pending,
+     * with mStateVector holding the state at the root, until an output time
+     * past it is requested.
+     */
+    N_Vector mDenseVector;
+    double mDenseTime;
+    double mDenseRootTime;
+    bool mDenseRootPending;
+    std::vector<unsigned char> mDenseEventStatus;
+
     /**
      * the shared model object, owned by RoadRunner.
      */
@@ -125,6 +140,13 @@ private:
 
     void assignPendingEvents(double timeEnd, double tout);
 
+    /**
+     * integrate with the DENSE_OUTPUT flag, cvode takes its natural steps
+     * with CV_ONE_STEP and the output at tout is interpolated with
+     * CVodeGetDky.
+     */
+    double integrateDense(double timeStart, double hstep);
+
     void handleRootsForTime(double timeEnd,
             std::vector<unsigned char> &previousEventStatus);
 
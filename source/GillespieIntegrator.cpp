@@ -214,13 +214,7 @@ double GillespieIntegrator::integrate(double t, double hstep)
 
 void GillespieIntegrator::restart(double t0)
 {
-#ifdef RR_CXX_RANDOM
-    engine.seed((unsigned long) std::time(0));
-#else
-    timeval tv = {0, 0};
-    gettimeofday(&tv, 0);
-    srand48((long)(tv.tv_sec * tv.tv_usec));
-#endif
+    random.seed(options);
 }
 
 void GillespieIntegrator::setListener(IntegratorListenerPtr)
@@ -234,11 +228,7 @@ IntegratorListenerPtr GillespieIntegrator::getListener()
 
 double GillespieIntegrator::urand()
 {
-#ifdef RR_CXX_RANDOM
-    return (double) engine() / (double) engine.max();
-#else
-    return drand48();
-#endif
+    return random.uniform();
 }
 
 } /* namespace rr */
@@ -10,16 +10,8 @@
 
 #include "Integrator.h"
 #include "rrExecutableModel.h"
+#include "rrPhiloxRandom.h"
 
-// bugs in gcc 44 c++ random generator
-#if (__cplusplus >= 201103L) || defined(_MSC_VER)
-    #include <random>
-    #define cxx11_ns std
-    #define RR_CXX_RANDOM 1
-#else
-    #include <stdlib.h>
-    #include <sys/time.h>
-#endif
 
 
 namespace rr
@@ -45,8 +37,8 @@ public:
     virtual double integrate(double t0, double hstep);
 
     /**
-     * copies the state vector out of the model and into cvode vector,
-     * re-initializes cvode.
+     * re-seeds the random number generator, from the "seed" and
+     * "trajectory" options if they are set, otherwise from the time.
      */
     virtual void restart(double t0);
 
@@ -65,9 +57,7 @@ private:
     ExecutableModel *model;
     SimulateOptions options;
 
-#ifdef RR_CXX_RANDOM
-    cxx11_ns::mt19937 engine;
-#endif
+    PhiloxRandom random;
 
     double timeScale;
     double stoichScale;
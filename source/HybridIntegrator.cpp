@@ -0,0 +1,468 @@
+#pragma hdrstop
+#include "HybridIntegrator.h"
+#include "rrUtils.h"
+#include "rrLogger.h"
+
+#include <cvode/cvode.h>
+#include <cvode/cvode_dense.h>
+#include <nvector/nvector_serial.h>
+#include <cmath>
+#include <assert.h>
+#include <ctime>
+#include <limits>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+// min and max macros on windows interfer with max method of engine.
+#undef max
+#undef min
+
+namespace rr
+{
+
+int hybridDyDtFcn(realtype t, N_Vector cv_y, N_Vector cv_ydot, void *userData);
+int hybridRootFcn(realtype t, N_Vector y, realtype *gout, void *userData);
+
+static const int defaultMaxNumSteps = 10000;
+
+#define handleCVODEError(errCode, what) \
+        { std::stringstream _err_what; \
+          _err_what << "CVODE Error " << errCode << " in hybrid integrator, " << what; \
+          throw IntegratorException(_err_what.str(), std::string(__FUNC__)); }
+
+HybridIntegrator::HybridIntegrator(ExecutableModel* m,
+        const SimulateOptions* o) :
+        model(m),
+        stoichScale(1.0),
+        adaptivePartition(true),
+        fastPropensity(100.),
+        fastPopulation(100.),
+        needsPartition(true),
+        cvodeState(0),
+        cvodeMemory(0),
+        slowTarget(0)
+{
+    nReactions = model->getNumReactions();
+    stateVectorSize = model->getStateVector(0);
+    nSpecies = model->getNumIndFloatingSpecies();
+    floatingSpeciesStart = stateVectorSize - nSpecies;
+
+    assert(floatingSpeciesStart >= 0);
+
+    reactionRates.resize(nReactions);
+    fast.resize(nReactions);
+
+    // get rows and columns
+    int rows = 0, cols = 0;
+    model->getStoichiometryMatrix(&rows, &cols, 0);
+    double *data = new double[rows * cols];
+    model->getStoichiometryMatrix(&rows, &cols, &data);
+
+    // the dense matrix is row major, species x reactions, only the
+    // rows of the independent species are used, same as the Gillespie.
+    stoichColPtr.resize(nReactions + 1);
+    for (int j = 0; j < nReactions && j < cols; ++j)
+    {
+        stoichColPtr[j] = stoichRows.size();
+        for (int i = 0; i < nSpecies && i < rows; ++i)
+        {
+            double v = data[i * cols + j];
+            if (v != 0)
+            {
+                stoichRows.push_back(i);
+                stoichValues.push_back(v);
+            }
+        }
+    }
+    for (int j = std::min(nReactions, cols); j <= nReactions; ++j)
+    {
+        stoichColPtr[j] = stoichRows.size();
+    }
+
+    delete[] data;
+
+    if (o)
+    {
+        options = *o;
+    }
+
+    createCVode();
+
+    setSimulateOptions(o);
+
+    slowTarget = -log(urand());
+}
+
+HybridIntegrator::~HybridIntegrator()
+{
+    freeCVode();
+}
+
+void HybridIntegrator::setSimulateOptions(const SimulateOptions* o)
+{
+    if (o)
+    {
+        options = *o;
+
+        if(options.hasKey("stoichScale"))
+        {
+            stoichScale = options.getValue("stoichScale").convert<double>();
+        }
+
+        if(options.hasKey("hybridPartition"))
+        {
+            std::string p = options.getValue("hybridPartition").convert<std::string>();
+            if (p == "static")
+            {
+                adaptivePartition = false;
+            }
+            else if (p == "adaptive")
+            {
+                adaptivePartition = true;
+            }
+            else
+            {
+                throw IntegratorException("hybridPartition must be either "
+                        "\"static\" or \"adaptive\", not \"" + p + "\"");
+            }
+        }
+
+        if(options.hasKey("hybridFastPropensity"))
+        {
+            fastPropensity = options.getValue("hybridFastPropensity").convert<double>();
+        }
+
+        if(options.hasKey("hybridFastPopulation"))
+        {
+            fastPopulation = options.getValue("hybridFastPopulation").convert<double>();
+        }
+
+        needsPartition = true;
+    }
+
+    if (cvodeMemory)
+    {
+        CVodeSetMaxNumSteps(cvodeMemory, options.maximumNumSteps > 0 ?
+                options.maximumNumSteps : defaultMaxNumSteps);
+
+        if (options.maximumTimeStep > 0)
+        {
+            CVodeSetMaxStep(cvodeMemory, options.maximumTimeStep);
+        }
+
+        CVodeSStolerances(cvodeMemory, options.relative, options.absolute);
+    }
+}
+
+void HybridIntegrator::createCVode()
+{
+    int err;
+
+    // state vector plus the integrated slow propensity
+    cvodeState = N_VNew_Serial(stateVectorSize + 1);
+    std::fill(NV_DATA_S(cvodeState), NV_DATA_S(cvodeState) + stateVectorSize + 1, 0.);
+
+    if (options.integratorFlags & SimulateOptions::STIFF)
+    {
+        cvodeMemory = CVodeCreate(CV_BDF, CV_NEWTON);
+    }
+    else
+    {
+        cvodeMemory = CVodeCreate(CV_ADAMS, CV_FUNCTIONAL);
+    }
+
+    assert(cvodeMemory && "could not create Cvode, CVodeCreate failed");
+
+    if ((err = CVodeSetUserData(cvodeMemory, (void*) this)) != CV_SUCCESS)
+    {
+        handleCVODEError(err, "CVodeSetUserData");
+    }
+
+    if ((err = CVodeInit(cvodeMemory, hybridDyDtFcn, 0.0, cvodeState)) != CV_SUCCESS)
+    {
+        handleCVODEError(err, "CVodeInit");
+    }
+
+    if ((err = CVodeRootInit(cvodeMemory, 1, hybridRootFcn)) != CV_SUCCESS)
+    {
+        handleCVODEError(err, "CVodeRootInit");
+    }
+
+    if (options.integratorFlags & SimulateOptions::STIFF)
+    {
+        if ((err = CVDense(cvodeMemory, stateVectorSize + 1)) != CV_SUCCESS)
+        {
+            handleCVODEError(err, "CVDense");
+        }
+    }
+
+    CVodeSStolerances(cvodeMemory, options.relative, options.absolute);
+}
+
+void HybridIntegrator::freeCVode()
+{
+    if (cvodeMemory)
+    {
+        CVodeFree(&cvodeMemory);
+    }
+
+    if (cvodeState)
+    {
+        N_VDestroy_Serial(cvodeState);
+    }
+
+    cvodeMemory = 0;
+    cvodeState = 0;
+}
+
+void HybridIntegrator::reInit(double t0)
+{
+    int err;
+    if ((err = CVodeReInit(cvodeMemory, t0, cvodeState)) != CV_SUCCESS)
+    {
+        handleCVODEError(err, "CVodeReInit");
+    }
+}
+
+double HybridIntegrator::integrate(double t, double hstep)
+{
+    double tf = 0;
+    bool singleStep;
+
+    assert(hstep > 0 && "hstep must be > 0");
+
+    if (options.integratorFlags & SimulateOptions::VARIABLE_STEP)
+    {
+        if (options.minimumTimeStep > 0.0)
+        {
+            tf = t + options.minimumTimeStep;
+            singleStep = false;
+        }
+        else
+        {
+            tf = t + hstep;
+            singleStep = true;
+        }
+    }
+    else
+    {
+        tf = t + hstep;
+        singleStep = false;
+    }
+
+    Log(Logger::LOG_DEBUG) << "hybrid(" << t << ", " << tf << ")";
+
+    double *y = NV_DATA_S(cvodeState);
+
+    // the model state may have been changed since the last call,
+    // the integrated slow propensity carries over.
+    model->setTime(t);
+    model->getStateVector(y);
+
+    if (needsPartition)
+    {
+        partition();
+        needsPartition = false;
+    }
+
+    reInit(t);
+    CVodeSetStopTime(cvodeMemory, tf);
+
+    while (t < tf)
+    {
+        double tret = t;
+        int result = CVode(cvodeMemory, tf, cvodeState, &tret, CV_NORMAL);
+
+        if (result == CV_ROOT_RETURN)
+        {
+            t = tret;
+
+            model->setTime(t);
+            model->setStateVector(y);
+
+            fireSlowReaction(y);
+
+            // new waiting time for the next slow reaction
+            y[stateVectorSize] = 0;
+            slowTarget = -log(urand());
+
+            if (adaptivePartition)
+            {
+                partition();
+            }
+
+            reInit(t);
+            CVodeSetStopTime(cvodeMemory, tf);
+
+            if (singleStep)
+            {
+                return t;
+            }
+        }
+        else if (result == CV_SUCCESS || result == CV_TSTOP_RETURN)
+        {
+            t = tret;
+            model->setTime(t);
+            model->setStateVector(y);
+        }
+        else
+        {
+            handleCVODEError(result, "CVode");
+        }
+    }
+
+    return t;
+}
+
+void HybridIntegrator::partition()
+{
+    model->getReactionRates(nReactions, 0, &reactionRates[0]);
+
+    std::vector<double> amounts(stateVectorSize);
+    model->getStateVector(&amounts[0]);
+
+    int nFast = 0;
+
+    for (int j = 0; j < nReactions; ++j)
+    {
+        bool f = std::abs(reactionRates[j]) >= fastPropensity;
+
+        for (unsigned k = stoichColPtr[j]; f && k < stoichColPtr[j + 1]; ++k)
+        {
+            f = amounts[floatingSpeciesStart + stoichRows[k]] >= fastPopulation;
+        }
+
+        fast[j] = f;
+        nFast += f;
+    }
+
+    Log(Logger::LOG_DEBUG) << "hybrid partition, " << nFast << " fast, "
+            << nReactions - nFast << " slow reactions";
+}
+
+void HybridIntegrator::fireSlowReaction(double *y)
+{
+    model->getReactionRates(nReactions, 0, &reactionRates[0]);
+
+    double a0 = 0;
+    for (int j = 0; j < nReactions; ++j)
+    {
+        if (!fast[j])
+        {
+            a0 += std::abs(reactionRates[j]);
+        }
+    }
+
+    if (a0 <= 0)
+    {
+        return;
+    }
+
+    double r = urand() * a0;
+    double sp = 0;
+    int reaction = -1;
+
+    for (int j = 0; j < nReactions; ++j)
+    {
+        if (!fast[j])
+        {
+            reaction = j;
+            sp += std::abs(reactionRates[j]);
+            if (r < sp)
+            {
+                break;
+            }
+        }
+    }
+
+    assert(reaction >= 0);
+
+    // negative rate means the reaction goes in reverse
+    double sign = (reactionRates[reaction] > 0) - (reactionRates[reaction] < 0);
+
+    for (unsigned k = stoichColPtr[reaction]; k < stoichColPtr[reaction + 1]; ++k)
+    {
+        y[floatingSpeciesStart + stoichRows[k]] += stoichValues[k] * stoichScale * sign;
+    }
+
+    model->setStateVector(y);
+}
+
+void HybridIntegrator::restart(double t0)
+{
+    random.seed(options);
+
+    NV_DATA_S(cvodeState)[stateVectorSize] = 0;
+    slowTarget = -log(urand());
+    needsPartition = true;
+}
+
+void HybridIntegrator::setListener(IntegratorListenerPtr)
+{
+}
+
+IntegratorListenerPtr HybridIntegrator::getListener()
+{
+    return IntegratorListenerPtr();
+}
+
+double HybridIntegrator::urand()
+{
+    return random.uniform();
+}
+
+/**
+ * the regular model rates for everything that is not a species, the
+ * contribution of the fast reactions for the species, and the total
+ * slow propensity.
+ */
+int hybridDyDtFcn(realtype time, N_Vector cv_y, N_Vector cv_ydot, void *userData)
+{
+    HybridIntegrator *self = (HybridIntegrator*) userData;
+
+    assert(self && "userData pointer is NULL in hybrid dydt callback");
+
+    double *y = NV_DATA_S(cv_y);
+    double *ydot = NV_DATA_S(cv_ydot);
+    double *rates = &self->reactionRates[0];
+
+    self->model->getStateVectorRate(time, y, ydot);
+    self->model->getReactionRates(self->nReactions, 0, rates);
+
+    std::fill(ydot + self->floatingSpeciesStart, ydot + self->stateVectorSize, 0.);
+
+    double slow = 0;
+
+    for (int j = 0; j < self->nReactions; ++j)
+    {
+        if (self->fast[j])
+        {
+            for (unsigned k = self->stoichColPtr[j]; k < self->stoichColPtr[j + 1]; ++k)
+            {
+                ydot[self->floatingSpeciesStart + self->stoichRows[k]] +=
+                        self->stoichValues[k] * self->stoichScale * rates[j];
+            }
+        }
+        else
+        {
+            slow += std::abs(rates[j]);
+        }
+    }
+
+    ydot[self->stateVectorSize] = slow;
+
+    return CV_SUCCESS;
+}
+
+int hybridRootFcn(realtype time, N_Vector y_vector, realtype *gout, void *userData)
+{
+    HybridIntegrator *self = (HybridIntegrator*) userData;
+
+    gout[0] = NV_DATA_S(y_vector)[self->stateVectorSize] - self->slowTarget;
+
+    return CV_SUCCESS;
+}
+
+} /* namespace rr */
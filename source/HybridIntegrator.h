@@ -0,0 +1,162 @@
+#ifndef HYBRIDINTEGRATOR_H_
+#define HYBRIDINTEGRATOR_H_
+
+#include "Integrator.h"
+#include "rrExecutableModel.h"
+#include "rrPhiloxRandom.h"
+
+#include <vector>
+
+
+/**
+ * CVode vector struct
+ */
+typedef struct _generic_N_Vector *N_Vector;
+
+namespace rr
+{
+
+class ExecutableModel;
+
+/**
+ * Hybrid stochastic / deterministic integrator.
+ *
+ * The reactions are partitioned into a fast set, reactions with a large
+ * propensity where all the species they change are abundant, and a slow
+ * set, the rest. The fast reactions are integrated as ODEs with CVODE,
+ * and the slow reactions fire stochastically in between.
+ *
+ * The integral of the total slow propensity is integrated along with the
+ * state vector, the next slow reaction fires when this integral reaches
+ * -log(r) for a uniform random r, which CVODE locates with a root function.
+ * This is exact for the slow reactions even though their propensities
+ * change continuously with the fast species, see Haseltine and Rawlings,
+ * J. Chem. Phys. 117, 6959 (2002), and Salis and Kaznessis,
+ * J. Chem. Phys. 122, 054103 (2005).
+ *
+ * The right hand side uses the model's regular getStateVectorRate, and only
+ * replaces the species rates with the contribution of the fast reactions,
+ * so the cost of integrating the fast set is close to a deterministic run.
+ *
+ * Like the GillespieIntegrator, the reaction rates are taken as the
+ * propensities, and the floating species amounts as the molecule counts.
+ *
+ * The following keys may be set in the SimulateOptions:
+ *
+ * stoichScale: scale factor for stoichiometry, same as the GillespieIntegrator.
+ *
+ * hybridPartition: "adaptive" (default), the reactions are re-partitioned
+ * after every stochastic firing, or "static", the partition is determined
+ * once at the start of the simulation.
+ *
+ * hybridFastPropensity: minimum propensity of a fast reaction, defaults to 100.
+ *
+ * hybridFastPopulation: minimum amount of every species a fast reaction
+ * changes, defaults to 100.
+ */
+class HybridIntegrator: public Integrator
+{
+public:
+    HybridIntegrator(ExecutableModel* model, const SimulateOptions* options);
+
+    virtual ~HybridIntegrator();
+
+    /**
+     * Set the configuration parameters the integrator uses.
+     */
+    virtual void setSimulateOptions(const SimulateOptions* options);
+
+    /**
+     * integrates the model from t0 to t0 + hstep
+     */
+    virtual double integrate(double t0, double hstep);
+
+    /**
+     * re-seeds the random number generator, see
+     * GillespieIntegrator::restart, and re-partitions the reactions.
+     */
+    virtual void restart(double t0);
+
+    /**
+     * the integrator can hold a single listener. If clients require multicast,
+     * they can create a multi-cast listener.
+     */
+    virtual void setListener(IntegratorListenerPtr);
+
+    /**
+     * get the integrator listener
+     */
+    virtual IntegratorListenerPtr getListener();
+
+private:
+    ExecutableModel *model;
+    SimulateOptions options;
+
+    PhiloxRandom random;
+
+    double stoichScale;
+    bool adaptivePartition;
+    double fastPropensity;
+    double fastPopulation;
+
+    int nReactions;
+    int nSpecies;
+
+    // starting index of floating species
+    int floatingSpeciesStart;
+    int stateVectorSize;
+
+    std::vector<double> reactionRates;
+
+    /**
+     * stoichiometry matrix in compressed sparse column format, so the
+     * species changed by reaction j are
+     * stoichRows[stoichColPtr[j]] ... stoichRows[stoichColPtr[j+1]-1].
+     */
+    std::vector<unsigned> stoichColPtr;
+    std::vector<unsigned> stoichRows;
+    std::vector<double> stoichValues;
+
+    std::vector<bool> fast;
+    bool needsPartition;
+
+    /**
+     * the model state vector, followed by the integral of the slow
+     * propensity since the last stochastic firing.
+     */
+    N_Vector cvodeState;
+    void *cvodeMemory;
+
+    /**
+     * the next slow reaction fires when the integrated slow propensity
+     * reaches this value.
+     */
+    double slowTarget;
+
+    void createCVode();
+
+    void freeCVode();
+
+    void reInit(double t0);
+
+    /**
+     * partition the reactions at the current model state.
+     */
+    void partition();
+
+    /**
+     * pick a slow reaction at the current model state and fire it.
+     */
+    void fireSlowReaction(double *y);
+
+    double urand();
+
+    friend int hybridDyDtFcn(double t, N_Vector cv_y, N_Vector cv_ydot,
+            void *userData);
+    friend int hybridRootFcn(double t, N_Vector y, double *gout,
+            void *userData);
+};
+
+} /* namespace rr */
+
+#endif /* HYBRIDINTEGRATOR_H_ */
@@ -0,0 +1,764 @@
+#pragma hdrstop
+#include "IDAIntegrator.h"
+#include "rrExecutableModel.h"
+#include "rrException.h"
+#include "rrLogger.h"
+#include "rrStringUtils.h"
+
+#include <ida/ida.h>
+#include <ida/ida_dense.h>
+#include <nvector/nvector_serial.h>
+#include <sundials/sundials_dense.h>
+
+#include <algorithm>
+#include <sstream>
+#include <cstdlib>
+#include <float.h>
+#include <math.h>
+#include <assert.h>
+#include <Poco/Logger.h>
+
+// min and max macros conflict with std functions
+#undef min
+#undef max
+
+using namespace std;
+
+namespace rr
+{
+
+int idaResidualFcn(realtype t, N_Vector yy, N_Vector yp, N_Vector rr, void *user_data);
+int idaRootFcn(realtype t, N_Vector yy, N_Vector yp, realtype *gout, void *user_data);
+
+const int IDAIntegrator::mDefaultMaxNumSteps = 10000;
+
+/**
+ * Newton iterations for consistent initial values.
+ */
+static const int maxConsistentIterations = 20;
+
+/**
+ * ida error and warning messages.
+ */
+static void idaErrHandler(int error_code, const char *module, const char *function,
+        char *msg, void *eh_data);
+
+/**
+ * decode the ida error code to a string
+ */
+static std::string idaDecodeError(int idaError);
+
+/**
+ * macro to throw a (hopefully) usefull error message
+ */
+#define handleIDAError(errCode) \
+        { std::string _err_what = std::string("IDA Error: ") + \
+          idaDecodeError(errCode); \
+          throw IntegratorException(_err_what, std::string(__FUNC__)); }
+
+
+IDAIntegrator::IDAIntegrator(ExecutableModel* model,
+        const SimulateOptions* options) :
+                mModel(model),
+                options(*options),
+                mIDA_Memory(0),
+                mStateVector(0),
+                mRateVector(0),
+                stateVectorVariables(false),
+                mLastTimeValue(0),
+                mLastEvent(0)
+{
+    Log(Logger::LOG_INFORMATION) << "creating IDAIntegrator";
+
+    if (mModel)
+    {
+        createIDA();
+    }
+
+    setSimulateOptions(0);
+}
+
+IDAIntegrator::~IDAIntegrator()
+{
+    freeIDA();
+}
+
+void IDAIntegrator::setSimulateOptions(const SimulateOptions* o)
+{
+    if (o)
+    {
+        options = *o;
+    }
+
+    if (mIDA_Memory == 0)
+    {
+        return;
+    }
+
+    if (options.initialTimeStep > 0)
+    {
+        IDASetInitStep(mIDA_Memory, options.initialTimeStep);
+    }
+
+    if (options.maximumTimeStep > 0)
+    {
+        IDASetMaxStep(mIDA_Memory, options.maximumTimeStep);
+    }
+
+    if (options.maximumNumSteps > 0)
+    {
+        IDASetMaxNumSteps(mIDA_Memory, options.maximumNumSteps);
+    }
+    else
+    {
+        IDASetMaxNumSteps(mIDA_Memory, mDefaultMaxNumSteps);
+    }
+
+    setIDATolerances();
+}
+
+void IDAIntegrator::setListener(IntegratorListenerPtr p)
+{
+    listener = p;
+}
+
+IntegratorListenerPtr IDAIntegrator::getListener()
+{
+    return listener;
+}
+
+double IDAIntegrator::integrate(double timeStart, double hstep)
+{
+    double timeEnd = 0.0;
+    double tout = timeStart + hstep;
+    int strikes = 3;
+
+    const int itask = ((options.integratorFlags & SimulateOptions::MULTI_STEP)
+            || (options.integratorFlags & SimulateOptions::VARIABLE_STEP))
+            ? IDA_ONE_STEP : IDA_NORMAL;
+
+    // get the original event status
+    vector<unsigned char> eventStatus(mModel->getEventTriggers(0, 0, 0), false);
+
+    while (tout - timeEnd >= 1E-16)
+    {
+        // no state variables and no events, but still need to evaluate
+        // the model.
+        if (mIDA_Memory == 0)
+        {
+            mModel->convertToAmounts();
+            mModel->getStateVectorRate(tout, 0, 0);
+            return tout;
+        }
+
+        if (mLastTimeValue > timeStart)
+        {
+            restart(timeStart);
+        }
+
+        double nextTargetEndTime = tout;
+
+        if (mModel->getPendingEventSize() > 0 &&
+                mModel->getNextPendingEventTime(false) < nextTargetEndTime)
+        {
+            nextTargetEndTime = mModel->getNextPendingEventTime(true);
+        }
+
+        // event status before time step
+        if (eventStatus.size())
+        {
+            mModel->getEventTriggers(eventStatus.size(), 0, &eventStatus[0]);
+        }
+
+        // time step
+        int nResult = IDASolve(mIDA_Memory, nextTargetEndTime, &timeEnd,
+                mStateVector, mRateVector, itask);
+
+        if (nResult == IDA_ROOT_RETURN)
+        {
+            Log(Logger::LOG_DEBUG) << "--- E V E N T   ( time: " << timeEnd << " ) ";
+
+            bool tooCloseToStart = fabs(timeEnd - mLastEvent) > options.relative;
+
+            strikes = tooCloseToStart ? 3 : strikes - 1;
+
+            if (tooCloseToStart || strikes > 0)
+            {
+                applyEvents(timeEnd, eventStatus);
+                restart(timeEnd);
+                mLastEvent = timeEnd;
+
+                if (listener)
+                {
+                    listener->onEvent(this, mModel, timeEnd);
+                }
+            }
+        }
+        else if (nResult == IDA_SUCCESS || nResult == IDA_TSTOP_RETURN)
+        {
+            mModel->setTime(timeEnd);
+
+            if (stateVectorVariables)
+            {
+                mModel->setStateVector(NV_DATA_S(mStateVector));
+            }
+
+            if (listener)
+            {
+                listener->onTimeStep(this, mModel, timeEnd);
+            }
+        }
+        else
+        {
+            handleIDAError(nResult);
+        }
+
+        mLastTimeValue = timeEnd;
+
+        try
+        {
+            mModel->testConstraints();
+        }
+        catch (const std::exception& e)
+        {
+            Log(Logger::LOG_WARNING) << "Constraint Violated at time = "
+                    << timeEnd << ": " << e.what();
+        }
+
+        assignPendingEvents(timeEnd, tout);
+
+        if (tout - timeEnd > 1E-16)
+        {
+            timeStart = timeEnd;
+        }
+
+        if (options.integratorFlags & SimulateOptions::VARIABLE_STEP)
+        {
+            return timeEnd;
+        }
+    }
+
+    return timeEnd;
+}
+
+void IDAIntegrator::restart(double time)
+{
+    if (!mModel)
+    {
+        return;
+    }
+
+    // apply any events that trigger before or at time 0.
+    // important NOT to set model time before we check get
+    // the initial event state, initially time is < 0.
+    if (time <= 0.0 && mStateVector)
+    {
+        if (stateVectorVariables)
+        {
+            mModel->getStateVector(NV_DATA_S(mStateVector));
+        }
+
+        vector<unsigned char> eventStatus(mModel->getEventTriggers(0, 0, 0), false);
+        if (eventStatus.size())
+        {
+            mModel->getEventTriggers(eventStatus.size(), 0, &eventStatus[0]);
+            applyEvents(0, eventStatus);
+        }
+    }
+
+    mModel->setTime(time);
+
+    if (mIDA_Memory)
+    {
+        if (stateVectorVariables)
+        {
+            mModel->getStateVector(NV_DATA_S(mStateVector));
+        }
+
+        makeConsistent(time);
+
+        int err = IDAReInit(mIDA_Memory, time, mStateVector, mRateVector);
+
+        if (err != IDA_SUCCESS)
+        {
+            handleIDAError(err);
+        }
+
+        setIDATolerances();
+    }
+}
+
+void IDAIntegrator::createIDA()
+{
+    assert(mStateVector == 0 && mIDA_Memory == 0 &&
+            "calling createIDA, but ida objects already exist");
+
+    int allocStateVectorSize = 0;
+    int realStateVectorSize = mModel->getStateVector(0);
+
+    int err;
+
+    if (realStateVectorSize > 0)
+    {
+        stateVectorVariables = true;
+        allocStateVectorSize = realStateVectorSize;
+    }
+    else if (mModel->getNumEvents() > 0)
+    {
+        stateVectorVariables = false;
+        allocStateVectorSize = 1;
+    }
+    else
+    {
+        stateVectorVariables = false;
+        return;
+    }
+
+    mStateVector = N_VNew_Serial(allocStateVectorSize);
+    mRateVector = N_VNew_Serial(allocStateVectorSize);
+
+    N_VConst(0.0, mStateVector);
+    N_VConst(0.0, mRateVector);
+
+    if (stateVectorVariables)
+    {
+        mModel->getStateVector(NV_DATA_S(mStateVector));
+        createProjection();
+    }
+    else
+    {
+        NV_Ith_S(mStateVector, 0) = 1.0;
+    }
+
+    mIDA_Memory = IDACreate();
+
+    assert(mIDA_Memory && "could not create IDA, IDACreate failed");
+
+    if ((err = IDASetErrHandlerFn(mIDA_Memory, idaErrHandler, NULL)) != IDA_SUCCESS)
+    {
+        handleIDAError(err);
+    }
+
+    if ((err = IDASetUserData(mIDA_Memory, (void*) this)) != IDA_SUCCESS)
+    {
+        handleIDAError(err);
+    }
+
+    IDASetMaxNumSteps(mIDA_Memory, mDefaultMaxNumSteps);
+
+    // the initial values are made consistent on restart.
+    if ((err = IDAInit(mIDA_Memory, idaResidualFcn, 0.0, mStateVector,
+            mRateVector)) != IDA_SUCCESS)
+    {
+        handleIDAError(err);
+    }
+
+    if (mModel->getNumEvents() > 0)
+    {
+        if ((err = IDARootInit(mIDA_Memory, mModel->getNumEvents(),
+                idaRootFcn)) != IDA_SUCCESS)
+        {
+            handleIDAError(err);
+        }
+    }
+
+    if ((err = IDADense(mIDA_Memory, allocStateVectorSize)) != IDA_SUCCESS)
+    {
+        handleIDAError(err);
+    }
+
+    setIDATolerances();
+
+    mModel->resetEvents();
+}
+
+void IDAIntegrator::freeIDA()
+{
+    // ida does not check for null values.
+    if (mIDA_Memory)
+    {
+        IDAFree(&mIDA_Memory);
+    }
+
+    if (mStateVector)
+    {
+        N_VDestroy_Serial(mStateVector);
+    }
+
+    if (mRateVector)
+    {
+        N_VDestroy_Serial(mRateVector);
+    }
+
+    mIDA_Memory = 0;
+    mStateVector = 0;
+    mRateVector = 0;
+}
+
+void IDAIntegrator::createProjection()
+{
+    const int n = mModel->getStateVector(0);
+    const int numAlgebraic = mModel->getNumAlgebraicRules();
+    const int numFast = mModel->getNumFastReactions();
+    const int numIndFloatingSpecies = mModel->getNumIndFloatingSpecies();
+    // the rate rule values and the algebraic rule variables come first
+    const int numRateRuleValues = n - numIndFloatingSpecies;
+
+    mRate.resize(n);
+    mResiduals.resize(numAlgebraic + numFast);
+    mConstraints.clear();
+    mProjection.clear();
+
+    // the algebraic rule variables are only determined by their constraint
+    vector<bool> algebraic(n, false);
+    for (int i = 0; i < numAlgebraic; ++i)
+    {
+        algebraic[mModel->getAlgebraicRuleStateVectorIndex(i)] = true;
+        mConstraints.push_back(i);
+    }
+
+    // reduced row echelon form of the transposed fast reaction
+    // stoichiometry, a fast reaction which is a combination of the
+    // previous ones gives no new constraint.
+    vector<vector<double> > pivotRows;
+    vector<int> pivotCols;
+
+    for (int k = 0; k < numFast; ++k)
+    {
+        const int reaction = mModel->getFastReactionIndex(k);
+        vector<double> row(n, 0.0);
+        double scale = 0;
+
+        for (int s = 0; s < numIndFloatingSpecies; ++s)
+        {
+            if (!algebraic[numRateRuleValues + s])
+            {
+                row[numRateRuleValues + s] = mModel->getStoichiometry(s, reaction);
+                scale = std::max(scale, fabs(row[numRateRuleValues + s]));
+            }
+        }
+
+        for (unsigned p = 0; p < pivotRows.size(); ++p)
+        {
+            const double f = row[pivotCols[p]];
+            if (f != 0.0)
+            {
+                for (int j = 0; j < n; ++j)
+                {
+                    row[j] -= f * pivotRows[p][j];
+                }
+            }
+        }
+
+        int pivot = -1;
+        double pivotMax = 1.e-10 * scale;
+        for (int j = 0; j < n; ++j)
+        {
+            if (fabs(row[j]) > pivotMax)
+            {
+                pivotMax = fabs(row[j]);
+                pivot = j;
+            }
+        }
+
+        if (pivot < 0)
+        {
+            Log(Logger::LOG_NOTICE) << "Fast reaction '"
+                    << mModel->getReactionId(reaction)
+                    << "' depends on the other fast reactions, "
+                    << "it does not add a constraint";
+            continue;
+        }
+
+        const double inv = 1.0 / row[pivot];
+        for (int j = 0; j < n; ++j)
+        {
+            row[j] *= inv;
+        }
+        row[pivot] = 1.0;
+
+        for (unsigned p = 0; p < pivotRows.size(); ++p)
+        {
+            const double f = pivotRows[p][pivot];
+            if (f != 0.0)
+            {
+                for (int j = 0; j < n; ++j)
+                {
+                    pivotRows[p][j] -= f * row[j];
+                }
+            }
+        }
+
+        pivotRows.push_back(row);
+        pivotCols.push_back(pivot);
+        mConstraints.push_back(numAlgebraic + k);
+    }
+
+    // each non pivot column of the echelon form gives a vector in its
+    // null space, these are the rows of L.
+    vector<bool> isPivot(n, false);
+    for (unsigned p = 0; p < pivotCols.size(); ++p)
+    {
+        isPivot[pivotCols[p]] = true;
+    }
+
+    for (int j = 0; j < n; ++j)
+    {
+        if (algebraic[j] || isPivot[j])
+        {
+            continue;
+        }
+
+        SparseRow row;
+        row.push_back(make_pair(j, 1.0));
+
+        for (unsigned p = 0; p < pivotRows.size(); ++p)
+        {
+            if (pivotRows[p][j] != 0.0)
+            {
+                row.push_back(make_pair(pivotCols[p], -pivotRows[p][j]));
+            }
+        }
+
+        mProjection.push_back(row);
+    }
+
+    assert((int)(mProjection.size() + mConstraints.size()) == n &&
+            "the number of residuals must match the state vector size");
+
+    Log(Logger::LOG_INFORMATION) << "IDAIntegrator, " << mProjection.size()
+            << " differential and " << mConstraints.size()
+            << " algebraic equations";
+}
+
+void IDAIntegrator::residual(double time, const double *y, const double *yp,
+        double *res)
+{
+    if (!stateVectorVariables)
+    {
+        res[0] = yp[0];
+        return;
+    }
+
+    mModel->getStateVectorRate(time, y, &mRate[0]);
+
+    const unsigned numDifferential = mProjection.size();
+
+    for (unsigned i = 0; i < numDifferential; ++i)
+    {
+        const SparseRow &row = mProjection[i];
+        double sum = 0;
+        for (SparseRow::const_iterator j = row.begin(); j != row.end(); ++j)
+        {
+            sum += j->second * (yp[j->first] - mRate[j->first]);
+        }
+        res[i] = sum;
+    }
+
+    if (mConstraints.size())
+    {
+        mModel->getStateVectorConstraints(time, y, &mResiduals[0]);
+
+        for (unsigned i = 0; i < mConstraints.size(); ++i)
+        {
+            res[numDifferential + i] = mResiduals[mConstraints[i]];
+        }
+    }
+}
+
+void IDAIntegrator::makeConsistent(double time)
+{
+    if (!stateVectorVariables)
+    {
+        NV_Ith_S(mStateVector, 0) = 1.0;
+        NV_Ith_S(mRateVector, 0) = 0.0;
+        return;
+    }
+
+    const int n = NV_LENGTH_S(mStateVector);
+    const unsigned numDifferential = mProjection.size();
+    double *y = NV_DATA_S(mStateVector);
+
+    if (mConstraints.size())
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            // algebraic rule variables do not need an initial value
+            if (!(fabs(y[i]) <= DBL_MAX))
+            {
+                y[i] = 0;
+            }
+        }
+
+        // L y stays fixed, only the constrained part changes
+        vector<double> y0(y, y + n);
+        vector<double> g(n), gp(n);
+
+        DlsMat jac = NewDenseMat(n, n);
+        long int *pivots = NewLintArray(n);
+        bool converged = false;
+
+        for (int iter = 0; iter < maxConsistentIterations && !converged; ++iter)
+        {
+            // the newton residual, L (y - y0) followed by the constraints
+            double *res = &g[0];
+            for (int pass = 0; pass <= n; ++pass)
+            {
+                const int j = pass - 1;
+                double yj = 0;
+                double delta = 0;
+
+                if (j >= 0)
+                {
+                    yj = y[j];
+                    delta = sqrt(DBL_EPSILON * std::max(1.e-5, fabs(yj)));
+                    y[j] += delta;
+                    res = &gp[0];
+                }
+
+                for (unsigned i = 0; i < numDifferential; ++i)
+                {
+                    const SparseRow &row = mProjection[i];
+                    double sum = 0;
+                    for (SparseRow::const_iterator k = row.begin(); k != row.end(); ++k)
+                    {
+                        sum += k->second * (y[k->first] - y0[k->first]);
+                    }
+                    res[i] = sum;
+                }
+
+                mModel->getStateVectorConstraints(time, y, &mResiduals[0]);
+                for (unsigned i = 0; i < mConstraints.size(); ++i)
+                {
+                    res[numDifferential + i] = mResiduals[mConstraints[i]];
+                }
+
+                if (j >= 0)
+                {
+                    y[j] = yj;
+                    for (int i = 0; i < n; ++i)
+                    {
+                        DENSE_ELEM(jac, i, j) = (gp[i] - g[i]) / delta;
+                    }
+                }
+            }
+
+            if (DenseGETRF(jac, pivots) != 0)
+            {
+                break;
+            }
+
+            // g is overwritten with the newton step
+            DenseGETRS(jac, pivots, &g[0]);
+
+            double norm = 0;
+            for (int i = 0; i < n; ++i)
+            {
+                y[i] -= g[i];
+                const double e = g[i] / (options.absolute + options.relative * fabs(y[i]));
+                norm += e * e;
+            }
+
+            converged = sqrt(norm / n) < 1.e-3;
+        }
+
+        DestroyMat(jac);
+        DestroyArray(pivots);
+
+        if (!converged)
+        {
+            std::stringstream ss;
+            ss << "IDAIntegrator could not find values which satisfy the "
+                    "algebraic rules and fast reactions at time " << time;
+            throw IntegratorException(ss.str(), __FUNC__);
+        }
+
+        mModel->setStateVector(y);
+    }
+
+    // with y' = f(y), L (y' - f) = 0, ida does not need the true
+    // derivative of the constrained components.
+    mModel->getStateVectorRate(time, y, NV_DATA_S(mRateVector));
+}
+
+void IDAIntegrator::setIDATolerances()
+{
+    if (mIDA_Memory == 0)
+    {
+        return;
+    }
+
+    int err;
+    if ((err = IDASStolerances(mIDA_Memory, options.relative, options.absolute)) != IDA_SUCCESS)
+    {
+        handleIDAError(err);
+    }
+}
+
+void IDAIntegrator::applyEvents(double timeEnd,
+        std::vector<unsigned char> &previousEventStatus)
+{
+    double *stateVector = stateVectorVariables ? NV_DATA_S(mStateVector) : 0;
+    mModel->applyEvents(timeEnd, &previousEventStatus[0], stateVector, stateVector);
+}
+
+void IDAIntegrator::assignPendingEvents(double timeEnd, double tout)
+{
+    double *stateVector = stateVectorVariables ? NV_DATA_S(mStateVector) : 0;
+    int handled = mModel->applyPendingEvents(stateVector, timeEnd, tout);
+    if (handled > 0)
+    {
+        restart(timeEnd);
+    }
+}
+
+int idaResidualFcn(realtype time, N_Vector yy, N_Vector yp, N_Vector rr,
+        void *user_data)
+{
+    IDAIntegrator *ida = (IDAIntegrator*) user_data;
+
+    assert(ida && "user data pointer is NULL in ida residual callback");
+
+    ida->residual(time, NV_DATA_S(yy), NV_DATA_S(yp), NV_DATA_S(rr));
+
+    return IDA_SUCCESS;
+}
+
+int idaRootFcn(realtype time, N_Vector yy, N_Vector yp, realtype *gout,
+        void *user_data)
+{
+    IDAIntegrator *ida = (IDAIntegrator*) user_data;
+
+    assert(ida && "user data pointer is NULL on ida root callback");
+
+    ida->mModel->getEventRoots(time, NV_DATA_S(yy), gout);
+
+    return IDA_SUCCESS;
+}
+
+static std::string idaDecodeError(int idaError)
+{
+    char *name = IDAGetReturnFlagName(idaError);
+    std::string result = name ? name : "UNKNOWN_CODE";
+    free(name);
+    return result;
+}
+
+static void idaErrHandler(int error_code, const char *module, const char *function,
+        char *msg, void *eh_data)
+{
+    if (error_code < 0)
+    {
+        Log(Logger::LOG_ERROR) << "IDA Error: " << idaDecodeError(error_code)
+                               << ", Module: " << module << ", Function: " << function
+                               << ", Message: " << msg;
+    }
+    else if (error_code == IDA_WARNING)
+    {
+        Log(Logger::LOG_WARNING) << "IDA Warning: "
+                                 << ", Module: " << module << ", Function: " << function
+                                 << ", Message: " << msg;
+    }
+}
+
+} /* namespace rr */
@@ -0,0 +1,178 @@
+#ifndef IDAINTEGRATOR_H_
+#define IDAINTEGRATOR_H_
+
+#include "Integrator.h"
+#include "rrRoadRunnerOptions.h"
+
+#include <vector>
+#include <utility>
+
+/**
+ * sundials vector struct
+ */
+typedef struct _generic_N_Vector *N_Vector;
+
+namespace rr
+{
+
+class ExecutableModel;
+
+/**
+ * @internal
+ * Integrates the model as a differential algebraic system with the
+ * sundials IDA BDF solver, so that algebraic rules and fast reactions are
+ * treated as constraints instead of as very stiff ODEs.
+ *
+ * The state vector y is the same as for the other integrators, the
+ * variables determined by algebraic rules are part of it but have a zero
+ * rate. The residual is
+ *
+ *     L (y' - f(y)) = 0
+ *     g(y) = 0
+ *
+ * where f is ExecutableModel::getStateVectorRate and g are the algebraic
+ * rule residuals, and the rates of a set of independent fast reactions,
+ * from ExecutableModel::getStateVectorConstraints.
+ *
+ * The rows of L span the left null space of the fast reaction
+ * stoichiometry, restricted to the state vector entries not determined by
+ * algebraic rules. The fast reaction rates cancel out of these, which
+ * leaves the slow dynamics of the conserved sums of the fast reactions,
+ * while the fast reactions themselves stay at equilibrium. Without any
+ * constraints, L is the identity and this is just an ODE.
+ *
+ * Consistent initial values are found with a Newton iteration on the
+ * constraints which keeps L y fixed, at the start and after each event.
+ */
+class IDAIntegrator: public Integrator
+{
+public:
+    IDAIntegrator(ExecutableModel* model, const SimulateOptions* options);
+
+    virtual ~IDAIntegrator();
+
+    /**
+     * Set the configuration parameters the integrator uses.
+     */
+    virtual void setSimulateOptions(const SimulateOptions* options);
+
+    /**
+     * integrates the model from t0 to t0 + hstep
+     */
+    virtual double integrate(double t0, double hstep);
+
+    /**
+     * copies the state vector out of the model, applies any events
+     * if t0 <= 0, finds consistent values and re-initializes ida.
+     */
+    virtual void restart(double t0);
+
+    /**
+     * the integrator can hold a single listener. If clients require multicast,
+     * they can create a multi-cast listener.
+     */
+    virtual void setListener(IntegratorListenerPtr);
+
+    /**
+     * get the integrator listener
+     */
+    virtual IntegratorListenerPtr getListener();
+
+private:
+    static const int mDefaultMaxNumSteps;
+
+    /**
+     * the shared model object, owned by RoadRunner.
+     */
+    ExecutableModel *mModel;
+
+    SimulateOptions options;
+
+    IntegratorListenerPtr listener;
+
+    /**
+     * the ida object.
+     */
+    void *mIDA_Memory;
+
+    /**
+     * state vector and its time derivative.
+     */
+    N_Vector mStateVector;
+    N_Vector mRateVector;
+
+    /**
+     * models may have no state vector variables, but if they have events,
+     * we still need an ida state vector of len 1 for the root finder.
+     */
+    bool stateVectorVariables;
+
+    double mLastTimeValue;
+    double mLastEvent;
+
+    /**
+     * sparse rows of L, pairs of state vector index and coefficient.
+     */
+    typedef std::vector<std::pair<int, double> > SparseRow;
+    std::vector<SparseRow> mProjection;
+
+    /**
+     * the entries of getStateVectorConstraints used as residuals, the
+     * algebraic rules and the independent fast reactions.
+     */
+    std::vector<int> mConstraints;
+
+    /**
+     * work space for the rate and constraint evaluation.
+     */
+    std::vector<double> mRate;
+    std::vector<double> mResiduals;
+
+    /**
+     * set up the ida state vectors and the residual projection.
+     */
+    void createIDA();
+
+    /**
+     * free and nullify the ida objects.
+     */
+    void freeIDA();
+
+    /**
+     * find L from the stoichiometry of the fast reactions.
+     */
+    void createProjection();
+
+    /**
+     * solve the constraints at the given time, keeping L y fixed, and set
+     * y' to the model rate, so the ida residual is zero.
+     */
+    void makeConsistent(double time);
+
+    /**
+     * evaluate the ida residual.
+     */
+    void residual(double time, const double *y, const double *yp, double *res);
+
+    void setIDATolerances();
+
+    void applyEvents(double timeEnd, std::vector<unsigned char> &previousEventStatus);
+
+    void assignPendingEvents(double timeEnd, double tout);
+
+    /**
+     * ida residual callback
+     */
+    friend int idaResidualFcn(double t, N_Vector yy, N_Vector yp,
+            N_Vector rr, void *user_data);
+
+    /**
+     * ida event root finding callback.
+     */
+    friend int idaRootFcn(double t, N_Vector yy, N_Vector yp,
+            double *gout, void *user_data);
+};
+
+} /* namespace rr */
+
+#endif /* IDAINTEGRATOR_H_ */
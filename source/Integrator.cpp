@@ -8,6 +8,11 @@
 #include "Integrator.h"
 #include "CVODEIntegrator.h"
 #include "GillespieIntegrator.h"
+#include "TauLeapingIntegrator.h"
+#include "HybridIntegrator.h"
+#include "RK45Integrator.h"
+#include "RosenbrockIntegrator.h"
+#include "IDAIntegrator.h"
 
 namespace rr
 {
@@ -20,6 +25,26 @@ Integrator* Integrator::New(const SimulateOptions* opt, ExecutableModel* m)
     {
         result = new GillespieIntegrator(m, opt);
     }
+    else if (opt->integrator == SimulateOptions::TAU_LEAPING)
+    {
+        result = new TauLeapingIntegrator(m, opt);
+    }
+    else if (opt->integrator == SimulateOptions::HYBRID)
+    {
+        result = new HybridIntegrator(m, opt);
+    }
+    else if (opt->integrator == SimulateOptions::RK45)
+    {
+        result = new RK45Integrator(m, opt);
+    }
+    else if (opt->integrator == SimulateOptions::ROSENBROCK)
+    {
+        result = new RosenbrockIntegrator(m, opt);
+    }
+    else if (opt->integrator == SimulateOptions::IDA)
+    {
+        result = new IDAIntegrator(m, opt);
+    }
     else
     {
         result = new CVODEIntegrator(m, opt);
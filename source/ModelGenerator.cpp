@@ -17,6 +17,7 @@
 #endif
 
 #include "rrLogger.h"
+#include "rrException.h"
 #include <string>
 #include <algorithm>
 
@@ -63,4 +64,56 @@ ModelGenerator* ModelGenerator::New(const string& compiler, const string& tempFo
 
 }
 
+unsigned long ModelGenerator::getModelCacheHits()
+{
+#if defined(BUILD_LLVM)
+    return rrllvm::LLVMModelGenerator::getCacheHits();
+#else
+    return 0;
+#endif
+}
+
+unsigned long ModelGenerator::getModelCacheMisses()
+{
+#if defined(BUILD_LLVM)
+    return rrllvm::LLVMModelGenerator::getCacheMisses();
+#else
+    return 0;
+#endif
+}
+
+void ModelGenerator::purgeModelCache()
+{
+#if defined(BUILD_LLVM)
+    rrllvm::LLVMModelGenerator::purgeCache();
+#endif
+}
+
+void ModelGenerator::trimModelCache()
+{
+#if defined(BUILD_LLVM)
+    rrllvm::LLVMModelGenerator::trimCache();
+#endif
+}
+
+void ModelGenerator::compileModelLibrary(const std::string& sbml,
+        unsigned options, const std::string& path)
+{
+#if defined(BUILD_LLVM)
+    rrllvm::LLVMModelGenerator::compileModelLibrary(sbml, options, path);
+#else
+    throw CoreException("model libraries require the LLVM model generator");
+#endif
+}
+
+ExecutableModel* ModelGenerator::loadModelLibrary(const std::string& path,
+        std::string* sbml, unsigned* options)
+{
+#if defined(BUILD_LLVM)
+    return rrllvm::LLVMModelGenerator::loadModelLibrary(path, sbml, options);
+#else
+    throw CoreException("model libraries require the LLVM model generator");
+#endif
+}
+
 } /* namespace rr */
@@ -141,7 +141,63 @@ public:
          * The MCJIT is the new LLVM JIT engine, it is not as well tested as the
          * original JIT engine. Does NOT work on LLVM 3.1
          */
-        USE_MCJIT =                       (0x1 << 10)
+        USE_MCJIT =                       (0x1 << 10),
+
+        /**
+         * Generate floating point code with relaxed IEEE semantics,
+         * allows the optimizer to re-associate and contract arithmetic,
+         * use the LLVM exp, log and pow intrinsics, expand powers with small
+         * integer exponents into multiplications and run the SLP vectorizer.
+         *
+         * Defaults to false.
+         *
+         * Results may differ from the strict code in the last few bits,
+         * and NaN or Inf values are not guaranteed to propagate. Requires
+         * LLVM 3.3 or later, ignored otherwise.
+         */
+        FAST_MATH =                       (0x1 << 11),
+
+        /**
+         * Evaluate each assignment rule that a generated function (reaction
+         * rates, rate rules, jacobian, event assignments, ...) depends on
+         * once at the start of the function, in dependency order, and
+         * re-use the value, instead of re-generating the rule expression
+         * everywhere the symbol is used. Rules only used in the branches of
+         * a piecewise are still evaluated in their branch.
+         *
+         * Defaults to false.
+         */
+        OPTIMIZE_ASSIGNMENT_RULES =       (0x1 << 12),
+
+        /**
+         * Once all the model functions have been compiled to native code,
+         * release the LLVM IR that the execution engine would otherwise
+         * keep for the life time of the model. Only the native code and
+         * the symbol tables are kept, this can considerably reduce the
+         * memory used by each loaded model.
+         *
+         * Implies eager compilation of every generated function.
+         *
+         * Defaults to false.
+         */
+        COMPACT =                         (0x1 << 13),
+
+        /**
+         * Legacy C back end only, build the model with the system C
+         * compiler ($CC or gcc) at -O3, instead of compiling it in memory
+         * with libtcc, or with the configured compiler without
+         * optimization. $CC may be any compiler which takes gcc style
+         * options, optionally with a launcher such as ccache. Compiling
+         * takes longer, but the model runs faster, which pays off for long
+         * simulations. The compiled library is cached, so this is only paid
+         * once for each model, unlike models compiled in memory by libtcc,
+         * which are compiled again by every load.
+         *
+         * Ignored by the LLVM back end.
+         *
+         * Defaults to false.
+         */
+        OPTIMIZE_NATIVE =                 (0x1 << 14)
     };
 
     /**
@@ -188,6 +244,46 @@ public:
      */
     virtual ~ModelGenerator() {};
 
+    /**
+     * number of models that were created from an already compiled model
+     * in the LLVM model cache, 0 if not built with LLVM.
+     */
+    static unsigned long getModelCacheHits();
+
+    /**
+     * number of models that had to be compiled, 0 if not built with LLVM.
+     */
+    static unsigned long getModelCacheMisses();
+
+    /**
+     * release the compiled models the LLVM model cache keeps alive
+     * for re-use, models that are in use are not affected.
+     */
+    static void purgeModelCache();
+
+    /**
+     * release the least recently used models the LLVM model cache keeps
+     * alive until it is within the current cache limits.
+     */
+    static void trimModelCache();
+
+    /**
+     * compile the sbml ahead of time into a model library at path, see
+     * rrllvm::LLVMModelGenerator::compileModelLibrary. Throws if not built
+     * with LLVM.
+     */
+    static void compileModelLibrary(const std::string& sbml, unsigned options,
+            const std::string& path);
+
+    /**
+     * create a model from a model library, without generating any code.
+     *
+     * @param sbml if not null, set to the sbml the library was compiled from.
+     * @param options if not null, set to the options it was compiled with.
+     */
+    static ExecutableModel *loadModelLibrary(const std::string& path,
+            std::string *sbml = 0, unsigned *options = 0);
+
 
 
 protected:
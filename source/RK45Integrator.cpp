@@ -0,0 +1,679 @@
+#pragma hdrstop
+#include "RK45Integrator.h"
+#include "CVODEIntegrator.h"
+#include "rrUtils.h"
+#include "rrLogger.h"
+
+#include <cmath>
+#include <cfloat>
+#include <limits>
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+// min and max macros on windows
+#undef max
+#undef min
+
+namespace rr
+{
+
+static const double inf = std::numeric_limits<double>::infinity();
+
+static const int defaultMaxNumSteps = 10000;
+
+/**
+ * Dormand-Prince coefficients
+ */
+static const double c2 = 1.0 / 5.0, c3 = 3.0 / 10.0, c4 = 4.0 / 5.0, c5 = 8.0 / 9.0;
+
+static const double a21 = 1.0 / 5.0;
+static const double a31 = 3.0 / 40.0, a32 = 9.0 / 40.0;
+static const double a41 = 44.0 / 45.0, a42 = -56.0 / 15.0, a43 = 32.0 / 9.0;
+static const double a51 = 19372.0 / 6561.0, a52 = -25360.0 / 2187.0,
+        a53 = 64448.0 / 6561.0, a54 = -212.0 / 729.0;
+static const double a61 = 9017.0 / 3168.0, a62 = -355.0 / 33.0,
+        a63 = 46732.0 / 5247.0, a64 = 49.0 / 176.0, a65 = -5103.0 / 18656.0;
+static const double a71 = 35.0 / 384.0, a73 = 500.0 / 1113.0,
+        a74 = 125.0 / 192.0, a75 = -2187.0 / 6784.0, a76 = 11.0 / 84.0;
+
+/**
+ * error estimate, difference between the 5th and 4th order solutions
+ */
+static const double e1 = 71.0 / 57600.0, e3 = -71.0 / 16695.0,
+        e4 = 71.0 / 1920.0, e5 = -17253.0 / 339200.0, e6 = 22.0 / 525.0,
+        e7 = -1.0 / 40.0;
+
+/**
+ * dense output
+ */
+static const double d1 = -12715105075.0 / 11282082432.0,
+        d3 = 87487479700.0 / 32700410799.0, d4 = -10690763975.0 / 1880347072.0,
+        d5 = 701980252875.0 / 199316789632.0, d6 = -1453857185.0 / 822651844.0,
+        d7 = 69997945.0 / 29380423.0;
+
+/**
+ * step size control, same as DOPRI5 defaults
+ */
+static const double safe = 0.9;
+static const double facMin = 0.2;
+static const double facMax = 10.0;
+static const double beta = 0.04;
+
+/**
+ * number of consecutive stiff steps before the model is considered stiff.
+ */
+static const int stiffSteps = 15;
+
+static inline double* data(vector<double>& v)
+{
+    return v.empty() ? 0 : &v[0];
+}
+
+static inline const double* data(const vector<double>& v)
+{
+    return v.empty() ? 0 : &v[0];
+}
+
+RK45Integrator::RK45Integrator(ExecutableModel* m, const SimulateOptions* o) :
+        model(m),
+        stateVectorSize(0),
+        numEvents(0),
+        initialized(false),
+        time(0),
+        timeOld(0),
+        hLast(0),
+        h(0),
+        facOld(1.e-4),
+        lastRejected(false),
+        eventPending(false),
+        stiffCount(0),
+        nonStiffCount(0),
+        stiffDetected(false),
+        stiffSwitch(true),
+        stiffIntegrator(0)
+{
+    Log(Logger::LOG_INFORMATION) << "creating RK45Integrator";
+
+    if (o)
+    {
+        setSimulateOptions(o);
+    }
+
+    stateVectorSize = model->getStateVector(0);
+    numEvents = model->getNumEvents();
+
+    y.resize(stateVectorSize);
+    k1.resize(stateVectorSize);
+    k2.resize(stateVectorSize);
+    k3.resize(stateVectorSize);
+    k4.resize(stateVectorSize);
+    k5.resize(stateVectorSize);
+    k6.resize(stateVectorSize);
+    k7.resize(stateVectorSize);
+    yNew.resize(stateVectorSize);
+    yStage.resize(stateVectorSize);
+    rcont1.resize(stateVectorSize);
+    rcont2.resize(stateVectorSize);
+    rcont3.resize(stateVectorSize);
+    rcont4.resize(stateVectorSize);
+    rcont5.resize(stateVectorSize);
+
+    rootsOld.resize(numEvents);
+    rootsNew.resize(numEvents);
+    rootsMid.resize(numEvents);
+    eventStatus.resize(numEvents);
+
+    model->resetEvents();
+}
+
+RK45Integrator::~RK45Integrator()
+{
+    delete stiffIntegrator;
+}
+
+void RK45Integrator::setSimulateOptions(const SimulateOptions* o)
+{
+    if (o)
+    {
+        options = *o;
+
+        if (options.hasKey("rk45StiffSwitch"))
+        {
+            stiffSwitch = options.getValue("rk45StiffSwitch").convert<bool>();
+        }
+
+        if (stiffIntegrator)
+        {
+            SimulateOptions stiffOptions = options;
+            stiffOptions.integratorFlags |= SimulateOptions::STIFF;
+            stiffIntegrator->setSimulateOptions(&stiffOptions);
+        }
+    }
+}
+
+double RK45Integrator::integrate(double t0, double hstep)
+{
+    const double tout = t0 + hstep;
+
+    // models with no state variables and no events
+    if (stateVectorSize == 0 && numEvents == 0)
+    {
+        model->convertToAmounts();
+        model->getStateVectorRate(tout, 0, 0);
+        return tout;
+    }
+
+    // after switching, CVODE owns the state until the next restart.
+    if (stiffIntegrator)
+    {
+        return stiffIntegrator->integrate(t0, hstep);
+    }
+
+    // t0 is outside of the last step if the caller has moved the
+    // model time.
+    const double eps = 16 * DBL_EPSILON * std::max(1.0, fabs(t0));
+    if (!initialized || t0 < timeOld - eps || t0 > time + eps)
+    {
+        restart(t0);
+    }
+
+    // stiffness was detected on a step that went past the last output
+    // time, the model state was set to the interpolated state at t0.
+    if (stiffDetected && stiffSwitch)
+    {
+        switchToStiff(t0);
+        return stiffIntegrator->integrate(t0, hstep);
+    }
+
+    const bool singleStep = options.integratorFlags &
+            (SimulateOptions::MULTI_STEP | SimulateOptions::VARIABLE_STEP);
+
+    const int maxSteps = options.maximumNumSteps > 0 ?
+            options.maximumNumSteps : defaultMaxNumSteps;
+
+    int steps = 0;
+
+    while (time < tout)
+    {
+        if (eventPending)
+        {
+            applyEvents();
+        }
+
+        // steps may overshoot tout as the output is interpolated, but
+        // not delayed events or the end of a single step.
+        double timeStop = singleStep ? tout : inf;
+
+        if (model->getPendingEventSize() > 0)
+        {
+            timeStop = std::min(timeStop, model->getNextPendingEventTime(false));
+        }
+
+        if (++steps > maxSteps)
+        {
+            std::stringstream ss;
+            ss << "RK45Integrator took " << maxSteps << " steps from time "
+                    << t0 << " but could not reach " << tout;
+            throw IntegratorException(ss.str(), __FUNC__);
+        }
+
+        step(timeStop);
+
+        if (numEvents > 0)
+        {
+            locateRoot();
+        }
+
+        if (model->getPendingEventSize() > 0)
+        {
+            int handled = model->applyPendingEvents(data(y), time, tout);
+            if (handled > 0)
+            {
+                eventPending = false;
+                model->getStateVector(data(y));
+                resetState();
+            }
+        }
+
+        if (listener)
+        {
+            model->setTime(time);
+            model->setStateVector(data(y));
+            listener->onTimeStep(this, model, time);
+        }
+
+        if (stiffDetected && stiffSwitch && time <= tout)
+        {
+            model->setTime(time);
+            model->setStateVector(data(y));
+            switchToStiff(time);
+
+            if (singleStep)
+            {
+                return time;
+            }
+            return stiffIntegrator->integrate(time, tout - time);
+        }
+
+        if (singleStep)
+        {
+            break;
+        }
+    }
+
+    const double tret = std::min(time, tout);
+
+    if (tret < time)
+    {
+        interpolate(tret, yStage);
+        model->setStateVector(data(yStage));
+    }
+    else
+    {
+        model->setStateVector(data(y));
+    }
+
+    model->setTime(tret);
+
+    try
+    {
+        model->testConstraints();
+    }
+    catch (const std::exception& e)
+    {
+        Log(Logger::LOG_WARNING) << "Constraint Violated at time = " << tret
+                << ": " << e.what();
+    }
+
+    return tret;
+}
+
+void RK45Integrator::step(double timeStop)
+{
+    const int n = stateVectorSize;
+    const double rtol = options.relative;
+    const double atol = options.absolute;
+    const double hmax = options.maximumTimeStep > 0 ?
+            options.maximumTimeStep : inf;
+    const double expo = 0.2 - beta * 0.75;
+
+    if (h <= 0)
+    {
+        h = options.initialTimeStep > 0 ? options.initialTimeStep : initialStep();
+    }
+
+    h = std::min(h, hmax);
+
+    while (true)
+    {
+        bool last = false;
+        if (time + 1.01 * h >= timeStop)
+        {
+            h = timeStop - time;
+            last = true;
+        }
+
+        if (h <= 16 * DBL_EPSILON * fabs(time) ||
+                (options.minimumTimeStep > 0 && h < options.minimumTimeStep && !last))
+        {
+            std::stringstream ss;
+            ss << "RK45Integrator step size too small at time " << time;
+            throw IntegratorException(ss.str(), __FUNC__);
+        }
+
+        double *py = data(y);
+        double *pk1 = data(k1), *pk2 = data(k2), *pk3 = data(k3), *pk4 = data(k4);
+        double *pk5 = data(k5), *pk6 = data(k6), *pk7 = data(k7);
+        double *ps = data(yStage), *pn = data(yNew);
+
+        for (int i = 0; i < n; ++i)
+        {
+            ps[i] = py[i] + h * a21 * pk1[i];
+        }
+        model->getStateVectorRate(time + c2 * h, ps, pk2);
+
+        for (int i = 0; i < n; ++i)
+        {
+            ps[i] = py[i] + h * (a31 * pk1[i] + a32 * pk2[i]);
+        }
+        model->getStateVectorRate(time + c3 * h, ps, pk3);
+
+        for (int i = 0; i < n; ++i)
+        {
+            ps[i] = py[i] + h * (a41 * pk1[i] + a42 * pk2[i] + a43 * pk3[i]);
+        }
+        model->getStateVectorRate(time + c4 * h, ps, pk4);
+
+        for (int i = 0; i < n; ++i)
+        {
+            ps[i] = py[i] + h * (a51 * pk1[i] + a52 * pk2[i] + a53 * pk3[i]
+                    + a54 * pk4[i]);
+        }
+        model->getStateVectorRate(time + c5 * h, ps, pk5);
+
+        // yStage is kept for the stiffness test
+        for (int i = 0; i < n; ++i)
+        {
+            ps[i] = py[i] + h * (a61 * pk1[i] + a62 * pk2[i] + a63 * pk3[i]
+                    + a64 * pk4[i] + a65 * pk5[i]);
+        }
+        model->getStateVectorRate(time + h, ps, pk6);
+
+        for (int i = 0; i < n; ++i)
+        {
+            pn[i] = py[i] + h * (a71 * pk1[i] + a73 * pk3[i] + a74 * pk4[i]
+                    + a75 * pk5[i] + a76 * pk6[i]);
+        }
+        model->getStateVectorRate(time + h, pn, pk7);
+
+        double err = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            double e = h * (e1 * pk1[i] + e3 * pk3[i] + e4 * pk4[i]
+                    + e5 * pk5[i] + e6 * pk6[i] + e7 * pk7[i]);
+            double sc = atol + rtol * std::max(fabs(py[i]), fabs(pn[i]));
+            err += (e / sc) * (e / sc);
+        }
+        err = n > 0 ? sqrt(err / n) : 0;
+
+        double fac11 = pow(err, expo);
+        double fac = fac11 / pow(facOld, beta);
+        fac = std::max(1.0 / facMax, std::min(1.0 / facMin, fac / safe));
+        double hNew = h / fac;
+
+        if (err > 1.0)
+        {
+            // rejected
+            h = h / std::min(1.0 / facMin, fac11 / safe);
+            lastRejected = true;
+            continue;
+        }
+
+        // accepted
+        facOld = std::max(err, 1.0e-4);
+
+        // stiffness test, h * |lambda| is approximated by
+        // h * |k7 - k6| / |yNew - yStage|
+        double stnum = 0, stden = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            stnum += (pk7[i] - pk6[i]) * (pk7[i] - pk6[i]);
+            stden += (pn[i] - ps[i]) * (pn[i] - ps[i]);
+        }
+
+        if (stden > 0)
+        {
+            double hlamb = h * sqrt(stnum / stden);
+            if (hlamb > 3.25)
+            {
+                nonStiffCount = 0;
+                if (++stiffCount == stiffSteps)
+                {
+                    stiffDetected = true;
+
+                    // Log does not parenthesize its argument
+                    const Logger::Level level = stiffSwitch ?
+                            Logger::LOG_NOTICE : Logger::LOG_WARNING;
+                    Log(level) << "RK45Integrator, model appears to be "
+                            "stiff at time " << time;
+                }
+            }
+            else if (++nonStiffCount == 6)
+            {
+                stiffCount = 0;
+            }
+        }
+
+        // dense output
+        for (int i = 0; i < n; ++i)
+        {
+            double ydiff = pn[i] - py[i];
+            double bspl = h * pk1[i] - ydiff;
+            rcont1[i] = py[i];
+            rcont2[i] = ydiff;
+            rcont3[i] = bspl;
+            rcont4[i] = ydiff - h * pk7[i] - bspl;
+            rcont5[i] = h * (d1 * pk1[i] + d3 * pk3[i] + d4 * pk4[i]
+                    + d5 * pk5[i] + d6 * pk6[i] + d7 * pk7[i]);
+        }
+
+        timeOld = time;
+        time = last ? timeStop : time + h;
+        hLast = h;
+
+        // first same as last
+        y.swap(yNew);
+        k1.swap(k7);
+
+        if (lastRejected)
+        {
+            hNew = std::min(hNew, h);
+        }
+        lastRejected = false;
+
+        // keep the step size that was limited by timeStop
+        if (!last)
+        {
+            h = std::min(hNew, hmax);
+        }
+        else
+        {
+            h = std::min(std::max(h, hNew), hmax);
+        }
+
+        break;
+    }
+}
+
+double RK45Integrator::initialStep()
+{
+    const int n = stateVectorSize;
+    const double hmax = options.maximumTimeStep > 0 ?
+            options.maximumTimeStep : inf;
+
+    double dnf = norm(k1, y);
+    double dny = norm(y, y);
+
+    double h0 = (dnf <= 1.e-10 || dny <= 1.e-10) ? 1.e-6 : 0.01 * dny / dnf;
+    h0 = std::min(h0, hmax);
+
+    // explicit euler step, and the rate there
+    for (int i = 0; i < n; ++i)
+    {
+        yStage[i] = y[i] + h0 * k1[i];
+    }
+    model->getStateVectorRate(time + h0, data(yStage), data(k2));
+
+    for (int i = 0; i < n; ++i)
+    {
+        k3[i] = k2[i] - k1[i];
+    }
+    double der2 = norm(k3, y) / h0;
+
+    double der12 = std::max(fabs(der2), sqrt(dnf));
+    double h1 = der12 <= 1.e-15 ?
+            std::max(1.e-6, fabs(h0) * 1.e-3) : pow(0.01 / der12, 0.2);
+
+    return std::min(std::min(100 * fabs(h0), h1), hmax);
+}
+
+double RK45Integrator::norm(const std::vector<double>& v,
+        const std::vector<double>& yv) const
+{
+    if (v.empty())
+    {
+        return 0;
+    }
+
+    double sum = 0;
+    for (unsigned i = 0; i < v.size(); ++i)
+    {
+        double sc = options.absolute + options.relative * fabs(yv[i]);
+        sum += (v[i] / sc) * (v[i] / sc);
+    }
+    return sqrt(sum / v.size());
+}
+
+void RK45Integrator::interpolate(double t, std::vector<double>& result) const
+{
+    const double s = hLast > 0 ? (t - timeOld) / hLast : 1.0;
+    const double s1 = 1.0 - s;
+
+    for (int i = 0; i < stateVectorSize; ++i)
+    {
+        result[i] = rcont1[i] + s * (rcont2[i] + s1 * (rcont3[i]
+                + s * (rcont4[i] + s1 * rcont5[i])));
+    }
+}
+
+void RK45Integrator::locateRoot()
+{
+    model->getEventRoots(time, data(y), data(rootsNew));
+
+    bool found = false;
+    for (int i = 0; i < numEvents && !found; ++i)
+    {
+        found = (rootsOld[i] > 0) != (rootsNew[i] > 0);
+    }
+
+    if (!found)
+    {
+        rootsOld.swap(rootsNew);
+        return;
+    }
+
+    // the roots are +1 for triggered and -1 for not, so bisect on the first
+    // time any event changes state.
+    double lo = timeOld;
+    double hi = time;
+    const double tol = 100 * DBL_EPSILON * (fabs(time) + fabs(hLast));
+
+    while (hi - lo > tol)
+    {
+        double mid = lo + (hi - lo) / 2;
+        interpolate(mid, yStage);
+        model->getEventRoots(mid, data(yStage), data(rootsMid));
+
+        bool changed = false;
+        for (int i = 0; i < numEvents && !changed; ++i)
+        {
+            changed = (rootsOld[i] > 0) != (rootsMid[i] > 0);
+        }
+
+        if (changed)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid;
+        }
+    }
+
+    Log(Logger::LOG_DEBUG) << "RK45Integrator, event root at time " << hi;
+
+    // truncate the step at the root, the dense output is still valid
+    // between timeOld and hi.
+    if (hi < time)
+    {
+        interpolate(hi, y);
+        time = hi;
+    }
+
+    for (int i = 0; i < numEvents; ++i)
+    {
+        eventStatus[i] = rootsOld[i] > 0;
+    }
+
+    eventPending = true;
+}
+
+void RK45Integrator::applyEvents()
+{
+    model->applyEvents(time, &eventStatus[0], data(y), data(y));
+    eventPending = false;
+
+    resetState();
+
+    if (listener)
+    {
+        listener->onEvent(this, model, time);
+    }
+}
+
+void RK45Integrator::resetState()
+{
+    model->getStateVectorRate(time, data(y), data(k1));
+
+    if (numEvents > 0)
+    {
+        model->getEventRoots(time, data(y), data(rootsOld));
+    }
+
+    // nothing to interpolate until the next step
+    timeOld = time;
+    hLast = 0;
+}
+
+void RK45Integrator::switchToStiff(double t)
+{
+    Log(Logger::LOG_NOTICE) << "RK45Integrator, switching to CVODE BDF at time " << t;
+
+    SimulateOptions stiffOptions = options;
+    stiffOptions.integratorFlags |= SimulateOptions::STIFF;
+
+    delete stiffIntegrator;
+    stiffIntegrator = new CVODEIntegrator(model, &stiffOptions);
+    stiffIntegrator->setListener(listener);
+    stiffIntegrator->restart(t);
+}
+
+void RK45Integrator::restart(double t0)
+{
+    if (numEvents > 0 && t0 <= 0.0)
+    {
+        // apply any events that trigger before or at time 0, same as
+        // the CVODEIntegrator.
+        model->getStateVector(data(y));
+        model->getEventTriggers(numEvents, 0, &eventStatus[0]);
+        model->applyEvents(0, &eventStatus[0], data(y), data(y));
+    }
+
+    model->setTime(t0);
+    model->getStateVector(data(y));
+
+    time = t0;
+    h = 0;
+    facOld = 1.e-4;
+    lastRejected = false;
+    eventPending = false;
+    stiffCount = 0;
+    nonStiffCount = 0;
+    stiffDetected = false;
+
+    delete stiffIntegrator;
+    stiffIntegrator = 0;
+
+    resetState();
+
+    initialized = true;
+}
+
+void RK45Integrator::setListener(IntegratorListenerPtr p)
+{
+    listener = p;
+
+    if (stiffIntegrator)
+    {
+        stiffIntegrator->setListener(p);
+    }
+}
+
+IntegratorListenerPtr RK45Integrator::getListener()
+{
+    return listener;
+}
+
+} /* namespace rr */
@@ -0,0 +1,188 @@
+#ifndef RK45INTEGRATOR_H_
+#define RK45INTEGRATOR_H_
+
+#include "Integrator.h"
+#include "rrExecutableModel.h"
+
+#include <vector>
+
+namespace rr
+{
+
+class ExecutableModel;
+
+/**
+ * Explicit embedded Runge-Kutta integrator, the Dormand-Prince 5(4) pair
+ * with the 4th order dense output and step size control of Hairer's DOPRI5,
+ * see Hairer, Norsett and Wanner, Solving Ordinary Differential Equations I.
+ *
+ * This works directly on ExecutableModel::getStateVectorRate and allocates
+ * all of its work vectors once, so for small non-stiff models it has much
+ * less overhead per simulation than the CVODEIntegrator.
+ *
+ * Internal steps are not limited by the output times, the output values
+ * are interpolated with the dense output. Event roots are located within
+ * each step by bisection on the dense output.
+ *
+ * The stiffness test of DOPRI5 is performed on every step. If the model is
+ * found to be stiff, the rest of the simulation is handed over to a
+ * CVODEIntegrator using BDF, until the next restart.
+ *
+ * The following keys may be set in the SimulateOptions:
+ *
+ * rk45StiffSwitch: switch to CVODE BDF when stiffness is detected,
+ * defaults to true.
+ */
+class RK45Integrator: public Integrator
+{
+public:
+    RK45Integrator(ExecutableModel* model, const SimulateOptions* options);
+
+    virtual ~RK45Integrator();
+
+    /**
+     * Set the configuration parameters the integrator uses.
+     */
+    virtual void setSimulateOptions(const SimulateOptions* options);
+
+    /**
+     * integrates the model from t0 to t0 + hstep
+     */
+    virtual double integrate(double t0, double hstep);
+
+    /**
+     * copies the state vector out of the model, applies any events
+     * if t0 <= 0, and resets the step size and stiffness detection.
+     */
+    virtual void restart(double t0);
+
+    /**
+     * the integrator can hold a single listener. If clients require multicast,
+     * they can create a multi-cast listener.
+     */
+    virtual void setListener(IntegratorListenerPtr);
+
+    /**
+     * get the integrator listener
+     */
+    virtual IntegratorListenerPtr getListener();
+
+private:
+    ExecutableModel *model;
+    SimulateOptions options;
+    IntegratorListenerPtr listener;
+
+    int stateVectorSize;
+    int numEvents;
+
+    /**
+     * set by restart, the integrator restarts itself on first use.
+     */
+    bool initialized;
+
+    /**
+     * current internal time and state, may be ahead of the time
+     * last returned by integrate.
+     */
+    double time;
+    std::vector<double> y;
+
+    /**
+     * start of the last step, the dense output is valid between
+     * timeOld and time.
+     */
+    double timeOld;
+
+    /**
+     * size of the last step and the next step
+     */
+    double hLast;
+    double h;
+
+    /**
+     * step size controller state
+     */
+    double facOld;
+    bool lastRejected;
+
+    /**
+     * stages, k1 is the rate at the current state.
+     */
+    std::vector<double> k1, k2, k3, k4, k5, k6, k7;
+    std::vector<double> yNew;
+    std::vector<double> yStage;
+
+    /**
+     * dense output coefficients of the last step.
+     */
+    std::vector<double> rcont1, rcont2, rcont3, rcont4, rcont5;
+
+    /**
+     * event roots at the current time, after a step, and during
+     * root finding.
+     */
+    std::vector<double> rootsOld, rootsNew, rootsMid;
+
+    /**
+     * set when a step was truncated at an event root, the events are
+     * applied before the next step.
+     */
+    bool eventPending;
+    std::vector<unsigned char> eventStatus;
+
+    /**
+     * DOPRI5 stiffness detection counters
+     */
+    int stiffCount;
+    int nonStiffCount;
+    bool stiffDetected;
+
+    bool stiffSwitch;
+    Integrator *stiffIntegrator;
+
+    /**
+     * take one accepted step, no further than timeStop.
+     */
+    void step(double timeStop);
+
+    /**
+     * Hairer's initial step size heuristic.
+     */
+    double initialStep();
+
+    /**
+     * weighted rms norm of v with the tolerances of y.
+     */
+    double norm(const std::vector<double>& v, const std::vector<double>& y) const;
+
+    /**
+     * evaluate the dense output of the last step at t.
+     */
+    void interpolate(double t, std::vector<double>& result) const;
+
+    /**
+     * find the first event root in the last step, truncate the
+     * step to it.
+     */
+    void locateRoot();
+
+    /**
+     * apply the events at the current root, and start over from
+     * the new state.
+     */
+    void applyEvents();
+
+    /**
+     * re-evaluate the rate and event roots after the state was changed.
+     */
+    void resetState();
+
+    /**
+     * hand the simulation over to CVODE, the model state must be at t.
+     */
+    void switchToStiff(double t);
+};
+
+} /* namespace rr */
+
+#endif /* RK45INTEGRATOR_H_ */
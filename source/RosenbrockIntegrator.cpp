@@ -0,0 +1,637 @@
+#pragma hdrstop
+#include "RosenbrockIntegrator.h"
+#include "rrUtils.h"
+#include "rrLogger.h"
+
+#include <sundials/sundials_dense.h>
+
+#include <cmath>
+#include <cfloat>
+#include <limits>
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+// min and max macros on windows
+#undef max
+#undef min
+
+namespace rr
+{
+
+static const double inf = std::numeric_limits<double>::infinity();
+
+static const int defaultMaxNumSteps = 10000;
+
+/**
+ * Rodas4 coefficients, in the form used by Hairer's RODAS, the stage
+ * equations are
+ *
+ * (I / (h gamma) - J) k_i = f(t + c_i h, y + sum_j a_ij k_j)
+ *                           + sum_j (C_ij / h) k_j + d_i h df/dt
+ *
+ * the 3rd order solution is y + sum_j a_5j k_j + k5, the 4th order solution
+ * adds k6, which is also the error estimate.
+ */
+static const double gamma0 = 0.25;
+
+static const double c[6] = { 0.0, 0.386, 0.21, 0.63, 1.0, 1.0 };
+
+static const double d[6] = { 0.25, -0.1043, 0.1035, -0.0362, 0.0, 0.0 };
+
+static const double a[5][4] = {
+    { 0.0, 0.0, 0.0, 0.0 },
+    { 1.544, 0.0, 0.0, 0.0 },
+    { 0.9466785280815826, 0.2557011698983284, 0.0, 0.0 },
+    { 3.314825187068521, 2.896124015972201, 0.9986419139977817, 0.0 },
+    { 1.221224509226641, 6.019134481288629, 12.53708332932087, -0.687886036105895 }
+};
+
+static const double C[6][5] = {
+    { 0.0, 0.0, 0.0, 0.0, 0.0 },
+    { -5.6688, 0.0, 0.0, 0.0, 0.0 },
+    { -2.430093356833875, -0.2063599157091915, 0.0, 0.0, 0.0 },
+    { -0.1073529058151375, -9.594562251023355, -20.47028614809616, 0.0, 0.0 },
+    { 7.496443313967647, -10.24680431464352, -33.99990352819905,
+            11.70890893206160, 0.0 },
+    { 8.083246795921522, -7.981132988064893, -31.52159432874371,
+            16.31930543123136, -6.058818238834054 }
+};
+
+/**
+ * step size control
+ */
+static const double safe = 0.9;
+static const double facMin = 0.2;
+static const double facMax = 6.0;
+
+template <typename T>
+static inline T* data(vector<T>& v)
+{
+    return v.empty() ? 0 : &v[0];
+}
+
+template <typename T>
+static inline const T* data(const vector<T>& v)
+{
+    return v.empty() ? 0 : &v[0];
+}
+
+RosenbrockIntegrator::RosenbrockIntegrator(ExecutableModel* m,
+        const SimulateOptions* o) :
+        model(m),
+        stateVectorSize(0),
+        numEvents(0),
+        initialized(false),
+        exactJacobian(true),
+        time(0),
+        timeOld(0),
+        hLast(0),
+        h(0),
+        lastRejected(false),
+        eventPending(false)
+{
+    Log(Logger::LOG_INFORMATION) << "creating RosenbrockIntegrator";
+
+    if (o)
+    {
+        setSimulateOptions(o);
+    }
+
+    stateVectorSize = model->getStateVector(0);
+    numEvents = model->getNumEvents();
+
+    const int n = stateVectorSize;
+
+    y.resize(n);
+    dydt.resize(n);
+    yOld.resize(n);
+    dydtOld.resize(n);
+    yEnd.resize(n);
+    dydtEnd.resize(n);
+    jac.resize(n * n);
+    lu.resize(n * n);
+    luColumns.resize(n);
+    for (int j = 0; j < n; ++j)
+    {
+        luColumns[j] = &lu[j * n];
+    }
+    pivots.resize(n);
+    dfdt.resize(n);
+    for (int i = 0; i < 6; ++i)
+    {
+        k[i].resize(n);
+    }
+    yNew.resize(n);
+    yStage.resize(n);
+    rhs.resize(n);
+
+    rootsOld.resize(numEvents);
+    rootsNew.resize(numEvents);
+    rootsMid.resize(numEvents);
+    eventStatus.resize(numEvents);
+
+    model->resetEvents();
+}
+
+RosenbrockIntegrator::~RosenbrockIntegrator()
+{
+}
+
+void RosenbrockIntegrator::setSimulateOptions(const SimulateOptions* o)
+{
+    if (o)
+    {
+        options = *o;
+    }
+}
+
+double RosenbrockIntegrator::integrate(double t0, double hstep)
+{
+    const double tout = t0 + hstep;
+
+    // models with no state variables and no events
+    if (stateVectorSize == 0 && numEvents == 0)
+    {
+        model->convertToAmounts();
+        model->getStateVectorRate(tout, 0, 0);
+        return tout;
+    }
+
+    // t0 is outside of the last step if the caller has moved the
+    // model time.
+    const double eps = 16 * DBL_EPSILON * std::max(1.0, fabs(t0));
+    if (!initialized || t0 < timeOld - eps || t0 > time + eps)
+    {
+        restart(t0);
+    }
+
+    const bool singleStep = options.integratorFlags &
+            (SimulateOptions::MULTI_STEP | SimulateOptions::VARIABLE_STEP);
+
+    const int maxSteps = options.maximumNumSteps > 0 ?
+            options.maximumNumSteps : defaultMaxNumSteps;
+
+    int steps = 0;
+
+    while (time < tout)
+    {
+        if (eventPending)
+        {
+            applyEvents();
+        }
+
+        // steps may overshoot tout as the output is interpolated, but
+        // not delayed events or the end of a single step.
+        double timeStop = singleStep ? tout : inf;
+
+        if (model->getPendingEventSize() > 0)
+        {
+            timeStop = std::min(timeStop, model->getNextPendingEventTime(false));
+        }
+
+        if (++steps > maxSteps)
+        {
+            std::stringstream ss;
+            ss << "RosenbrockIntegrator took " << maxSteps << " steps from time "
+                    << t0 << " but could not reach " << tout;
+            throw IntegratorException(ss.str(), __FUNC__);
+        }
+
+        step(timeStop);
+
+        if (numEvents > 0)
+        {
+            locateRoot();
+        }
+
+        if (model->getPendingEventSize() > 0)
+        {
+            int handled = model->applyPendingEvents(data(y), time, tout);
+            if (handled > 0)
+            {
+                eventPending = false;
+                model->getStateVector(data(y));
+                resetState();
+            }
+        }
+
+        if (listener)
+        {
+            model->setTime(time);
+            model->setStateVector(data(y));
+            listener->onTimeStep(this, model, time);
+        }
+
+        if (singleStep)
+        {
+            break;
+        }
+    }
+
+    const double tret = std::min(time, tout);
+
+    if (tret < time)
+    {
+        interpolate(tret, yStage);
+        model->setStateVector(data(yStage));
+    }
+    else
+    {
+        model->setStateVector(data(y));
+    }
+
+    model->setTime(tret);
+
+    try
+    {
+        model->testConstraints();
+    }
+    catch (const std::exception& e)
+    {
+        Log(Logger::LOG_WARNING) << "Constraint Violated at time = " << tret
+                << ": " << e.what();
+    }
+
+    return tret;
+}
+
+void RosenbrockIntegrator::evalJacobian()
+{
+    const int n = stateVectorSize;
+
+    if (exactJacobian)
+    {
+        if (model->getStateVectorJacobian(time, data(y), data(jac)) < 0)
+        {
+            Log(Logger::LOG_NOTICE) << "RosenbrockIntegrator, model does not "
+                    "provide an exact Jacobian, using finite differences";
+            exactJacobian = false;
+        }
+    }
+
+    // forward differences, rhs holds the perturbed rate
+    if (!exactJacobian)
+    {
+        std::copy(y.begin(), y.end(), yStage.begin());
+
+        for (int j = 0; j < n; ++j)
+        {
+            const double delta = sqrt(DBL_EPSILON * std::max(1.e-5, fabs(y[j])));
+            yStage[j] = y[j] + delta;
+            model->getStateVectorRate(time, data(yStage), data(rhs));
+            yStage[j] = y[j];
+
+            for (int i = 0; i < n; ++i)
+            {
+                jac[i * n + j] = (rhs[i] - dydt[i]) / delta;
+            }
+        }
+    }
+
+    const double delta = sqrt(DBL_EPSILON * std::max(1.e-5, fabs(time)));
+    model->getStateVectorRate(time + delta, data(y), data(rhs));
+
+    for (int i = 0; i < n; ++i)
+    {
+        dfdt[i] = (rhs[i] - dydt[i]) / delta;
+    }
+}
+
+void RosenbrockIntegrator::step(double timeStop)
+{
+    const int n = stateVectorSize;
+    const double rtol = options.relative;
+    const double atol = options.absolute;
+    const double hmax = options.maximumTimeStep > 0 ?
+            options.maximumTimeStep : inf;
+
+    if (h <= 0)
+    {
+        h = options.initialTimeStep > 0 ? options.initialTimeStep : initialStep();
+    }
+
+    h = std::min(h, hmax);
+
+    // one Jacobian per step, re-used if the step is rejected
+    evalJacobian();
+
+    while (true)
+    {
+        bool last = false;
+        if (time + 1.01 * h >= timeStop)
+        {
+            h = timeStop - time;
+            last = true;
+        }
+
+        if (h <= 16 * DBL_EPSILON * fabs(time) ||
+                (options.minimumTimeStep > 0 && h < options.minimumTimeStep && !last))
+        {
+            std::stringstream ss;
+            ss << "RosenbrockIntegrator step size too small at time " << time;
+            throw IntegratorException(ss.str(), __FUNC__);
+        }
+
+        // stage matrix I / (h gamma) - J, column major for denseGETRF
+        const double fac = 1.0 / (h * gamma0);
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = 0; j < n; ++j)
+            {
+                lu[j * n + i] = -jac[i * n + j];
+            }
+            lu[i * n + i] += fac;
+        }
+
+        if (n > 0 && denseGETRF(data(luColumns), n, n, data(pivots)) != 0)
+        {
+            Log(Logger::LOG_DEBUG) << "RosenbrockIntegrator, singular "
+                    "matrix at time " << time << ", step size " << h;
+            h *= 0.5;
+            lastRejected = true;
+            continue;
+        }
+
+        const double *py = data(y);
+        double *ps = data(yStage);
+        double *pr = data(rhs);
+
+        for (int s = 0; s < 6; ++s)
+        {
+            if (s == 0)
+            {
+                std::copy(dydt.begin(), dydt.end(), rhs.begin());
+            }
+            else
+            {
+                // the last stage is evaluated at the 3rd order solution
+                if (s < 5)
+                {
+                    for (int i = 0; i < n; ++i)
+                    {
+                        double sum = py[i];
+                        for (int j = 0; j < s; ++j)
+                        {
+                            sum += a[s][j] * k[j][i];
+                        }
+                        ps[i] = sum;
+                    }
+                }
+                else
+                {
+                    for (int i = 0; i < n; ++i)
+                    {
+                        ps[i] += k[4][i];
+                    }
+                }
+
+                model->getStateVectorRate(time + c[s] * h, ps, pr);
+
+                for (int i = 0; i < n; ++i)
+                {
+                    double sum = 0;
+                    for (int j = 0; j < s; ++j)
+                    {
+                        sum += C[s][j] * k[j][i];
+                    }
+                    pr[i] += sum / h;
+                }
+            }
+
+            if (d[s] != 0.0)
+            {
+                for (int i = 0; i < n; ++i)
+                {
+                    pr[i] += d[s] * h * dfdt[i];
+                }
+            }
+
+            if (n > 0)
+            {
+                denseGETRS(data(luColumns), n, data(pivots), pr);
+            }
+            std::copy(rhs.begin(), rhs.end(), k[s].begin());
+        }
+
+        double err = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            yNew[i] = ps[i] + k[5][i];
+            double sc = atol + rtol * std::max(fabs(py[i]), fabs(yNew[i]));
+            err += (k[5][i] / sc) * (k[5][i] / sc);
+        }
+        err = n > 0 ? sqrt(err / n) : 0;
+
+        double hNew = h * std::max(facMin,
+                std::min(facMax, safe * pow(std::max(err, 1.e-10), -0.25)));
+
+        if (err > 1.0)
+        {
+            // rejected
+            h = std::min(hNew, h);
+            lastRejected = true;
+            continue;
+        }
+
+        // accepted
+        timeOld = time;
+        time = last ? timeStop : time + h;
+        hLast = time - timeOld;
+
+        y.swap(yOld);
+        dydt.swap(dydtOld);
+        y.swap(yNew);
+
+        model->getStateVectorRate(time, data(y), data(dydt));
+
+        std::copy(y.begin(), y.end(), yEnd.begin());
+        std::copy(dydt.begin(), dydt.end(), dydtEnd.begin());
+
+        if (lastRejected)
+        {
+            hNew = std::min(hNew, h);
+        }
+        lastRejected = false;
+
+        // keep the step size that was limited by timeStop
+        if (!last)
+        {
+            h = std::min(hNew, hmax);
+        }
+        else
+        {
+            h = std::min(std::max(h, hNew), hmax);
+        }
+
+        break;
+    }
+}
+
+double RosenbrockIntegrator::initialStep()
+{
+    const double hmax = options.maximumTimeStep > 0 ?
+            options.maximumTimeStep : inf;
+
+    double dnf = 0, dny = 0;
+    for (int i = 0; i < stateVectorSize; ++i)
+    {
+        double sc = options.absolute + options.relative * fabs(y[i]);
+        dnf += (dydt[i] / sc) * (dydt[i] / sc);
+        dny += (y[i] / sc) * (y[i] / sc);
+    }
+
+    double h0 = (dnf <= 1.e-20 || dny <= 1.e-20) ? 1.e-6 : 0.01 * sqrt(dny / dnf);
+
+    return std::min(h0, hmax);
+}
+
+void RosenbrockIntegrator::interpolate(double t, std::vector<double>& result) const
+{
+    if (hLast <= 0)
+    {
+        std::copy(y.begin(), y.end(), result.begin());
+        return;
+    }
+
+    const double s = (t - timeOld) / hLast;
+    const double s1 = 1.0 - s;
+
+    // cubic Hermite basis
+    const double h00 = (1.0 + 2.0 * s) * s1 * s1;
+    const double h10 = s * s1 * s1 * hLast;
+    const double h01 = s * s * (3.0 - 2.0 * s);
+    const double h11 = -s * s * s1 * hLast;
+
+    for (int i = 0; i < stateVectorSize; ++i)
+    {
+        result[i] = h00 * yOld[i] + h10 * dydtOld[i]
+                + h01 * yEnd[i] + h11 * dydtEnd[i];
+    }
+}
+
+void RosenbrockIntegrator::locateRoot()
+{
+    model->getEventRoots(time, data(y), data(rootsNew));
+
+    bool found = false;
+    for (int i = 0; i < numEvents && !found; ++i)
+    {
+        found = (rootsOld[i] > 0) != (rootsNew[i] > 0);
+    }
+
+    if (!found)
+    {
+        rootsOld.swap(rootsNew);
+        return;
+    }
+
+    // the roots are +1 for triggered and -1 for not, so bisect on the first
+    // time any event changes state.
+    double lo = timeOld;
+    double hi = time;
+    const double tol = 100 * DBL_EPSILON * (fabs(time) + fabs(hLast));
+
+    while (hi - lo > tol)
+    {
+        double mid = lo + (hi - lo) / 2;
+        interpolate(mid, yStage);
+        model->getEventRoots(mid, data(yStage), data(rootsMid));
+
+        bool changed = false;
+        for (int i = 0; i < numEvents && !changed; ++i)
+        {
+            changed = (rootsOld[i] > 0) != (rootsMid[i] > 0);
+        }
+
+        if (changed)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid;
+        }
+    }
+
+    Log(Logger::LOG_DEBUG) << "RosenbrockIntegrator, event root at time " << hi;
+
+    // truncate the step at the root, the interpolant is still valid
+    // for the whole step.
+    if (hi < time)
+    {
+        interpolate(hi, y);
+        time = hi;
+    }
+
+    for (int i = 0; i < numEvents; ++i)
+    {
+        eventStatus[i] = rootsOld[i] > 0;
+    }
+
+    eventPending = true;
+}
+
+void RosenbrockIntegrator::applyEvents()
+{
+    model->applyEvents(time, &eventStatus[0], data(y), data(y));
+    eventPending = false;
+
+    resetState();
+
+    if (listener)
+    {
+        listener->onEvent(this, model, time);
+    }
+}
+
+void RosenbrockIntegrator::resetState()
+{
+    model->getStateVectorRate(time, data(y), data(dydt));
+
+    if (numEvents > 0)
+    {
+        model->getEventRoots(time, data(y), data(rootsOld));
+    }
+
+    // nothing to interpolate until the next step
+    timeOld = time;
+    hLast = 0;
+}
+
+void RosenbrockIntegrator::restart(double t0)
+{
+    if (numEvents > 0 && t0 <= 0.0)
+    {
+        // apply any events that trigger before or at time 0, same as
+        // the CVODEIntegrator.
+        model->getStateVector(data(y));
+        model->getEventTriggers(numEvents, 0, &eventStatus[0]);
+        model->applyEvents(0, &eventStatus[0], data(y), data(y));
+    }
+
+    model->setTime(t0);
+    model->getStateVector(data(y));
+
+    time = t0;
+    h = 0;
+    lastRejected = false;
+    eventPending = false;
+
+    resetState();
+
+    initialized = true;
+}
+
+void RosenbrockIntegrator::setListener(IntegratorListenerPtr p)
+{
+    listener = p;
+}
+
+IntegratorListenerPtr RosenbrockIntegrator::getListener()
+{
+    return listener;
+}
+
+} /* namespace rr */
@@ -0,0 +1,183 @@
+#ifndef ROSENBROCKINTEGRATOR_H_
+#define ROSENBROCKINTEGRATOR_H_
+
+#include "Integrator.h"
+#include "rrExecutableModel.h"
+
+#include <vector>
+
+namespace rr
+{
+
+class ExecutableModel;
+
+/**
+ * Linearly implicit Rosenbrock integrator for stiff models, the 4th order
+ * Rodas4 method with an embedded 3rd order error estimate, see Hairer and
+ * Wanner, Solving Ordinary Differential Equations II, section IV.7.
+ *
+ * Each step evaluates the Jacobian once, with
+ * ExecutableModel::getStateVectorJacobian if the model provides an exact one,
+ * otherwise by finite differences of getStateVectorRate, and performs a single
+ * dense LU factorization of I / (h gamma) - J which is used for all six
+ * stages. No Newton iterations are needed, so for small stiff models this is
+ * usually much cheaper than the BDF method of the CVODEIntegrator.
+ *
+ * All the work arrays are allocated once. The output values and event roots
+ * are found with cubic Hermite interpolation over the last step, event roots
+ * are located by bisection on ExecutableModel::getEventRoots, the same as the
+ * RK45Integrator.
+ */
+class RosenbrockIntegrator: public Integrator
+{
+public:
+    RosenbrockIntegrator(ExecutableModel* model, const SimulateOptions* options);
+
+    virtual ~RosenbrockIntegrator();
+
+    /**
+     * Set the configuration parameters the integrator uses.
+     */
+    virtual void setSimulateOptions(const SimulateOptions* options);
+
+    /**
+     * integrates the model from t0 to t0 + hstep
+     */
+    virtual double integrate(double t0, double hstep);
+
+    /**
+     * copies the state vector out of the model, applies any events
+     * if t0 <= 0, and resets the step size.
+     */
+    virtual void restart(double t0);
+
+    /**
+     * the integrator can hold a single listener. If clients require multicast,
+     * they can create a multi-cast listener.
+     */
+    virtual void setListener(IntegratorListenerPtr);
+
+    /**
+     * get the integrator listener
+     */
+    virtual IntegratorListenerPtr getListener();
+
+private:
+    ExecutableModel *model;
+    SimulateOptions options;
+    IntegratorListenerPtr listener;
+
+    int stateVectorSize;
+    int numEvents;
+
+    /**
+     * set by restart, the integrator restarts itself on first use.
+     */
+    bool initialized;
+
+    /**
+     * cleared the first time the model does not provide an exact
+     * Jacobian, finite differences are used from then on.
+     */
+    bool exactJacobian;
+
+    /**
+     * current internal time, state and rate, may be ahead of the time
+     * last returned by integrate.
+     */
+    double time;
+    std::vector<double> y;
+    std::vector<double> dydt;
+
+    /**
+     * state and rate at the start and end of the last step, the
+     * interpolant is valid between timeOld and timeOld + hLast.
+     */
+    double timeOld;
+    std::vector<double> yOld, dydtOld;
+    std::vector<double> yEnd, dydtEnd;
+
+    /**
+     * size of the last step and the next step
+     */
+    double hLast;
+    double h;
+
+    bool lastRejected;
+
+    /**
+     * row major Jacobian, and the column major LU factors of the stage
+     * matrix, with a pointer to each column for denseGETRF.
+     */
+    std::vector<double> jac;
+    std::vector<double> lu;
+    std::vector<double*> luColumns;
+    std::vector<long> pivots;
+
+    /**
+     * partial derivative of the rate with respect to time.
+     */
+    std::vector<double> dfdt;
+
+    /**
+     * stages
+     */
+    std::vector<double> k[6];
+    std::vector<double> yNew;
+    std::vector<double> yStage;
+    std::vector<double> rhs;
+
+    /**
+     * event roots at the current time, after a step, and during
+     * root finding.
+     */
+    std::vector<double> rootsOld, rootsNew, rootsMid;
+
+    /**
+     * set when a step was truncated at an event root, the events are
+     * applied before the next step.
+     */
+    bool eventPending;
+    std::vector<unsigned char> eventStatus;
+
+    /**
+     * take one accepted step, no further than timeStop.
+     */
+    void step(double timeStop);
+
+    /**
+     * evaluate jac and dfdt at the current time and state.
+     */
+    void evalJacobian();
+
+    /**
+     * initial step size heuristic.
+     */
+    double initialStep();
+
+    /**
+     * evaluate the interpolant of the last step at t.
+     */
+    void interpolate(double t, std::vector<double>& result) const;
+
+    /**
+     * find the first event root in the last step, truncate the
+     * step to it.
+     */
+    void locateRoot();
+
+    /**
+     * apply the events at the current root, and start over from
+     * the new state.
+     */
+    void applyEvents();
+
+    /**
+     * re-evaluate the rate and event roots after the state was changed.
+     */
+    void resetState();
+};
+
+} /* namespace rr */
+
+#endif /* ROSENBROCKINTEGRATOR_H_ */
@@ -0,0 +1,564 @@
+#include "TauLeapingIntegrator.h"
+#include "rrUtils.h"
+#include "rrLogger.h"
+
+#include <cmath>
+#include <assert.h>
+#include <ctime>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+// min and max macros on windows interfer with max method of engine.
+#undef max
+#undef min
+
+namespace rr
+{
+
+static const double inf = std::numeric_limits<double>::infinity();
+
+/**
+ * the g_i factor of Cao, Gillespie and Petzold, depends on the highest
+ * order of the reactions species i is a reactant in, and how many
+ * molecules of i that reaction requires.
+ */
+static double gFactor(int order, double stoich, double x)
+{
+    double x1 = std::max(x - 1., 1.);
+    double x2 = std::max(x - 2., 1.);
+
+    switch (order)
+    {
+    case 0:
+    case 1:
+        return 1.;
+    case 2:
+        return stoich >= 2. ? 2. + 1. / x1 : 2.;
+    case 3:
+        if (stoich >= 3.)
+        {
+            return 3. + 1. / x1 + 2. / x2;
+        }
+        else if (stoich >= 2.)
+        {
+            return 1.5 * (2. + 1. / x1);
+        }
+        return 3.;
+    default:
+        return order;
+    }
+}
+
+TauLeapingIntegrator::TauLeapingIntegrator(ExecutableModel* m,
+        const SimulateOptions* o) :
+        model(m),
+        stoichScale(1.0),
+        epsilon(0.03),
+        criticalThreshold(10.),
+        ssaThreshold(10.),
+        ssaSteps(100)
+{
+    nReactions = model->getNumReactions();
+    stateVectorSize = model->getStateVector(0);
+    nSpecies = model->getNumIndFloatingSpecies();
+    floatingSpeciesStart = stateVectorSize - nSpecies;
+
+    assert(floatingSpeciesStart >= 0);
+
+    reactionRates.resize(nReactions);
+    propensities.resize(nReactions);
+    critical.resize(nReactions);
+    stateVector.resize(stateVectorSize);
+    newStateVector.resize(stateVectorSize);
+    mu.resize(nSpecies);
+    sigma2.resize(nSpecies);
+    highestOrder.resize(nSpecies);
+    highestOrderStoich.resize(nSpecies);
+
+    // get rows and columns
+    int rows = 0, cols = 0;
+    model->getStoichiometryMatrix(&rows, &cols, 0);
+    double *data = new double[rows * cols];
+    model->getStoichiometryMatrix(&rows, &cols, &data);
+
+    // the dense matrix is row major, species x reactions, only the
+    // rows of the independent species are used, same as the Gillespie.
+    stoichColPtr.resize(nReactions + 1);
+    for (int j = 0; j < nReactions && j < cols; ++j)
+    {
+        stoichColPtr[j] = stoichRows.size();
+        for (int i = 0; i < nSpecies && i < rows; ++i)
+        {
+            double v = data[i * cols + j];
+            if (v != 0)
+            {
+                stoichRows.push_back(i);
+                stoichValues.push_back(v);
+            }
+        }
+    }
+    for (int j = std::min(nReactions, cols); j <= nReactions; ++j)
+    {
+        stoichColPtr[j] = stoichRows.size();
+    }
+
+    delete[] data;
+
+    Log(Logger::LOG_DEBUG) << "tau leaping, " << nReactions << " reactions, "
+            << nSpecies << " species, " << stoichValues.size()
+            << " non-zero stoichiometries";
+
+    setSimulateOptions(o);
+}
+
+TauLeapingIntegrator::~TauLeapingIntegrator()
+{
+}
+
+void TauLeapingIntegrator::setSimulateOptions(const SimulateOptions* o)
+{
+    if (o)
+    {
+        options = *o;
+
+        if(options.hasKey("stoichScale"))
+        {
+            stoichScale = options.getValue("stoichScale").convert<double>();
+        }
+
+        if(options.hasKey("tauEpsilon"))
+        {
+            epsilon = options.getValue("tauEpsilon").convert<double>();
+        }
+
+        if(options.hasKey("tauCriticalThreshold"))
+        {
+            criticalThreshold = options.getValue("tauCriticalThreshold").convert<double>();
+        }
+
+        if(options.hasKey("tauSSAThreshold"))
+        {
+            ssaThreshold = options.getValue("tauSSAThreshold").convert<double>();
+        }
+
+        if(options.hasKey("tauSSASteps"))
+        {
+            ssaSteps = options.getValue("tauSSASteps").convert<int>();
+        }
+
+        if (epsilon <= 0 || epsilon >= 1)
+        {
+            throw IntegratorException("tauEpsilon must be between 0 and 1");
+        }
+
+        Log(Logger::LOG_DEBUG) << "tau leaping, epsilon: " << epsilon
+                << ", critical threshold: " << criticalThreshold
+                << ", ssa threshold: " << ssaThreshold
+                << ", ssa steps: " << ssaSteps;
+    }
+}
+
+double TauLeapingIntegrator::integrate(double t, double hstep)
+{
+    double tf = 0;
+    bool singleStep;
+
+    assert(hstep > 0 && "hstep must be > 0");
+
+    if (options.integratorFlags & SimulateOptions::VARIABLE_STEP)
+    {
+        if (options.minimumTimeStep > 0.0)
+        {
+            tf = t + options.minimumTimeStep;
+            singleStep = false;
+        }
+        else
+        {
+            tf = t + hstep;
+            singleStep = true;
+        }
+    }
+    else
+    {
+        tf = t + hstep;
+        singleStep = false;
+    }
+
+    Log(Logger::LOG_DEBUG) << "tau leaping(" << t << ", " << tf << ")";
+
+    // get the initial state vector
+    model->setTime(t);
+    model->getStateVector(&stateVector[0]);
+
+    while (t < tf)
+    {
+        double a0 = updatePropensities();
+
+        if (a0 <= 0)
+        {
+            // no reaction occurs
+            return inf;
+        }
+
+        double tau1 = selectNonCriticalTau();
+
+        // leap would not be much longer than the expected time to the
+        // next reaction, simulate exactly instead.
+        if (tau1 < ssaThreshold / a0)
+        {
+            for (int k = 0; k < ssaSteps && t < tf && a0 > 0; ++k)
+            {
+                t = ssaStep(t, tf, a0);
+
+                if (singleStep)
+                {
+                    return t;
+                }
+
+                a0 = updatePropensities();
+            }
+
+            if (a0 <= 0 && t < tf)
+            {
+                return inf;
+            }
+            continue;
+        }
+
+        // sum of the critical propensities
+        double a0c = 0;
+        for (int j = 0; j < nReactions; ++j)
+        {
+            if (critical[j])
+            {
+                a0c += propensities[j];
+            }
+        }
+
+        double tau;
+
+        // leap, halving the non-critical step whenever a species
+        // would go negative.
+        while (true)
+        {
+            double tau2 = a0c > 0 ? -log(urand()) / a0c : inf;
+            bool fireCritical = tau2 <= tau1;
+            tau = fireCritical ? tau2 : tau1;
+
+            if (t + tau > tf)
+            {
+                tau = tf - t;
+                fireCritical = false;
+            }
+
+            newStateVector = stateVector;
+
+            for (int j = 0; j < nReactions; ++j)
+            {
+                if (!critical[j] && propensities[j] > 0)
+                {
+                    double n = poisson(propensities[j] * tau);
+                    if (n > 0)
+                    {
+                        fireReaction(j, n);
+                    }
+                }
+            }
+
+            if (fireCritical)
+            {
+                double r = urand() * a0c;
+                double sp = 0;
+                int reaction = -1;
+                for (int j = 0; j < nReactions; ++j)
+                {
+                    if (critical[j])
+                    {
+                        reaction = j;
+                        sp += propensities[j];
+                        if (r < sp)
+                        {
+                            break;
+                        }
+                    }
+                }
+
+                assert(reaction >= 0);
+                fireReaction(reaction, 1);
+            }
+
+            bool negative = false;
+            for (int i = floatingSpeciesStart; i < stateVectorSize; ++i)
+            {
+                if (newStateVector[i] < 0)
+                {
+                    negative = true;
+                    break;
+                }
+            }
+
+            if (!negative)
+            {
+                break;
+            }
+
+            Log(Logger::LOG_TRACE) << "rejecting leap of " << tau
+                    << ", negative population";
+
+            tau1 = tau1 / 2.;
+        }
+
+        t = t + tau;
+        stateVector.swap(newStateVector);
+
+        // rates could be time dependent
+        model->setTime(t);
+        model->setStateVector(&stateVector[0]);
+
+        if (singleStep)
+        {
+            return t;
+        }
+    }
+
+    return t;
+}
+
+double TauLeapingIntegrator::updatePropensities()
+{
+    double a0 = 0;
+
+    model->getReactionRates(nReactions, 0, &reactionRates[0]);
+
+    for (int j = 0; j < nReactions; ++j)
+    {
+        // if reaction rate is negative, the reaction goes in reverse,
+        // same as the Gillespie.
+        propensities[j] = std::abs(reactionRates[j]);
+        a0 += propensities[j];
+    }
+
+    return a0;
+}
+
+double TauLeapingIntegrator::selectNonCriticalTau()
+{
+    std::fill(mu.begin(), mu.end(), 0.);
+    std::fill(sigma2.begin(), sigma2.end(), 0.);
+    std::fill(highestOrder.begin(), highestOrder.end(), 0);
+    std::fill(highestOrderStoich.begin(), highestOrderStoich.end(), 0.);
+
+    for (int j = 0; j < nReactions; ++j)
+    {
+        critical[j] = false;
+
+        if (propensities[j] <= 0)
+        {
+            continue;
+        }
+
+        double sign = (reactionRates[j] > 0) - (reactionRates[j] < 0);
+
+        // the number of times this reaction can fire before exhausting
+        // a reactant, and its order, taken from the reactant stoichiometry.
+        double firings = inf;
+        int order = 0;
+
+        for (unsigned k = stoichColPtr[j]; k < stoichColPtr[j + 1]; ++k)
+        {
+            double v = stoichValues[k] * stoichScale * sign;
+            if (v < 0)
+            {
+                double x = stateVector[floatingSpeciesStart + stoichRows[k]];
+                firings = std::min(firings, std::floor(x / -v));
+                order += (int)std::ceil(-stoichValues[k] * sign);
+            }
+        }
+
+        if (firings < criticalThreshold)
+        {
+            critical[j] = true;
+            continue;
+        }
+
+        for (unsigned k = stoichColPtr[j]; k < stoichColPtr[j + 1]; ++k)
+        {
+            unsigned i = stoichRows[k];
+            double v = stoichValues[k] * stoichScale * sign;
+
+            mu[i] += v * propensities[j];
+            sigma2[i] += v * v * propensities[j];
+
+            if (v < 0)
+            {
+                double nu = -stoichValues[k] * sign;
+                if (order > highestOrder[i] ||
+                        (order == highestOrder[i] && nu > highestOrderStoich[i]))
+                {
+                    highestOrder[i] = order;
+                    highestOrderStoich[i] = nu;
+                }
+            }
+        }
+    }
+
+    double tau = inf;
+
+    // only species that are reactants of non-critical reactions
+    // bound the step.
+    for (int i = 0; i < nSpecies; ++i)
+    {
+        if (highestOrder[i] == 0)
+        {
+            continue;
+        }
+
+        double x = stateVector[floatingSpeciesStart + i];
+        double g = gFactor(highestOrder[i], highestOrderStoich[i], x);
+        double bound = std::max(epsilon * x / g, 1.);
+
+        if (mu[i] != 0)
+        {
+            tau = std::min(tau, bound / std::abs(mu[i]));
+        }
+
+        if (sigma2[i] != 0)
+        {
+            tau = std::min(tau, bound * bound / sigma2[i]);
+        }
+    }
+
+    return tau;
+}
+
+double TauLeapingIntegrator::ssaStep(double t, double tf, double a0)
+{
+    double tau = -log(urand()) / a0;
+
+    // reactions are memoryless, so stopping at tf without firing is exact.
+    if (t + tau > tf)
+    {
+        t = tf;
+        model->setTime(t);
+        return t;
+    }
+
+    double r = urand() * a0;
+    double sp = 0;
+    int reaction = nReactions - 1;
+
+    for (int j = 0; j < nReactions; ++j)
+    {
+        sp += propensities[j];
+        if (r < sp)
+        {
+            reaction = j;
+            break;
+        }
+    }
+
+    newStateVector = stateVector;
+    fireReaction(reaction, 1);
+    stateVector.swap(newStateVector);
+
+    t = t + tau;
+
+    model->setTime(t);
+    model->setStateVector(&stateVector[0]);
+
+    return t;
+}
+
+void TauLeapingIntegrator::fireReaction(int reaction, double n)
+{
+    double sign = (reactionRates[reaction] > 0) - (reactionRates[reaction] < 0);
+
+    for (unsigned k = stoichColPtr[reaction]; k < stoichColPtr[reaction + 1]; ++k)
+    {
+        newStateVector[floatingSpeciesStart + stoichRows[k]] +=
+                n * stoichValues[k] * stoichScale * sign;
+    }
+}
+
+void TauLeapingIntegrator::restart(double t0)
+{
+    random.seed(options);
+}
+
+void TauLeapingIntegrator::setListener(IntegratorListenerPtr)
+{
+}
+
+IntegratorListenerPtr TauLeapingIntegrator::getListener()
+{
+    return IntegratorListenerPtr();
+}
+
+double TauLeapingIntegrator::urand()
+{
+    return random.uniform();
+}
+
+/**
+ * Poisson random variate, multiplication method for small means,
+ * Hormann's transformed rejection (PTRS) for larger ones.
+ */
+double TauLeapingIntegrator::poisson(double mean)
+{
+    if (mean <= 0)
+    {
+        return 0;
+    }
+
+    if (mean < 10)
+    {
+        double l = exp(-mean);
+        double p = 1;
+        double k = 0;
+
+        while (true)
+        {
+            p *= urand();
+            if (p <= l)
+            {
+                return k;
+            }
+            k += 1;
+        }
+    }
+
+    double slam = sqrt(mean);
+    double loglam = log(mean);
+    double b = 0.931 + 2.53 * slam;
+    double a = -0.059 + 0.02483 * b;
+    double invalpha = 1.1239 + 1.1328 / (b - 3.4);
+    double vr = 0.9277 - 3.6224 / (b - 2);
+
+    while (true)
+    {
+        double u = urand() - 0.5;
+        double v = urand();
+        double us = 0.5 - std::abs(u);
+        double k = std::floor((2 * a / us + b) * u + mean + 0.43);
+
+        if ((us >= 0.07) && (v <= vr))
+        {
+            return k;
+        }
+
+        if ((k < 0) || ((us < 0.013) && (v > us)))
+        {
+            continue;
+        }
+
+        if ((log(v) + log(invalpha) - log(a / (us * us) + b)) <=
+                (-mean + k * loglam - lgamma(k + 1)))
+        {
+            return k;
+        }
+    }
+}
+
+} /* namespace rr */
@@ -0,0 +1,160 @@
+#ifndef TAULEAPINGINTEGRATOR_H_
+#define TAULEAPINGINTEGRATOR_H_
+
+#include "Integrator.h"
+#include "rrExecutableModel.h"
+#include "rrPhiloxRandom.h"
+
+#include <vector>
+
+
+
+namespace rr
+{
+
+class ExecutableModel;
+
+/**
+ * Adaptive explicit tau-leaping stochastic integrator.
+ *
+ * Instead of simulating every reaction firing like the GillespieIntegrator,
+ * each step leaps forward by a time tau over which the propensities are
+ * not expected to change much, and the number of firings of each reaction
+ * in that interval is sampled from a Poisson distribution.
+ *
+ * The step size is selected with the species based formula of
+ * Cao, Gillespie and Petzold, "Efficient step size selection for the
+ * tau-leaping simulation method", J. Chem. Phys. 124, 044109 (2006).
+ *
+ * Reactions that are within a few firings of exhausting one of their
+ * reactants are considered critical, at most one critical reaction fires
+ * per leap, and is chosen as in the exact SSA. If the leap would be so
+ * short that it is no better than exact simulation, a batch of exact SSA
+ * steps are taken instead.
+ *
+ * Like the GillespieIntegrator, the reaction rates are taken as the
+ * propensities, and the floating species amounts as the molecule counts.
+ *
+ * The following keys may be set in the SimulateOptions:
+ *
+ * stoichScale: scale factor for stoichiometry, same as the GillespieIntegrator.
+ *
+ * tauEpsilon: the error control parameter, the relative change in propensity
+ * allowed in a leap, defaults to 0.03.
+ *
+ * tauCriticalThreshold: a reaction is critical if it can fire fewer than
+ * this many times before exhausting a reactant, defaults to 10.
+ *
+ * tauSSAThreshold: if the leap is shorter than this many times the expected
+ * time to the next reaction, exact SSA steps are taken, defaults to 10.
+ *
+ * tauSSASteps: number of exact steps to take in that case, defaults to 100.
+ */
+class TauLeapingIntegrator: public Integrator
+{
+public:
+    TauLeapingIntegrator(ExecutableModel* model, const SimulateOptions* options);
+
+    virtual ~TauLeapingIntegrator();
+
+    /**
+     * Set the configuration parameters the integrator uses.
+     */
+    virtual void setSimulateOptions(const SimulateOptions* options);
+
+    /**
+     * integrates the model from t0 to t0 + hstep
+     */
+    virtual double integrate(double t0, double hstep);
+
+    /**
+     * re-seeds the random number generator, see
+     * GillespieIntegrator::restart.
+     */
+    virtual void restart(double t0);
+
+    /**
+     * the integrator can hold a single listener. If clients require multicast,
+     * they can create a multi-cast listener.
+     */
+    virtual void setListener(IntegratorListenerPtr);
+
+    /**
+     * get the integrator listener
+     */
+    virtual IntegratorListenerPtr getListener();
+
+private:
+    ExecutableModel *model;
+    SimulateOptions options;
+
+    PhiloxRandom random;
+
+    double stoichScale;
+    double epsilon;
+    double criticalThreshold;
+    double ssaThreshold;
+    int ssaSteps;
+
+    int nReactions;
+    int nSpecies;
+
+    // starting index of floating species
+    int floatingSpeciesStart;
+    int stateVectorSize;
+
+    // signed reaction rates, and their absolute values, the propensities
+    std::vector<double> reactionRates;
+    std::vector<double> propensities;
+
+    std::vector<double> stateVector;
+    std::vector<double> newStateVector;
+
+    /**
+     * stoichiometry matrix in compressed sparse column format, so the
+     * species changed by reaction j are
+     * stoichRows[stoichColPtr[j]] ... stoichRows[stoichColPtr[j+1]-1].
+     */
+    std::vector<unsigned> stoichColPtr;
+    std::vector<unsigned> stoichRows;
+    std::vector<double> stoichValues;
+
+    std::vector<bool> critical;
+
+    // per species work space for the step size selection
+    std::vector<double> mu;
+    std::vector<double> sigma2;
+    std::vector<int> highestOrder;
+    std::vector<double> highestOrderStoich;
+
+    /**
+     * evaluate the propensities at the current state, returns their sum.
+     */
+    double updatePropensities();
+
+    /**
+     * mark the critical reactions, and get the largest leap for
+     * the non-critical reactions.
+     */
+    double selectNonCriticalTau();
+
+    /**
+     * take a single exact SSA step, but not past tf.
+     *
+     * @returns the new time.
+     */
+    double ssaStep(double t, double tf, double a0);
+
+    /**
+     * fire the given reaction n times in the new state vector.
+     */
+    void fireReaction(int reaction, double n);
+
+    double urand();
+
+    double poisson(double mean);
+};
+
+} /* namespace rr */
+
+#endif /* TAULEAPINGINTEGRATOR_H_ */
@@ -16,6 +16,11 @@
 #include "rrStringUtils.h"
 #include "rrUtils.h"
 #include "rrRoadRunner.h"
+#include "rrModelSharedLibrary.h"
+#if defined(RR_USE_LIBTCC)
+#include "libtcc.h"
+#endif
+#include <stdlib.h>
 //---------------------------------------------------------------------------
 
 using namespace std;
@@ -26,7 +31,8 @@ CCompiler::CCompiler(const string& supportCodeFolder, const string& compiler)
 :
 mSupportCodeFolder(supportCodeFolder),
 mCompilerName(getFileName(compiler)),
-mCompilerLocation(getFilePath(compiler))
+mCompilerLocation(getFilePath(compiler)),
+mOptimize(false)
 {
     if(mSupportCodeFolder.size() > 0)
     {
@@ -89,6 +95,156 @@ bool CCompiler::compileSource(const string& sourceFileName)
     return fileExists(mDLLFileName);
 }
 
+#if defined(RR_USE_LIBTCC)
+/**
+ * collects the libtcc errors and warnings.
+ */
+static void tccError(void* opaque, const char* msg)
+{
+    static_cast<vector<string>*>(opaque)->push_back(msg);
+}
+#endif
+
+bool CCompiler::compileSourceInMemory(const string& source,
+        const vector<string>& symbols, ModelSharedLibrary& lib)
+{
+#if defined(RR_USE_LIBTCC)
+    mCompilerOutput.clear();
+
+    TCCState* state = tcc_new();
+    if(!state)
+    {
+        throw Exception("Could not create the libtcc compiler");
+    }
+
+    tcc_set_error_func(state, &mCompilerOutput, tccError);
+
+    // libtcc1.a and the tcc headers are installed in compilers/tcc, next
+    // to the support code
+    tcc_set_lib_path(state, joinPath(mSupportCodeFolder, "..", "compilers", "tcc").c_str());
+    tcc_add_include_path(state, mSupportCodeFolder.c_str());
+
+#if defined(__linux__) && defined(__x86_64__)
+    // tcc predates the multiarch glibc layout
+    if(folderExists("/usr/include/x86_64-linux-gnu"))
+    {
+        tcc_add_sysinclude_path(state, "/usr/include/x86_64-linux-gnu");
+    }
+#elif defined(__linux__) && defined(__i386__)
+    if(folderExists("/usr/include/i386-linux-gnu"))
+    {
+        tcc_add_sysinclude_path(state, "/usr/include/i386-linux-gnu");
+    }
+#endif
+
+    tcc_set_output_type(state, TCC_OUTPUT_MEMORY);
+
+    void* code = 0;
+    bool ok = tcc_compile_string(state, source.c_str()) == 0
+            && tcc_add_file(state, joinPath(mSupportCodeFolder, "rrSupport.c").c_str()) == 0;
+
+    if(ok)
+    {
+        int size = tcc_relocate(state, 0);
+        code = size > 0 ? malloc(size) : 0;
+        ok = code && tcc_relocate(state, code) == 0;
+    }
+
+    for(int i = 0; i < mCompilerOutput.size(); i++)
+    {
+        Log(ok ? lDebug : Logger::LOG_ERROR)<<"libtcc: "<<mCompilerOutput[i];
+    }
+
+    // the symbols are only looked up in the tcc state, which is deleted
+    // here while the caller still serializes libtcc.
+    std::map<string, void*> addresses;
+    for(int i = 0; ok && i < symbols.size(); i++)
+    {
+        if(void* address = tcc_get_symbol(state, symbols[i].c_str()))
+        {
+            addresses[symbols[i]] = address;
+        }
+    }
+
+    tcc_delete(state);
+
+    if(!ok)
+    {
+        free(code);
+        return false;
+    }
+
+    return lib.load(code, addresses);
+#else
+    throw Exception("roadrunner was built without libtcc, models can not be compiled in memory");
+#endif
+}
+
+bool CCompiler::hasInMemoryCompiler()
+{
+#if defined(RR_USE_LIBTCC)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CCompiler::setOptimize(bool optimize)
+{
+    mOptimize = optimize;
+}
+
+bool CCompiler::getOptimize() const
+{
+    return mOptimize;
+}
+
+string CCompiler::getCompilerSignature() const
+{
+    return getCompilerPath() + (mOptimize ? " -O3" : " -O0");
+}
+
+string CCompiler::getCompilerPath() const
+{
+    if(mOptimize)
+    {
+        return getenv("CC") ? getenv("CC") : "gcc";
+    }
+    return joinPath(mCompilerLocation, mCompilerName);
+}
+
+string CCompiler::getCompilerBaseName() const
+{
+    if(!mOptimize)
+    {
+        return getFileNameNoExtension(mCompilerName);
+    }
+
+    // $CC is a command line, the compiler is the last word which is not
+    // an option, anything before it is a launcher.
+    vector<string> words = splitString(getCompilerPath(), " \t");
+    string compiler;
+    for(int i = 0; i < words.size(); i++)
+    {
+        if(words[i].size() && words[i][0] != '-')
+        {
+            compiler = words[i];
+        }
+    }
+    return getFileNameNoExtension(compiler);
+}
+
+void CCompiler::checkCompiler() const
+{
+    const string name = getCompilerBaseName();
+    if(name.empty() || name == "cl")
+    {
+        throw Exception("The C compiler '" + getCompilerPath() + "' is not supported, "
+                "models are built with gcc style options, set CC to a compiler "
+                "which takes these, such as gcc or clang");
+    }
+}
+
 bool CCompiler::setCompiler(const string& compiler)
 {
     mCompilerName = getFileName(compiler);
@@ -138,56 +294,60 @@ bool CCompiler::setupCompilerEnvironment()
     mIncludePaths.clear();
     mLibraryPaths.clear();
     mCompilerFlags.clear();
-    if(getFileNameNoExtension(mCompilerName) == "tcc" || getFileNameNoExtension(mCompilerName) == "gcc")
+    checkCompiler();
+
+    // tcc, gcc, cc, clang and cross compilers all take gcc style options
+    const string name = getCompilerBaseName();
+    if(!mOptimize)
     {
-        mCompilerFlags.push_back("-g");         //-g adds runtime debug information
+        mCompilerFlags.push_back("-g");     //-g adds runtime debug information
+    }
 #if defined(__unix__) || defined(_WIN32)
-        mCompilerFlags.push_back("-shared");
-        mCompilerFlags.push_back("-rdynamic");  //-rdynamic : Export global symbols to the dynamic linker
+    mCompilerFlags.push_back("-shared");
+    mCompilerFlags.push_back("-rdynamic");  //-rdynamic : Export global symbols to the dynamic linker
 #elif defined(__APPLE__)
-        mCompilerFlags.push_back("-dynamiclib");
+    mCompilerFlags.push_back("-dynamiclib");
 #endif
-                                                //-b : Generate additional support code to check memory allocations and array/pointer bounds. `-g' is implied.
+                                            //-b : Generate additional support code to check memory allocations and array/pointer bounds. `-g' is implied.
+
+    mCompilerFlags.push_back("-fPIC"); // shared lib
+    mCompilerFlags.push_back(mOptimize ? "-O3" : "-O0"); // optimize for long simulations, or compile fast
 
-        mCompilerFlags.push_back("-fPIC"); // shared lib
-        mCompilerFlags.push_back("-O0"); // turn off optimization
+    //LogLevel                              //-v is for verbose
+    if(name == "tcc")
+    {
+        mIncludePaths.push_back(".");
+        mIncludePaths.push_back("r:/rrl/source");
 
-        //LogLevel                              //-v is for verbose
-        if(getFileNameNoExtension(mCompilerName) == "tcc")
+        mIncludePaths.push_back(joinPath(mCompilerLocation, "include"));
+        mLibraryPaths.push_back(".");
+        mLibraryPaths.push_back(joinPath(mCompilerLocation, "lib"));
+        if(gLog.getLevel() < lDebug)
+        {
+            mCompilerFlags.push_back("-v"); // suppress warnings
+        }
+        else if(gLog.getLevel() >= lDebug1)
+        {
+            mCompilerFlags.push_back("-vv");
+        }
+        else if(gLog.getLevel() >= lDebug2)
+        {
+            mCompilerFlags.push_back("-vvv");
+        }
+    }
+    else
+    {
+        if(gLog.getLevel() < lDebug)
         {
-            mIncludePaths.push_back(".");
-            mIncludePaths.push_back("r:/rrl/source");
-
-            mIncludePaths.push_back(joinPath(mCompilerLocation, "include"));
-            mLibraryPaths.push_back(".");
-            mLibraryPaths.push_back(joinPath(mCompilerLocation, "lib"));
-            if(gLog.getLevel() < lDebug)
-            {
-                mCompilerFlags.push_back("-v"); // suppress warnings
-            }
-            else if(gLog.getLevel() >= lDebug1)
-            {
-                mCompilerFlags.push_back("-vv");
-            }
-            else if(gLog.getLevel() >= lDebug2)
-            {
-                mCompilerFlags.push_back("-vvv");
-            }
+            mCompilerFlags.push_back("-w"); // suppress warnings
         }
-        else if(getFileNameNoExtension(mCompilerName) == "gcc")
+        else if(gLog.getLevel() >= lDebug1)
         {
-            if(gLog.getLevel() < lDebug)
-            {
-                mCompilerFlags.push_back("-w"); // suppress warnings
-            }
-            else if(gLog.getLevel() >= lDebug1)
-            {
-                mCompilerFlags.push_back("-Wall");
-            }
-            else if(gLog.getLevel() >= lDebug2)
-            {
-                mCompilerFlags.push_back("-Wall -pedantic");
-            }
+            mCompilerFlags.push_back("-Wall");
+        }
+        else if(gLog.getLevel() >= lDebug2)
+        {
+            mCompilerFlags.push_back("-Wall -pedantic");
         }
     }
 
@@ -198,35 +358,30 @@ bool CCompiler::setupCompilerEnvironment()
 string CCompiler::createCompilerCommand(const string& sourceFileName)
 {
     stringstream exeCmd;
-    if(getFileNameNoExtension(mCompilerName) == "tcc"
-       || getFileNameNoExtension(mCompilerName) == "gcc"
-       || getFileNameNoExtension(mCompilerName) == "cc")
+    // standard unix compiler options
+    exeCmd<<getCompilerPath();
+    //Add compiler flags
+    for(int i = 0; i < mCompilerFlags.size(); i++)
     {
-        // standard unix compiler options
-        exeCmd<<joinPath(mCompilerLocation, mCompilerName);
-        //Add compiler flags
-        for(int i = 0; i < mCompilerFlags.size(); i++)
-        {
-            exeCmd<<" "<<mCompilerFlags[i];
-        }
-        exeCmd<<" \""<<sourceFileName<<"\" \""<<joinPath(mSupportCodeFolder, "rrSupport.c")<<"\"";
+        exeCmd<<" "<<mCompilerFlags[i];
+    }
+    exeCmd<<" \""<<sourceFileName<<"\" \""<<joinPath(mSupportCodeFolder, "rrSupport.c")<<"\"";
 
 
-        exeCmd<<" -o \""<<mDLLFileName<<"\"";
+    exeCmd<<" -o \""<<mDLLFileName<<"\"";
 #if defined(WIN32)
-        exeCmd<<" -DBUILD_MODEL_DLL ";
+    exeCmd<<" -DBUILD_MODEL_DLL ";
 #endif
-        //Add include paths
-        for(int i = 0; i < mIncludePaths.size(); i++)
-        {
-            exeCmd<<" -I\""<<mIncludePaths[i]<<"\" " ;
-        }
+    //Add include paths
+    for(int i = 0; i < mIncludePaths.size(); i++)
+    {
+        exeCmd<<" -I\""<<mIncludePaths[i]<<"\" " ;
+    }
 
-        //Add library paths
-        for(int i = 0; i < mLibraryPaths.size(); i++)
-        {
-            exeCmd<<" -L\""<<mLibraryPaths[i]<<"\" " ;
-        }
+    //Add library paths
+    for(int i = 0; i < mLibraryPaths.size(); i++)
+    {
+        exeCmd<<" -L\""<<mLibraryPaths[i]<<"\" " ;
     }
     return exeCmd.str();
 }
@@ -11,6 +11,8 @@ using std::string;
 namespace rr
 {
 
+class ModelSharedLibrary;
+
 /**
  * compiler class for the C based model system.
  */
@@ -36,6 +38,48 @@ public:
     bool                        setLibraryPath(const string& path);
     void                        execute(StringList& oProxyCode);
     bool                        compileSource(const string& cSource);
+
+    /**
+     * compile the source, which must contain its header, and the support
+     * code with libtcc into memory, and load the code into lib. No
+     * process is started and no files are written, so nothing is cached,
+     * every call compiles the source again.
+     *
+     * The given symbols are resolved and the tcc state is deleted before
+     * this returns, lib only keeps the relocated code, so nothing touches
+     * libtcc after the call.
+     *
+     * libtcc keeps its state in globals, so calls must be serialized.
+     */
+    bool                        compileSourceInMemory(const string& source,
+                                        const vector<string>& symbols, ModelSharedLibrary& lib);
+
+    /**
+     * true if roadrunner was built with libtcc, see compileSourceInMemory.
+     */
+    static bool                 hasInMemoryCompiler();
+
+    /**
+     * build with the system C compiler ($CC or gcc) at -O3 instead of the
+     * configured compiler without optimization, for long simulations.
+     * $CC may be any compiler which takes gcc style options, such as
+     * clang or a cross compiler, and may start with a launcher, such as
+     * ccache.
+     */
+    void                        setOptimize(bool optimize);
+    bool                        getOptimize() const;
+
+    /**
+     * throws an Exception if the compiler that is run does not take gcc
+     * style options, which are the only ones the command is built with.
+     */
+    void                        checkCompiler() const;
+
+    /**
+     * the compiler executable and optimization level, the compiled
+     * libraries are cached under a key which includes this.
+     */
+    string                      getCompilerSignature() const;
     string                      getCompilerMessages();
     bool                        setOutputPath(const string& path);
 
@@ -54,11 +98,25 @@ private:
     string                      mCompilerName;
     string                      mCompilerLocation;    //Path to executable
 
+    bool                        mOptimize;
+
     vector<string>              mCompilerOutput;
     vector<string>              mIncludePaths;
     vector<string>              mLibraryPaths;
     vector<string>              mCompilerFlags;
     string                      createCompilerCommand(const string& sourceFileName);
+
+    /**
+     * the compiler that is run, the system compiler if optimizing.
+     */
+    string                      getCompilerPath() const;
+
+    /**
+     * the compiler without path, extension, options or launcher, i.e.
+     * "gcc" for "ccache /usr/bin/gcc -m64".
+     */
+    string                      getCompilerBaseName() const;
+
     bool                        setupCompilerEnvironment();
     string                      mOutputPath;
 
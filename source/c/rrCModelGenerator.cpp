@@ -2351,16 +2351,18 @@ ExecutableModel *CModelGenerator::createModel(const string& sbml, uint options)
 
     bool forceReCompile = options & ModelGenerator::RECOMPILE;
 
+    bool optimize = options & ModelGenerator::OPTIMIZE_NATIVE;
+
     LibStructural libStruct(sbml);
 
     ExecutableModel *model = createModel(sbml, &libStruct, forceReCompile,
-            computeAndAssignConsevationLaws);
+            computeAndAssignConsevationLaws, optimize);
 
     return model;
 }
 
 ExecutableModel *CModelGenerator::createModel(const string& sbml, LibStructural *ls,
-        bool forceReCompile, bool computeAndAssignConsevationLaws)
+        bool forceReCompile, bool computeAndAssignConsevationLaws, bool optimize)
 {
     NOMSupport nom;
     CModelGenerator::loadSBMLIntoNOM(nom, sbml);
@@ -2380,7 +2382,25 @@ ExecutableModel *CModelGenerator::createModel(const string& sbml, LibStructural
         throw(CoreException("SBML string is empty!"));
     }
 
-    string modelName = getMD5(sbml);
+    // the compiler settings are shared by everything below, and libtcc
+    // keeps its state in globals, so the lock is held from here on.
+    Mutex::ScopedLock lock(mCompileMutex);
+
+    mCompiler.setOptimize(optimize);
+    const bool inMemory = !optimize && CCompiler::hasInMemoryCompiler();
+
+    if(!inMemory)
+    {
+        mCompiler.checkCompiler();
+    }
+
+    // the generated code depends on the conservation analysis, and the
+    // library on the compiler, so a cached library is only reused if
+    // they are all the same. Models compiled in memory by libtcc are not
+    // cached, they are compiled again by every load, which is fast.
+    string modelName = getMD5(sbml
+            + (computeAndAssignConsevationLaws ? "\nCONSERVED_MOIETIES" : "")
+            + "\n" + (inMemory ? string("libtcc") : mCompiler.getCompilerSignature()));
 
     //Check if model has been compiled
     mModelLib->setPath(mTempFileFolder);
@@ -2396,13 +2416,31 @@ ExecutableModel *CModelGenerator::createModel(const string& sbml, LibStructural
         }
     }
 
-    generateModelCode(sbml, modelName, computeAndAssignConsevationLaws);
+    if(inMemory)
+    {
+        if(!generateModelCode(mCurrentSBML, computeAndAssignConsevationLaws).size())
+        {
+            throw CoreException("Failed to generate model code");
+        }
+    }
+    else
+    {
+        generateModelCode(sbml, modelName, computeAndAssignConsevationLaws);
+    }
 
-    Mutex::ScopedLock lock(mCompileMutex);
     try
     {
+        if(inMemory)
+        {
+            if(!mCompiler.compileSourceInMemory(getHeaderCode() + "\n" + getSourceCode(),
+                    CompiledExecutableModel::getSymbolNames(), *mModelLib))
+            {
+                Log(Logger::LOG_ERROR)<<"Failed to compile model in memory";
+                return 0;
+            }
+        }
         //Can't have multiple threads compiling to the same dll at the same time..
-        if(!fileExists(mModelLib->getFullFileName()) || forceReCompile == true)
+        else if(!fileExists(mModelLib->getFullFileName()) || forceReCompile == true)
         {
             if(!compileModel())
             {
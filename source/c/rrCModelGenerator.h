@@ -15,6 +15,12 @@ using Poco::Mutex;
 /**
  * Generate executable SBML models by generating and compiling C
  * source code into shared libraries with an external C compiler.
+ *
+ * If roadrunner is built with libtcc, the code is compiled in memory
+ * instead, unless the OPTIMIZE_NATIVE option asks for the system compiler.
+ * Shared libraries are cached in the temporary directory under a hash of
+ * the SBML, the options which change the generated code, and the
+ * compiler, so an identical model is only compiled once.
  */
 class RR_DECLSPEC CModelGenerator : public CompiledModelGenerator
 {
@@ -41,6 +47,8 @@ public:
     /**
      * Set the name of the compiler to use. As this is a C source code compiler, this
      * is the name of the external C compiler, which would typically be 'gcc', 'cc', 'icc', etc...
+     *
+     * Not used when models are compiled in memory with libtcc.
      */
     virtual                             bool setCompiler(const string& compiler);
 
@@ -58,7 +66,8 @@ private:
      * The caller own this.
      */
     ExecutableModel                     *createModel(const string& sbml, ls::LibStructural *ls,
-                                                     bool forceReCompile, bool computeAndAssignConsevationLaws);
+                                                     bool forceReCompile, bool computeAndAssignConsevationLaws,
+                                                     bool optimize);
 
     CodeBuilder                         mHeader;
     CodeBuilder                         mSource;
@@ -304,6 +304,24 @@ int CompiledExecutableModel::setStateVector(const double* stateVector)
     return mData.numRateRules + mData.numRateRules;
 }
 
+std::vector<std::string> CompiledExecutableModel::getSymbolNames()
+{
+    static const char* names[] = {
+        "InitModel", "InitModelData", "initializeInitialConditions",
+        "setParameterValues", "setCompartmentVolumes", "getNumLocalParameters",
+        "setBoundaryConditions", "setInitialConditions",
+        "evalInitialAssignments", "computeRules", "convertToAmounts",
+        "computeConservedTotals", "getConcentration", "GetCurrentValues",
+        "__evalModel", "convertToConcentrations", "evalEvents",
+        "updateDependentSpeciesValues", "computeAllRatesOfChange",
+        "AssignRatesA", "AssignRatesB", "testConstraints", "resetEvents",
+        "InitializeRateRuleSymbols", "InitializeRates", "setConcentration",
+        "computeReactionRates", "computeEventPriorities"
+    };
+
+    return std::vector<std::string>(names, names + sizeof(names) / sizeof(names[0]));
+}
+
 bool CompiledExecutableModel::setupDLLFunctions()
 {
     //Exported functions in the dll need to be assigned to a function pointer here..
@@ -630,6 +648,48 @@ void CompiledExecutableModel::getStateVectorRate(double timein, const double *y,
     }
 }
 
+int CompiledExecutableModel::getStateVectorJacobian(double time, const double *y,
+        double *jac)
+{
+    return -1;
+}
+
+int CompiledExecutableModel::getNumAlgebraicRules()
+{
+    return 0;
+}
+
+int CompiledExecutableModel::getAlgebraicRuleStateVectorIndex(int index)
+{
+    throw Exception("index out of range");
+}
+
+int CompiledExecutableModel::getNumFastReactions()
+{
+    return 0;
+}
+
+int CompiledExecutableModel::getFastReactionIndex(int index)
+{
+    throw Exception("index out of range");
+}
+
+int CompiledExecutableModel::getStateVectorConstraints(double time,
+        const double *y, double *residuals)
+{
+    return 0;
+}
+
+void CompiledExecutableModel::saveState(std::ostream &out)
+{
+    throw Exception("saveState is not supported by the C backend");
+}
+
+void CompiledExecutableModel::loadState(std::istream &in)
+{
+    throw Exception("loadState is not supported by the C backend");
+}
+
 void CompiledExecutableModel::evalEvents(const double timeIn, const double*y)
 {
     if(!cevalEvents)
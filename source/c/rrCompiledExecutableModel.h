@@ -50,6 +50,12 @@ public:
     CompiledExecutableModel(const ModelSymbols& symbols, ModelSharedLibrary* dll);
     virtual ~CompiledExecutableModel();
 
+    /**
+     * the names of the functions setupDLLFunctions looks up in the model
+     * library, for libraries whose symbols are resolved up front.
+     */
+    static std::vector<std::string> getSymbolNames();
+
     virtual bool getConservedSumChanged();
     virtual void setConservedSumChanged(bool);
 
@@ -306,6 +312,24 @@ public:
      */
     virtual void getStateVectorRate(double time, const double *y, double *dydt = 0);
 
+    /**
+     * the C models do not provide an exact Jacobian, always returns -1.
+     */
+    virtual int getStateVectorJacobian(double time, const double *y, double *jac);
+
+    /**
+     * the C models do not support algebraic rules or fast reactions, these
+     * always have no constraints.
+     */
+    virtual int getNumAlgebraicRules();
+    virtual int getAlgebraicRuleStateVectorIndex(int index);
+    virtual int getNumFastReactions();
+    virtual int getFastReactionIndex(int index);
+    virtual int getStateVectorConstraints(double time, const double *y,
+            double *residuals);
+    virtual void saveState(std::ostream &out);
+    virtual void loadState(std::istream &in);
+
     virtual void evalEvents(const double time, const double *y);
     virtual void resetEvents();
     virtual void testConstraints();
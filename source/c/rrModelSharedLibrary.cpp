@@ -4,6 +4,7 @@
 #include "rrModelSharedLibrary.h"
 #include "rrLogger.h"
 #include "rrUtils.h"
+#include <stdlib.h>
 //---------------------------------------------------------------------------
 
 
@@ -13,6 +14,8 @@ using Poco::UUID;
 using Poco::UUIDGenerator;
 
 ModelSharedLibrary::ModelSharedLibrary(const string& pathTo)
+:
+mTCCCode(0)
 {
 	if(fileExists(pathTo))
     {
@@ -21,19 +24,34 @@ ModelSharedLibrary::ModelSharedLibrary(const string& pathTo)
 }
 
 ModelSharedLibrary::~ModelSharedLibrary()
-{}
+{
+    // in memory code has no other owner
+    if(mTCCCode)
+    {
+        unload();
+    }
+}
 
 bool ModelSharedLibrary::isLoaded()
 {
-	return mTheLib.isLoaded();
+	return mTCCCode || mTheLib.isLoaded();
 }
 
 void* ModelSharedLibrary::getSymbol(const string& name)
 {
+    if(mTCCCode)
+    {
+        std::map<string, void*>::const_iterator i = mTCCSymbols.find(name);
+        return i != mTCCSymbols.end() ? i->second : 0;
+    }
 	return mTheLib.getSymbol(name);
 }
 bool  ModelSharedLibrary::hasSymbol(const string& name)
 {
+    if(mTCCCode)
+    {
+        return getSymbol(name) != 0;
+    }
 	return mTheLib.hasSymbol(name);
 }
 
@@ -64,8 +82,26 @@ bool ModelSharedLibrary::load(const string& libName)
     return mTheLib.isLoaded();
 }
 
+bool ModelSharedLibrary::load(void* code, const std::map<string, void*>& symbols)
+{
+    if(isLoaded())
+    {
+        unload();
+    }
+    mTCCCode = code;
+    mTCCSymbols = symbols;
+    return isLoaded();
+}
+
 bool ModelSharedLibrary::unload()
 {
+    if(mTCCCode)
+    {
+        free(mTCCCode);
+        mTCCCode = 0;
+        mTCCSymbols.clear();
+        return true;
+    }
 	mTheLib.unload();
     return true;
 }
@@ -4,8 +4,7 @@
 #include "Poco/SharedLibrary.h"
 #include "rrExporter.h"
 #include <string>
-
-
+#include <map>
 
 namespace rr
 {
@@ -17,6 +16,9 @@ using Poco::SharedLibrary;
  * Access an actual compiled shared library (.so, .dll or .dylib) that
  * was compiled by a ModelGenerator and provides access to the exported
  * C functions.
+ *
+ * The library may also be code that libtcc compiled into memory, in which
+ * case there is no file, and the symbols were resolved by the compiler.
  */
 class RR_DECLSPEC ModelSharedLibrary
 {
@@ -24,6 +26,8 @@ class RR_DECLSPEC ModelSharedLibrary
         string                             mLibName;
         string                            mPathToLib;
         SharedLibrary                    mTheLib;
+        void*                            mTCCCode;
+        std::map<string, void*>          mTCCSymbols;
 
     public:
                                         ModelSharedLibrary(const string& pathToLib = "");
@@ -36,6 +40,14 @@ class RR_DECLSPEC ModelSharedLibrary
 
         bool                            load();
         bool                            load(const string& name);
+
+        /**
+         * take ownership of the memory libtcc relocated its code into, with
+         * the addresses of its symbols in that code, the library is then
+         * loaded without a file. The tcc state is not needed any more, it
+         * is deleted by the compiler, under its lock.
+         */
+        bool                            load(void* code, const std::map<string, void*>& symbols);
         bool                            unload();
         bool                            isLoaded();
         void*                            getSymbol(const string& name);
@@ -8,6 +8,7 @@
 #include "ConservedMoietyConverter.h"
 #include "ConservedMoietyPlugin.h"
 #include "ConservationDocumentPlugin.h"
+#include "SparseStructuralAnalysis.h"
 #include "rr-libstruct/lsLibStructural.h"
 
 #include <sbml/conversion/SBMLConverterRegistry.h>
@@ -110,6 +111,7 @@ ConservedMoietyConverter::ConservedMoietyConverter() :
         SBMLConverter(),
         mModel(0),
         structural(0),
+        sparse(0),
         resultDoc(0),
         resultModel(0)
 {
@@ -120,6 +122,7 @@ ConservedMoietyConverter::ConservedMoietyConverter(
         SBMLConverter(orig),
         mModel(0),
         structural(0),
+        sparse(0),
         resultDoc(0),
         resultModel(0)
 {
@@ -128,6 +131,7 @@ ConservedMoietyConverter::ConservedMoietyConverter(
 ConservedMoietyConverter::~ConservedMoietyConverter()
 {
     delete structural;
+    delete sparse;
     delete resultDoc;
 }
 
@@ -180,11 +184,24 @@ int ConservedMoietyConverter::convert()
 
     resultModel = resultDoc->getModel();
 
-    vector<string> indSpecies = structural->getIndependentSpecies();
+    vector<string> indSpecies;
 
-    vector<string> depSpecies = structural->getDependentSpecies();
+    vector<string> depSpecies;
 
-    ls::DoubleMatrix *L0 = structural->getL0Matrix();
+    ls::DoubleMatrix *L0;
+
+    if (sparse)
+    {
+        indSpecies = sparse->getIndependentSpecies();
+        depSpecies = sparse->getDependentSpecies();
+        L0 = new ls::DoubleMatrix(sparse->getL0Matrix());
+    }
+    else
+    {
+        indSpecies = structural->getIndependentSpecies();
+        depSpecies = structural->getDependentSpecies();
+        L0 = structural->getL0Matrix();
+    }
 
     if (rr::Logger::getLevel() >= loggingLevel)
     {
@@ -192,10 +209,14 @@ int ConservedMoietyConverter::convert()
         Log(loggingLevel) << "independent species: " << toString(indSpecies);
         Log(loggingLevel) << "dependent species: " << toString(depSpecies);
         Log(loggingLevel) << "L0 matrix: " << endl << *L0;
-        Log(loggingLevel) << "Stoichiometry Matrix: " << endl
-                << *(structural->getStoichiometryMatrix());
-        Log(loggingLevel) << "Reordered Stoichiometry Matrix: "
-                << endl << *(structural->getReorderedStoichiometryMatrix());
+
+        if (structural)
+        {
+            Log(loggingLevel) << "Stoichiometry Matrix: " << endl
+                    << *(structural->getStoichiometryMatrix());
+            Log(loggingLevel) << "Reordered Stoichiometry Matrix: "
+                    << endl << *(structural->getReorderedStoichiometryMatrix());
+        }
     }
 
     createReorderedSpecies(resultModel, mModel, indSpecies, depSpecies);
@@ -336,7 +357,19 @@ int ConservedMoietyConverter::setDocument(const libsbml::SBMLDocument* doc)
         return LIBSBML_INVALID_OBJECT;
     }
 
-    structural = new ls::LibStructural(mModel);
+    delete structural;
+    delete sparse;
+    structural = 0;
+    sparse = 0;
+
+    if (SparseStructuralAnalysis::isSparseModel(mModel))
+    {
+        sparse = new SparseStructuralAnalysis(mModel);
+    }
+    else
+    {
+        structural = new ls::LibStructural(mModel);
+    }
 
     return LIBSBML_OPERATION_SUCCESS;
 }
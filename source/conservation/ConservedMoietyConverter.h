@@ -24,6 +24,7 @@ namespace rr
 namespace conservation
 {
 
+class SparseStructuralAnalysis;
 
 #ifndef SWIG
 
@@ -152,12 +153,16 @@ public:
 private:
 
     /**
-     * class used to calculate the L0 matrix.
-     *
-     * Will be replaced with a sparse version in next RoadRunner release.
+     * class used to calculate the L0 matrix of small models.
      */
     ls::LibStructural *structural;
 
+    /**
+     * used instead of structural for models with at least
+     * Config::ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD floating species.
+     */
+    SparseStructuralAnalysis *sparse;
+
     /**
      * base class has an mDocument field, use this for the src doc
      */
@@ -0,0 +1,512 @@
+#include "SparseStructuralAnalysis.h"
+#include "rrConfig.h"
+#include "rrLogger.h"
+#include "rrException.h"
+
+#include <sbml/Model.h>
+#include <sbml/Compartment.h>
+#include <sbml/Species.h>
+#include <sbml/Reaction.h>
+#include <sbml/SpeciesReference.h>
+
+#include <algorithm>
+#include <map>
+#include <assert.h>
+#include <math.h>
+
+using namespace std;
+using namespace libsbml;
+
+namespace rr
+{
+namespace conservation
+{
+
+/**
+ * a dense vector which remembers which of its entries were touched, so
+ * that it can be gathered and cleared in time proportional to the number
+ * of non-zeros.
+ */
+class SparseAccumulator
+{
+public:
+    SparseAccumulator(int size) : values(size, 0.0), touched(size, false)
+    {
+    }
+
+    void add(int i, double value)
+    {
+        if (!touched[i])
+        {
+            touched[i] = true;
+            indices.push_back(i);
+        }
+        values[i] += value;
+    }
+
+    double get(int i) const
+    {
+        return values[i];
+    }
+
+    void set(int i, double value)
+    {
+        if (!touched[i])
+        {
+            touched[i] = true;
+            indices.push_back(i);
+        }
+        values[i] = value;
+    }
+
+    /**
+     * largest absolute value and its index.
+     */
+    double maxAbs(int& index) const
+    {
+        double result = 0;
+        index = -1;
+        for (unsigned i = 0; i < indices.size(); ++i)
+        {
+            if (fabs(values[indices[i]]) > result)
+            {
+                result = fabs(values[indices[i]]);
+                index = indices[i];
+            }
+        }
+        return result;
+    }
+
+    /**
+     * the entries whose magnitude is larger than tol, ordered by index.
+     */
+    vector<pair<int, double> > gather(double tol) const
+    {
+        vector<int> sorted(indices);
+        sort(sorted.begin(), sorted.end());
+
+        vector<pair<int, double> > result;
+        for (unsigned i = 0; i < sorted.size(); ++i)
+        {
+            if (fabs(values[sorted[i]]) > tol)
+            {
+                result.push_back(make_pair(sorted[i], values[sorted[i]]));
+            }
+        }
+        return result;
+    }
+
+    void clear()
+    {
+        for (unsigned i = 0; i < indices.size(); ++i)
+        {
+            values[indices[i]] = 0;
+            touched[indices[i]] = false;
+        }
+        indices.clear();
+    }
+
+private:
+    vector<double> values;
+    vector<bool> touched;
+    vector<int> indices;
+};
+
+/**
+ * a linearly independent row found by the elimination, as a combination
+ * of the original species rows.
+ */
+struct BasisRow
+{
+    int pivot;
+    double pivotValue;
+    vector<pair<int, double> > row;
+    vector<pair<int, double> > combination;
+};
+
+/**
+ * the stoichiometry of a species reference, an unset L3 stoichiometry is
+ * NaN, and defaults to 1.
+ */
+static double referenceStoichiometry(const SpeciesReference *ref)
+{
+    double value = ref->getStoichiometry();
+    return ref->isSetStoichiometry() && !isnan(value) ? value : 1.0;
+}
+
+/**
+ * the initial amount of a species, the compartment size times its initial
+ * concentration if that is what is given.
+ */
+static double initialAmount(const libsbml::Model *model, const Species *s)
+{
+    if (!s->isSetInitialConcentration())
+    {
+        return s->getInitialAmount();
+    }
+
+    const Compartment *c = model->getCompartment(s->getCompartment());
+    double size = c && c->isSetSize() ? c->getSize() : 1.0;
+    return size * s->getInitialConcentration();
+}
+
+/**
+ * true if any reaction of the model has a stoichiometryMath element, its
+ * value is not known until the model is evaluated.
+ */
+static bool hasStoichiometryMath(const libsbml::Model *model)
+{
+    for (unsigned j = 0; j < model->getNumReactions(); ++j)
+    {
+        const Reaction *reaction = model->getReaction(j);
+
+        for (unsigned k = 0; k < reaction->getNumReactants(); ++k)
+        {
+            if (reaction->getReactant(k)->isSetStoichiometryMath())
+            {
+                return true;
+            }
+        }
+
+        for (unsigned k = 0; k < reaction->getNumProducts(); ++k)
+        {
+            if (reaction->getProduct(k)->isSetStoichiometryMath())
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+SparseStructuralAnalysis::SparseStructuralAnalysis(const libsbml::Model *model,
+        double tolerance)
+{
+    if (hasStoichiometryMath(model))
+    {
+        throw CoreException("Sparse structural analysis of model '"
+                + model->getId() + "' with stoichiometryMath is not supported");
+    }
+
+    vector<string> species;
+    vector<double> values;
+    map<string, int> speciesIndex;
+
+    for (unsigned i = 0; i < model->getNumSpecies(); ++i)
+    {
+        const Species *s = model->getSpecies(i);
+        if (!s->getBoundaryCondition())
+        {
+            speciesIndex[s->getId()] = species.size();
+            species.push_back(s->getId());
+            values.push_back(initialAmount(model, s));
+        }
+    }
+
+    const int numSpecies = species.size();
+    const int numReactions = model->getNumReactions();
+
+    // sparse rows of N in model order, the reactions are visited in order
+    // so the rows are sorted by column.
+    vector<SparseRow> rows(numSpecies);
+
+    for (int j = 0; j < numReactions; ++j)
+    {
+        const Reaction *reaction = model->getReaction(j);
+        reactions.push_back(reaction->getId());
+
+        map<int, double> column;
+
+        for (unsigned k = 0; k < reaction->getNumReactants(); ++k)
+        {
+            const SpeciesReference *ref = reaction->getReactant(k);
+            map<string, int>::const_iterator i = speciesIndex.find(ref->getSpecies());
+            if (i != speciesIndex.end())
+            {
+                column[i->second] -= referenceStoichiometry(ref);
+            }
+        }
+
+        for (unsigned k = 0; k < reaction->getNumProducts(); ++k)
+        {
+            const SpeciesReference *ref = reaction->getProduct(k);
+            map<string, int>::const_iterator i = speciesIndex.find(ref->getSpecies());
+            if (i != speciesIndex.end())
+            {
+                column[i->second] += referenceStoichiometry(ref);
+            }
+        }
+
+        for (map<int, double>::const_iterator i = column.begin();
+                i != column.end(); ++i)
+        {
+            if (i->second != 0)
+            {
+                rows[i->first].push_back(make_pair(j, i->second));
+            }
+        }
+    }
+
+    vector<BasisRow> basis;
+    vector<int> independent;
+    vector<int> dependent;
+
+    // position of each independent species in independent
+    vector<int> indPos(numSpecies, -1);
+
+    // dependent rows of L0 in terms of species indices
+    vector<SparseRow> depRows;
+
+    SparseAccumulator row(numReactions);
+    SparseAccumulator combination(numSpecies);
+
+    for (int r = 0; r < numSpecies; ++r)
+    {
+        double scale = 0;
+        for (unsigned k = 0; k < rows[r].size(); ++k)
+        {
+            row.set(rows[r][k].first, rows[r][k].second);
+            scale = max(scale, fabs(rows[r][k].second));
+        }
+        combination.set(r, 1.0);
+
+        // each basis row is zero in the pivot columns of the ones before it,
+        // so eliminating in order leaves all the pivot columns zero.
+        for (unsigned b = 0; b < basis.size() && scale > 0; ++b)
+        {
+            const BasisRow& br = basis[b];
+            const double value = row.get(br.pivot);
+
+            if (value == 0)
+            {
+                continue;
+            }
+
+            const double f = value / br.pivotValue;
+
+            for (unsigned k = 0; k < br.row.size(); ++k)
+            {
+                row.add(br.row[k].first, -f * br.row[k].second);
+            }
+            row.set(br.pivot, 0);
+
+            for (unsigned k = 0; k < br.combination.size(); ++k)
+            {
+                combination.add(br.combination[k].first,
+                        -f * br.combination[k].second);
+            }
+        }
+
+        int pivot = -1;
+        double maxValue = row.maxAbs(pivot);
+
+        if (scale == 0 || maxValue <= tolerance * scale)
+        {
+            // N_r + sum c_s N_s = 0 over the independent s, so the L0 row
+            // is -c.
+            SparseRow l0Row;
+            SparseRow c = combination.gather(tolerance);
+            for (unsigned k = 0; k < c.size(); ++k)
+            {
+                if (c[k].first != r)
+                {
+                    l0Row.push_back(make_pair(c[k].first, -c[k].second));
+                }
+            }
+            dependent.push_back(r);
+            depRows.push_back(l0Row);
+        }
+        else
+        {
+            BasisRow br;
+            br.pivot = pivot;
+            br.pivotValue = row.get(pivot);
+            br.row = row.gather(tolerance * scale);
+            br.combination = combination.gather(tolerance);
+            basis.push_back(br);
+
+            indPos[r] = independent.size();
+            independent.push_back(r);
+        }
+
+        row.clear();
+        combination.clear();
+    }
+
+    for (unsigned i = 0; i < independent.size(); ++i)
+    {
+        indSpecies.push_back(species[independent[i]]);
+        stoichiometry.push_back(rows[independent[i]]);
+        initialValues.push_back(values[independent[i]]);
+    }
+
+    for (unsigned i = 0; i < dependent.size(); ++i)
+    {
+        depSpecies.push_back(species[dependent[i]]);
+        stoichiometry.push_back(rows[dependent[i]]);
+        initialValues.push_back(values[dependent[i]]);
+
+        SparseRow l0Row;
+        for (unsigned k = 0; k < depRows[i].size(); ++k)
+        {
+            int pos = indPos[depRows[i][k].first];
+            assert(pos >= 0 && "dependent species combination of dependent species");
+            l0Row.push_back(make_pair(pos, depRows[i][k].second));
+        }
+        sort(l0Row.begin(), l0Row.end());
+        l0.push_back(l0Row);
+    }
+
+    Log(Logger::LOG_INFORMATION) << "sparse structural analysis of "
+            << numSpecies << " species and " << numReactions << " reactions: "
+            << indSpecies.size() << " independent, " << depSpecies.size()
+            << " dependent species";
+}
+
+SparseStructuralAnalysis::~SparseStructuralAnalysis()
+{
+}
+
+bool SparseStructuralAnalysis::isSparseModel(const libsbml::Model *model)
+{
+    int threshold = Config::getInt(Config::ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD);
+
+    if (threshold <= 0 || model == 0 || hasStoichiometryMath(model))
+    {
+        return false;
+    }
+
+    int numFloating = model->getNumSpecies()
+            - model->getNumSpeciesWithBoundaryCondition();
+
+    return numFloating >= threshold;
+}
+
+const std::vector<std::string>& SparseStructuralAnalysis::getIndependentSpecies() const
+{
+    return indSpecies;
+}
+
+const std::vector<std::string>& SparseStructuralAnalysis::getDependentSpecies() const
+{
+    return depSpecies;
+}
+
+const std::vector<std::string>& SparseStructuralAnalysis::getReactions() const
+{
+    return reactions;
+}
+
+int SparseStructuralAnalysis::getNumIndSpecies() const
+{
+    return indSpecies.size();
+}
+
+int SparseStructuralAnalysis::getNumDepSpecies() const
+{
+    return depSpecies.size();
+}
+
+ls::DoubleMatrix SparseStructuralAnalysis::getReorderedStoichiometryMatrix() const
+{
+    ls::DoubleMatrix result(stoichiometry.size(), reactions.size());
+
+    for (unsigned i = 0; i < stoichiometry.size(); ++i)
+    {
+        for (unsigned k = 0; k < stoichiometry[i].size(); ++k)
+        {
+            result(i, stoichiometry[i][k].first) = stoichiometry[i][k].second;
+        }
+    }
+
+    return result;
+}
+
+ls::DoubleMatrix SparseStructuralAnalysis::getNrMatrix() const
+{
+    ls::DoubleMatrix result(indSpecies.size(), reactions.size());
+
+    for (unsigned i = 0; i < indSpecies.size(); ++i)
+    {
+        for (unsigned k = 0; k < stoichiometry[i].size(); ++k)
+        {
+            result(i, stoichiometry[i][k].first) = stoichiometry[i][k].second;
+        }
+    }
+
+    return result;
+}
+
+ls::DoubleMatrix SparseStructuralAnalysis::getL0Matrix() const
+{
+    ls::DoubleMatrix result(depSpecies.size(), indSpecies.size());
+
+    for (unsigned i = 0; i < l0.size(); ++i)
+    {
+        for (unsigned k = 0; k < l0[i].size(); ++k)
+        {
+            result(i, l0[i][k].first) = l0[i][k].second;
+        }
+    }
+
+    return result;
+}
+
+ls::DoubleMatrix SparseStructuralAnalysis::getLinkMatrix() const
+{
+    const unsigned numInd = indSpecies.size();
+    ls::DoubleMatrix result(numInd + depSpecies.size(), numInd);
+
+    for (unsigned i = 0; i < numInd; ++i)
+    {
+        result(i, i) = 1.0;
+    }
+
+    for (unsigned i = 0; i < l0.size(); ++i)
+    {
+        for (unsigned k = 0; k < l0[i].size(); ++k)
+        {
+            result(numInd + i, l0[i][k].first) = l0[i][k].second;
+        }
+    }
+
+    return result;
+}
+
+ls::DoubleMatrix SparseStructuralAnalysis::getConservationMatrix() const
+{
+    const unsigned numInd = indSpecies.size();
+    ls::DoubleMatrix result(depSpecies.size(), numInd + depSpecies.size());
+
+    for (unsigned i = 0; i < l0.size(); ++i)
+    {
+        for (unsigned k = 0; k < l0[i].size(); ++k)
+        {
+            result(i, l0[i][k].first) = -l0[i][k].second;
+        }
+        result(i, numInd + i) = 1.0;
+    }
+
+    return result;
+}
+
+std::vector<double> SparseStructuralAnalysis::getConservedSums() const
+{
+    const unsigned numInd = indSpecies.size();
+    std::vector<double> result(depSpecies.size());
+
+    for (unsigned i = 0; i < l0.size(); ++i)
+    {
+        double sum = initialValues[numInd + i];
+        for (unsigned k = 0; k < l0[i].size(); ++k)
+        {
+            sum -= l0[i][k].second * initialValues[l0[i][k].first];
+        }
+        result[i] = sum;
+    }
+
+    return result;
+}
+
+} /* namespace conservation */
+} /* namespace rr */
@@ -0,0 +1,140 @@
+#ifndef SPARSESTRUCTURALANALYSIS_H_
+#define SPARSESTRUCTURALANALYSIS_H_
+
+#include "rrExporter.h"
+#include "rr-libstruct/lsMatrix.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace libsbml
+{
+class Model;
+}
+
+namespace rr
+{
+namespace conservation
+{
+
+/**
+ * @internal
+ * Conservation analysis of the stoichiometry matrix which works on the
+ * sparse rows of N, for networks that are too large for the dense QR
+ * factorization in LibStructural.
+ *
+ * The floating species rows of N are processed in model order, and each row
+ * is eliminated against the linearly independent rows found so far. If
+ * nothing is left, the species is dependent, and the combination of the
+ * independent rows which it was reduced with is its row of L0. Otherwise the
+ * remainder is added to the independent rows, pivoting on its largest entry.
+ *
+ * Stoichiometry rows only have a few entries, so the eliminations are
+ * short sparse vector updates, and only N, the independent rows and L0 are
+ * stored, never a dense species x reactions matrix.
+ *
+ * The species are ordered independent first, then dependent, within each
+ * group they keep the order they have in the model, so
+ *
+ *     N = L Nr,  L = [I; L0]
+ *
+ * with the rows of N in this order, and the conservation laws are
+ *
+ *     [-L0 I] x = T
+ */
+class RR_DECLSPEC SparseStructuralAnalysis
+{
+public:
+
+    /**
+     * performs the analysis on the given model, the model is not
+     * referenced after the constructor returns.
+     *
+     * A reduced row is considered zero if all of its entries are smaller
+     * than tolerance times the largest entry of the original row.
+     *
+     * Throws a CoreException if the model has stoichiometryMath, an unset
+     * stoichiometry is taken to be 1.
+     */
+    SparseStructuralAnalysis(const libsbml::Model *model,
+            double tolerance = 1.e-9);
+
+    ~SparseStructuralAnalysis();
+
+    /**
+     * should the sparse analysis be used for this model, true if the
+     * number of floating species is at least
+     * Config::ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD and none of its
+     * reactions have stoichiometryMath.
+     */
+    static bool isSparseModel(const libsbml::Model *model);
+
+    const std::vector<std::string>& getIndependentSpecies() const;
+
+    const std::vector<std::string>& getDependentSpecies() const;
+
+    const std::vector<std::string>& getReactions() const;
+
+    int getNumIndSpecies() const;
+
+    int getNumDepSpecies() const;
+
+    /**
+     * stoichiometry matrix with the rows in the independent, dependent order.
+     */
+    ls::DoubleMatrix getReorderedStoichiometryMatrix() const;
+
+    /**
+     * the independent rows of the stoichiometry matrix.
+     */
+    ls::DoubleMatrix getNrMatrix() const;
+
+    /**
+     * dependent species x independent species.
+     */
+    ls::DoubleMatrix getL0Matrix() const;
+
+    /**
+     * [I; L0]
+     */
+    ls::DoubleMatrix getLinkMatrix() const;
+
+    /**
+     * [-L0 I], one row per conservation law.
+     */
+    ls::DoubleMatrix getConservationMatrix() const;
+
+    /**
+     * the conserved sums of the initial amounts of the species, species
+     * with an initial concentration are multiplied by the compartment size.
+     */
+    std::vector<double> getConservedSums() const;
+
+private:
+    typedef std::vector<std::pair<int, double> > SparseRow;
+
+    std::vector<std::string> indSpecies;
+    std::vector<std::string> depSpecies;
+    std::vector<std::string> reactions;
+
+    /**
+     * sparse rows of N, independent first, then dependent.
+     */
+    std::vector<SparseRow> stoichiometry;
+
+    /**
+     * sparse rows of L0, the column indices are independent species indices.
+     */
+    std::vector<SparseRow> l0;
+
+    /**
+     * initial amounts in the same order as the rows of stoichiometry.
+     */
+    std::vector<double> initialValues;
+};
+
+} /* namespace conservation */
+} /* namespace rr */
+
+#endif /* SPARSESTRUCTURALANALYSIS_H_ */
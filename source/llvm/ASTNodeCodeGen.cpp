@@ -472,6 +472,15 @@ llvm::Value* ASTNodeCodeGen::intrinsicCallCodeGen(const libsbml::ASTNode *ast)
     Function* func;
     Module *module = getModule();
 
+    if (ast->getType() == AST_POWER || ast->getType() == AST_FUNCTION_POWER)
+    {
+        Value *result = integerPowerCodeGen(ast);
+        if (result)
+        {
+            return result;
+        }
+    }
+
     switch (ast->getType())
     {
     case AST_FUNCTION_POWER:
@@ -608,6 +617,37 @@ llvm::Value* ASTNodeCodeGen::intrinsicCallCodeGen(const libsbml::ASTNode *ast)
     break;
     }
 
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR >= 3)
+    // with fast math, use the LLVM intrinsics for the common transcendentals,
+    // these are understood by the optimizer and the vectorizer, and
+    // are lowered to the same libm call if nothing better is available.
+    if (builder.getFastMathFlags().unsafeAlgebra())
+    {
+        Intrinsic::ID id = Intrinsic::not_intrinsic;
+
+        switch (ast->getType())
+        {
+        case AST_FUNCTION_POWER:
+        case AST_POWER:
+            id = Intrinsic::pow;
+            break;
+        case AST_FUNCTION_EXP:
+            id = Intrinsic::exp;
+            break;
+        case AST_FUNCTION_LN:
+            id = Intrinsic::log;
+            break;
+        default:
+            break;
+        }
+
+        if (id != Intrinsic::not_intrinsic)
+        {
+            func = Intrinsic::getDeclaration(module, id, builder.getDoubleTy());
+        }
+    }
+#endif
+
     // get the function
     if (func == 0)
     {
@@ -693,6 +733,102 @@ llvm::Value* ASTNodeCodeGen::intrinsicCallCodeGen(const libsbml::ASTNode *ast)
 
 }
 
+/**
+ * largest integer exponent that is expanded into multiplications,
+ * x^16 takes 4 squarings.
+ */
+static const long maxExpandedPowerExponent = 16;
+
+/**
+ * get the value of an integer literal exponent, handles integers,
+ * reals with integer values and a unary minus of either.
+ */
+static bool getIntegerExponent(const libsbml::ASTNode *ast, long &value)
+{
+    switch (ast->getType())
+    {
+    case AST_INTEGER:
+        value = ast->getInteger();
+        return true;
+    case AST_REAL:
+    {
+        double d = ast->getReal();
+        if (std::fabs(d) <= maxExpandedPowerExponent && std::floor(d) == d)
+        {
+            value = (long)d;
+            return true;
+        }
+        return false;
+    }
+    case AST_MINUS:
+        if (ast->getNumChildren() == 1 &&
+                getIntegerExponent(ast->getChild(0), value))
+        {
+            value = -value;
+            return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+llvm::Value* ASTNodeCodeGen::integerPowerCodeGen(const libsbml::ASTNode *ast)
+{
+    long exponent = 0;
+
+    // the expansion differs from pow in the last bits, and in overflow and
+    // NaN handling, so it is only done with FAST_MATH, which is what sets
+    // the builder's fast math flags.
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR >= 3)
+    if (!builder.getFastMathFlags().unsafeAlgebra())
+    {
+        return 0;
+    }
+#else
+    return 0;
+#endif
+
+    if (ast->getNumChildren() != 2 ||
+            !getIntegerExponent(ast->getChild(1), exponent) ||
+            exponent > maxExpandedPowerExponent ||
+            exponent < -maxExpandedPowerExponent)
+    {
+        return 0;
+    }
+
+    Value *one = ConstantFP::get(builder.getContext(), APFloat(1.0));
+
+    if (exponent == 0)
+    {
+        // pow(x, 0) is 1 for any x, even NaN.
+        return one;
+    }
+
+    Value *base = codeGen(ast->getChild(0));
+    Value *result = 0;
+    unsigned long n = exponent < 0 ? -exponent : exponent;
+
+    while (true)
+    {
+        if (n & 1)
+        {
+            result = result ? builder.CreateFMul(result, base, "powtmp") : base;
+        }
+
+        n >>= 1;
+
+        if (n == 0)
+        {
+            break;
+        }
+
+        base = builder.CreateFMul(base, base, "powtmp");
+    }
+
+    return exponent < 0 ? builder.CreateFDiv(one, result, "powtmp") : result;
+}
+
 llvm::Value* ASTNodeCodeGen::toBoolean(llvm::Value* value)
 {
     Type *type = value->getType();
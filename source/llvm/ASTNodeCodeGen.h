@@ -70,6 +70,17 @@ private:
 
     llvm::Value *intrinsicCallCodeGen(const libsbml::ASTNode *ast);
 
+    /**
+     * If the exponent of a power node is a small integer literal, expand
+     * the power into a sequence of multiplications by repeated squaring,
+     * i.e. x^4 becomes (x*x)*(x*x), so no call to pow is made. Only
+     * done with the FAST_MATH option.
+     *
+     * @returns 0 if the exponent is not a small integer literal, or
+     * FAST_MATH is off.
+     */
+    llvm::Value *integerPowerCodeGen(const libsbml::ASTNode *ast);
+
     llvm::Value *piecewiseCodeGen(const libsbml::ASTNode *ast);
 
     /**
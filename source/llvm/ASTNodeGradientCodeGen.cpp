@@ -0,0 +1,702 @@
+#define _USE_MATH_DEFINES
+
+#pragma hdrstop
+#include "ASTNodeGradientCodeGen.h"
+#include "ASTNodeCodeGen.h"
+#include "LLVMException.h"
+#include "rrLogger.h"
+#include "rrStringUtils.h"
+
+#include <sbml/math/ASTNode.h>
+#include <sbml/Model.h>
+#include <cmath>
+#include <set>
+
+using namespace libsbml;
+using namespace llvm;
+using namespace std;
+using namespace rr;
+
+namespace rrllvm
+{
+
+/**
+ * the local scope of a user function call, the bvars resolve to the
+ * values and gradients of the arguments, everything else goes to
+ * the parent resolvers.
+ */
+class FunctionScopeResolver: public LoadSymbolResolver,
+    public GradientSymbolResolver
+{
+public:
+    FunctionScopeResolver(llvm::IRBuilder<> &builder,
+            LoadSymbolResolver &parent,
+            GradientSymbolResolver &parentGradient) :
+                builder(builder),
+                parent(parent),
+                parentGradient(parentGradient)
+    {
+    }
+
+    virtual ~FunctionScopeResolver() {};
+
+    virtual llvm::Value *loadSymbolValue(const std::string& symbol,
+            const llvm::ArrayRef<llvm::Value*>& args =
+                    llvm::ArrayRef<llvm::Value*>())
+    {
+        map<string, Value*>::const_iterator i = values.find(symbol);
+        if (i != values.end())
+        {
+            return i->second;
+        }
+        return parent.loadSymbolValue(symbol, args);
+    }
+
+    virtual void loadSymbolGradient(const std::string& symbol,
+            Gradient& result)
+    {
+        if (values.find(symbol) != values.end())
+        {
+            map<string, Gradient>::const_iterator i = gradients.find(symbol);
+            if (i != gradients.end())
+            {
+                addGradient(builder, result, i->second);
+            }
+            return;
+        }
+        parentGradient.loadSymbolGradient(symbol, result);
+    }
+
+    virtual void recursiveSymbolPush(const std::string& symbol)
+    {
+        parent.recursiveSymbolPush(symbol);
+    }
+
+    virtual void recursiveSymbolPop()
+    {
+        parent.recursiveSymbolPop();
+    }
+
+    map<string, Value*> values;
+    map<string, Gradient> gradients;
+
+private:
+    llvm::IRBuilder<> &builder;
+    LoadSymbolResolver &parent;
+    GradientSymbolResolver &parentGradient;
+};
+
+
+void addGradient(llvm::IRBuilder<> &builder, Gradient& result,
+        const Gradient& g, llvm::Value *scale)
+{
+    for (Gradient::const_iterator i = g.begin(); i != g.end(); ++i)
+    {
+        Value *value = scale ?
+                builder.CreateFMul(scale, i->second, "dscaletmp") : i->second;
+
+        Gradient::iterator j = result.find(i->first);
+        if (j != result.end())
+        {
+            j->second = builder.CreateFAdd(j->second, value, "daddtmp");
+        }
+        else
+        {
+            result[i->first] = value;
+        }
+    }
+}
+
+ASTNodeGradientCodeGen::ASTNodeGradientCodeGen(llvm::IRBuilder<> &builder,
+        LoadSymbolResolver &resolver,
+        GradientSymbolResolver &gradientResolver,
+        const libsbml::Model *model) :
+            builder(builder),
+            resolver(resolver),
+            gradientResolver(gradientResolver),
+            model(model)
+{
+}
+
+ASTNodeGradientCodeGen::~ASTNodeGradientCodeGen()
+{
+}
+
+void ASTNodeGradientCodeGen::codeGen(const libsbml::ASTNode *ast,
+        Gradient& result)
+{
+    if (ast == 0)
+    {
+        throw_llvm_exception("ASTNode is NULL");
+    }
+
+    switch (ast->getType())
+    {
+    case AST_PLUS:
+    case AST_MINUS:
+    case AST_TIMES:
+    case AST_DIVIDE:
+        arithmeticCodeGen(ast, result);
+        break;
+
+    case AST_NAME:
+        gradientResolver.loadSymbolGradient(ast->getName(), result);
+        break;
+
+    // numbers, constants and time do not depend on the state
+    case AST_INTEGER:
+    case AST_REAL:
+    case AST_REAL_E:
+    case AST_RATIONAL:
+    case AST_NAME_AVOGADRO:
+    case AST_NAME_TIME:
+    case AST_CONSTANT_E:
+    case AST_CONSTANT_FALSE:
+    case AST_CONSTANT_PI:
+    case AST_CONSTANT_TRUE:
+        break;
+
+    // booleans are only used as piecewise conditions, and floor and
+    // ceiling are piecewise constant.
+    case AST_RELATIONAL_EQ:
+    case AST_RELATIONAL_GEQ:
+    case AST_RELATIONAL_GT:
+    case AST_RELATIONAL_LEQ:
+    case AST_RELATIONAL_LT:
+    case AST_RELATIONAL_NEQ:
+    case AST_LOGICAL_AND:
+    case AST_LOGICAL_NOT:
+    case AST_LOGICAL_OR:
+    case AST_LOGICAL_XOR:
+    case AST_FUNCTION_CEILING:
+    case AST_FUNCTION_FLOOR:
+        break;
+
+    case AST_FUNCTION:
+        functionCallCodeGen(ast, result);
+        break;
+
+    case AST_POWER:
+    case AST_FUNCTION_POWER:
+        powerCodeGen(ast, result);
+        break;
+
+    case AST_FUNCTION_ROOT:
+        rootCodeGen(ast, result);
+        break;
+
+    case AST_FUNCTION_LOG:
+        logCodeGen(ast, result);
+        break;
+
+    case AST_FUNCTION_ABS:
+    case AST_FUNCTION_ARCCOS:
+    case AST_FUNCTION_ARCSIN:
+    case AST_FUNCTION_ARCTAN:
+    case AST_FUNCTION_COS:
+    case AST_FUNCTION_COSH:
+    case AST_FUNCTION_EXP:
+    case AST_FUNCTION_LN:
+    case AST_FUNCTION_SIN:
+    case AST_FUNCTION_SINH:
+    case AST_FUNCTION_TAN:
+    case AST_FUNCTION_TANH:
+        intrinsicCodeGen(ast, result);
+        break;
+
+    case AST_FUNCTION_PIECEWISE:
+        piecewiseCodeGen(ast, result);
+        break;
+
+    // the ASTNodeCodeGen ignores the delay, so does the derivative
+    case AST_FUNCTION_DELAY:
+        if (ast->getNumChildren() > 0)
+        {
+            codeGen(ast->getChild(0), result);
+        }
+        break;
+
+    default:
+        constantCodeGen(ast);
+        break;
+    }
+}
+
+void ASTNodeGradientCodeGen::arithmeticCodeGen(const libsbml::ASTNode *ast,
+        Gradient& result)
+{
+    const uint numChildren = ast->getNumChildren();
+    const ASTNodeType_t type = ast->getType();
+
+    vector<Gradient> gradients(numChildren);
+    bool isConstant = true;
+
+    for (uint i = 0; i < numChildren; ++i)
+    {
+        codeGen(ast->getChild(i), gradients[i]);
+        isConstant = isConstant && gradients[i].empty();
+    }
+
+    if (isConstant)
+    {
+        return;
+    }
+
+    switch (type)
+    {
+    case AST_PLUS:
+        for (uint i = 0; i < numChildren; ++i)
+        {
+            addGradient(builder, result, gradients[i]);
+        }
+        break;
+
+    case AST_MINUS:
+        if (numChildren == 1)
+        {
+            addGradient(builder, result, gradients[0], constant(-1.0));
+        }
+        else
+        {
+            addGradient(builder, result, gradients[0]);
+            for (uint i = 1; i < numChildren; ++i)
+            {
+                addGradient(builder, result, gradients[i], constant(-1.0));
+            }
+        }
+        break;
+
+    case AST_TIMES:
+    {
+        // product rule, each gradient is scaled by the product of all
+        // the other factors.
+        vector<Value*> values(numChildren);
+        for (uint i = 0; i < numChildren; ++i)
+        {
+            values[i] = valueCodeGen(ast->getChild(i));
+        }
+
+        for (uint i = 0; i < numChildren; ++i)
+        {
+            if (gradients[i].empty())
+            {
+                continue;
+            }
+
+            Value *scale = 0;
+            for (uint j = 0; j < numChildren; ++j)
+            {
+                if (j != i)
+                {
+                    scale = scale ?
+                        builder.CreateFMul(scale, values[j], "multmp") : values[j];
+                }
+            }
+            addGradient(builder, result, gradients[i], scale);
+        }
+        break;
+    }
+
+    case AST_DIVIDE:
+    {
+        // evaluated left to right like the ASTNodeCodeGen,
+        // d(u / v) = (du - (u / v) * dv) / v
+        Value *value = valueCodeGen(ast->getChild(0));
+        Gradient acc = gradients[0];
+
+        for (uint i = 1; i < numChildren; ++i)
+        {
+            Value *v = valueCodeGen(ast->getChild(i));
+            Value *inv = builder.CreateFDiv(constant(1.0), v, "divtmp");
+            value = builder.CreateFDiv(value, v, "divtmp");
+
+            Gradient next;
+            addGradient(builder, next, acc, inv);
+
+            if (!gradients[i].empty())
+            {
+                Value *scale = builder.CreateFNeg(
+                        builder.CreateFMul(value, inv, "multmp"), "negtmp");
+                addGradient(builder, next, gradients[i], scale);
+            }
+            acc.swap(next);
+        }
+
+        addGradient(builder, result, acc);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+void ASTNodeGradientCodeGen::powerCodeGen(const libsbml::ASTNode *ast,
+        Gradient& result)
+{
+    if (ast->getNumChildren() != 2)
+    {
+        constantCodeGen(ast);
+        return;
+    }
+
+    const ASTNode *baseNode = ast->getChild(0);
+    const ASTNode *expNode = ast->getChild(1);
+
+    Gradient base;
+    Gradient exp;
+    codeGen(baseNode, base);
+    codeGen(expNode, exp);
+
+    if (base.empty() && exp.empty())
+    {
+        return;
+    }
+
+    Value *u = valueCodeGen(baseNode);
+    Value *v = valueCodeGen(expNode);
+
+    if (exp.empty())
+    {
+        // d(u^v) = v * u^(v-1) * du
+        Value *vm1 = builder.CreateFSub(v, constant(1.0), "subtmp");
+        Module *module = builder.GetInsertBlock()->getParent()->getParent();
+        Function *powFunc = Intrinsic::getDeclaration(module, Intrinsic::pow,
+                builder.getDoubleTy());
+        Value *args[] = {u, vm1};
+        Value *powm1 = builder.CreateCall(powFunc, args, "powtmp");
+        addGradient(builder, result, base,
+                builder.CreateFMul(v, powm1, "multmp"));
+    }
+    else
+    {
+        // d(u^v) = u^v * (dv * ln(u) + v * du / u)
+        Value *p = valueCodeGen(ast);
+        Value *lnu = callIntrinsic(Intrinsic::log, u);
+        addGradient(builder, result, exp, builder.CreateFMul(p, lnu, "multmp"));
+
+        if (!base.empty())
+        {
+            Value *scale = builder.CreateFDiv(
+                    builder.CreateFMul(p, v, "multmp"), u, "divtmp");
+            addGradient(builder, result, base, scale);
+        }
+    }
+}
+
+void ASTNodeGradientCodeGen::rootCodeGen(const libsbml::ASTNode *ast,
+        Gradient& result)
+{
+    // root(n, x) = x^(1/n), with a default degree of 2
+    const ASTNode *degreeNode = ast->getNumChildren() == 2 ? ast->getChild(0) : 0;
+    const ASTNode *xNode = ast->getNumChildren() == 2 ?
+            ast->getChild(1) : ast->getChild(0);
+
+    if (degreeNode)
+    {
+        Gradient degree;
+        codeGen(degreeNode, degree);
+        if (!degree.empty())
+        {
+            constantCodeGen(ast);
+        }
+    }
+
+    Gradient x;
+    codeGen(xNode, x);
+
+    if (x.empty())
+    {
+        return;
+    }
+
+    // d(x^(1/n)) = x^(1/n) / (n * x) * dx
+    Value *n = degreeNode ? valueCodeGen(degreeNode) : constant(2.0);
+    Value *p = valueCodeGen(ast);
+    Value *scale = builder.CreateFDiv(p,
+            builder.CreateFMul(n, valueCodeGen(xNode), "multmp"), "divtmp");
+    addGradient(builder, result, x, scale);
+}
+
+void ASTNodeGradientCodeGen::logCodeGen(const libsbml::ASTNode *ast,
+        Gradient& result)
+{
+    // log(b, x) = ln(x) / ln(b), with a default base of 10
+    const ASTNode *baseNode = ast->getNumChildren() == 2 ? ast->getChild(0) : 0;
+    const ASTNode *xNode = ast->getNumChildren() == 2 ?
+            ast->getChild(1) : ast->getChild(0);
+
+    if (baseNode)
+    {
+        Gradient base;
+        codeGen(baseNode, base);
+        if (!base.empty())
+        {
+            constantCodeGen(ast);
+        }
+    }
+
+    Gradient x;
+    codeGen(xNode, x);
+
+    if (x.empty())
+    {
+        return;
+    }
+
+    Value *lnb = baseNode ?
+            callIntrinsic(Intrinsic::log, valueCodeGen(baseNode)) :
+            constant(M_LN10);
+    Value *scale = builder.CreateFDiv(constant(1.0),
+            builder.CreateFMul(valueCodeGen(xNode), lnb, "multmp"), "divtmp");
+    addGradient(builder, result, x, scale);
+}
+
+void ASTNodeGradientCodeGen::intrinsicCodeGen(const libsbml::ASTNode *ast,
+        Gradient& result)
+{
+    if (ast->getNumChildren() != 1)
+    {
+        constantCodeGen(ast);
+        return;
+    }
+
+    const ASTNode *uNode = ast->getChild(0);
+
+    Gradient g;
+    codeGen(uNode, g);
+
+    if (g.empty())
+    {
+        return;
+    }
+
+    Value *u = valueCodeGen(uNode);
+    Value *scale = 0;
+
+    switch (ast->getType())
+    {
+    case AST_FUNCTION_ABS:
+        scale = builder.CreateSelect(
+                builder.CreateFCmpOLT(u, constant(0.0), "lttmp"),
+                constant(-1.0), constant(1.0), "signtmp");
+        break;
+    case AST_FUNCTION_ARCCOS:
+    case AST_FUNCTION_ARCSIN:
+    {
+        // +-1 / sqrt(1 - u^2)
+        Value *w = builder.CreateFSub(constant(1.0),
+                builder.CreateFMul(u, u, "multmp"), "subtmp");
+        scale = builder.CreateFDiv(
+                constant(ast->getType() == AST_FUNCTION_ARCSIN ? 1.0 : -1.0),
+                callIntrinsic(Intrinsic::sqrt, w), "divtmp");
+        break;
+    }
+    case AST_FUNCTION_ARCTAN:
+        scale = builder.CreateFDiv(constant(1.0), builder.CreateFAdd(
+                constant(1.0), builder.CreateFMul(u, u, "multmp"), "addtmp"),
+                "divtmp");
+        break;
+    case AST_FUNCTION_COS:
+        scale = builder.CreateFNeg(callIntrinsic(Intrinsic::sin, u), "negtmp");
+        break;
+    case AST_FUNCTION_COSH:
+    case AST_FUNCTION_SINH:
+    {
+        // sinh' = cosh = (e^u + e^-u) / 2, cosh' = sinh = (e^u - e^-u) / 2
+        Value *ep = callIntrinsic(Intrinsic::exp, u);
+        Value *em = builder.CreateFDiv(constant(1.0), ep, "divtmp");
+        Value *sum = ast->getType() == AST_FUNCTION_SINH ?
+                builder.CreateFAdd(ep, em, "addtmp") :
+                builder.CreateFSub(ep, em, "subtmp");
+        scale = builder.CreateFMul(constant(0.5), sum, "multmp");
+        break;
+    }
+    case AST_FUNCTION_EXP:
+        scale = valueCodeGen(ast);
+        break;
+    case AST_FUNCTION_LN:
+        scale = builder.CreateFDiv(constant(1.0), u, "divtmp");
+        break;
+    case AST_FUNCTION_SIN:
+        scale = callIntrinsic(Intrinsic::cos, u);
+        break;
+    case AST_FUNCTION_TAN:
+    {
+        // 1 + tan^2
+        Value *p = valueCodeGen(ast);
+        scale = builder.CreateFAdd(constant(1.0),
+                builder.CreateFMul(p, p, "multmp"), "addtmp");
+        break;
+    }
+    case AST_FUNCTION_TANH:
+    {
+        // 1 - tanh^2
+        Value *p = valueCodeGen(ast);
+        scale = builder.CreateFSub(constant(1.0),
+                builder.CreateFMul(p, p, "multmp"), "subtmp");
+        break;
+    }
+    default:
+        constantCodeGen(ast);
+        return;
+    }
+
+    addGradient(builder, result, g, scale);
+}
+
+void ASTNodeGradientCodeGen::functionCallCodeGen(const libsbml::ASTNode *ast,
+        Gradient& result)
+{
+    const FunctionDefinition *funcDef = model->getFunctionDefinition(
+            ast->getName());
+
+    if (!funcDef || !funcDef->getMath() || !funcDef->getMath()->isLambda())
+    {
+        throw_llvm_exception(string("could not find a function definition for ")
+                + ast->getName());
+    }
+
+    const ASTNode *math = funcDef->getMath();
+    const uint nchild = math->getNumChildren();
+
+    if (nchild < 1 || nchild - 1 != ast->getNumChildren())
+    {
+        throw_llvm_exception(string(ast->getName()) +
+                ", argument count does not match");
+    }
+
+    FunctionScopeResolver scope(builder, resolver, gradientResolver);
+
+    // first set of child nodes are bvars
+    for (uint i = 0; i < nchild - 1; ++i)
+    {
+        const string name = math->getChild(i)->getName();
+        scope.values[name] = valueCodeGen(ast->getChild(i));
+        codeGen(ast->getChild(i), scope.gradients[name]);
+    }
+
+    resolver.recursiveSymbolPush(ast->getName());
+
+    ASTNodeGradientCodeGen(builder, scope, scope, model).codeGen(
+            math->getChild(nchild - 1), result);
+
+    resolver.recursiveSymbolPop();
+}
+
+void ASTNodeGradientCodeGen::piecewiseCodeGen(const libsbml::ASTNode *ast,
+        Gradient& result)
+{
+    // same block structure as ASTNodeCodeGen::piecewiseCodeGen, each
+    // component of the gradient gets its own PHI node.
+    LLVMContext &context = builder.getContext();
+
+    Function *func = builder.GetInsertBlock()->getParent();
+
+    BasicBlock *mergeBB = BasicBlock::Create(context, "dmerge");
+
+    vector<Gradient> gradients;
+    vector<BasicBlock*> blocks;
+
+    const uint nchild = ast->getNumChildren();
+    uint i = 0;
+
+    while ((i + 1) < nchild)
+    {
+        BasicBlock *thenBB = BasicBlock::Create(context,
+                "dthen_" + toString(i), func);
+
+        BasicBlock *elseBB = BasicBlock::Create(context, "delse_" + toString(i));
+
+        const ASTNode *thenNode = ast->getChild(i++);
+        const ASTNode *condNode = ast->getChild(i++);
+
+        Value *cond = valueCodeGen(condNode);
+
+        builder.CreateCondBr(cond, thenBB, elseBB);
+
+        builder.SetInsertPoint(thenBB);
+        gradients.push_back(Gradient());
+        codeGen(thenNode, gradients.back());
+
+        builder.CreateBr(mergeBB);
+        blocks.push_back(builder.GetInsertBlock());
+
+        func->getBasicBlockList().push_back(elseBB);
+        builder.SetInsertPoint(elseBB);
+    }
+
+    // otherwise, a missing otherwise value is a NaN, which is constant.
+    gradients.push_back(Gradient());
+    if (i < nchild)
+    {
+        codeGen(ast->getChild(i), gradients.back());
+    }
+
+    builder.CreateBr(mergeBB);
+    blocks.push_back(builder.GetInsertBlock());
+
+    func->getBasicBlockList().push_back(mergeBB);
+    builder.SetInsertPoint(mergeBB);
+
+    set<uint> indices;
+    for (uint j = 0; j < gradients.size(); ++j)
+    {
+        for (Gradient::const_iterator k = gradients[j].begin();
+                k != gradients[j].end(); ++k)
+        {
+            indices.insert(k->first);
+        }
+    }
+
+    Gradient merged;
+    for (set<uint>::const_iterator k = indices.begin(); k != indices.end(); ++k)
+    {
+        PHINode *pn = builder.CreatePHI(Type::getDoubleTy(context),
+                blocks.size(), "diftmp");
+
+        for (uint j = 0; j < blocks.size(); ++j)
+        {
+            Gradient::const_iterator v = gradients[j].find(*k);
+            pn->addIncoming(v != gradients[j].end() ? v->second : constant(0.0),
+                    blocks[j]);
+        }
+
+        merged[*k] = pn;
+    }
+
+    addGradient(builder, result, merged);
+}
+
+void ASTNodeGradientCodeGen::constantCodeGen(const libsbml::ASTNode *ast)
+{
+    for (uint i = 0; i < ast->getNumChildren(); ++i)
+    {
+        Gradient g;
+        codeGen(ast->getChild(i), g);
+        if (!g.empty())
+        {
+            throw_llvm_exception("can not differentiate " + to_string(ast));
+        }
+    }
+}
+
+llvm::Value *ASTNodeGradientCodeGen::valueCodeGen(const libsbml::ASTNode *ast)
+{
+    return ASTNodeCodeGen(builder, resolver).codeGen(ast);
+}
+
+llvm::Value *ASTNodeGradientCodeGen::constant(double value)
+{
+    return ConstantFP::get(builder.getContext(), APFloat(value));
+}
+
+llvm::Value *ASTNodeGradientCodeGen::callIntrinsic(llvm::Intrinsic::ID id,
+        llvm::Value *arg)
+{
+    Module *module = builder.GetInsertBlock()->getParent()->getParent();
+    Function *func = Intrinsic::getDeclaration(module, id, builder.getDoubleTy());
+    return builder.CreateCall(func, arg, "calltmp");
+}
+
+} /* namespace rrllvm */
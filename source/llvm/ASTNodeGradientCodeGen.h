@@ -0,0 +1,112 @@
+#ifndef ASTNODEGRADIENTCODEGEN_H_
+#define ASTNODEGRADIENTCODEGEN_H_
+
+#include "CodeGen.h"
+#include "LLVMIncludes.h"
+#include "rrOSSpecifics.h"
+#include <map>
+#include <string>
+
+namespace libsbml
+{
+class ASTNode;
+class Model;
+}
+
+namespace rrllvm
+{
+
+/**
+ * the non-zero partial derivatives of a value with respect to the
+ * state vector, keyed by state vector index.
+ */
+typedef std::map<uint, llvm::Value*> Gradient;
+
+/**
+ * resolves the gradient of a named symbol, the counterpart of
+ * the LoadSymbolResolver.
+ */
+class GradientSymbolResolver
+{
+public:
+    /**
+     * generate the partial derivatives of the value of the symbol with
+     * respect to the state vector and add them to result. Nothing is added
+     * for symbols which do not depend on the state vector.
+     */
+    virtual void loadSymbolGradient(const std::string& symbol,
+            Gradient& result) = 0;
+
+protected:
+    virtual ~GradientSymbolResolver() {};
+};
+
+/**
+ * Generates the gradient of an ASTNode, i.e. symbolic forward mode
+ * differentiation with respect to all the state variables at once.
+ *
+ * The values of sub-expressions are generated with an ASTNodeCodeGen
+ * using the given LoadSymbolResolver, the gradients of names come from the
+ * GradientSymbolResolver. User function calls are differentiated through,
+ * the bvars take the values and gradients of the arguments.
+ *
+ * Math which can not be differentiated, such as a factorial of a
+ * state dependent value, causes an LLVMException to be thrown.
+ */
+class ASTNodeGradientCodeGen
+{
+public:
+    ASTNodeGradientCodeGen(llvm::IRBuilder<> &builder,
+            LoadSymbolResolver &resolver,
+            GradientSymbolResolver &gradientResolver,
+            const libsbml::Model *model);
+
+    ~ASTNodeGradientCodeGen();
+
+    /**
+     * add the gradient of ast to result.
+     */
+    void codeGen(const libsbml::ASTNode *ast, Gradient& result);
+
+private:
+    void arithmeticCodeGen(const libsbml::ASTNode *ast, Gradient& result);
+
+    void powerCodeGen(const libsbml::ASTNode *ast, Gradient& result);
+
+    void rootCodeGen(const libsbml::ASTNode *ast, Gradient& result);
+
+    void logCodeGen(const libsbml::ASTNode *ast, Gradient& result);
+
+    void intrinsicCodeGen(const libsbml::ASTNode *ast, Gradient& result);
+
+    void functionCallCodeGen(const libsbml::ASTNode *ast, Gradient& result);
+
+    void piecewiseCodeGen(const libsbml::ASTNode *ast, Gradient& result);
+
+    /**
+     * math that can only be differentiated if it does not depend
+     * on the state vector, throws if it does.
+     */
+    void constantCodeGen(const libsbml::ASTNode *ast);
+
+    llvm::Value *valueCodeGen(const libsbml::ASTNode *ast);
+
+    llvm::Value *constant(double value);
+
+    llvm::Value *callIntrinsic(llvm::Intrinsic::ID id, llvm::Value *arg);
+
+    llvm::IRBuilder<> &builder;
+    LoadSymbolResolver &resolver;
+    GradientSymbolResolver &gradientResolver;
+    const libsbml::Model *model;
+};
+
+/**
+ * result += scale * g, a null scale is taken as one.
+ */
+void addGradient(llvm::IRBuilder<> &builder, Gradient& result,
+        const Gradient& g, llvm::Value *scale = 0);
+
+} /* namespace rrllvm */
+
+#endif /* ASTNODEGRADIENTCODEGEN_H_ */
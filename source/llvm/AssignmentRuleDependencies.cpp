@@ -0,0 +1,138 @@
+#pragma hdrstop
+#include "AssignmentRuleDependencies.h"
+
+#include <sbml/Model.h>
+#include <sbml/math/ASTNode.h>
+
+using namespace libsbml;
+using namespace std;
+
+namespace rrllvm
+{
+
+AssignmentRuleDependencies::AssignmentRuleDependencies(
+        const libsbml::Model *model, const LLVMModelSymbols &modelSymbols) :
+        model(model), modelSymbols(modelSymbols)
+{
+}
+
+void AssignmentRuleDependencies::addMath(const libsbml::ASTNode *math)
+{
+    vector<string> rules;
+    findRules(math, rules);
+
+    for (vector<string>::const_iterator i = rules.begin(); i != rules.end(); ++i)
+    {
+        visitRule(*i);
+    }
+}
+
+void AssignmentRuleDependencies::addSymbol(const std::string &symbol)
+{
+    vector<string> rules;
+    findRules(symbol, rules);
+
+    for (vector<string>::const_iterator i = rules.begin(); i != rules.end(); ++i)
+    {
+        visitRule(*i);
+    }
+}
+
+void AssignmentRuleDependencies::addReactionRates()
+{
+    const ListOfReactions *reactions = model->getListOfReactions();
+
+    for (unsigned i = 0; i < reactions->size(); ++i)
+    {
+        addSymbol(reactions->get(i)->getId());
+    }
+}
+
+const std::vector<std::string>& AssignmentRuleDependencies::getEvaluationOrder() const
+{
+    return evaluationOrder;
+}
+
+void AssignmentRuleDependencies::findRules(const libsbml::ASTNode *math,
+        std::vector<std::string> &rules) const
+{
+    if (math == 0)
+    {
+        return;
+    }
+
+    if (math->getType() == AST_NAME)
+    {
+        findRules(string(math->getName()), rules);
+    }
+
+    // piecewise is generated as branches, only the first condition is
+    // always evaluated. Rules used in the other pieces are left to be
+    // generated in the branch where they are used.
+    if (math->getType() == AST_FUNCTION_PIECEWISE)
+    {
+        if (math->getNumChildren() > 1)
+        {
+            findRules(math->getChild(1), rules);
+        }
+        return;
+    }
+
+    for (unsigned i = 0; i < math->getNumChildren(); ++i)
+    {
+        findRules(math->getChild(i), rules);
+    }
+}
+
+void AssignmentRuleDependencies::findRules(const std::string &symbol,
+        std::vector<std::string> &rules) const
+{
+    const SymbolForest &assignmentRules = modelSymbols.getAssigmentRules();
+
+    if (assignmentRules.find(symbol) != assignmentRules.end())
+    {
+        rules.push_back(symbol);
+        return;
+    }
+
+    // species concentrations are divided by their compartment
+    const Species *species = model->getSpecies(symbol);
+    if (species)
+    {
+        findRules(species->getCompartment(), rules);
+        return;
+    }
+
+    // reaction rates are re-generated from the kinetic law, the reaction is
+    // kept on the stack whilst searching so a (invalid) recursive kinetic
+    // law does not recurse forever.
+    const Reaction *reaction = model->getReaction(symbol);
+    if (reaction && reaction->getKineticLaw() &&
+            reactionStack.insert(symbol).second)
+    {
+        findRules(reaction->getKineticLaw()->getMath(), rules);
+        reactionStack.erase(symbol);
+    }
+}
+
+void AssignmentRuleDependencies::visitRule(const std::string &rule)
+{
+    if (!visited.insert(rule).second)
+    {
+        return;
+    }
+
+    const SymbolForest &assignmentRules = modelSymbols.getAssigmentRules();
+
+    vector<string> rules;
+    findRules(assignmentRules.find(rule)->second, rules);
+
+    for (vector<string>::const_iterator i = rules.begin(); i != rules.end(); ++i)
+    {
+        visitRule(*i);
+    }
+
+    evaluationOrder.push_back(rule);
+}
+
+} /* namespace rrllvm */
@@ -0,0 +1,106 @@
+#ifndef ASSIGNMENTRULEDEPENDENCIES_H_
+#define ASSIGNMENTRULEDEPENDENCIES_H_
+
+#include "LLVMModelSymbols.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace libsbml
+{
+class ASTNode;
+class Model;
+}
+
+namespace rrllvm
+{
+
+/**
+ * Determines which assignment rules a generated function depends on, and
+ * the order they need to be evaluated in.
+ *
+ * Assignment rules are symbolic re-write rules, the ASTNodeCodeGen simply
+ * re-generates the rule expression everywhere the symbol is used. So, if
+ * a large rule is used by 20 reactions, the expression would be evaluated 20
+ * times in a single call to evalReactionRates.
+ *
+ * A code generator adds the math it is going to generate to this object, and
+ * gets back the list of assignment rules that are used (directly, or
+ * indirectly through other rules, species compartments or reaction rates),
+ * sorted so that each rule comes after all the rules it depends on. The
+ * rules can then be evaluated once, in this order, at the top of the
+ * function, see ModelDataLoadSymbolResolver::cacheAssignmentRules.
+ *
+ * Only the math that is evaluated unconditionally is searched: rules that
+ * are only used in the pieces of a piecewise (after its first condition)
+ * are not returned, they are still generated inline in their branch, so
+ * they are not evaluated when the branch is not taken.
+ */
+class AssignmentRuleDependencies
+{
+public:
+    AssignmentRuleDependencies(const libsbml::Model *model,
+            const LLVMModelSymbols &modelSymbols);
+
+    /**
+     * add all the symbols used in the given math.
+     */
+    void addMath(const libsbml::ASTNode *math);
+
+    /**
+     * add a single symbol.
+     */
+    void addSymbol(const std::string &symbol);
+
+    /**
+     * add the kinetic laws of all the reactions in the model.
+     */
+    void addReactionRates();
+
+    /**
+     * the assignment rule symbols that are used by the math added so far,
+     * in dependency order, i.e. if rule a uses rule b, b comes before a.
+     *
+     * If the rules are recursive, the order is arbitrary for the rules
+     * in the cycle, the code generator will detect and report the cycle.
+     */
+    const std::vector<std::string>& getEvaluationOrder() const;
+
+private:
+
+    /**
+     * get the assignment rules that a symbol directly depends on,
+     * i.e. the rules found in the math without going through other rules.
+     */
+    void findRules(const libsbml::ASTNode *math,
+            std::vector<std::string> &rules) const;
+
+    void findRules(const std::string &symbol,
+            std::vector<std::string> &rules) const;
+
+    /**
+     * depth first visit of an assignment rule, appends it to the evaluation
+     * order after all its dependencies.
+     */
+    void visitRule(const std::string &rule);
+
+    const libsbml::Model *model;
+    const LLVMModelSymbols &modelSymbols;
+
+    /**
+     * rules that have been (or are being) visited.
+     */
+    std::set<std::string> visited;
+
+    /**
+     * reactions whose kinetic law is currently being searched.
+     */
+    mutable std::set<std::string> reactionStack;
+
+    std::vector<std::string> evaluationOrder;
+};
+
+} /* namespace rrllvm */
+
+#endif /* ASSIGNMENTRULEDEPENDENCIES_H_ */
@@ -11,6 +11,7 @@
 #include "ModelGeneratorContext.h"
 #include "CodeGen.h"
 #include "LLVMException.h"
+#include "SBMLSupportIRBuilder.h"
 #include "rrLogger.h"
 #include <Poco/Logger.h>
 
@@ -31,15 +32,28 @@ class CodeGenBase
 {
 public:
     FunctionPtrType createFunction()
+    {
+        return (FunctionPtrType)engine.getPointerToFunction(createFunctionIR());
+    }
+
+    /**
+     * generate and optimize the function, without compiling it to native
+     * code, for model libraries which are compiled ahead of time.
+     */
+    llvm::Function *createFunctionIR()
     {
         llvm::Function *func = (llvm::Function*)codeGen();
 
+        // pull the bodies of sec, arccot, root, etc. into the function
+        // so the optimizer can see through them.
+        SBMLSupportIRBuilder::inlineCalls(func);
+
         if(functionPassManager)
         {
             functionPassManager->run(*func);
         }
 
-        return (FunctionPtrType)engine.getPointerToFunction(func);
+        return func;
     }
 
     typedef FunctionPtrType FunctionPtr;
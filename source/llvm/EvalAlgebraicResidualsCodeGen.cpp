@@ -0,0 +1,98 @@
+#pragma hdrstop
+#include "EvalAlgebraicResidualsCodeGen.h"
+#include "LLVMException.h"
+#include "ASTNodeCodeGen.h"
+#include "ModelDataSymbolResolver.h"
+#include "AssignmentRuleDependencies.h"
+#include "ModelGenerator.h"
+#include "rrLogger.h"
+#include <sbml/math/ASTNode.h>
+#include <Poco/Logger.h>
+
+using namespace libsbml;
+using namespace llvm;
+using namespace std;
+
+
+namespace rrllvm
+{
+
+const char* EvalAlgebraicResidualsCodeGen::FunctionName = "evalAlgebraicResiduals";
+
+EvalAlgebraicResidualsCodeGen::EvalAlgebraicResidualsCodeGen(
+        const ModelGeneratorContext &mgc) :
+        CodeGenBase<EvalAlgebraicResiduals_FunctionPtr>(mgc)
+{
+}
+
+EvalAlgebraicResidualsCodeGen::~EvalAlgebraicResidualsCodeGen()
+{
+}
+
+Value* EvalAlgebraicResidualsCodeGen::codeGen()
+{
+    llvm::Type *argTypes[] = {
+        llvm::PointerType::get(
+            ModelDataIRBuilder::getStructType(module), 0),
+        llvm::Type::getDoublePtrTy(context)
+    };
+
+    const char *argNames[] = { "modelData", "residuals" };
+
+    llvm::Value *args[] = { 0, 0 };
+
+    codeGenHeader(FunctionName, llvm::Type::getVoidTy(context),
+            argTypes, argNames, args);
+
+    Value *modelData = args[0];
+    Value *residuals = args[1];
+
+    ModelDataLoadSymbolResolver resolver(modelData, model, modelSymbols,
+            dataSymbols, builder);
+
+    const ListOfRules *rules = model->getListOfRules();
+    const ListOfReactions *reactions = model->getListOfReactions();
+
+    const vector<uint>& algebraicRules = dataSymbols.getAlgebraicRules();
+    const vector<uint>& fastReactions = dataSymbols.getFastReactions();
+
+    if (options & rr::ModelGenerator::OPTIMIZE_ASSIGNMENT_RULES)
+    {
+        AssignmentRuleDependencies dependencies(model, modelSymbols);
+
+        for (uint i = 0; i < algebraicRules.size(); ++i)
+        {
+            dependencies.addMath(rules->get(algebraicRules[i])->getMath());
+        }
+
+        if (fastReactions.size())
+        {
+            dependencies.addReactionRates();
+        }
+
+        resolver.cacheAssignmentRules(dependencies.getEvaluationOrder());
+    }
+
+    uint index = 0;
+
+    for (uint i = 0; i < algebraicRules.size(); ++i, ++index)
+    {
+        const Rule *rule = rules->get(algebraicRules[i]);
+        Value *value = ASTNodeCodeGen(builder, resolver).codeGen(rule->getMath());
+        Value *ep = builder.CreateConstGEP1_32(residuals, index);
+        builder.CreateStore(value, ep);
+    }
+
+    for (uint i = 0; i < fastReactions.size(); ++i, ++index)
+    {
+        Value *value = resolver.loadReactionRate(reactions->get(fastReactions[i]));
+        Value *ep = builder.CreateConstGEP1_32(residuals, index);
+        builder.CreateStore(value, ep);
+    }
+
+    builder.CreateRetVoid();
+
+    return verifyFunction();
+}
+
+} /* namespace rrllvm */
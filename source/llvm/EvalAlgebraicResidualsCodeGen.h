@@ -0,0 +1,40 @@
+#ifndef EVALALGEBRAICRESIDUALSCODEGEN_H_
+#define EVALALGEBRAICRESIDUALSCODEGEN_H_
+
+#include "CodeGenBase.h"
+#include "ModelGeneratorContext.h"
+#include "ModelDataIRBuilder.h"
+#include <sbml/Model.h>
+
+namespace rrllvm
+{
+
+typedef void (*EvalAlgebraicResiduals_FunctionPtr)(LLVMModelData*, double*);
+
+/**
+ * Evaluate the algebraic constraints on the current model state.
+ *
+ * The generated function stores the value of the math of each algebraic
+ * rule, in the order of LLVMModelDataSymbols::getAlgebraicRules, followed by
+ * the rate of each fast reaction, in the order of
+ * LLVMModelDataSymbols::getFastReactions, into the given buffer.
+ *
+ * All of these are zero when the constraints are satisfied, the fast
+ * reactions are then at equilibrium.
+ */
+class EvalAlgebraicResidualsCodeGen:
+        public CodeGenBase<EvalAlgebraicResiduals_FunctionPtr>
+{
+public:
+    EvalAlgebraicResidualsCodeGen(const ModelGeneratorContext &mgc);
+    virtual ~EvalAlgebraicResidualsCodeGen();
+
+    llvm::Value *codeGen();
+
+    static const char* FunctionName;
+    typedef EvalAlgebraicResiduals_FunctionPtr FunctionPtr;
+};
+
+} /* namespace rrllvm */
+
+#endif /* EVALALGEBRAICRESIDUALSCODEGEN_H_ */
@@ -177,7 +177,7 @@ void EvalInitialConditionsCodeGen::codeGenStoichiometry(
         // initial value here. In this case, data is duplicated between the
         // rate rules vector and the CSR sparse matrix. (only occurs once
         // in 1100 tests)
-        if (!nz.id.empty() && dataSymbols.hasRateRule(nz.id))
+        if (!nz.id.empty() && dataSymbols.hasRateRuleValue(nz.id))
         {
             modelDataBuilder.createRateRuleValueStore(nz.id, stoichValue);
         }
@@ -0,0 +1,428 @@
+#pragma hdrstop
+#include "EvalJacobianCodeGen.h"
+#include "EvalRateRuleRatesCodeGen.h"
+#include "LLVMException.h"
+#include "ASTNodeCodeGen.h"
+#include "ASTNodeGradientCodeGen.h"
+#include "ModelDataSymbolResolver.h"
+#include "KineticLawParameterResolver.h"
+#include "AssignmentRuleDependencies.h"
+#include "ModelGenerator.h"
+#include "rrLogger.h"
+#include <sbml/math/ASTNode.h>
+#include <Poco/Logger.h>
+#include <set>
+
+using namespace libsbml;
+using namespace llvm;
+using namespace std;
+using rr::Logger;
+
+
+namespace rrllvm
+{
+
+/**
+ * the gradients of model symbols with respect to the state vector,
+ * the state vector is the rate rule values followed by the independent
+ * floating species amounts.
+ */
+class ModelDataGradientResolver: public GradientSymbolResolver
+{
+public:
+    ModelDataGradientResolver(LoadSymbolResolver &resolver,
+            const libsbml::Model *model,
+            const LLVMModelSymbols &modelSymbols,
+            const LLVMModelDataSymbols &modelDataSymbols,
+            llvm::IRBuilder<> &builder) :
+                resolver(resolver),
+                model(model),
+                modelSymbols(modelSymbols),
+                modelDataSymbols(modelDataSymbols),
+                builder(builder)
+    {
+    }
+
+    virtual ~ModelDataGradientResolver() {};
+
+    virtual void loadSymbolGradient(const std::string& symbol,
+            Gradient& result)
+    {
+        if (symbol.compare(SBML_TIME_SYMBOL) == 0)
+        {
+            return;
+        }
+
+        /*********************************************************************/
+        /* AssignmentRule */
+        /*********************************************************************/
+        {
+            map<string, Gradient>::const_iterator c = cachedRules.find(symbol);
+            if (c != cachedRules.end())
+            {
+                addGradient(builder, result, c->second);
+                return;
+            }
+
+            SymbolForest::ConstIterator i =
+                    modelSymbols.getAssigmentRules().find(symbol);
+            if (i != modelSymbols.getAssigmentRules().end())
+            {
+                resolver.recursiveSymbolPush(symbol);
+                ASTNodeGradientCodeGen(builder, resolver, *this, model).codeGen(
+                        i->second, result);
+                resolver.recursiveSymbolPop();
+                return;
+            }
+        }
+
+        /*********************************************************************/
+        /* Species */
+        /*********************************************************************/
+        const Species *species = model->getSpecies(symbol);
+        if (species)
+        {
+            Gradient amt;
+            const uint numRateRules = modelDataSymbols.getRateRuleValuesSize();
+
+            if (modelDataSymbols.isIndependentFloatingSpecies(symbol))
+            {
+                uint index = modelDataSymbols.getFloatingSpeciesIndex(symbol);
+                if (index < modelDataSymbols.getIndependentFloatingSpeciesSize())
+                {
+                    amt[numRateRules + index] = one();
+                }
+            }
+            else if (modelDataSymbols.hasRateRuleValue(symbol))
+            {
+                amt[modelDataSymbols.getRateRuleValuesIndex(symbol)] = one();
+            }
+
+            if (species->getHasOnlySubstanceUnits())
+            {
+                addGradient(builder, result, amt);
+                return;
+            }
+
+            // d(amt / vol) = (d amt - conc * d vol) / vol
+            Gradient vol;
+            loadSymbolGradient(species->getCompartment(), vol);
+
+            if (amt.empty() && vol.empty())
+            {
+                return;
+            }
+
+            Value *inv = builder.CreateFDiv(one(),
+                    resolver.loadSymbolValue(species->getCompartment()),
+                    symbol + "_inv_vol");
+
+            addGradient(builder, result, amt, inv);
+
+            if (!vol.empty())
+            {
+                Value *conc = resolver.loadSymbolValue(symbol);
+                Value *scale = builder.CreateFNeg(
+                        builder.CreateFMul(conc, inv, "multmp"), "negtmp");
+                addGradient(builder, result, vol, scale);
+            }
+            return;
+        }
+
+        if (modelDataSymbols.hasRateRuleValue(symbol))
+        {
+            Gradient g;
+            g[modelDataSymbols.getRateRuleValuesIndex(symbol)] = one();
+            addGradient(builder, result, g);
+            return;
+        }
+
+        /*********************************************************************/
+        /* Reaction Rate */
+        /*********************************************************************/
+        const Reaction* reaction = model->getReaction(symbol);
+        if (reaction)
+        {
+            loadReactionRateGradient(reaction, result);
+            return;
+        }
+
+        // compartments, global parameters and species references without
+        // rules are constant.
+    }
+
+    void loadReactionRateGradient(const libsbml::Reaction *reaction,
+            Gradient& result);
+
+    /**
+     * generate the gradients of the given assignment rules up front, in
+     * the given order, and re-use them, the same as
+     * ModelDataLoadSymbolResolver::cacheAssignmentRules.
+     */
+    void cacheAssignmentRules(const std::vector<std::string>& rules)
+    {
+        for (vector<string>::const_iterator i = rules.begin(); i != rules.end(); ++i)
+        {
+            Gradient g;
+            loadSymbolGradient(*i, g);
+            cachedRules[*i] = g;
+        }
+    }
+
+private:
+    llvm::Value *one()
+    {
+        return ConstantFP::get(builder.getContext(), APFloat(1.0));
+    }
+
+    LoadSymbolResolver &resolver;
+    const libsbml::Model *model;
+    const LLVMModelSymbols &modelSymbols;
+    const LLVMModelDataSymbols &modelDataSymbols;
+    llvm::IRBuilder<> &builder;
+
+    map<string, Gradient> cachedRules;
+};
+
+/**
+ * local parameters of a kinetic law are constant.
+ */
+class KineticLawGradientResolver: public GradientSymbolResolver
+{
+public:
+    KineticLawGradientResolver(GradientSymbolResolver& parentResolver,
+            const libsbml::KineticLaw& kineticLaw) :
+                parentResolver(parentResolver),
+                kineticLaw(kineticLaw)
+    {
+    }
+
+    virtual ~KineticLawGradientResolver() {};
+
+    virtual void loadSymbolGradient(const std::string& symbol,
+            Gradient& result)
+    {
+        if (kineticLaw.getLocalParameter(symbol) || kineticLaw.getParameter(symbol))
+        {
+            return;
+        }
+        parentResolver.loadSymbolGradient(symbol, result);
+    }
+
+private:
+    GradientSymbolResolver& parentResolver;
+    const libsbml::KineticLaw& kineticLaw;
+};
+
+void ModelDataGradientResolver::loadReactionRateGradient(
+        const libsbml::Reaction* reaction, Gradient& result)
+{
+    const KineticLaw *kinetic = reaction->getKineticLaw();
+
+    if (!kinetic || !kinetic->getMath())
+    {
+        return;
+    }
+
+    KineticLawParameterResolver lpResolver(resolver, *kinetic, builder);
+    KineticLawGradientResolver lpGradientResolver(*this, *kinetic);
+
+    ASTNodeGradientCodeGen(builder, lpResolver, lpGradientResolver,
+            model).codeGen(kinetic->getMath(), result);
+}
+
+
+const char* EvalJacobianCodeGen::FunctionName = "evalJacobian";
+
+EvalJacobianCodeGen::EvalJacobianCodeGen(const ModelGeneratorContext &mgc) :
+        CodeGenBase<EvalJacobian_FunctionPtr>(mgc)
+{
+}
+
+EvalJacobianCodeGen::~EvalJacobianCodeGen()
+{
+}
+
+llvm::BasicBlock* EvalJacobianCodeGen::codeGenJacobianHeader(
+        llvm::Value* &modelData, llvm::Value* &jacobian)
+{
+    llvm::Type *argTypes[] = {
+        llvm::PointerType::get(
+            ModelDataIRBuilder::getStructType(module), 0),
+        llvm::Type::getDoublePtrTy(context)
+    };
+
+    const char *argNames[] = { "modelData", "jacobian" };
+
+    llvm::Value *args[] = { 0, 0 };
+
+    llvm::BasicBlock *basicBlock = codeGenHeader(FunctionName,
+            llvm::Type::getInt32Ty(context), argTypes, argNames, args);
+
+    modelData = args[0];
+    jacobian = args[1];
+
+    return basicBlock;
+}
+
+Value* EvalJacobianCodeGen::codeGen()
+{
+    try
+    {
+        return jacobianCodeGen();
+    }
+    catch (LLVMException& e)
+    {
+        // integrators fall back to finite differences
+        Log(Logger::LOG_NOTICE) << "Could not generate the Jacobian: "
+                << e.what() << ", the model will not provide exact derivatives";
+
+        if (function)
+        {
+            function->eraseFromParent();
+            function = 0;
+        }
+
+        Value *modelData = 0;
+        Value *jacobian = 0;
+        codeGenJacobianHeader(modelData, jacobian);
+
+        builder.CreateRet(ConstantInt::get(Type::getInt32Ty(context), -1, true));
+
+        return verifyFunction();
+    }
+}
+
+Value* EvalJacobianCodeGen::jacobianCodeGen()
+{
+    Value *modelData = 0;
+    Value *jacobian = 0;
+
+    codeGenJacobianHeader(modelData, jacobian);
+
+    ModelDataLoadSymbolResolver resolver(modelData, model, modelSymbols,
+            dataSymbols, builder);
+    ModelDataGradientResolver gradientResolver(resolver, model, modelSymbols,
+            dataSymbols, builder);
+    ModelDataIRBuilder mdbuilder(modelData, dataSymbols, builder);
+    ASTNodeFactory nodes;
+
+    const uint numRateRules = dataSymbols.getRateRuleValuesSize();
+    const uint numIndFloatingSpecies = dataSymbols.getIndependentFloatingSpeciesSize();
+    const uint stateVectorSize = numRateRules + numIndFloatingSpecies;
+
+    const ListOfRules *rules = model->getListOfRules();
+    const ListOfReactions *reactions = model->getListOfReactions();
+
+    // the amount rate math of the rate rules
+    vector<pair<uint, const ASTNode*> > rateRules;
+    for (uint i = 0; i < rules->size(); ++i)
+    {
+        const RateRule *rateRule = dynamic_cast<const RateRule*>(rules->get(i));
+        if (rateRule)
+        {
+            rateRules.push_back(make_pair(
+                    dataSymbols.getRateRuleIndex(rateRule->getVariable()),
+                    EvalRateRuleRatesCodeGen::getAmountRateMath(model,
+                            rateRule, nodes)));
+        }
+    }
+
+    if (options & rr::ModelGenerator::OPTIMIZE_ASSIGNMENT_RULES)
+    {
+        AssignmentRuleDependencies dependencies(model, modelSymbols);
+        dependencies.addReactionRates();
+
+        for (uint i = 0; i < rateRules.size(); ++i)
+        {
+            dependencies.addMath(rateRules[i].second);
+        }
+
+        resolver.cacheAssignmentRules(dependencies.getEvaluationOrder());
+        gradientResolver.cacheAssignmentRules(dependencies.getEvaluationOrder());
+    }
+
+    // row major index of the Jacobian -> value
+    Gradient entries;
+
+    for (uint i = 0; i < rateRules.size(); ++i)
+    {
+        Gradient g;
+        ASTNodeGradientCodeGen(builder, resolver, gradientResolver, model).codeGen(
+                rateRules[i].second, g);
+
+        for (Gradient::const_iterator j = g.begin(); j != g.end(); ++j)
+        {
+            Gradient entry;
+            entry[rateRules[i].first * stateVectorSize + j->first] = j->second;
+            addGradient(builder, entries, entry);
+        }
+    }
+
+    vector<Gradient> reactionGradients(reactions->size());
+    for (uint i = 0; i < reactions->size(); ++i)
+    {
+        gradientResolver.loadReactionRateGradient(reactions->get(i),
+                reactionGradients[i]);
+    }
+
+    // model wide conversion factor, species with their own conversion factor
+    // use that one instead.
+    Value *modelConversionFactor = 0;
+    if (model->isSetConversionFactor() && model->getConversionFactor().length() > 0)
+    {
+        modelConversionFactor = resolver.loadSymbolValue(model->getConversionFactor());
+    }
+
+    const vector<uint>& stoichRows = dataSymbols.getStoichRowIndx();
+    const vector<uint>& stoichCols = dataSymbols.getStoichColIndx();
+    set<pair<uint, uint> > stoichEntries;
+
+    for (uint i = 0; i < stoichRows.size(); ++i)
+    {
+        const uint row = stoichRows[i];
+        const uint col = stoichCols[i];
+
+        if (row >= numIndFloatingSpecies || reactionGradients[col].empty() ||
+                !stoichEntries.insert(make_pair(row, col)).second)
+        {
+            continue;
+        }
+
+        Value *scale = mdbuilder.createStoichiometryLoad(row, col);
+
+        const Species *species = model->getSpecies(
+                dataSymbols.getFloatingSpeciesId(row));
+        Value *conversionFactor = modelConversionFactor;
+        if (species && species->isSetConversionFactor())
+        {
+            conversionFactor = resolver.loadSymbolValue(
+                    species->getConversionFactor());
+        }
+
+        if (conversionFactor)
+        {
+            scale = builder.CreateFMul(conversionFactor, scale, "multmp");
+        }
+
+        const Gradient& g = reactionGradients[col];
+        for (Gradient::const_iterator j = g.begin(); j != g.end(); ++j)
+        {
+            Gradient entry;
+            entry[(numRateRules + row) * stateVectorSize + j->first] = j->second;
+            addGradient(builder, entries, entry, scale);
+        }
+    }
+
+    for (Gradient::const_iterator i = entries.begin(); i != entries.end(); ++i)
+    {
+        Value *ep = builder.CreateConstGEP1_32(jacobian, i->first);
+        builder.CreateStore(i->second, ep);
+    }
+
+    builder.CreateRet(ConstantInt::get(Type::getInt32Ty(context), 0));
+
+    return verifyFunction();
+}
+
+} /* namespace rrllvm */
@@ -0,0 +1,55 @@
+#ifndef EVALJACOBIANCODEGEN_H_
+#define EVALJACOBIANCODEGEN_H_
+
+#include "CodeGenBase.h"
+#include "ModelGeneratorContext.h"
+#include "ASTNodeFactory.h"
+#include "ModelDataIRBuilder.h"
+#include <sbml/Model.h>
+
+namespace rrllvm
+{
+
+typedef int (*EvalJacobian_FunctionPtr)(LLVMModelData*, double*);
+
+/**
+ * Evaluate the exact Jacobian of the state vector rate at the current model
+ * state, i.e. the partial derivatives of the rate rule rates and the
+ * floating species amount rates with respect to the rate rule values and
+ * the independent floating species amounts.
+ *
+ * The kinetic laws, assignment rules and rate rules are differentiated
+ * symbolically with the ASTNodeGradientCodeGen, and the reaction rate
+ * derivatives are multiplied by the current stoichiometry and
+ * conversion factors.
+ *
+ * The generated function takes a row major, state vector size squared
+ * buffer which must be zero filled by the caller, only the non-zero entries
+ * are written. It returns 0 on success, or -1 if the model math could not
+ * be differentiated, in which case nothing is written.
+ *
+ * The stoichiometry and conversion factors are treated as constant with
+ * respect to the state.
+ */
+class EvalJacobianCodeGen:
+        public CodeGenBase<EvalJacobian_FunctionPtr>
+{
+public:
+    EvalJacobianCodeGen(const ModelGeneratorContext &mgc);
+    virtual ~EvalJacobianCodeGen();
+
+    llvm::Value *codeGen();
+
+    static const char* FunctionName;
+    typedef EvalJacobian_FunctionPtr FunctionPtr;
+
+private:
+    llvm::BasicBlock *codeGenJacobianHeader(llvm::Value* &modelData,
+            llvm::Value* &jacobian);
+
+    llvm::Value *jacobianCodeGen();
+};
+
+} /* namespace rrllvm */
+
+#endif /* EVALJACOBIANCODEGEN_H_ */
@@ -35,6 +35,15 @@ public:
 
     static const char* FunctionName;
     typedef EvalRateRuleRates_FunctionPtr FunctionPtr;
+
+    /**
+     * get the math for the rate of change of the amount of the rate
+     * rule variable. Rate rules for species concentrations are converted
+     * to amount rates, any new nodes are owned by the factory.
+     */
+    static const libsbml::ASTNode *getAmountRateMath(
+            const libsbml::Model *model, const libsbml::RateRule *rateRule,
+            ASTNodeFactory &nodes);
 };
 } /* namespace rr */
 #endif /* RRLLVMEVALRATERULERATESCODEGEN_H_ */
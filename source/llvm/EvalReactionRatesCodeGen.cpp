@@ -11,6 +11,8 @@
 #include "ASTNodeFactory.h"
 #include "ModelDataSymbolResolver.h"
 #include "KineticLawParameterResolver.h"
+#include "AssignmentRuleDependencies.h"
+#include "ModelGenerator.h"
 #include "rrLogger.h"
 #include <sbml/math/ASTNode.h>
 #include <sbml/math/FormulaFormatter.h>
@@ -59,6 +61,21 @@ Value* EvalReactionRatesCodeGen::codeGen()
     ModelDataIRBuilder mdbuilder(modelData, dataSymbols, builder);
     ASTNodeFactory nodes;
 
+    // evaluate each assignment rule that the rates depend on once, up front,
+    // rather than re-generating the rule in every kinetic law that uses it.
+    if (options & rr::ModelGenerator::OPTIMIZE_ASSIGNMENT_RULES)
+    {
+        AssignmentRuleDependencies dependencies(model, modelSymbols);
+        dependencies.addReactionRates();
+
+        if (model->isSetConversionFactor())
+        {
+            dependencies.addSymbol(model->getConversionFactor());
+        }
+
+        resolver.cacheAssignmentRules(dependencies.getEvaluationOrder());
+    }
+
     // iterate through all of the reaction, and generate code based on thier
     // kinetic rules.
 
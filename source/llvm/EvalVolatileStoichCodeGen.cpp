@@ -10,6 +10,8 @@
 #include "ASTNodeCodeGen.h"
 #include "ASTNodeFactory.h"
 #include "ModelDataSymbolResolver.h"
+#include "AssignmentRuleDependencies.h"
+#include "ModelGenerator.h"
 #include "rrLogger.h"
 
 #include <vector>
@@ -49,6 +51,25 @@ Value* EvalVolatileStoichCodeGen::codeGen()
     ASTNodeCodeGen astCodeGen(builder, resolver);
 
     const ListOfReactions *reactions = model->getListOfReactions();
+
+    // evaluate each assignment rule that the stoichiometries depend on once,
+    // up front.
+    if (options & rr::ModelGenerator::OPTIMIZE_ASSIGNMENT_RULES)
+    {
+        AssignmentRuleDependencies dependencies(model, modelSymbols);
+
+        for (uint i = 0; i < reactions->size(); ++i)
+        {
+            const Reaction *reaction = reactions->get(i);
+            addStoichiometryDependencies(dependencies,
+                    reaction->getListOfProducts());
+            addStoichiometryDependencies(dependencies,
+                    reaction->getListOfReactants());
+        }
+
+        resolver.cacheAssignmentRules(dependencies.getEvaluationOrder());
+    }
+
     for (uint i = 0; i < reactions->size(); ++i)
     {
         const Reaction *reaction = reactions->get(i);
@@ -70,7 +91,7 @@ Value* EvalVolatileStoichCodeGen::codeGen()
                 Value *value = 0;
 
                 if (dataSymbols.hasAssignmentRule(p->getId())
-                        || dataSymbols.hasRateRule(p->getId()))
+                        || dataSymbols.hasRateRuleValue(p->getId()))
                 {
                     value = resolver.loadSymbolValue(p->getId());
                 }
@@ -153,7 +174,7 @@ bool EvalVolatileStoichCodeGen::isConstantSpeciesReference(
     {
         return s->getConstant();
     }
-    else if (dataSymbols.hasRateRule(s->getId())
+    else if (dataSymbols.hasRateRuleValue(s->getId())
             || dataSymbols.hasAssignmentRule(s->getId()))
     {
         return false;
@@ -229,5 +250,29 @@ bool EvalVolatileStoichCodeGen::isConstantASTNode(const ASTNode *ast) const
     return true;
 }
 
+void EvalVolatileStoichCodeGen::addStoichiometryDependencies(
+        AssignmentRuleDependencies &dependencies,
+        const libsbml::ListOfSpeciesReferences *refs) const
+{
+    for (uint j = 0; j < refs->size(); ++j)
+    {
+        const SpeciesReference *r = (const SpeciesReference*)refs->get(j);
+
+        if (r->isSetId() && r->getId().length() > 0
+                && !isConstantSpeciesReference(r))
+        {
+            if (dataSymbols.hasAssignmentRule(r->getId())
+                    || dataSymbols.hasRateRuleValue(r->getId()))
+            {
+                dependencies.addSymbol(r->getId());
+            }
+            else if (r->isSetStoichiometryMath())
+            {
+                dependencies.addMath(r->getStoichiometryMath()->getMath());
+            }
+        }
+    }
+}
+
 
 } /* namespace rrllvm */
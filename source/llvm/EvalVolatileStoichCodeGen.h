@@ -20,6 +20,8 @@
 namespace rrllvm
 {
 
+class AssignmentRuleDependencies;
+
 typedef void (*EvalVolatileStoichCodeGen_FunctionPtr)(LLVMModelData*);
 
 class EvalVolatileStoichCodeGen:
@@ -49,6 +51,12 @@ private:
      * document elements.
      */
    bool isConstantASTNode(const libsbml::ASTNode *ast) const;
+
+   /**
+    * add the rules or math of the non-constant references in the list.
+    */
+   void addStoichiometryDependencies(AssignmentRuleDependencies &dependencies,
+           const libsbml::ListOfSpeciesReferences *refs) const;
 };
 
 } /* namespace rrllvm */
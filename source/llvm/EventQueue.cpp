@@ -60,6 +60,18 @@ Event::Event(LLVMExecutableModel& model, uint id) :
             ": " << *this;
 }
 
+Event::Event(LLVMExecutableModel& model, uint id, double delay,
+        double assignTime, uint dataSize, const double* data) :
+        model(model),
+        id(id),
+        delay(delay),
+        assignTime(assignTime),
+        dataSize(dataSize),
+        data(new double[dataSize])
+{
+    std::copy(data, data + dataSize, this->data);
+}
+
 Event::Event(const Event& o) :
         model(o.model),
         id(o.id),
@@ -273,6 +285,21 @@ void EventQueue::push(const Event& e)
     c.push_back(e);
 }
 
+void EventQueue::clear()
+{
+    c.clear();
+}
+
+EventQueue::const_iterator EventQueue::begin() const
+{
+    return c.begin();
+}
+
+EventQueue::const_iterator EventQueue::end() const
+{
+    return c.end();
+}
+
 EventQueue::const_reference EventQueue::top()
 {
     c.sort();
@@ -23,6 +23,14 @@ class Event
 {
 public:
     Event(LLVMExecutableModel&, uint id);
+
+    /**
+     * re-create a previously queued event from its saved values, the model
+     * is not evaluated.
+     */
+    Event(LLVMExecutableModel&, uint id, double delay, double assignTime,
+            uint dataSize, const double* data);
+
     Event(const Event& other);
     Event& operator=( const Event& rhs );
     ~Event();
@@ -120,6 +128,17 @@ public:
      */
     void push(const Event& e);
 
+    /**
+     * remove all events from the queue.
+     */
+    void clear();
+
+    /**
+     * iterate over the queued events, these are in no particular order.
+     */
+    const_iterator begin() const;
+    const_iterator end() const;
+
     /**
      * the time the next event is sceduled to be assigned.
      */
@@ -9,6 +9,8 @@
 #include "ModelDataIRBuilder.h"
 #include "ModelDataSymbolResolver.h"
 #include "ASTNodeCodeGen.h"
+#include "AssignmentRuleDependencies.h"
+#include "ModelGenerator.h"
 
 namespace rrllvm
 {
@@ -40,6 +42,20 @@ bool EventTriggerCodeGen::eventCodeGen(llvm::Value *modelData,
     const ListOfEventAssignments *assignments =
             event->getListOfEventAssignments();
 
+    // this is the start of the event's case block, so the rules the
+    // assignments use can be evaluated once here.
+    if (options & rr::ModelGenerator::OPTIMIZE_ASSIGNMENT_RULES)
+    {
+        AssignmentRuleDependencies dependencies(model, modelSymbols);
+
+        for (uint id = 0; id < assignments->size(); ++id)
+        {
+            dependencies.addMath(assignments->get(id)->getMath());
+        }
+
+        mdLoadResolver.cacheAssignmentRules(dependencies.getEvaluationOrder());
+    }
+
     for (uint id = 0; id < assignments->size(); ++id)
     {
         const EventAssignment *a = assignments->get(id);
@@ -16,6 +16,7 @@
 #include "rrStringUtils.h"
 #include <iomanip>
 #include <cstdlib>
+#include <algorithm>
 
 using rr::Logger;
 using rr::getLogger;
@@ -145,6 +146,10 @@ int LLVMExecutableModel::setValues(bool (*funcPtr)(LLVMModelData*, int, double),
             {
                 s << ", it is defined by a rate rule and can not be set independently.";
             }
+            else if (symbols->hasAlgebraicRule(id))
+            {
+                s << ", it is determined by an algebraic rule and can not be set independently.";
+            }
 
             throw_llvm_exception(s.str());
         }
@@ -172,6 +177,8 @@ LLVMExecutableModel::LLVMExecutableModel() :
     eventAssignPtr(0),
     evalVolatileStoichPtr(0),
     evalConversionFactorPtr(0),
+    evalJacobianPtr(0),
+    evalAlgebraicResidualsPtr(0),
     setBoundarySpeciesAmountPtr(0),
     setFloatingSpeciesAmountPtr(0),
     setBoundarySpeciesConcentrationPtr(0),
@@ -211,6 +218,8 @@ LLVMExecutableModel::LLVMExecutableModel(
     eventAssignPtr(rc->eventAssignPtr),
     evalVolatileStoichPtr(rc->evalVolatileStoichPtr),
     evalConversionFactorPtr(rc->evalConversionFactorPtr),
+    evalJacobianPtr(rc->evalJacobianPtr),
+    evalAlgebraicResidualsPtr(rc->evalAlgebraicResidualsPtr),
     setBoundarySpeciesAmountPtr(rc->setBoundarySpeciesAmountPtr),
     setFloatingSpeciesAmountPtr(rc->setFloatingSpeciesAmountPtr),
     setBoundarySpeciesConcentrationPtr(rc->setBoundarySpeciesConcentrationPtr),
@@ -370,6 +379,11 @@ void LLVMExecutableModel::getStateVectorRate(double time, const double *y, doubl
         evalRateRuleRatesPtr(modelData);
         modelData->rateRuleRates = 0;
 
+        // variables determined by algebraic rules are stored after the rate
+        // rules, they do not change by themselves.
+        std::fill(dydt + symbols->getRateRuleSize(),
+                dydt + modelData->numRateRules, 0.0);
+
         // restore original pointers for state vector
         modelData->rateRuleValuesAlias = savedRateRules;
         modelData->floatingSpeciesAmountsAlias = savedFloatingSpeciesAmounts;
@@ -402,6 +416,11 @@ void LLVMExecutableModel::getStateVectorRate(double time, const double *y, doubl
         modelData->rateRuleRates = dydt;
         evalRateRuleRatesPtr(modelData);
         modelData->rateRuleRates = 0;
+
+        // variables determined by algebraic rules are stored after the rate
+        // rules, they do not change by themselves.
+        std::fill(dydt + symbols->getRateRuleSize(),
+                dydt + modelData->numRateRules, 0.0);
     }
 
     /*
@@ -515,11 +534,26 @@ string LLVMExecutableModel::getInfo()
     dump_array(stream, nEvents, (bool*)tmpEvents);
     delete[] tmpEvents;
 
+    stream << "* Memory Usage *" << endl;
+    stream << "Native Code Size: " << resources->nativeCodeSize << endl;
+    stream << "LLVM IR Size: " << resources->irSize << endl;
+    if (resources->irSizeReleased)
+    {
+        stream << "LLVM IR Released: " << resources->irSizeReleased << endl;
+    }
+    stream << "Model Data Size: " << modelData->size << endl;
+    stream << "Total: " << getMemoryUsage() << endl;
+
     stream << *modelData;
 
     return stream.str();
 }
 
+size_t LLVMExecutableModel::getMemoryUsage() const
+{
+    return resources->getMemoryUsage() + modelData->size;
+}
+
 int LLVMExecutableModel::getFloatingSpeciesIndex(const string& id)
 {
     try
@@ -697,6 +731,237 @@ void LLVMExecutableModel::setConservedSumChanged(bool val)
 {
 }
 
+int LLVMExecutableModel::getStateVectorJacobian(double time, const double *y,
+        double *jac)
+{
+    if (!evalJacobianPtr || !jac)
+    {
+        return -1;
+    }
+
+    modelData->time = time;
+
+    double *savedRateRules = modelData->rateRuleValuesAlias;
+    double *savedFloatingSpeciesAmounts = modelData->floatingSpeciesAmountsAlias;
+
+    if (y)
+    {
+        modelData->rateRuleValuesAlias = const_cast<double*>(y);
+        modelData->floatingSpeciesAmountsAlias = const_cast<double*>(y + modelData->numRateRules);
+    }
+
+    evalVolatileStoichPtr(modelData);
+
+    const int n = modelData->numRateRules + modelData->numIndFloatingSpecies;
+    std::fill(jac, jac + n * n, 0.0);
+
+    int result = evalJacobianPtr(modelData, jac);
+
+    // restore original pointers for state vector
+    modelData->rateRuleValuesAlias = savedRateRules;
+    modelData->floatingSpeciesAmountsAlias = savedFloatingSpeciesAmounts;
+
+    return result;
+}
+
+int LLVMExecutableModel::getNumAlgebraicRules()
+{
+    return symbols->getAlgebraicRules().size();
+}
+
+int LLVMExecutableModel::getAlgebraicRuleStateVectorIndex(int index)
+{
+    const std::vector<std::string>& variables = symbols->getAlgebraicRuleVariables();
+
+    if (index < 0 || index >= (int)variables.size())
+    {
+        throw_llvm_exception("index out of range");
+    }
+
+    // algebraic rule variables are stored after the rate rules, which
+    // are at the start of the state vector.
+    return symbols->getRateRuleValuesIndex(variables[index]);
+}
+
+int LLVMExecutableModel::getNumFastReactions()
+{
+    return symbols->getFastReactions().size();
+}
+
+int LLVMExecutableModel::getFastReactionIndex(int index)
+{
+    const std::vector<uint>& fast = symbols->getFastReactions();
+
+    if (index < 0 || index >= (int)fast.size())
+    {
+        throw_llvm_exception("index out of range");
+    }
+
+    return fast[index];
+}
+
+int LLVMExecutableModel::getStateVectorConstraints(double time, const double *y,
+        double *residuals)
+{
+    const int n = symbols->getAlgebraicRules().size() +
+            symbols->getFastReactions().size();
+
+    if (n == 0 || !residuals)
+    {
+        return n;
+    }
+
+    modelData->time = time;
+
+    double *savedRateRules = modelData->rateRuleValuesAlias;
+    double *savedFloatingSpeciesAmounts = modelData->floatingSpeciesAmountsAlias;
+
+    if (y)
+    {
+        modelData->rateRuleValuesAlias = const_cast<double*>(y);
+        modelData->floatingSpeciesAmountsAlias = const_cast<double*>(y + modelData->numRateRules);
+    }
+
+    evalVolatileStoichPtr(modelData);
+
+    evalAlgebraicResidualsPtr(modelData, residuals);
+
+    // restore original pointers for state vector
+    modelData->rateRuleValuesAlias = savedRateRules;
+    modelData->floatingSpeciesAmountsAlias = savedFloatingSpeciesAmounts;
+
+    return n;
+}
+
+/**
+ * the model state is only ever read back on the same platform, so
+ * values are written in native byte order.
+ */
+template <typename T>
+static void writeBinary(std::ostream &out, const T& value)
+{
+    out.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static void readBinary(std::istream &in, T& value)
+{
+    in.read((char*)&value, sizeof(T));
+}
+
+void LLVMExecutableModel::saveState(std::ostream &out)
+{
+    const rr::csr_matrix *stoich = modelData->stoichiometry;
+    const unsigned dataSize = modelData->size - sizeof(LLVMModelData);
+
+    writeBinary(out, modelData->size);
+    writeBinary(out, modelData->numEvents);
+    writeBinary(out, stoich->nnz);
+
+    writeBinary(out, modelData->time);
+    writeBinary(out, modelData->flags);
+    out.write((const char*)modelData->data, dataSize);
+
+    // the stoichiometry can be changed by volatile stoichiometry or
+    // setValue, so keep the current values.
+    out.write((const char*)stoich->values, stoich->nnz * sizeof(double));
+
+    writeBinary(out, conversionFactor);
+
+    writeBinary(out, (unsigned)pendingEvents.size());
+    for (rrllvm::EventQueue::const_iterator i = pendingEvents.begin();
+            i != pendingEvents.end(); ++i)
+    {
+        writeBinary(out, i->id);
+        writeBinary(out, i->delay);
+        writeBinary(out, i->assignTime);
+        writeBinary(out, i->dataSize);
+        out.write((const char*)i->data, i->dataSize * sizeof(double));
+    }
+
+    if (!out)
+    {
+        throw_llvm_exception("error writing model state");
+    }
+}
+
+void LLVMExecutableModel::loadState(std::istream &in)
+{
+    rr::csr_matrix *stoich = modelData->stoichiometry;
+    const unsigned dataSize = modelData->size - sizeof(LLVMModelData);
+
+    unsigned size = 0, numEvents = 0, nnz = 0;
+    readBinary(in, size);
+    readBinary(in, numEvents);
+    readBinary(in, nnz);
+
+    if (!in || size != modelData->size || numEvents != modelData->numEvents
+            || nnz != stoich->nnz)
+    {
+        throw_llvm_exception("saved state does not match model " +
+                symbols->getModelName());
+    }
+
+    // read everything first so a truncated state leaves the model untouched.
+    double time = 0;
+    unsigned flags = 0;
+    readBinary(in, time);
+    readBinary(in, flags);
+
+    // one extra element so the buffers are never empty
+    std::vector<char> data(dataSize + 1);
+    std::vector<double> stoichValues(nnz + 1);
+    double factor = 0;
+    in.read(&data[0], dataSize);
+    in.read((char*)&stoichValues[0], nnz * sizeof(double));
+    readBinary(in, factor);
+
+    unsigned numPending = 0;
+    readBinary(in, numPending);
+
+    std::list<rrllvm::Event> events;
+    std::vector<double> eventData;
+    for (unsigned i = 0; in && i < numPending; ++i)
+    {
+        uint id = 0, eventDataSize = 0;
+        double delay = 0, assignTime = 0;
+        readBinary(in, id);
+        readBinary(in, delay);
+        readBinary(in, assignTime);
+        readBinary(in, eventDataSize);
+
+        if (!in || id >= modelData->numEvents
+                || eventDataSize != getEventBufferSize(id))
+        {
+            throw_llvm_exception("invalid pending event in saved state");
+        }
+
+        eventData.resize(eventDataSize + 1);
+        in.read((char*)&eventData[0], eventDataSize * sizeof(double));
+
+        events.push_back(rrllvm::Event(*this, id, delay, assignTime,
+                eventDataSize, &eventData[0]));
+    }
+
+    if (!in)
+    {
+        throw_llvm_exception("error reading model state");
+    }
+
+    modelData->time = time;
+    modelData->flags = flags;
+    memcpy(modelData->data, &data[0], dataSize);
+    memcpy(stoich->values, &stoichValues[0], nnz * sizeof(double));
+    conversionFactor = factor;
+
+    pendingEvents.clear();
+    for (std::list<rrllvm::Event>::const_iterator i = events.begin();
+            i != events.end(); ++i)
+    {
+        pendingEvents.push(*i);
+    }
+}
+
 int LLVMExecutableModel::getStateVector(double* stateVector)
 {
     if (stateVector == 0)
@@ -1200,10 +1465,16 @@ int LLVMExecutableModel::setBoundarySpeciesAmounts(int len, const int* indx,
 
 std::string LLVMExecutableModel::getStateVectorId(int index)
 {
-    if (index < modelData->numRateRules )
+    const int numRateRules = symbols->getRateRuleSize();
+
+    if (index < numRateRules)
     {
         return symbols->getRateRuleId(index);
     }
+    else if (index < modelData->numRateRules)
+    {
+        return symbols->getAlgebraicRuleVariables()[index - numRateRules];
+    }
     else
     {
         return symbols->getFloatingSpeciesId(index - modelData->numRateRules);
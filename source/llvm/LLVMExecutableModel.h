@@ -25,6 +25,8 @@
 #include "EventTriggerCodeGen.h"
 #include "EvalVolatileStoichCodeGen.h"
 #include "EvalConversionFactorCodeGen.h"
+#include "EvalJacobianCodeGen.h"
+#include "EvalAlgebraicResidualsCodeGen.h"
 #include "SetValuesCodeGen.h"
 #include "SetInitialValuesCodeGen.h"
 #include "EventQueue.h"
@@ -193,11 +195,43 @@ public:
      */
     virtual void getStateVectorRate(double time, const double *y, double* dydt=0);
 
+    virtual int getStateVectorJacobian(double time, const double *y, double *jac);
+
+    virtual int getNumAlgebraicRules();
+
+    virtual int getAlgebraicRuleStateVectorIndex(int index);
+
+    virtual int getNumFastReactions();
+
+    virtual int getFastReactionIndex(int index);
+
+    virtual int getStateVectorConstraints(double time, const double *y,
+            double *residuals);
+
+    /**
+     * writes the model data block, the stoichiometry values and the
+     * pending events.
+     */
+    virtual void saveState(std::ostream &out);
+
+    /**
+     * copies a saved model data block back over the current one, the
+     * pointers in the block are kept.
+     */
+    virtual void loadState(std::istream &in);
+
 
     virtual void testConstraints();
 
     virtual string getInfo();
 
+    /**
+     * estimated number of bytes used by this model, the native code and
+     * any LLVM IR that is kept alive (shared with other instances of the
+     * same model) plus this instance's model data.
+     */
+    size_t getMemoryUsage() const;
+
     virtual int getFloatingSpeciesIndex(const string&);
     virtual string getFloatingSpeciesId(int);
     virtual int getBoundarySpeciesIndex(const string&);
@@ -567,6 +601,8 @@ private:
     EventAssignCodeGen::FunctionPtr eventAssignPtr;
     EvalVolatileStoichCodeGen::FunctionPtr evalVolatileStoichPtr;
     EvalConversionFactorCodeGen::FunctionPtr evalConversionFactorPtr;
+    EvalJacobianCodeGen::FunctionPtr evalJacobianPtr;
+    EvalAlgebraicResidualsCodeGen::FunctionPtr evalAlgebraicResidualsPtr;
 
     // set model values externally.
     SetBoundarySpeciesAmountCodeGen::FunctionPtr setBoundarySpeciesAmountPtr;
@@ -98,6 +98,9 @@ struct LLVMModelData
 
     /**
      * all rate rules are by definition dependent
+     *
+     * size of the rateRuleValues block, the rate rules followed by the
+     * variables of the algebraic rules.
      */
     unsigned                            numRateRules;                     // 8
 
@@ -21,6 +21,9 @@
 #include <string>
 #include <vector>
 #include <sstream>
+#include <istream>
+#include <ostream>
+#include <algorithm>
 
 #if (__cplusplus >= 201103L) || defined(_MSC_VER)
 #include <memory>
@@ -148,6 +151,7 @@ LLVMModelDataSymbols::LLVMModelDataSymbols(const libsbml::Model *model,
     // first go through the rules, see if they determine other stuff
     {
         const ListOfRules * rules = model->getListOfRules();
+        vector<uint> algebraic;
         for (unsigned i = 0; i < rules->size(); ++i)
         {
             const Rule *rule = rules->get(i);
@@ -163,13 +167,13 @@ LLVMModelDataSymbols::LLVMModelDataSymbols(const libsbml::Model *model,
             }
             else if (dynamic_cast<const AlgebraicRule*>(rule))
             {
-                char* formula = SBML_formulaToString(rule->getMath());
-                Log(Logger::LOG_WARNING)
-                    << "Unable to handle algebraic rules. Formula '0 = "
-                    << formula << "' ignored.";
-                free(formula);
+                algebraic.push_back(i);
             }
         }
+
+        // algebraic rules determine whatever is left over, so need
+        // to know all the other rules first.
+        initAlgebraicRules(model, algebraic);
     }
 
     {
@@ -207,10 +211,230 @@ LLVMModelDataSymbols::LLVMModelDataSymbols(const libsbml::Model *model,
     initEvents(model);
 }
 
+/**
+ * binary serialization of the symbols, the element overloads have to be
+ * declared before the container templates that use them.
+ */
+template <typename T>
+static void writeBinary(std::ostream& out, const T& value)
+{
+    out.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static void readBinary(std::istream& in, T& value)
+{
+    in.read((char*)&value, sizeof(T));
+}
+
+static void writeBinary(std::ostream& out, const std::string& value)
+{
+    writeBinary(out, (unsigned)value.size());
+    out.write(value.data(), value.size());
+}
+
+static void readBinary(std::istream& in, std::string& value)
+{
+    unsigned size = 0;
+    readBinary(in, size);
+    value.resize(in ? size : 0);
+    if (value.size())
+    {
+        in.read(&value[0], size);
+    }
+}
+
+static void writeBinary(std::ostream& out,
+        const rrllvm::LLVMModelDataSymbols::SpeciesReferenceInfo& value)
+{
+    writeBinary(out, value.row);
+    writeBinary(out, value.column);
+    writeBinary(out, value.type);
+    writeBinary(out, value.id);
+}
+
+static void readBinary(std::istream& in,
+        rrllvm::LLVMModelDataSymbols::SpeciesReferenceInfo& value)
+{
+    readBinary(in, value.row);
+    readBinary(in, value.column);
+    readBinary(in, value.type);
+    readBinary(in, value.id);
+}
+
+template <typename T>
+static void writeBinary(std::ostream& out, const std::vector<T>& value)
+{
+    writeBinary(out, (unsigned)value.size());
+    for (typename std::vector<T>::const_iterator i = value.begin();
+            i != value.end(); ++i)
+    {
+        writeBinary(out, *i);
+    }
+}
+
+template <typename T>
+static void readBinary(std::istream& in, std::vector<T>& value)
+{
+    unsigned size = 0;
+    readBinary(in, size);
+    value.clear();
+    for (unsigned i = 0; in && i < size; ++i)
+    {
+        T item;
+        readBinary(in, item);
+        value.push_back(item);
+    }
+}
+
+template <typename T>
+static void writeBinary(std::ostream& out, const std::set<T>& value)
+{
+    writeBinary(out, (unsigned)value.size());
+    for (typename std::set<T>::const_iterator i = value.begin();
+            i != value.end(); ++i)
+    {
+        writeBinary(out, *i);
+    }
+}
+
+template <typename T>
+static void readBinary(std::istream& in, std::set<T>& value)
+{
+    unsigned size = 0;
+    readBinary(in, size);
+    value.clear();
+    for (unsigned i = 0; in && i < size; ++i)
+    {
+        T item;
+        readBinary(in, item);
+        value.insert(item);
+    }
+}
+
+template <typename K, typename V>
+static void writeBinary(std::ostream& out, const std::map<K, V>& value)
+{
+    writeBinary(out, (unsigned)value.size());
+    for (typename std::map<K, V>::const_iterator i = value.begin();
+            i != value.end(); ++i)
+    {
+        writeBinary(out, i->first);
+        writeBinary(out, i->second);
+    }
+}
+
+template <typename K, typename V>
+static void readBinary(std::istream& in, std::map<K, V>& value)
+{
+    unsigned size = 0;
+    readBinary(in, size);
+    value.clear();
+    for (unsigned i = 0; in && i < size; ++i)
+    {
+        K key;
+        readBinary(in, key);
+        readBinary(in, value[key]);
+    }
+}
+
+LLVMModelDataSymbols::LLVMModelDataSymbols(std::istream& in) :
+    independentFloatingSpeciesSize(0),
+    independentBoundarySpeciesSize(0),
+    independentGlobalParameterSize(0),
+    independentCompartmentSize(0),
+    independentInitFloatingSpeciesSize(0),
+    independentInitBoundarySpeciesSize(0),
+    independentInitGlobalParameterSize(0),
+    independentInitCompartmentSize(0)
+{
+    // same order as save
+    readBinary(in, modelName);
+    readBinary(in, floatingSpeciesMap);
+    readBinary(in, boundarySpeciesMap);
+    readBinary(in, compartmentsMap);
+    readBinary(in, globalParametersMap);
+    readBinary(in, namedSpeciesReferenceInfo);
+    readBinary(in, reactionsMap);
+    readBinary(in, stoichColIndx);
+    readBinary(in, stoichRowIndx);
+    readBinary(in, stoichIds);
+    readBinary(in, stoichTypes);
+    readBinary(in, assigmentRules);
+    readBinary(in, rateRules);
+    readBinary(in, algebraicRules);
+    readBinary(in, algebraicRuleVariables);
+    readBinary(in, fastReactions);
+    readBinary(in, independentFloatingSpeciesSize);
+    readBinary(in, independentBoundarySpeciesSize);
+    readBinary(in, independentGlobalParameterSize);
+    readBinary(in, independentCompartmentSize);
+    readBinary(in, eventAssignmentsSize);
+    readBinary(in, eventAttributes);
+    readBinary(in, eventIds);
+    readBinary(in, conservedMoietySpeciesSet);
+    readBinary(in, initAssignmentRules);
+    readBinary(in, initFloatingSpeciesMap);
+    readBinary(in, initBoundarySpeciesMap);
+    readBinary(in, initCompartmentsMap);
+    readBinary(in, initGlobalParametersMap);
+    readBinary(in, independentInitFloatingSpeciesSize);
+    readBinary(in, independentInitBoundarySpeciesSize);
+    readBinary(in, independentInitGlobalParameterSize);
+    readBinary(in, independentInitCompartmentSize);
+
+    if (!in)
+    {
+        throw_llvm_exception("error reading model symbols");
+    }
+}
+
 LLVMModelDataSymbols::~LLVMModelDataSymbols()
 {
 }
 
+void LLVMModelDataSymbols::save(std::ostream& out) const
+{
+    writeBinary(out, modelName);
+    writeBinary(out, floatingSpeciesMap);
+    writeBinary(out, boundarySpeciesMap);
+    writeBinary(out, compartmentsMap);
+    writeBinary(out, globalParametersMap);
+    writeBinary(out, namedSpeciesReferenceInfo);
+    writeBinary(out, reactionsMap);
+    writeBinary(out, stoichColIndx);
+    writeBinary(out, stoichRowIndx);
+    writeBinary(out, stoichIds);
+    writeBinary(out, stoichTypes);
+    writeBinary(out, assigmentRules);
+    writeBinary(out, rateRules);
+    writeBinary(out, algebraicRules);
+    writeBinary(out, algebraicRuleVariables);
+    writeBinary(out, fastReactions);
+    writeBinary(out, independentFloatingSpeciesSize);
+    writeBinary(out, independentBoundarySpeciesSize);
+    writeBinary(out, independentGlobalParameterSize);
+    writeBinary(out, independentCompartmentSize);
+    writeBinary(out, eventAssignmentsSize);
+    writeBinary(out, eventAttributes);
+    writeBinary(out, eventIds);
+    writeBinary(out, conservedMoietySpeciesSet);
+    writeBinary(out, initAssignmentRules);
+    writeBinary(out, initFloatingSpeciesMap);
+    writeBinary(out, initBoundarySpeciesMap);
+    writeBinary(out, initCompartmentsMap);
+    writeBinary(out, initGlobalParametersMap);
+    writeBinary(out, independentInitFloatingSpeciesSize);
+    writeBinary(out, independentInitBoundarySpeciesSize);
+    writeBinary(out, independentInitGlobalParameterSize);
+    writeBinary(out, independentInitCompartmentSize);
+
+    if (!out)
+    {
+        throw_llvm_exception("error writing model symbols");
+    }
+}
+
 const std::string& LLVMModelDataSymbols::getModelName() const
 {
     return modelName;
@@ -341,7 +565,7 @@ void LLVMModelDataSymbols::initAllocModelDataBuffers(LLVMModelData& m) const
     m.numIndGlobalParameters        = independentGlobalParameterSize;
     m.numReactions                  = reactionsMap.size();
     m.numEvents                     = eventAttributes.size();
-    m.numRateRules                  = rateRules.size();
+    m.numRateRules                  = getRateRuleValuesSize();
     m.numIndCompartments               = independentCompartmentSize;
     m.numIndBoundarySpecies            = independentBoundarySpeciesSize;
 
@@ -594,10 +818,151 @@ std::string rrllvm::LLVMModelDataSymbols::getRateRuleId(uint indx) const
             rr::toString(indx));
 }
 
+uint LLVMModelDataSymbols::getRateRuleValuesSize() const
+{
+    return rateRules.size() + algebraicRuleVariables.size();
+}
+
+uint LLVMModelDataSymbols::getRateRuleValuesIndex(std::string const& id) const
+{
+    StringUIntMap::const_iterator i = rateRules.find(id);
+    if (i != rateRules.end())
+    {
+        return i->second;
+    }
+
+    vector<string>::const_iterator j = std::find(algebraicRuleVariables.begin(),
+            algebraicRuleVariables.end(), id);
+    if (j != algebraicRuleVariables.end())
+    {
+        return rateRules.size() + (j - algebraicRuleVariables.begin());
+    }
+
+    throw LLVMException("could not find rate rule or algebraic rule with id "
+            + id, __FUNC__);
+}
+
+const std::vector<uint>& LLVMModelDataSymbols::getAlgebraicRules() const
+{
+    return algebraicRules;
+}
+
+const std::vector<std::string>& LLVMModelDataSymbols::getAlgebraicRuleVariables() const
+{
+    return algebraicRuleVariables;
+}
+
+const std::vector<uint>& LLVMModelDataSymbols::getFastReactions() const
+{
+    return fastReactions;
+}
+
+/**
+ * collect the names in an AST in the order they appear.
+ */
+static void getNames(const ASTNode *node, vector<string>& names)
+{
+    if (node->getType() == AST_NAME)
+    {
+        names.push_back(node->getName());
+    }
+
+    for (uint i = 0; i < node->getNumChildren(); ++i)
+    {
+        getNames(node->getChild(i), names);
+    }
+}
+
+void LLVMModelDataSymbols::initAlgebraicRules(const libsbml::Model* model,
+        const std::vector<uint>& rules)
+{
+    if (rules.empty())
+    {
+        return;
+    }
+
+    // floating species changed by reactions get their dynamics from the
+    // reactions, so can not be determined by an algebraic rule.
+    set<string> reactionSpecies;
+    const ListOfReactions *reactions = model->getListOfReactions();
+    for (uint i = 0; i < reactions->size(); ++i)
+    {
+        const Reaction *r = reactions->get(i);
+        for (uint j = 0; j < r->getNumReactants(); ++j)
+        {
+            reactionSpecies.insert(r->getReactant(j)->getSpecies());
+        }
+        for (uint j = 0; j < r->getNumProducts(); ++j)
+        {
+            reactionSpecies.insert(r->getProduct(j)->getSpecies());
+        }
+    }
+
+    for (uint i = 0; i < rules.size(); ++i)
+    {
+        const Rule *rule = model->getListOfRules()->get(rules[i]);
+
+        vector<string> names;
+        if (rule->isSetMath())
+        {
+            getNames(rule->getMath(), names);
+        }
+
+        // SBML does not say which symbol an algebraic rule determines, use
+        // the first one in the formula which is not constant and not
+        // determined by anything else.
+        string variable;
+        for (uint j = 0; j < names.size() && variable.empty(); ++j)
+        {
+            const string& id = names[j];
+
+            if (rateRules.find(id) != rateRules.end() ||
+                    assigmentRules.find(id) != assigmentRules.end() ||
+                    hasAlgebraicRule(id))
+            {
+                continue;
+            }
+
+            const Parameter *p = model->getParameter(id);
+            const Compartment *c = model->getCompartment(id);
+            const Species *s = model->getSpecies(id);
+
+            if ((p && !p->getConstant()) || (c && !c->getConstant()) ||
+                    (s && !s->getConstant() && (s->getBoundaryCondition() ||
+                            reactionSpecies.find(id) == reactionSpecies.end())))
+            {
+                variable = id;
+            }
+        }
+
+        char* formula = SBML_formulaToString(rule->getMath());
+
+        if (variable.empty())
+        {
+            Log(Logger::LOG_WARNING)
+                << "Unable to determine the variable of the algebraic rule '0 = "
+                << formula << "', rule ignored.";
+        }
+        else
+        {
+            Log(Logger::LOG_NOTICE)
+                << "Algebraic rule '0 = " << formula << "' determines '"
+                << variable << "', it is only solved by the ida integrator, "
+                << "other integrators keep it constant.";
+
+            algebraicRules.push_back(rules[i]);
+            algebraicRuleVariables.push_back(variable);
+        }
+
+        free(formula);
+    }
+}
+
 bool LLVMModelDataSymbols::isIndependentElement(const std::string& id) const
 {
     return rateRules.find(id) == rateRules.end() &&
-            assigmentRules.find(id) == assigmentRules.end();
+            assigmentRules.find(id) == assigmentRules.end() &&
+            !hasAlgebraicRule(id);
 }
 
 bool LLVMModelDataSymbols::hasAssignmentRule(const std::string& id) const
@@ -610,6 +975,17 @@ bool LLVMModelDataSymbols::hasRateRule(const std::string& id) const
     return rateRules.find(id) != rateRules.end();
 }
 
+bool LLVMModelDataSymbols::hasAlgebraicRule(const std::string& id) const
+{
+    return std::find(algebraicRuleVariables.begin(),
+            algebraicRuleVariables.end(), id) != algebraicRuleVariables.end();
+}
+
+bool LLVMModelDataSymbols::hasRateRuleValue(const std::string& id) const
+{
+    return hasRateRule(id) || hasAlgebraicRule(id);
+}
+
 uint LLVMModelDataSymbols::getCompartmentsSize() const
 {
     return compartmentsMap.size();
@@ -938,9 +1314,11 @@ void LLVMModelDataSymbols::initReactions(const libsbml::Model* model)
     {
         const Reaction *reaction = reactions->get(i);
         if (reaction->isSetFast() && reaction->getFast()==true) {
-          Log(Logger::LOG_WARNING)
-            << "Unable to handle SBML fast reactions. Reaction '"
-            << reaction->getId() << "' treated as a slow reaction.";
+          Log(Logger::LOG_NOTICE)
+            << "Reaction '" << reaction->getId() << "' is fast, it is only "
+            << "kept at equilibrium by the ida integrator, other integrators "
+            << "treat it as a slow reaction.";
+          fastReactions.push_back(i);
         }
         reactionsMap.insert(StringUIntPair(reaction->getId(), i));
 
@@ -1127,6 +1505,10 @@ bool LLVMModelDataSymbols::isValidSpeciesReference(
         {
             err += "it is defined by rate rule";
         }
+        else if (hasAlgebraicRule(id))
+        {
+            err += "it is determined by an algebraic rule";
+        }
         else if (isIndependentBoundarySpecies(id))
         {
             err += "it is a boundary species";
@@ -17,6 +17,7 @@
 #include <map>
 #include <set>
 #include <list>
+#include <iosfwd>
 
 namespace libsbml
 {
@@ -159,8 +160,20 @@ public:
 
     LLVMModelDataSymbols(libsbml::Model const* model, unsigned options);
 
+    /**
+     * read the symbols written by save, models loaded from a model library
+     * have no sbml document to determine them from.
+     */
+    LLVMModelDataSymbols(std::istream& in);
+
     virtual ~LLVMModelDataSymbols();
 
+    /**
+     * write all the symbols in a binary format, in native byte order, as
+     * they are only read back on the same platform.
+     */
+    void save(std::ostream& out) const;
+
     const std::string& getModelName() const;
 
     uint getCompartmentIndex(std::string const&) const;
@@ -214,6 +227,44 @@ public:
      */
     std::string getRateRuleId(uint indx) const;
 
+    /**
+     * the rateRuleValues block of the model data holds the values of the
+     * rate rules, followed by the variables of the algebraic rules, so
+     * both are part of the state vector. The algebraic rule variables are
+     * not rate rules, the rate rule accessors above do not see them.
+     *
+     * size of the block, the number of rate rules plus the number of
+     * algebraic rule variables.
+     */
+    uint getRateRuleValuesSize() const;
+
+    /**
+     * index of a rate rule or algebraic rule variable in the rateRuleValues
+     * block, which is also its index in the state vector.
+     */
+    uint getRateRuleValuesIndex(std::string const&) const;
+
+    /**
+     * indices in the model list of rules of the algebraic rules which
+     * could be used.
+     */
+    const std::vector<uint>& getAlgebraicRules() const;
+
+    /**
+     * the variable each algebraic rule determines, in the same order as
+     * getAlgebraicRules.
+     *
+     * These are stored after the rate rule values, so they are part of the
+     * state vector, but have a zero rate. Their values are only determined
+     * by integrators which handle algebraic constraints.
+     */
+    const std::vector<std::string>& getAlgebraicRuleVariables() const;
+
+    /**
+     * indices of the reactions which are marked as fast.
+     */
+    const std::vector<uint>& getFastReactions() const;
+
     /**
      * number of global parameters which are not determined by rules.
      */
@@ -296,6 +347,17 @@ public:
 
     bool hasRateRule(const std::string& id) const;
 
+    /**
+     * is the symbol determined by an algebraic rule.
+     */
+    bool hasAlgebraicRule(const std::string& id) const;
+
+    /**
+     * is the symbol stored in the rateRuleValues block, i.e. has a
+     * rate rule or is determined by an algebraic rule.
+     */
+    bool hasRateRuleValue(const std::string& id) const;
+
     bool hasAssignmentRule(const std::string& id) const;
 
     bool hasInitialAssignmentRule(const std::string& id) const;
@@ -551,6 +613,15 @@ private:
      */
     StringUIntMap rateRules;
 
+    /**
+     * algebraic rules, and the variables they determine, these
+     * variables are stored after the rate rules.
+     */
+    std::vector<uint> algebraicRules;
+    std::vector<std::string> algebraicRuleVariables;
+
+    std::vector<uint> fastReactions;
+
     uint independentFloatingSpeciesSize;
     uint independentBoundarySpeciesSize;
     uint independentGlobalParameterSize;
@@ -589,6 +660,13 @@ private:
 
     void initReactions(const libsbml::Model *model);
 
+    /**
+     * pick the variable each algebraic rule determines, must be called
+     * after the other rules are known.
+     */
+    void initAlgebraicRules(const libsbml::Model *model,
+            const std::vector<uint>& rules);
+
     void displayCompartmentInfo();
 
     void initEvents(const libsbml::Model *model);
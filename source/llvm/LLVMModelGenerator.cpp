@@ -13,9 +13,35 @@
 #include "ModelGeneratorContext.h"
 #include "LLVMIncludes.h"
 #include "ModelResources.h"
+#include "ModelLibrary.h"
 #include "rrUtils.h"
 #include <rrLogger.h>
+#include "rrConfig.h"
+#include "rrWorkerPool.h"
 #include <Poco/Mutex.h>
+#include <Poco/Runnable.h>
+#include <Poco/Environment.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/Process.h>
+#include <llvm/Support/FormattedStream.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <algorithm>
+#include <fstream>
+#include <list>
+#include <sstream>
+#include <vector>
+
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Threading.h>
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR >= 5)
+#include <llvm/Linker/Linker.h>
+#else
+#include <llvm/Linker.h>
+#endif
 
 using rr::Logger;
 using rr::getLogger;
@@ -29,10 +55,101 @@ namespace rrllvm
 typedef cxx11_ns::weak_ptr<ModelResources> WeakModelPtr;
 typedef cxx11_ns::shared_ptr<ModelResources> SharedModelPtr;
 typedef cxx11_ns::unordered_map<std::string, WeakModelPtr> ModelPtrMap;
+typedef std::list<std::pair<std::string, SharedModelPtr> > ModelPtrList;
 
 static Poco::Mutex cachedModelsMutex;
 static ModelPtrMap cachedModels;
 
+/**
+ * strong references to the most recently used models, most recent
+ * at the front. Keeps the compiled code of a model alive after the last
+ * executable model that uses it is deleted, so the next load of the same
+ * sbml is a cache hit. Sized by the LLVM_MODEL_CACHE_SIZE and
+ * LLVM_MODEL_CACHE_MEMORY config values.
+ */
+static ModelPtrList retainedModels;
+
+static unsigned long cacheHits = 0;
+static unsigned long cacheMisses = 0;
+
+/**
+ * the generated code depends on the options as well as the sbml, so
+ * the options that change code generation are part of the key.
+ */
+static std::string cacheKey(const std::string& sbml, uint options)
+{
+    std::stringstream key;
+    key << rr::getMD5(sbml);
+    key << "_" << std::hex << (options & ~ModelGenerator::RECOMPILE);
+    return key.str();
+}
+
+/**
+ * drop the least recently used models until the retained list is within
+ * the configured count and memory limits, the dropped models are moved to
+ * released. A limit of 0 is not applied, if neither limit is set, no
+ * models are retained.
+ *
+ * cachedModelsMutex must be locked.
+ */
+static void trimRetainedModels(ModelPtrList& released)
+{
+    size_t maxCount = (size_t)std::max(0,
+            rr::Config::getInt(rr::Config::LLVM_MODEL_CACHE_SIZE));
+    size_t maxBytes = (size_t)std::max(0,
+            rr::Config::getInt(rr::Config::LLVM_MODEL_CACHE_MEMORY)) * 1024 * 1024;
+
+    if (maxCount == 0 && maxBytes == 0)
+    {
+        released.splice(released.end(), retainedModels);
+        return;
+    }
+
+    size_t bytes = 0;
+    for (ModelPtrList::const_iterator i = retainedModels.begin();
+            i != retainedModels.end(); ++i)
+    {
+        bytes += i->second->getMemoryUsage();
+    }
+
+    while (!retainedModels.empty() &&
+            ((maxCount > 0 && retainedModels.size() > maxCount) ||
+             (maxBytes > 0 && bytes > maxBytes)))
+    {
+        Log(Logger::LOG_DEBUG) << "releasing least recently used model "
+                << retainedModels.back().first << " from cache";
+
+        bytes -= retainedModels.back().second->getMemoryUsage();
+        released.splice(released.end(), retainedModels,
+                --retainedModels.end());
+    }
+}
+
+/**
+ * move (or insert) the model to the front of the retained list, and drop
+ * the least recently used models until the list is within the configured
+ * limits.
+ *
+ * cachedModelsMutex must be locked.
+ */
+static void retainModel(const std::string& key, const SharedModelPtr& model)
+{
+    for (ModelPtrList::iterator i = retainedModels.begin();
+            i != retainedModels.end(); ++i)
+    {
+        if (i->first == key)
+        {
+            retainedModels.erase(i);
+            break;
+        }
+    }
+
+    retainedModels.push_front(std::make_pair(key, model));
+
+    ModelPtrList released;
+    trimRetainedModels(released);
+}
+
 
 /**
  * copy the cached model fields between a cached model, and a
@@ -66,6 +183,470 @@ void copyCachedModel(a_type* src, b_type* dst)
     dst->eventAssignPtr = src->eventAssignPtr;
     dst->evalVolatileStoichPtr = src->evalVolatileStoichPtr;
     dst->evalConversionFactorPtr = src->evalConversionFactorPtr;
+    dst->evalJacobianPtr = src->evalJacobianPtr;
+    dst->evalAlgebraicResidualsPtr = src->evalAlgebraicResidualsPtr;
+}
+
+
+/**
+ * generates one of the model functions, optimized, but not compiled.
+ */
+typedef llvm::Function* (*IRCodeGenFunction)(const ModelGeneratorContext&);
+
+template <typename CodeGenType>
+static llvm::Function* generateIR(const ModelGeneratorContext& context)
+{
+    return CodeGenType(context).createFunctionIR();
+}
+
+/**
+ * compiles one of the model functions that has been generated in (or linked
+ * into) the context's module, and stores the resulting function pointer in
+ * the model resources.
+ */
+typedef void (*ResolveFunction)(const ModelGeneratorContext&, ModelResources&);
+
+template <typename CodeGenType,
+    typename CodeGenType::FunctionPtr ModelResources::*functionPtr>
+static void resolve(const ModelGeneratorContext& context, ModelResources& rc)
+{
+    llvm::Function *func = context.getModule()->getFunction(
+            CodeGenType::FunctionName);
+
+    if (func == 0)
+    {
+        throw_llvm_exception(string("model function ") +
+                CodeGenType::FunctionName + " was not generated");
+    }
+
+    rc.*functionPtr = (typename CodeGenType::FunctionPtr)
+            context.getExecutionEngine().getPointerToFunction(func);
+}
+
+struct ModelFunction
+{
+    IRCodeGenFunction generate;
+    ResolveFunction resolve;
+};
+
+template <typename CodeGenType,
+    typename CodeGenType::FunctionPtr ModelResources::*functionPtr>
+static void addFunction(std::vector<ModelFunction>& functions)
+{
+    ModelFunction func = {&generateIR<CodeGenType>,
+            &resolve<CodeGenType, functionPtr>};
+    functions.push_back(func);
+}
+
+/**
+ * the model functions for the given options, in the order they are
+ * generated, most expensive first. The function pointers of the functions
+ * the options leave out are set to 0.
+ */
+static std::vector<ModelFunction> createFunctionList(uint options,
+        ModelResources& rc)
+{
+    std::vector<ModelFunction> functions;
+
+    addFunction<EvalInitialConditionsCodeGen,
+            &ModelResources::evalInitialConditionsPtr>(functions);
+
+    addFunction<EvalReactionRatesCodeGen,
+            &ModelResources::evalReactionRatesPtr>(functions);
+
+    addFunction<GetBoundarySpeciesAmountCodeGen,
+            &ModelResources::getBoundarySpeciesAmountPtr>(functions);
+
+    addFunction<GetFloatingSpeciesAmountCodeGen,
+            &ModelResources::getFloatingSpeciesAmountPtr>(functions);
+
+    addFunction<GetBoundarySpeciesConcentrationCodeGen,
+            &ModelResources::getBoundarySpeciesConcentrationPtr>(functions);
+
+    addFunction<GetFloatingSpeciesConcentrationCodeGen,
+            &ModelResources::getFloatingSpeciesConcentrationPtr>(functions);
+
+    addFunction<GetCompartmentVolumeCodeGen,
+            &ModelResources::getCompartmentVolumePtr>(functions);
+
+    addFunction<GetGlobalParameterCodeGen,
+            &ModelResources::getGlobalParameterPtr>(functions);
+
+    addFunction<EvalRateRuleRatesCodeGen,
+            &ModelResources::evalRateRuleRatesPtr>(functions);
+
+    addFunction<GetEventTriggerCodeGen,
+            &ModelResources::getEventTriggerPtr>(functions);
+
+    addFunction<GetEventPriorityCodeGen,
+            &ModelResources::getEventPriorityPtr>(functions);
+
+    addFunction<GetEventDelayCodeGen,
+            &ModelResources::getEventDelayPtr>(functions);
+
+    addFunction<EventTriggerCodeGen,
+            &ModelResources::eventTriggerPtr>(functions);
+
+    addFunction<EventAssignCodeGen,
+            &ModelResources::eventAssignPtr>(functions);
+
+    addFunction<EvalVolatileStoichCodeGen,
+            &ModelResources::evalVolatileStoichPtr>(functions);
+
+    addFunction<EvalConversionFactorCodeGen,
+            &ModelResources::evalConversionFactorPtr>(functions);
+
+    addFunction<EvalJacobianCodeGen,
+            &ModelResources::evalJacobianPtr>(functions);
+
+    addFunction<EvalAlgebraicResidualsCodeGen,
+            &ModelResources::evalAlgebraicResidualsPtr>(functions);
+
+    if (options & ModelGenerator::READ_ONLY)
+    {
+        rc.setBoundarySpeciesAmountPtr = 0;
+        rc.setBoundarySpeciesConcentrationPtr = 0;
+        rc.setFloatingSpeciesConcentrationPtr = 0;
+        rc.setCompartmentVolumePtr = 0;
+        rc.setFloatingSpeciesAmountPtr = 0;
+        rc.setGlobalParameterPtr = 0;
+    }
+    else
+    {
+        addFunction<SetBoundarySpeciesAmountCodeGen,
+                &ModelResources::setBoundarySpeciesAmountPtr>(functions);
+
+        addFunction<SetBoundarySpeciesConcentrationCodeGen,
+                &ModelResources::setBoundarySpeciesConcentrationPtr>(functions);
+
+        addFunction<SetFloatingSpeciesConcentrationCodeGen,
+                &ModelResources::setFloatingSpeciesConcentrationPtr>(functions);
+
+        addFunction<SetCompartmentVolumeCodeGen,
+                &ModelResources::setCompartmentVolumePtr>(functions);
+
+        addFunction<SetFloatingSpeciesAmountCodeGen,
+                &ModelResources::setFloatingSpeciesAmountPtr>(functions);
+
+        addFunction<SetGlobalParameterCodeGen,
+                &ModelResources::setGlobalParameterPtr>(functions);
+    }
+
+    if (options & ModelGenerator::MUTABLE_INITIAL_CONDITIONS)
+    {
+        addFunction<GetFloatingSpeciesInitConcentrationCodeGen,
+                &ModelResources::getFloatingSpeciesInitConcentrationsPtr>(functions);
+        addFunction<SetFloatingSpeciesInitConcentrationCodeGen,
+                &ModelResources::setFloatingSpeciesInitConcentrationsPtr>(functions);
+
+        addFunction<GetFloatingSpeciesInitAmountCodeGen,
+                &ModelResources::getFloatingSpeciesInitAmountsPtr>(functions);
+        addFunction<SetFloatingSpeciesInitAmountCodeGen,
+                &ModelResources::setFloatingSpeciesInitAmountsPtr>(functions);
+
+        addFunction<GetCompartmentInitVolumeCodeGen,
+                &ModelResources::getCompartmentInitVolumesPtr>(functions);
+        addFunction<SetCompartmentInitVolumeCodeGen,
+                &ModelResources::setCompartmentInitVolumesPtr>(functions);
+
+        addFunction<GetGlobalParameterInitValueCodeGen,
+                &ModelResources::getGlobalParameterInitValuePtr>(functions);
+    }
+    else
+    {
+        rc.getFloatingSpeciesInitConcentrationsPtr = 0;
+        rc.setFloatingSpeciesInitConcentrationsPtr = 0;
+
+        rc.getFloatingSpeciesInitAmountsPtr = 0;
+        rc.setFloatingSpeciesInitAmountsPtr = 0;
+
+        rc.getCompartmentInitVolumesPtr = 0;
+        rc.setCompartmentInitVolumesPtr = 0;
+
+        rc.getGlobalParameterInitValuePtr = 0;
+    }
+
+    return functions;
+}
+
+/**
+ * LLVM modules declare the functions ModelGeneratorContext::addGlobalMappings
+ * maps with local linkage. Give them external linkage so the linker
+ * unifies the declarations of a worker module with the main module's,
+ * which the execution engine has the mappings for.
+ */
+static void externalizeDeclarations(llvm::Module *module)
+{
+    for (llvm::Module::iterator f = module->begin(); f != module->end(); ++f)
+    {
+        if (f->isDeclaration() && f->hasLocalLinkage())
+        {
+            f->setLinkage(llvm::GlobalValue::ExternalLinkage);
+        }
+    }
+}
+
+/**
+ * generates the IR of a subset of the model functions.
+ *
+ * LLVM contexts and modules can not be shared between threads, and neither
+ * can libsbml documents, so a worker that runs on its own thread gets its
+ * own context built from its own copy of the sbml document. The first worker
+ * always uses the main context in the calling thread.
+ *
+ * Workers on other threads only generate and optimize IR, they never
+ * compile anything. Their module is written out as bitcode, which the
+ * calling thread links into the main module (see linkWorkers), so all the
+ * native code is emitted by the main execution engine, and the worker's
+ * context and document are released as soon as they are linked.
+ *
+ * Contexts and execution engines are created and deleted on the calling
+ * thread, the only LLVM work that runs concurrently is building IR and
+ * running the function passes, each thread in its own LLVMContext.
+ */
+class CodeGenWorker : public Poco::Runnable
+{
+public:
+    CodeGenWorker(ModelGeneratorContext& context) :
+        doc(0), ownedContext(0), context(&context)
+    {
+    }
+
+    CodeGenWorker(const libsbml::SBMLDocument *src, uint options) :
+        doc(src->clone()), ownedContext(0), context(0)
+    {
+        try
+        {
+            ownedContext = new ModelGeneratorContext(doc, options);
+        }
+        catch(...)
+        {
+            delete doc;
+            throw;
+        }
+        context = ownedContext;
+    }
+
+    virtual ~CodeGenWorker()
+    {
+        // context borrows the doc
+        delete ownedContext;
+        delete doc;
+    }
+
+    void addFunction(IRCodeGenFunction func)
+    {
+        functions.push_back(func);
+    }
+
+    virtual void run()
+    {
+        try
+        {
+            for (unsigned i = 0; i < functions.size(); ++i)
+            {
+                llvm::Function *func = functions[i](*context);
+
+                // linked into the main module by name
+                if (ownedContext)
+                {
+                    func->setLinkage(llvm::GlobalValue::ExternalLinkage);
+                }
+            }
+
+            if (ownedContext)
+            {
+                externalizeDeclarations(context->getModule());
+
+                llvm::raw_string_ostream out(bitcode);
+                llvm::WriteBitcodeToFile(context->getModule(), out);
+            }
+        }
+        catch(std::exception& e)
+        {
+            error = e.what();
+        }
+        catch(...)
+        {
+            error = "unknown error generating model functions";
+        }
+    }
+
+    /**
+     * the worker's module, empty for the worker that uses the main context.
+     */
+    const std::string& getBitcode() const
+    {
+        return bitcode;
+    }
+
+    const std::string& getError() const
+    {
+        return error;
+    }
+
+private:
+    libsbml::SBMLDocument *doc;
+    ModelGeneratorContext *ownedContext;
+    ModelGeneratorContext *context;
+    std::vector<IRCodeGenFunction> functions;
+    std::string bitcode;
+    std::string error;
+};
+
+typedef cxx11_ns::shared_ptr<CodeGenWorker> CodeGenWorkerPtr;
+typedef std::vector<CodeGenWorkerPtr> CodeGenWorkerList;
+
+/**
+ * make the LLVM global state safe to use from multiple threads, returns
+ * false if this build of LLVM does not support threads.
+ */
+static bool startMultithreaded()
+{
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR < 5)
+    // no-op if already enabled.
+    return llvm::llvm_start_multithreaded();
+#else
+    // thread safety is determined when LLVM is built.
+    return llvm::llvm_is_multithreaded();
+#endif
+}
+
+/**
+ * create the workers, as many as the LLVM_CODEGEN_THREADS config value,
+ * but never more than there are functions, and distribute the functions
+ * between them.
+ */
+static CodeGenWorkerList createWorkers(ModelGeneratorContext& context,
+        uint options, const std::vector<ModelFunction>& functions)
+{
+    int nthreads = rr::Config::getInt(rr::Config::LLVM_CODEGEN_THREADS);
+
+    if (nthreads <= 0)
+    {
+        nthreads = Poco::Environment::processorCount();
+    }
+
+    nthreads = std::max(1, std::min(nthreads, (int)functions.size()));
+
+    if (nthreads > 1 && !startMultithreaded())
+    {
+        Log(Logger::LOG_WARNING) << "LLVM was built without thread support, "
+                "generating model functions on a single thread";
+        nthreads = 1;
+    }
+
+    CodeGenWorkerList workers;
+
+    workers.push_back(CodeGenWorkerPtr(new CodeGenWorker(context)));
+
+    for (int i = 1; i < nthreads; ++i)
+    {
+        workers.push_back(CodeGenWorkerPtr(new CodeGenWorker(
+                context.getDocument(), options)));
+    }
+
+    // the most expensive functions are at the front of the list,
+    // so round robin spreads them out.
+    for (unsigned i = 0; i < functions.size(); ++i)
+    {
+        workers[i % workers.size()]->addFunction(functions[i].generate);
+    }
+
+    return workers;
+}
+
+/**
+ * run the first worker in the calling thread, and each of the rest in its
+ * own thread, wait for all of them to finish.
+ */
+static void runWorkers(CodeGenWorkerList& workers)
+{
+    if (workers.size() > 1)
+    {
+        Log(Logger::LOG_DEBUG) << "generating model functions with "
+                << workers.size() << " threads";
+    }
+
+    std::vector<CodeGenWorker*> runnables;
+    for (unsigned i = 0; i < workers.size(); ++i)
+    {
+        runnables.push_back(workers[i].get());
+    }
+
+    rr::WorkerPool(workers.size()).run(runnables);
+
+    for (unsigned i = 0; i < workers.size(); ++i)
+    {
+        if (workers[i]->getError().size())
+        {
+            throw_llvm_exception(workers[i]->getError());
+        }
+    }
+}
+
+/**
+ * read a worker's bitcode into the main context, and link it into the
+ * main module.
+ */
+static void linkBitcode(const std::string& bitcode, llvm::Module *dest)
+{
+    using namespace llvm;
+
+    std::string err;
+    MemoryBuffer *buffer = MemoryBuffer::getMemBuffer(bitcode, "", false);
+
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR >= 5)
+    ErrorOr<Module*> parsed = parseBitcodeFile(buffer, dest->getContext());
+    Module *src = 0;
+    if (parsed)
+    {
+        src = parsed.get();
+    }
+    else
+    {
+        err = parsed.getError().message();
+    }
+#else
+    Module *src = ParseBitcodeFile(buffer, dest->getContext(), &err);
+#endif
+
+    // the reader does not take ownership of the buffer
+    delete buffer;
+
+    if (src == 0)
+    {
+        throw_llvm_exception("could not read generated module, " + err);
+    }
+
+    bool failed = Linker::LinkModules(dest, src, Linker::DestroySource, &err);
+    delete src;
+
+    if (failed)
+    {
+        throw_llvm_exception("could not link generated module, " + err);
+    }
+}
+
+/**
+ * link the modules of the workers that ran on other threads into the
+ * main context's module, and release the workers with their contexts.
+ */
+static void linkWorkers(ModelGeneratorContext& context,
+        CodeGenWorkerList& workers)
+{
+    if (workers.size() > 1)
+    {
+        externalizeDeclarations(context.getModule());
+
+        for (unsigned i = 1; i < workers.size(); ++i)
+        {
+            linkBitcode(workers[i]->getBitcode(), context.getModule());
+            workers[i].reset();
+        }
+    }
+
+    workers.clear();
 }
 
 
@@ -121,12 +702,7 @@ ExecutableModel* LLVMModelGenerator::createModel(const std::string& sbml,
     if (!forceReCompile)
     {
         // check for a chached copy
-        md5 = rr::getMD5(sbml);
-
-        if (options & ModelGenerator::CONSERVED_MOIETIES)
-        {
-            md5 += "_conserved";
-        }
+        md5 = cacheKey(sbml, options);
 
         ModelPtrMap::const_iterator i;
 
@@ -139,6 +715,16 @@ ExecutableModel* LLVMModelGenerator::createModel(const std::string& sbml,
             sp = i->second.lock();
         }
 
+        if (sp)
+        {
+            ++cacheHits;
+            retainModel(md5, sp);
+        }
+        else
+        {
+            ++cacheMisses;
+        }
+
         cachedModelsMutex.unlock();
 
         // we could have recieved a bad ptr, a model could have been deleted,
@@ -162,116 +748,18 @@ ExecutableModel* LLVMModelGenerator::createModel(const std::string& sbml,
 
     ModelGeneratorContext context(sbml, options);
 
-    rc->evalInitialConditionsPtr =
-            EvalInitialConditionsCodeGen(context).createFunction();
-
-    rc->evalReactionRatesPtr =
-            EvalReactionRatesCodeGen(context).createFunction();
-
-    rc->getBoundarySpeciesAmountPtr =
-            GetBoundarySpeciesAmountCodeGen(context).createFunction();
+    std::vector<ModelFunction> functions = createFunctionList(options, *rc);
 
-    rc->getFloatingSpeciesAmountPtr =
-            GetFloatingSpeciesAmountCodeGen(context).createFunction();
-
-    rc->getBoundarySpeciesConcentrationPtr =
-            GetBoundarySpeciesConcentrationCodeGen(context).createFunction();
-
-    rc->getFloatingSpeciesConcentrationPtr =
-            GetFloatingSpeciesConcentrationCodeGen(context).createFunction();
-
-    rc->getCompartmentVolumePtr =
-            GetCompartmentVolumeCodeGen(context).createFunction();
-
-    rc->getGlobalParameterPtr =
-            GetGlobalParameterCodeGen(context).createFunction();
-
-    rc->evalRateRuleRatesPtr =
-            EvalRateRuleRatesCodeGen(context).createFunction();
-
-    rc->getEventTriggerPtr =
-            GetEventTriggerCodeGen(context).createFunction();
-
-    rc->getEventPriorityPtr =
-            GetEventPriorityCodeGen(context).createFunction();
-
-    rc->getEventDelayPtr =
-            GetEventDelayCodeGen(context).createFunction();
-
-    rc->eventTriggerPtr =
-            EventTriggerCodeGen(context).createFunction();
-
-    rc->eventAssignPtr =
-            EventAssignCodeGen(context).createFunction();
-
-    rc->evalVolatileStoichPtr =
-            EvalVolatileStoichCodeGen(context).createFunction();
-
-    rc->evalConversionFactorPtr =
-            EvalConversionFactorCodeGen(context).createFunction();
-
-    if (options & ModelGenerator::READ_ONLY)
-    {
-        rc->setBoundarySpeciesAmountPtr = 0;
-        rc->setBoundarySpeciesConcentrationPtr = 0;
-        rc->setFloatingSpeciesConcentrationPtr = 0;
-        rc->setCompartmentVolumePtr = 0;
-        rc->setFloatingSpeciesAmountPtr = 0;
-        rc->setGlobalParameterPtr = 0;
-    }
-    else
-    {
-        rc->setBoundarySpeciesAmountPtr = SetBoundarySpeciesAmountCodeGen(
-                context).createFunction();
-
-        rc->setBoundarySpeciesConcentrationPtr =
-                SetBoundarySpeciesConcentrationCodeGen(context).createFunction();
-
-        rc->setFloatingSpeciesConcentrationPtr =
-                SetFloatingSpeciesConcentrationCodeGen(context).createFunction();
-
-        rc->setCompartmentVolumePtr =
-                SetCompartmentVolumeCodeGen(context).createFunction();
-
-        rc->setFloatingSpeciesAmountPtr = SetFloatingSpeciesAmountCodeGen(
-                context).createFunction();
-
-        rc->setGlobalParameterPtr =
-                SetGlobalParameterCodeGen(context).createFunction();
-    }
-
-    if (options & ModelGenerator::MUTABLE_INITIAL_CONDITIONS)
-    {
-        rc->getFloatingSpeciesInitConcentrationsPtr =
-                GetFloatingSpeciesInitConcentrationCodeGen(context).createFunction();
-        rc->setFloatingSpeciesInitConcentrationsPtr =
-                SetFloatingSpeciesInitConcentrationCodeGen(context).createFunction();
+    CodeGenWorkerList workers = createWorkers(context, options, functions);
 
-        rc->getFloatingSpeciesInitAmountsPtr =
-                GetFloatingSpeciesInitAmountCodeGen(context).createFunction();
-        rc->setFloatingSpeciesInitAmountsPtr =
-                SetFloatingSpeciesInitAmountCodeGen(context).createFunction();
+    runWorkers(workers);
 
-        rc->getCompartmentInitVolumesPtr =
-                GetCompartmentInitVolumeCodeGen(context).createFunction();
-        rc->setCompartmentInitVolumesPtr =
-                SetCompartmentInitVolumeCodeGen(context).createFunction();
+    linkWorkers(context, workers);
 
-        rc->getGlobalParameterInitValuePtr =
-                GetGlobalParameterInitValueCodeGen(context).createFunction();
-    }
-    else
+    // everything is in the main module now, compile it with the main engine.
+    for (unsigned i = 0; i < functions.size(); ++i)
     {
-        rc->getFloatingSpeciesInitConcentrationsPtr = 0;
-        rc->setFloatingSpeciesInitConcentrationsPtr = 0;
-
-        rc->getFloatingSpeciesInitAmountsPtr = 0;
-        rc->setFloatingSpeciesInitAmountsPtr = 0;
-
-        rc->getCompartmentInitVolumesPtr = 0;
-        rc->setCompartmentInitVolumesPtr = 0;
-
-        rc->getGlobalParameterInitValuePtr = 0;
+        functions[i].resolve(context, *rc);
     }
 
 
@@ -300,6 +788,14 @@ ExecutableModel* LLVMModelGenerator::createModel(const std::string& sbml,
         throw_llvm_exception(s.str());
     }
 
+    if (options & ModelGenerator::COMPACT)
+    {
+        rc->irSizeReleased = context.releaseFunctionBodies();
+    }
+
+    rc->nativeCodeSize = context.getEmittedCodeSize();
+    rc->irSize = context.getModuleSizeEstimate();
+
     // * MOVE * the bits over from the context to the exe model.
     context.stealThePeach(&rc->symbols, &rc->context,
             &rc->executionEngine, &rc->errStr);
@@ -339,6 +835,7 @@ ExecutableModel* LLVMModelGenerator::createModel(const std::string& sbml,
                     ", inserting new resources into cache";
 
             cachedModels[md5] = rc;
+            retainModel(md5, rc);
         }
 
         cachedModelsMutex.unlock();
@@ -347,6 +844,343 @@ ExecutableModel* LLVMModelGenerator::createModel(const std::string& sbml,
     return new LLVMExecutableModel(rc, modelData);
 }
 
+/**
+ * model libraries are loaded without the execution engine that resolves
+ * the global mappings, so each call of a mapped function is replaced with
+ * a call through the rr_model_imports table, which is filled in at load.
+ * Mapped functions which are not called are removed.
+ */
+static void createModelLibraryImports(llvm::Module *module)
+{
+    using namespace llvm;
+
+    LLVMContext& context = module->getContext();
+    ArrayType *importsType = ArrayType::get(Type::getInt8PtrTy(context),
+            ModelLibrary::getImportCount());
+
+    GlobalVariable *imports = new GlobalVariable(*module, importsType, false,
+            GlobalValue::ExternalLinkage, ConstantAggregateZero::get(importsType),
+            ModelLibrary::importsName);
+
+    for (unsigned i = 0; i < ModelLibrary::getImportCount(); ++i)
+    {
+        Function *decl = module->getFunction(ModelLibrary::getImportName(i));
+
+        if (decl == 0)
+        {
+            continue;
+        }
+
+        while (!decl->use_empty())
+        {
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR >= 5)
+            CallInst *call = dyn_cast<CallInst>(decl->user_back());
+#else
+            CallInst *call = dyn_cast<CallInst>(decl->use_back());
+#endif
+            if (call == 0 || call->getCalledFunction() != decl)
+            {
+                throw_llvm_exception(string("unsupported use of ") +
+                        ModelLibrary::getImportName(i) + " in model library");
+            }
+
+            IRBuilder<> builder(call);
+            Value *ptr = builder.CreateLoad(
+                    builder.CreateConstGEP2_32(imports, 0, i));
+            call->setCalledFunction(builder.CreateBitCast(ptr, decl->getType()));
+        }
+
+        decl->eraseFromParent();
+    }
+
+    // whatever else is mapped, such as the debugging functions, must not
+    // be used.
+    for (Module::iterator i = module->begin(); i != module->end();)
+    {
+        Function *func = i++;
+
+        if (func->isDeclaration() && func->hasLocalLinkage())
+        {
+            if (!func->use_empty())
+            {
+                throw_llvm_exception("model library can not call "
+                        + func->getName().str());
+            }
+            func->eraseFromParent();
+        }
+    }
+}
+
+/**
+ * the constant data the library is loaded from.
+ */
+static void createModelLibraryInfo(llvm::Module *module, const std::string& info)
+{
+    using namespace llvm;
+
+    LLVMContext& context = module->getContext();
+    Constant *data = ConstantDataArray::getString(context, info, false);
+
+    new GlobalVariable(*module, data->getType(), true,
+            GlobalValue::ExternalLinkage, data, ModelLibrary::infoName);
+
+    new GlobalVariable(*module, Type::getInt32Ty(context), true,
+            GlobalValue::ExternalLinkage,
+            ConstantInt::get(Type::getInt32Ty(context), info.size()),
+            ModelLibrary::infoSizeName);
+}
+
+/**
+ * compile the module to a position independent native object file for
+ * the host.
+ */
+static std::string emitObjectFile(llvm::Module *module)
+{
+    using namespace llvm;
+
+    InitializeNativeTargetAsmPrinter();
+
+    std::string triple = sys::getDefaultTargetTriple();
+    std::string err;
+
+    const Target *target = TargetRegistry::lookupTarget(triple, err);
+
+    if (target == 0)
+    {
+        throw_llvm_exception("no target for " + triple + ", " + err);
+    }
+
+    TargetMachine *targetMachine = target->createTargetMachine(triple,
+            sys::getHostCPUName(), "", TargetOptions(), Reloc::PIC_,
+            CodeModel::Default, CodeGenOpt::Default);
+
+    if (targetMachine == 0)
+    {
+        throw_llvm_exception("could not create target machine for " + triple);
+    }
+
+    module->setTargetTriple(triple);
+
+    std::string obj;
+    PassManager passManager;
+
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR == 1)
+    passManager.add(new TargetData(*targetMachine->getTargetData()));
+#else
+    passManager.add(new DataLayout(*targetMachine->getDataLayout()));
+#endif
+
+    {
+        raw_string_ostream stream(obj);
+        formatted_raw_ostream out(stream);
+
+        if (targetMachine->addPassesToEmitFile(passManager, out,
+                TargetMachine::CGFT_ObjectFile))
+        {
+            delete targetMachine;
+            throw_llvm_exception("target " + triple +
+                    " can not emit object files");
+        }
+
+        passManager.run(*module);
+    }
+
+    delete targetMachine;
+
+    return obj;
+}
+
+static void writeFile(const std::string& path, const std::string& data)
+{
+    std::ofstream out(path.c_str(), std::ios::out | std::ios::binary);
+    out.write(data.data(), data.size());
+
+    if (!out)
+    {
+        throw_llvm_exception("could not write " + path);
+    }
+}
+
+/**
+ * link the object file into a shared library with the system C compiler,
+ * or the one in the CC environment variable.
+ */
+static void linkSharedLibrary(const std::string& obj, const std::string& path)
+{
+    std::string cc = Poco::Environment::get("CC", "cc");
+
+    Poco::Process::Args args;
+    args.push_back("-shared");
+    args.push_back("-o");
+    args.push_back(path);
+    args.push_back(obj);
+#if !defined(_WIN32)
+    args.push_back("-lm");
+#endif
+
+    int result = Poco::Process::launch(cc, args).wait();
+
+    if (result != 0)
+    {
+        std::stringstream err;
+        err << "linking " << path << " with " << cc << " failed with exit code "
+                << result;
+        throw_llvm_exception(err.str());
+    }
+}
+
+void LLVMModelGenerator::compileModelLibrary(const std::string& sbml,
+        uint options, const std::string& path)
+{
+    // the library is loaded without the IR, and is not cached
+    options &= ~(ModelGenerator::COMPACT | ModelGenerator::RECOMPILE);
+
+    ModelResources rc;
+    std::vector<ModelFunction> functions = createFunctionList(options, rc);
+
+    // all the functions go into a single module, so are generated on
+    // this thread.
+    ModelGeneratorContext context(sbml, options);
+
+    for (unsigned i = 0; i < functions.size(); ++i)
+    {
+        functions[i].generate(context)->setLinkage(
+                llvm::GlobalValue::ExternalLinkage);
+    }
+
+    LLVMModelData *modelData = createModelData(context.getModelDataSymbols());
+    uint llvmsize = ModelDataIRBuilder::getModelDataSize(context.getModule(),
+            &context.getExecutionEngine());
+    uint size = modelData->size;
+    LLVMModelData_free(modelData);
+
+    if (llvmsize != size)
+    {
+        std::stringstream s;
+        s << "LLVM Model Data size " << llvmsize << " is different from " <<
+                "C++ size of LLVM ModelData, " << size;
+        throw_llvm_exception(s.str());
+    }
+
+    createModelLibraryImports(context.getModule());
+    createModelLibraryInfo(context.getModule(), ModelLibrary::createInfo(sbml,
+            options, context.getModelDataSymbols()));
+
+    std::string obj = emitObjectFile(context.getModule());
+
+    std::string ext = Poco::Path(path).getExtension();
+
+    if (ext == "so" || ext == "dylib" || ext == "dll")
+    {
+        std::string objPath = path + ".o";
+        writeFile(objPath, obj);
+
+        try
+        {
+            linkSharedLibrary(objPath, path);
+        }
+        catch(...)
+        {
+            Poco::File(objPath).remove();
+            throw;
+        }
+
+        Poco::File(objPath).remove();
+    }
+    else
+    {
+        writeFile(path, obj);
+    }
+
+    Log(Logger::LOG_NOTICE) << "compiled model library " << path << ", "
+            << obj.size() << " bytes of object code";
+}
+
+ExecutableModel* LLVMModelGenerator::loadModelLibrary(const std::string& path,
+        std::string* sbml, uint* options)
+{
+    std::string librarySbml;
+    unsigned libraryOptions = 0;
+
+    SharedModelPtr rc = ModelLibrary::load(path, librarySbml, libraryOptions);
+
+    if (sbml)
+    {
+        sbml->swap(librarySbml);
+    }
+
+    if (options)
+    {
+        *options = libraryOptions;
+    }
+
+    return new LLVMExecutableModel(rc, createModelData(*rc->symbols));
+}
+
+unsigned long LLVMModelGenerator::getCacheHits()
+{
+    Poco::Mutex::ScopedLock lock(cachedModelsMutex);
+    return cacheHits;
+}
+
+unsigned long LLVMModelGenerator::getCacheMisses()
+{
+    Poco::Mutex::ScopedLock lock(cachedModelsMutex);
+    return cacheMisses;
+}
+
+unsigned LLVMModelGenerator::getCacheRetainedCount()
+{
+    Poco::Mutex::ScopedLock lock(cachedModelsMutex);
+    return retainedModels.size();
+}
+
+void LLVMModelGenerator::trimCache()
+{
+    ModelPtrList released;
+
+    cachedModelsMutex.lock();
+    trimRetainedModels(released);
+    cachedModelsMutex.unlock();
+
+    Log(Logger::LOG_DEBUG) << "released " << released.size()
+            << " retained models from the model cache";
+}
+
+void LLVMModelGenerator::purgeCache()
+{
+    ModelPtrList released;
+
+    cachedModelsMutex.lock();
+    released.swap(retainedModels);
+    cachedModelsMutex.unlock();
+
+    size_t count = released.size();
+
+    // deleting an execution engine is not cheap, do it outside the lock.
+    released.clear();
+
+    Poco::Mutex::ScopedLock lock(cachedModelsMutex);
+
+    // models that are still in use by an executable model stay in
+    // the map so they can still be shared.
+    for (ModelPtrMap::const_iterator j = cachedModels.begin();
+            j != cachedModels.end();)
+    {
+        if (j->second.expired())
+        {
+            j = cachedModels.erase(j);
+        }
+        else
+        {
+            ++j;
+        }
+    }
+
+    Log(Logger::LOG_DEBUG) << "released " << count
+            << " retained models from the model cache";
+}
+
 Compiler* LLVMModelGenerator::getCompiler()
 {
     return &compiler;
@@ -386,7 +1220,7 @@ LLVMModelData *createModelData(const rrllvm::LLVMModelDataSymbols &symbols)
     uint numInitGlobalParameters = symbols.getInitGlobalParameterSize();
 
     // no initial conditions for these
-    uint numRateRules = symbols.getRateRuleSize();
+    uint numRateRules = symbols.getRateRuleValuesSize();
     uint numReactions = symbols.getReactionSize();
 
     uint modelDataSize = modelDataBaseSize +
@@ -73,6 +73,67 @@ public:
      */
     virtual bool setCompiler(const std::string& compiler);
 
+    /**
+     * Compiled models are shared between all models created from the same
+     * sbml (and load options). In addition to the models that are in use,
+     * the generator keeps strong references to the most recently used
+     * compiled models, so re-loading a recently deleted model does not
+     * re-compile it. The number of retained models, and their total
+     * memory are limited by the Config::LLVM_MODEL_CACHE_SIZE and
+     * Config::LLVM_MODEL_CACHE_MEMORY values.
+     *
+     * number of createModel calls that re-used an existing compiled model.
+     */
+    static unsigned long getCacheHits();
+
+    /**
+     * number of createModel calls that had to compile the sbml, calls
+     * with the RECOMPILE option are not counted.
+     */
+    static unsigned long getCacheMisses();
+
+    /**
+     * number of compiled models the cache currently holds strong references
+     * to.
+     */
+    static unsigned getCacheRetainedCount();
+
+    /**
+     * release all the retained models. Models which are in use by
+     * an executable model are not affected.
+     */
+    static void purgeCache();
+
+    /**
+     * release the least recently used retained models until the cache is
+     * within the current LLVM_MODEL_CACHE_SIZE and LLVM_MODEL_CACHE_MEMORY
+     * limits. Called when either limit is changed.
+     */
+    static void trimCache();
+
+    /**
+     * compile the sbml ahead of time into a model library, a native
+     * shared library (.so, .dylib or .dll extension, linked with the system
+     * C compiler, or $CC) or else an object file, which contains the model
+     * functions, the sbml, and the model symbols.
+     *
+     * The COMPACT and RECOMPILE options have no effect.
+     */
+    static void compileModelLibrary(const std::string& sbml, uint options,
+            const std::string& path);
+
+    /**
+     * create an executable model from a model library made by
+     * compileModelLibrary, which does not generate any code. Models
+     * loaded from a library do not go through the model cache, the library
+     * stays loaded for as long as the model exists.
+     *
+     * @param sbml if not null, set to the sbml the library was compiled from.
+     * @param options if not null, set to the options it was compiled with.
+     */
+    static rr::ExecutableModel *loadModelLibrary(const std::string& path,
+            std::string *sbml = 0, uint *options = 0);
+
 
 private:
     LLVMCompiler compiler;
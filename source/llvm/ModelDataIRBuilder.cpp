@@ -316,8 +316,8 @@ llvm::Value* ModelDataIRBuilder::createLoad(ModelDataFields field, unsigned inde
 llvm::Value* ModelDataIRBuilder::createRateRuleValueGEP(const std::string& id,
         const llvm::Twine& name)
 {
-    uint index = symbols.getRateRuleIndex(id);
-    assert(index < symbols.getRateRuleSize());
+    uint index = symbols.getRateRuleValuesIndex(id);
+    assert(index < symbols.getRateRuleValuesSize());
     return createGEP(RateRuleValuesAlias, index,
             name.isTriviallyEmpty() ? id : name);
 }
@@ -551,7 +551,7 @@ llvm::StructType *ModelDataIRBuilder::createModelDataStructType(llvm::Module *mo
         uint numInitGlobalParameters = symbols.getInitGlobalParameterSize();
 
         // no initial conditions for these
-        uint numRateRules = symbols.getRateRuleSize();
+        uint numRateRules = symbols.getRateRuleValuesSize();
         uint numReactions = symbols.getReactionSize();
 
         LLVMContext &context = module->getContext();
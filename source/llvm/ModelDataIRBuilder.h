@@ -182,7 +182,8 @@ public:
             llvm::Value *value);
 
     /**
-     * rate rule GEP
+     * rate rule GEP, also takes the variables of algebraic rules, which
+     * are stored after the rate rule values.
      */
     llvm::Value *createRateRuleValueGEP(const std::string &id,
             const llvm::Twine &name = "");
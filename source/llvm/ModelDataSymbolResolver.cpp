@@ -32,6 +32,20 @@ ModelDataLoadSymbolResolver::ModelDataLoadSymbolResolver(llvm::Value *modelData,
 {
 }
 
+void ModelDataLoadSymbolResolver::cacheAssignmentRules(
+        const std::vector<std::string>& rules)
+{
+    for (vector<string>::const_iterator i = rules.begin(); i != rules.end(); ++i)
+    {
+        Value *value = loadSymbolValue(*i);
+        if (!value->hasName())
+        {
+            value->setName(*i);
+        }
+        cachedRules[*i] = value;
+    }
+}
+
 ModelDataStoreSymbolResolver::ModelDataStoreSymbolResolver(llvm::Value *modelData,
         const libsbml::Model *model,
         const LLVMModelSymbols &modelSymbols,
@@ -81,6 +95,12 @@ llvm::Value* ModelDataLoadSymbolResolver::loadSymbolValue(
     /* AssignmentRule */
     /*************************************************************************/
     {
+        ValueMap::const_iterator c = cachedRules.find(symbol);
+        if (c != cachedRules.end())
+        {
+            return c->second;
+        }
+
         SymbolForest::ConstIterator i = modelSymbols.getAssigmentRules().find(
                 symbol);
         if (i != modelSymbols.getAssigmentRules().end())
@@ -107,7 +127,7 @@ llvm::Value* ModelDataLoadSymbolResolver::loadSymbolValue(
         {
             amt = mdbuilder.createBoundSpeciesAmtLoad(symbol, symbol + "_amt");
         }
-        else if(modelDataSymbols.hasRateRule(symbol))
+        else if(modelDataSymbols.hasRateRuleValue(symbol))
         {
             amt = mdbuilder.createRateRuleValueLoad(symbol, symbol + "_amt");
         }
@@ -145,7 +165,7 @@ llvm::Value* ModelDataLoadSymbolResolver::loadSymbolValue(
         return mdbuilder.createGlobalParamLoad(symbol);
     }
 
-    if (modelDataSymbols.hasRateRule(symbol))
+    if (modelDataSymbols.hasRateRuleValue(symbol))
     {
         // species conc / amt has already been taken care of at this point
         return mdbuilder.createRateRuleValueLoad(symbol);
@@ -251,7 +271,7 @@ llvm::Value* ModelDataStoreSymbolResolver::storeSymbolValue(
         {
             return mdbuilder.createBoundSpeciesAmtStore(symbol, amt);
         }
-        else if(modelDataSymbols.hasRateRule(symbol))
+        else if(modelDataSymbols.hasRateRuleValue(symbol))
         {
             return mdbuilder.createRateRuleValueStore(symbol, amt);
         }
@@ -268,7 +288,7 @@ llvm::Value* ModelDataStoreSymbolResolver::storeSymbolValue(
     // at this point, we have already taken care of the species amount /
     // conc conversion, rest are just plain stores.
 
-    if (modelDataSymbols.hasRateRule(symbol))
+    if (modelDataSymbols.hasRateRuleValue(symbol))
     {
         return mdbuilder.createRateRuleValueStore(symbol, value);
     }
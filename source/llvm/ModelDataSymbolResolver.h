@@ -13,6 +13,9 @@
 #include "LLVMModelDataSymbols.h"
 #include "LLVMModelSymbols.h"
 
+#include <map>
+#include <vector>
+
 namespace libsbml
 {
 class Model;
@@ -37,8 +40,27 @@ public:
             const llvm::ArrayRef<llvm::Value*>& args =
                     llvm::ArrayRef<llvm::Value*>());
 
+    /**
+     * Generate code to evaluate each of the given assignment rules at the
+     * current insert point, and keep the resulting values. Any subsequent
+     * load of one of these symbols returns the cached value instead of
+     * re-generating the rule expression.
+     *
+     * The rules must be in dependency order (see AssignmentRuleDependencies),
+     * and the insert point must dominate every later use of the symbols,
+     * i.e. this should be called at the top of the function.
+     */
+    void cacheAssignmentRules(const std::vector<std::string>& rules);
+
 private:
     llvm::Value *modelData;
+
+    typedef std::map<std::string, llvm::Value*> ValueMap;
+
+    /**
+     * assignment rule values evaluated by cacheAssignmentRules
+     */
+    ValueMap cachedRules;
 };
 
 class ModelDataStoreSymbolResolver: public StoreSymbolResolver
@@ -11,11 +11,18 @@
 #include "ModelDataIRBuilder.h"
 #include "LLVMException.h"
 #include "SBMLSupportFunctions.h"
+#include "SBMLSupportIRBuilder.h"
 #include "ModelGenerator.h"
 #include "conservation/ConservedMoietyConverter.h"
 #include "conservation/ConservationExtension.h"
 #include "rrConfig.h"
 
+#include <llvm/Transforms/Vectorize.h>
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR >= 3)
+#include <llvm/ExecutionEngine/ObjectImage.h>
+#endif
+
 #include <sbml/SBMLReader.h>
 #include <string>
 #include <vector>
@@ -31,6 +38,31 @@ using rr::ModelGenerator;
 namespace rrllvm
 {
 
+/**
+ * adds up the size of all the native code the JIT emits. The legacy JIT
+ * notifies each function, MCJIT notifies whole object files.
+ */
+class CodeSizeListener : public JITEventListener
+{
+public:
+    CodeSizeListener() : codeSize(0) {}
+
+    virtual void NotifyFunctionEmitted(const Function &func, void *code,
+            size_t size, const EmittedFunctionDetails &details)
+    {
+        codeSize += size;
+    }
+
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR >= 3)
+    virtual void NotifyObjectEmitted(const ObjectImage &obj)
+    {
+        codeSize += obj.getData().size();
+    }
+#endif
+
+    size_t codeSize;
+};
+
 static void createLibraryFunctions(Module* module);
 
 static void createLibraryFunction(llvm::LibFunc::Func funcId,
@@ -84,7 +116,8 @@ ModelGeneratorContext::ModelGeneratorContext(std::string const &sbml,
         errString(new string()),
         options(options),
         moietyConverter(0),
-        functionPassManager(0)
+        functionPassManager(0),
+        codeSizeListener(0)
 {
     ownedDoc = checkedReadSBMLFromString(sbml.c_str());
 
@@ -149,16 +182,30 @@ ModelGeneratorContext::ModelGeneratorContext(std::string const &sbml,
 
     builder = new IRBuilder<>(*context);
 
+    initFastMath();
+
     // engine take ownership of module
     EngineBuilder engineBuilder(module);
 
     engineBuilder.setErrorStr(errString);
     executionEngine = engineBuilder.create();
 
+    codeSizeListener = new CodeSizeListener();
+    executionEngine->RegisterJITEventListener(codeSizeListener);
+
+    // in compact mode, function bodies are deleted once they are compiled,
+    // so every callee has to be compiled up front, not on first call.
+    if (options & rr::ModelGenerator::COMPACT)
+    {
+        executionEngine->DisableLazyCompilation(true);
+    }
+
     addGlobalMappings();
 
     createLibraryFunctions(module);
 
+    SBMLSupportIRBuilder::createFunctions(module);
+
     ModelDataIRBuilder::createModelDataStructType(module, executionEngine, *symbols);
 
     initFunctionPassManager();
@@ -168,14 +215,16 @@ ModelGeneratorContext::ModelGeneratorContext(libsbml::SBMLDocument const *doc,
     unsigned options) :
         ownedDoc(0),
         doc(0),
-        symbols(new LLVMModelDataSymbols(doc->getModel(), options)),
-        modelSymbols(new LLVMModelSymbols(getModel(), *symbols)),
+        symbols(0),
+        modelSymbols(0),
         errString(new string()),
         options(options),
         moietyConverter(0),
-        functionPassManager(0)
+        functionPassManager(0),
+        codeSizeListener(0)
 {
-    if (options & rr::ModelGenerator::CONSERVED_MOIETIES)
+    if ((options & rr::ModelGenerator::CONSERVED_MOIETIES) &&
+            !rr::conservation::ConservationExtension::isConservedMoietyDocument(doc))
     {
         Log(Logger::LOG_NOTICE) << "performing conserved moiety conversion";
 
@@ -196,20 +245,21 @@ ModelGeneratorContext::ModelGeneratorContext(libsbml::SBMLDocument const *doc,
         this->doc = moietyConverter->getDocument();
 
         SBMLWriter sw;
-        char* convertedStr = sw.writeToString(doc);
+        char* convertedStr = sw.writeToString(this->doc);
 
         Log(Logger::LOG_INFORMATION) << "***************** Conserved Moiety Converted Document ***************";
         Log(Logger::LOG_INFORMATION) << convertedStr;
         Log(Logger::LOG_INFORMATION) << "*********************************************************************";
 
-        delete convertedStr;
+        free(convertedStr);
     }
     else
     {
+        // either no conversion requested, or already a converted doc
         this->doc = doc;
     }
 
-    symbols = new LLVMModelDataSymbols(doc->getModel(), options);
+    symbols = new LLVMModelDataSymbols(this->doc->getModel(), options);
 
     modelSymbols = new LLVMModelSymbols(getModel(), *symbols);
 
@@ -224,6 +274,8 @@ ModelGeneratorContext::ModelGeneratorContext(libsbml::SBMLDocument const *doc,
 
     builder = new IRBuilder<>(*context);
 
+    initFastMath();
+
     // engine take ownership of module
     EngineBuilder engineBuilder(module);
 
@@ -231,10 +283,22 @@ ModelGeneratorContext::ModelGeneratorContext(libsbml::SBMLDocument const *doc,
     engineBuilder.setErrorStr(errString);
     executionEngine = engineBuilder.create();
 
+    codeSizeListener = new CodeSizeListener();
+    executionEngine->RegisterJITEventListener(codeSizeListener);
+
+    // in compact mode, function bodies are deleted once they are compiled,
+    // so every callee has to be compiled up front, not on first call.
+    if (options & rr::ModelGenerator::COMPACT)
+    {
+        executionEngine->DisableLazyCompilation(true);
+    }
+
     addGlobalMappings();
 
     createLibraryFunctions(module);
 
+    SBMLSupportIRBuilder::createFunctions(module);
+
     ModelDataIRBuilder::createModelDataStructType(module, executionEngine, *symbols);
 
     initFunctionPassManager();
@@ -254,7 +318,8 @@ ModelGeneratorContext::ModelGeneratorContext() :
         modelSymbols(new LLVMModelSymbols(getModel(), *symbols)),
         errString(new string()),
         options(0),
-        functionPassManager(0)
+        functionPassManager(0),
+        codeSizeListener(0)
 {
     // initialize LLVM
     // TODO check result
@@ -279,6 +344,11 @@ ModelGeneratorContext::ModelGeneratorContext() :
 
 ModelGeneratorContext::~ModelGeneratorContext()
 {
+    if (executionEngine && codeSizeListener)
+    {
+        executionEngine->UnregisterJITEventListener(codeSizeListener);
+    }
+    delete codeSizeListener;
     delete functionPassManager;
     delete modelSymbols;
     delete symbols;
@@ -330,6 +400,12 @@ void ModelGeneratorContext::stealThePeach(const LLVMModelDataSymbols **sym,
         const llvm::LLVMContext** ctx, const llvm::ExecutionEngine** eng,
         const string** err)
 {
+    // the engine may lazily emit code after we're gone
+    if (executionEngine && codeSizeListener)
+    {
+        executionEngine->UnregisterJITEventListener(codeSizeListener);
+    }
+
     *sym = symbols;
     symbols = 0;
     *ctx = context;
@@ -340,6 +416,67 @@ void ModelGeneratorContext::stealThePeach(const LLVMModelDataSymbols **sym,
     errString = 0;
 }
 
+size_t ModelGeneratorContext::getEmittedCodeSize() const
+{
+    return codeSizeListener ? codeSizeListener->codeSize : 0;
+}
+
+size_t ModelGeneratorContext::getModuleSizeEstimate() const
+{
+    size_t size = 0;
+
+    for (Module::const_iterator f = module->begin(); f != module->end(); ++f)
+    {
+        size += sizeof(Function);
+
+        for (Function::const_iterator bb = f->begin(); bb != f->end(); ++bb)
+        {
+            size += sizeof(BasicBlock);
+
+            for (BasicBlock::const_iterator i = bb->begin(); i != bb->end(); ++i)
+            {
+                size += sizeof(Instruction) + i->getNumOperands() * sizeof(Use);
+            }
+        }
+    }
+    return size;
+}
+
+size_t ModelGeneratorContext::releaseFunctionBodies()
+{
+    size_t before = getModuleSizeEstimate();
+
+    for (Module::iterator f = module->begin(); f != module->end();)
+    {
+        // erasing invalidates the iterator, so advance first.
+        Function *func = f++;
+
+        if (func->isDeclaration())
+        {
+            continue;
+        }
+
+        if (executionEngine->getPointerToGlobalIfAvailable(func))
+        {
+            // the engine has the native code, the IR is no longer needed.
+            func->deleteBody();
+        }
+        else if (func->hasLocalLinkage() && func->use_empty())
+        {
+            // never compiled and can not be called (i.e. inlined support
+            // functions), nothing will ever need it.
+            func->eraseFromParent();
+        }
+    }
+
+    size_t after = getModuleSizeEstimate();
+
+    Log(Logger::LOG_DEBUG) << "released " << (before - after)
+            << " bytes of LLVM IR, " << after << " bytes remain";
+
+    return before - after;
+}
+
 const LLVMModelSymbols& ModelGeneratorContext::getModelSymbols() const
 {
     return *modelSymbols;
@@ -411,11 +548,36 @@ void ModelGeneratorContext::initFunctionPassManager()
             functionPassManager->add(createDeadCodeEliminationPass());
         }
 
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR >= 3)
+        // only worth running on fast math code, without re-association
+        // there are very few isomorphic trees for it to pack
+        if (options & ModelGenerator::FAST_MATH)
+        {
+            Log(Logger::LOG_INFORMATION) << "using SLP vectorizer";
+            functionPassManager->add(createSLPVectorizerPass());
+        }
+#endif
+
 
         functionPassManager->doInitialization();
     }
 }
 
+void ModelGeneratorContext::initFastMath()
+{
+    if (options & ModelGenerator::FAST_MATH)
+    {
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR >= 3)
+        Log(Logger::LOG_INFORMATION) << "using FAST_MATH";
+        FastMathFlags fastMathFlags;
+        fastMathFlags.setUnsafeAlgebra();
+        builder->SetFastMathFlags(fastMathFlags);
+#else
+        Log(Logger::LOG_WARNING) << "FAST_MATH requires LLVM 3.3 or later, "
+                "generating strict IEEE code";
+#endif
+    }
+}
 
 /*********************** TESTING STUFF WILL GO AWAY EVENTUALLY ***********************/
 
@@ -440,7 +602,6 @@ void ModelGeneratorContext::addGlobalMappings()
     Type *int_type = Type::getInt32Ty(context);
     Type* args_i1[] = { int_type };
     Type* args_d1[] = { double_type };
-    Type* args_d2[] = { double_type, double_type };
 
     executionEngine->addGlobalMapping(ModelDataIRBuilder::getCSRMatrixSetNZDecl(module), (void*)rr::csr_matrix_set_nz);
     executionEngine->addGlobalMapping(ModelDataIRBuilder::getCSRMatrixGetNZDecl(module), (void*)rr::csr_matrix_get_nz);
@@ -448,70 +609,8 @@ void ModelGeneratorContext::addGlobalMappings()
     executionEngine->addGlobalMapping(LLVMModelDataIRBuilderTesting::getDispDoubleDecl(module), (void*)dispDouble);
     executionEngine->addGlobalMapping(LLVMModelDataIRBuilderTesting::getDispCharDecl(module), (void*)dispChar);
 
-    // AST_FUNCTION_ARCCOT:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("arccot",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::arccot);
-
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("rr_arccot_negzero",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::arccot_negzero);
-
-    // AST_FUNCTION_ARCCOTH:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("arccoth",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::arccoth);
-
-    // AST_FUNCTION_ARCCSC:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("arccsc",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::arccsc);
-
-    // AST_FUNCTION_ARCCSCH:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("arccsch",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::arccsch);
-
-    // AST_FUNCTION_ARCSEC:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("arcsec",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::arcsec);
-
-    // AST_FUNCTION_ARCSECH:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("arcsech",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::arcsech);
-
-    // AST_FUNCTION_COT:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("cot",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::cot);
-
-    // AST_FUNCTION_COTH:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("coth",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::coth);
-
-    // AST_FUNCTION_CSC:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("csc",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::csc);
-
-    // AST_FUNCTION_CSCH:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("csch",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::csch);
+    // the rest of the sbml support functions (sec, cot, arccoth, ...) are
+    // generated as inlinable IR by SBMLSupportIRBuilder::createFunctions
 
     // AST_FUNCTION_FACTORIAL:
     executionEngine->addGlobalMapping(
@@ -524,30 +623,6 @@ void ModelGeneratorContext::addGlobalMappings()
                     FunctionType::get(double_type, args_d1, false), module),
                         (void*) sbmlsupport::factoriald);
 
-    // case AST_FUNCTION_LOG:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("rr_logd",
-                    FunctionType::get(double_type, args_d2, false), module),
-                        (void*) sbmlsupport::logd);
-
-    // AST_FUNCTION_ROOT:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("rr_rootd",
-                    FunctionType::get(double_type, args_d2, false), module),
-                        (void*) sbmlsupport::rootd);
-
-    // AST_FUNCTION_SEC:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("sec",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::sec);
-
-    // AST_FUNCTION_SECH:
-    executionEngine->addGlobalMapping(
-            createGlobalMappingFunction("sech",
-                    FunctionType::get(double_type, args_d1, false), module),
-                        (void*) sbmlsupport::sech);
-
     // AST_FUNCTION_ARCCOSH:
     executionEngine->addGlobalMapping(
             createGlobalMappingFunction("arccosh",
@@ -631,6 +706,10 @@ static void createLibraryFunctions(Module* module)
     createLibraryFunction(LibFunc::sinh,
             FunctionType::get(double_type, args_d1, false), module);
 
+    /// double sqrt(double x);
+    createLibraryFunction(LibFunc::sqrt,
+            FunctionType::get(double_type, args_d1, false), module);
+
     /// double tan(double x);
     createLibraryFunction(LibFunc::tan,
             FunctionType::get(double_type, args_d1, false), module);
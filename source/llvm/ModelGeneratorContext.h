@@ -31,6 +31,8 @@ class ConservedMoietyConverter;
 namespace rrllvm
 {
 
+class CodeSizeListener;
+
 /**
  * All LLVM code generating objects basically need at a minimum three things
  * to operate:
@@ -117,6 +119,30 @@ public:
 
     llvm::IRBuilder<> &getBuilder() const;
 
+    /**
+     * number of bytes of native code the execution engine has emitted
+     * for the functions that have been generated so far.
+     */
+    size_t getEmittedCodeSize() const;
+
+    /**
+     * rough estimate of the number of bytes used by the LLVM IR in
+     * the module, based on the number of instructions and operands.
+     */
+    size_t getModuleSizeEstimate() const;
+
+    /**
+     * delete the IR body of every function that the execution engine has
+     * already compiled to native code, and erase unused internal functions.
+     * The native code is owned by the engine and remains valid, but the
+     * module can no longer be used to generate new code.
+     *
+     * Must be called after all of the model functions are created.
+     *
+     * @returns the estimated number of bytes of IR released.
+     */
+    size_t releaseFunctionBodies();
+
     /**
      * A lot can go wrong in the process of generating a model from  an sbml doc.
      * This class is intended to be stack allocated, so when any exception is
@@ -182,6 +208,12 @@ private:
 
     llvm::FunctionPassManager *functionPassManager;
 
+    /**
+     * registered with the execution engine whilst we own it, counts
+     * the native code size.
+     */
+    CodeSizeListener *codeSizeListener;
+
     unsigned options;
 
     /**
@@ -191,6 +223,13 @@ private:
     rr::conservation::ConservedMoietyConverter *moietyConverter;
 
     void initFunctionPassManager();
+
+    /**
+     * if the FAST_MATH option is set, set the builder's fast math flags so
+     * all the floating point arithmetic that gets generated may be
+     * re-associated and contracted.
+     */
+    void initFastMath();
 };
 
 
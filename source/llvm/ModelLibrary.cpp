@@ -0,0 +1,271 @@
+#pragma hdrstop
+#include "ModelLibrary.h"
+#include "ModelResources.h"
+#include "LLVMException.h"
+#include "SBMLSupportFunctions.h"
+#include "rrSparse.h"
+#include "rrLogger.h"
+
+#include <Poco/File.h>
+#include <Poco/SharedLibrary.h>
+
+#include <sstream>
+#include <string.h>
+#include <math.h>
+
+using rr::Logger;
+using rr::getLogger;
+
+namespace rrllvm
+{
+
+const char* ModelLibrary::infoName = "rr_model_info";
+const char* ModelLibrary::infoSizeName = "rr_model_info_size";
+const char* ModelLibrary::importsName = "rr_model_imports";
+
+/**
+ * rr_model_info header, the format version is incremented whenever the
+ * layout of the info, the symbols or the imports changes.
+ */
+static const char infoMagic[4] = {'R', 'R', 'M', 'L'};
+static const unsigned infoVersion = 1;
+
+// the same as ModelGeneratorContext.cpp, older MSVC do not have these
+#if defined(_MSC_VER)
+
+static double asinh(double value)
+{
+    return log(value + sqrt(value * value + 1.));
+}
+
+static double acosh(double value)
+{
+    return log(value + sqrt(value * value - 1.));
+}
+
+static double atanh(double value)
+{
+    return log((1. / value + 1.) / (1. / value - 1.)) / 2.;
+}
+
+#endif
+
+struct ModelLibraryImport
+{
+    const char* name;
+    void* address;
+};
+
+/**
+ * the functions ModelGeneratorContext::addGlobalMappings maps into the
+ * generated code, except for the debugging ones.
+ */
+static const ModelLibraryImport imports[] = {
+    {"rr_csr_matrix_set_nz",    (void*)rr::csr_matrix_set_nz},
+    {"rr_csr_matrix_get_nz",    (void*)rr::csr_matrix_get_nz},
+    {"rr_factoriali",           (void*)sbmlsupport::factoriali},
+    {"rr_factoriald",           (void*)sbmlsupport::factoriald},
+    {"arccosh",                 (void*)(double (*)(double))acosh},
+    {"arcsinh",                 (void*)(double (*)(double))asinh},
+    {"arctanh",                 (void*)(double (*)(double))atanh}
+};
+
+unsigned ModelLibrary::getImportCount()
+{
+    return sizeof(imports) / sizeof(imports[0]);
+}
+
+const char* ModelLibrary::getImportName(unsigned index)
+{
+    return imports[index].name;
+}
+
+template <typename T>
+static void writeBinary(std::ostream &out, const T& value)
+{
+    out.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static void readBinary(std::istream &in, T& value)
+{
+    in.read((char*)&value, sizeof(T));
+}
+
+std::string ModelLibrary::createInfo(const std::string& sbml,
+        unsigned options, const LLVMModelDataSymbols& symbols)
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+
+    out.write(infoMagic, sizeof(infoMagic));
+    writeBinary(out, infoVersion);
+    writeBinary(out, (unsigned)sizeof(LLVMModelData));
+    writeBinary(out, options);
+    writeBinary(out, (unsigned)sbml.size());
+    out.write(sbml.data(), sbml.size());
+
+    symbols.save(out);
+
+    return out.str();
+}
+
+/**
+ * set the resource's function pointer to the function the library exports
+ * under the code generator's name, or 0 if the library does not have it,
+ * which is the case for the setters of a read only model.
+ */
+template <typename CodeGenType,
+    typename CodeGenType::FunctionPtr ModelResources::*functionPtr>
+static void resolve(Poco::SharedLibrary& lib, ModelResources& rc)
+{
+    rc.*functionPtr = lib.hasSymbol(CodeGenType::FunctionName) ?
+            (typename CodeGenType::FunctionPtr)lib.getSymbol(CodeGenType::FunctionName) : 0;
+}
+
+static void resolveFunctions(Poco::SharedLibrary& lib, ModelResources& rc)
+{
+    resolve<EvalInitialConditionsCodeGen,
+            &ModelResources::evalInitialConditionsPtr>(lib, rc);
+    resolve<EvalReactionRatesCodeGen,
+            &ModelResources::evalReactionRatesPtr>(lib, rc);
+    resolve<GetBoundarySpeciesAmountCodeGen,
+            &ModelResources::getBoundarySpeciesAmountPtr>(lib, rc);
+    resolve<GetFloatingSpeciesAmountCodeGen,
+            &ModelResources::getFloatingSpeciesAmountPtr>(lib, rc);
+    resolve<GetBoundarySpeciesConcentrationCodeGen,
+            &ModelResources::getBoundarySpeciesConcentrationPtr>(lib, rc);
+    resolve<GetFloatingSpeciesConcentrationCodeGen,
+            &ModelResources::getFloatingSpeciesConcentrationPtr>(lib, rc);
+    resolve<GetCompartmentVolumeCodeGen,
+            &ModelResources::getCompartmentVolumePtr>(lib, rc);
+    resolve<GetGlobalParameterCodeGen,
+            &ModelResources::getGlobalParameterPtr>(lib, rc);
+    resolve<EvalRateRuleRatesCodeGen,
+            &ModelResources::evalRateRuleRatesPtr>(lib, rc);
+    resolve<GetEventTriggerCodeGen,
+            &ModelResources::getEventTriggerPtr>(lib, rc);
+    resolve<GetEventPriorityCodeGen,
+            &ModelResources::getEventPriorityPtr>(lib, rc);
+    resolve<GetEventDelayCodeGen,
+            &ModelResources::getEventDelayPtr>(lib, rc);
+    resolve<EventTriggerCodeGen,
+            &ModelResources::eventTriggerPtr>(lib, rc);
+    resolve<EventAssignCodeGen,
+            &ModelResources::eventAssignPtr>(lib, rc);
+    resolve<EvalVolatileStoichCodeGen,
+            &ModelResources::evalVolatileStoichPtr>(lib, rc);
+    resolve<EvalConversionFactorCodeGen,
+            &ModelResources::evalConversionFactorPtr>(lib, rc);
+    resolve<EvalJacobianCodeGen,
+            &ModelResources::evalJacobianPtr>(lib, rc);
+    resolve<EvalAlgebraicResidualsCodeGen,
+            &ModelResources::evalAlgebraicResidualsPtr>(lib, rc);
+
+    resolve<SetBoundarySpeciesAmountCodeGen,
+            &ModelResources::setBoundarySpeciesAmountPtr>(lib, rc);
+    resolve<SetBoundarySpeciesConcentrationCodeGen,
+            &ModelResources::setBoundarySpeciesConcentrationPtr>(lib, rc);
+    resolve<SetFloatingSpeciesConcentrationCodeGen,
+            &ModelResources::setFloatingSpeciesConcentrationPtr>(lib, rc);
+    resolve<SetCompartmentVolumeCodeGen,
+            &ModelResources::setCompartmentVolumePtr>(lib, rc);
+    resolve<SetFloatingSpeciesAmountCodeGen,
+            &ModelResources::setFloatingSpeciesAmountPtr>(lib, rc);
+    resolve<SetGlobalParameterCodeGen,
+            &ModelResources::setGlobalParameterPtr>(lib, rc);
+
+    resolve<GetFloatingSpeciesInitConcentrationCodeGen,
+            &ModelResources::getFloatingSpeciesInitConcentrationsPtr>(lib, rc);
+    resolve<SetFloatingSpeciesInitConcentrationCodeGen,
+            &ModelResources::setFloatingSpeciesInitConcentrationsPtr>(lib, rc);
+    resolve<GetFloatingSpeciesInitAmountCodeGen,
+            &ModelResources::getFloatingSpeciesInitAmountsPtr>(lib, rc);
+    resolve<SetFloatingSpeciesInitAmountCodeGen,
+            &ModelResources::setFloatingSpeciesInitAmountsPtr>(lib, rc);
+    resolve<GetCompartmentInitVolumeCodeGen,
+            &ModelResources::getCompartmentInitVolumesPtr>(lib, rc);
+    resolve<SetCompartmentInitVolumeCodeGen,
+            &ModelResources::setCompartmentInitVolumesPtr>(lib, rc);
+    resolve<GetGlobalParameterInitValueCodeGen,
+            &ModelResources::getGlobalParameterInitValuePtr>(lib, rc);
+}
+
+cxx11_ns::shared_ptr<ModelResources> ModelLibrary::load(
+        const std::string& path, std::string& sbml, unsigned& options)
+{
+    cxx11_ns::shared_ptr<ModelResources> rc(new ModelResources());
+
+    Poco::SharedLibrary *lib = new Poco::SharedLibrary();
+
+    try
+    {
+        lib->load(path);
+    }
+    catch(Poco::Exception& e)
+    {
+        delete lib;
+        throw_llvm_exception("could not load model library " + path +
+                ", " + e.displayText());
+    }
+
+    // the resources unload it from here on
+    rc->library = lib;
+
+    if (!lib->hasSymbol(infoName) || !lib->hasSymbol(infoSizeName)
+            || !lib->hasSymbol(importsName))
+    {
+        throw_llvm_exception(path + " is not a roadrunner model library");
+    }
+
+    const char* info = (const char*)lib->getSymbol(infoName);
+    unsigned infoSize = *(const unsigned*)lib->getSymbol(infoSizeName);
+
+    std::istringstream in(std::string(info, infoSize),
+            std::ios::in | std::ios::binary);
+
+    char magic[sizeof(infoMagic)] = {0};
+    unsigned version = 0, modelDataSize = 0, sbmlSize = 0;
+
+    in.read(magic, sizeof(magic));
+    readBinary(in, version);
+    readBinary(in, modelDataSize);
+    readBinary(in, options);
+    readBinary(in, sbmlSize);
+
+    if (!in || memcmp(magic, infoMagic, sizeof(magic)) != 0
+            || version != infoVersion || modelDataSize != sizeof(LLVMModelData))
+    {
+        throw_llvm_exception(path + " was compiled by an incompatible "
+                "version of roadrunner");
+    }
+
+    sbml.resize(sbmlSize);
+    if (sbmlSize)
+    {
+        in.read(&sbml[0], sbmlSize);
+    }
+
+    rc->symbols = new LLVMModelDataSymbols(in);
+
+    void **libImports = (void**)lib->getSymbol(importsName);
+    for (unsigned i = 0; i < getImportCount(); ++i)
+    {
+        libImports[i] = imports[i].address;
+    }
+
+    resolveFunctions(*lib, *rc);
+
+    if (!rc->evalInitialConditionsPtr || !rc->evalReactionRatesPtr)
+    {
+        throw_llvm_exception(path + " does not contain the model functions");
+    }
+
+    rc->nativeCodeSize = (size_t)Poco::File(path).getSize();
+
+    Log(Logger::LOG_DEBUG) << "loaded model library " << path << " for model "
+            << rc->symbols->getModelName();
+
+    return rc;
+}
+
+} /* namespace rrllvm */
@@ -0,0 +1,80 @@
+#ifndef MODELLIBRARY_H_
+#define MODELLIBRARY_H_
+
+#include <string>
+
+#if (__cplusplus >= 201103L) || defined(_MSC_VER)
+#include <memory>
+#define cxx11_ns std
+#else
+#include <tr1/memory>
+#define cxx11_ns std::tr1
+#endif
+
+namespace rrllvm
+{
+
+class ModelResources;
+class LLVMModelDataSymbols;
+
+/**
+ * A model library is a shared library with the native code of the model
+ * functions of a single model, compiled ahead of time by
+ * LLVMModelGenerator::compileModelLibrary.
+ *
+ * The model functions are exported under their code generator FunctionName,
+ * and the library has three more global symbols:
+ *
+ * rr_model_info: the format version, the load options, the sbml, and the
+ * serialized LLVMModelDataSymbols.
+ *
+ * rr_model_info_size: the size of rr_model_info in bytes.
+ *
+ * rr_model_imports: pointers to the roadrunner functions that the generated
+ * code calls, in the order of getImportName. These are filled in when the
+ * library is loaded, so the library does not have to be linked against
+ * roadrunner, and works when roadrunner itself is loaded with local
+ * symbols, as it is by Python.
+ *
+ * Loading a library does not generate any code, and does not use LLVM
+ * or libsbml, the model runs directly on the code in the library.
+ */
+class ModelLibrary
+{
+public:
+    static const char* infoName;
+    static const char* infoSizeName;
+    static const char* importsName;
+
+    /**
+     * number of entries in rr_model_imports.
+     */
+    static unsigned getImportCount();
+
+    /**
+     * the name of the function declaration in the generated code which
+     * calls through the given import.
+     */
+    static const char* getImportName(unsigned index);
+
+    /**
+     * the contents of rr_model_info.
+     */
+    static std::string createInfo(const std::string& sbml, unsigned options,
+            const LLVMModelDataSymbols& symbols);
+
+    /**
+     * load a model library, and create the model resources that reference
+     * the code in it. The library is unloaded when the resources are
+     * deleted.
+     *
+     * @param sbml set to the sbml the library was compiled from.
+     * @param options set to the load options it was compiled with.
+     */
+    static cxx11_ns::shared_ptr<ModelResources> load(const std::string& path,
+            std::string& sbml, unsigned& options);
+};
+
+} /* namespace rrllvm */
+
+#endif /* MODELLIBRARY_H_ */
@@ -8,6 +8,7 @@
 #include "ModelResources.h"
 
 #include <rrLogger.h>
+#include <Poco/SharedLibrary.h>
 
 using rr::Logger;
 using rr::getLogger;
@@ -16,7 +17,8 @@ namespace rrllvm
 {
 
 ModelResources::ModelResources() :
-        symbols(0), executionEngine(0), context(0), errStr(0)
+        symbols(0), executionEngine(0), context(0), errStr(0), library(0),
+        nativeCodeSize(0), irSize(0), irSizeReleased(0)
 {
     // the reset of the ivars are assigned by the generator,
     // and in an exception they are not, does not matter as
@@ -37,6 +39,24 @@ ModelResources::~ModelResources()
     delete executionEngine;
     delete context;
     delete errStr;
+
+    if (library)
+    {
+        library->unload();
+        delete library;
+    }
+}
+
+/**
+ * rough estimate of what an LLVMContext (type and constant tables) and an
+ * ExecutionEngine (target machine, code memory manager, global mappings)
+ * hold independently of the size of the model.
+ */
+static const size_t engineOverhead = 256 * 1024;
+
+size_t ModelResources::getMemoryUsage() const
+{
+    return nativeCodeSize + irSize + (executionEngine ? engineOverhead : 0);
 }
 
 } /* namespace rrllvm */
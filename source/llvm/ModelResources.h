@@ -10,6 +10,12 @@
 #define CACHEDMODEL_H_
 
 #include "LLVMExecutableModel.h"
+#include <vector>
+
+namespace Poco
+{
+class SharedLibrary;
+}
 
 namespace rrllvm
 {
@@ -25,6 +31,34 @@ public:
     const llvm::ExecutionEngine *executionEngine;
     const std::string *errStr;
 
+    /**
+     * the model library the functions were loaded from, if the model was
+     * compiled ahead of time, it is unloaded with the resources.
+     */
+    Poco::SharedLibrary *library;
+
+    /**
+     * bytes of native code emitted by the execution engine.
+     */
+    size_t nativeCodeSize;
+
+    /**
+     * estimated bytes used by the LLVM IR that the engine keeps alive.
+     */
+    size_t irSize;
+
+    /**
+     * estimated bytes of LLVM IR released after compilation in compact mode.
+     */
+    size_t irSizeReleased;
+
+    /**
+     * estimate of the total memory held by these resources, this is what
+     * the model cache uses for its memory budget: the native code, the IR,
+     * and a fixed estimate for the LLVM context and execution engine.
+     */
+    size_t getMemoryUsage() const;
+
     EvalInitialConditionsCodeGen::FunctionPtr evalInitialConditionsPtr;
     EvalReactionRatesCodeGen::FunctionPtr evalReactionRatesPtr;
     GetBoundarySpeciesAmountCodeGen::FunctionPtr getBoundarySpeciesAmountPtr;
@@ -41,6 +75,8 @@ public:
     EventAssignCodeGen::FunctionPtr eventAssignPtr;
     EvalVolatileStoichCodeGen::FunctionPtr evalVolatileStoichPtr;
     EvalConversionFactorCodeGen::FunctionPtr evalConversionFactorPtr;
+    EvalJacobianCodeGen::FunctionPtr evalJacobianPtr;
+    EvalAlgebraicResidualsCodeGen::FunctionPtr evalAlgebraicResidualsPtr;
     SetBoundarySpeciesAmountCodeGen::FunctionPtr setBoundarySpeciesAmountPtr;
     SetFloatingSpeciesAmountCodeGen::FunctionPtr setFloatingSpeciesAmountPtr;
     SetBoundarySpeciesConcentrationCodeGen::FunctionPtr setBoundarySpeciesConcentrationPtr;
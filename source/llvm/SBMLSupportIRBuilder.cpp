@@ -0,0 +1,260 @@
+#define _USE_MATH_DEFINES
+
+#pragma hdrstop
+#include "SBMLSupportIRBuilder.h"
+#include "LLVMException.h"
+#include "rrLogger.h"
+
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <cmath>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+using rr::Logger;
+
+namespace rrllvm
+{
+
+/**
+ * names of all the functions generated here, these are the same names that
+ * the ASTNodeCodeGen looks up in the module.
+ */
+static const char* supportFunctionNames[] = {
+        "arccot", "rr_arccot_negzero", "arccoth", "arccsc", "arccsch",
+        "arcsec", "arcsech", "cot", "coth", "csc", "csch", "rr_logd",
+        "rr_rootd", "sec", "sech"
+};
+
+static const unsigned numSupportFunctions =
+        sizeof(supportFunctionNames) / sizeof(supportFunctionNames[0]);
+
+/**
+ * creates an empty always inline function taking nargs doubles and returning
+ * a double, positions the builder at the entry block and fills args.
+ */
+static Function *createSupportFunction(Module *module, IRBuilder<> &builder,
+        const char* name, unsigned nargs, Value **args)
+{
+    Type *double_type = builder.getDoubleTy();
+    vector<Type*> argTypes(nargs, double_type);
+
+    Function *func = Function::Create(
+            FunctionType::get(double_type, argTypes, false),
+            Function::InternalLinkage, name, module);
+
+#if (LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR == 2)
+    func->addFnAttr(Attributes::AlwaysInline);
+#else
+    func->addFnAttr(Attribute::AlwaysInline);
+#endif
+
+    builder.SetInsertPoint(BasicBlock::Create(module->getContext(),
+            "entry", func));
+
+    unsigned i = 0;
+    for (Function::arg_iterator ai = func->arg_begin();
+            ai != func->arg_end(); ++ai, ++i)
+    {
+        args[i] = ai;
+    }
+
+    return func;
+}
+
+/**
+ * get a libm function declared in the module by createLibraryFunctions.
+ */
+static Function *getLibFunc(Module *module, LibFunc::Func funcId)
+{
+    TargetLibraryInfo targetLib;
+    Function *func = module->getFunction(targetLib.getName(funcId));
+
+    if (func == 0)
+    {
+        string msg = "library function ";
+        msg += targetLib.getName(funcId);
+        msg += " is not declared in the module";
+        throw_llvm_exception(msg);
+    }
+    return func;
+}
+
+static Value *callLibFunc(IRBuilder<> &builder, LibFunc::Func funcId,
+        Value *arg)
+{
+    Module *module = builder.GetInsertBlock()->getParent()->getParent();
+    return builder.CreateCall(getLibFunc(module, funcId), arg);
+}
+
+/**
+ * 1.0 / f(a)
+ */
+static void createReciprocalFunction(Module *module, IRBuilder<> &builder,
+        const char* name, LibFunc::Func funcId)
+{
+    Value *args[1];
+    createSupportFunction(module, builder, name, 1, args);
+    Value *one = ConstantFP::get(builder.getDoubleTy(), 1.0);
+    builder.CreateRet(builder.CreateFDiv(one,
+            callLibFunc(builder, funcId, args[0])));
+}
+
+/**
+ * f(1.0 / a)
+ */
+static void createOfReciprocalFunction(Module *module, IRBuilder<> &builder,
+        const char* name, LibFunc::Func funcId)
+{
+    Value *args[1];
+    createSupportFunction(module, builder, name, 1, args);
+    Value *one = ConstantFP::get(builder.getDoubleTy(), 1.0);
+    builder.CreateRet(callLibFunc(builder, funcId,
+            builder.CreateFDiv(one, args[0])));
+}
+
+/**
+ * a == 0 ? zeroValue : atan(1.0 / a)
+ */
+static void createArccotFunction(Module *module, IRBuilder<> &builder,
+        const char* name, double zeroValue)
+{
+    Value *args[1];
+    createSupportFunction(module, builder, name, 1, args);
+    Value *zero = ConstantFP::get(builder.getDoubleTy(), 0.0);
+    Value *one = ConstantFP::get(builder.getDoubleTy(), 1.0);
+    Value *atan = callLibFunc(builder, LibFunc::atan,
+            builder.CreateFDiv(one, args[0]));
+    builder.CreateRet(builder.CreateSelect(
+            builder.CreateFCmpOEQ(args[0], zero),
+            ConstantFP::get(builder.getDoubleTy(), zeroValue), atan));
+}
+
+void SBMLSupportIRBuilder::createFunctions(llvm::Module* module)
+{
+    IRBuilder<> builder(module->getContext());
+    Value *one = ConstantFP::get(builder.getDoubleTy(), 1.0);
+    Value *half = ConstantFP::get(builder.getDoubleTy(), 0.5);
+    Value *args[2];
+
+    createReciprocalFunction(module, builder, "sec", LibFunc::cos);
+    createReciprocalFunction(module, builder, "cot", LibFunc::tan);
+    createReciprocalFunction(module, builder, "csc", LibFunc::sin);
+    createReciprocalFunction(module, builder, "sech", LibFunc::cosh);
+    createReciprocalFunction(module, builder, "csch", LibFunc::sinh);
+
+    createOfReciprocalFunction(module, builder, "arcsec", LibFunc::acos);
+    createOfReciprocalFunction(module, builder, "arccsc", LibFunc::asin);
+
+    createArccotFunction(module, builder, "arccot", M_PI / 2.);
+    createArccotFunction(module, builder, "rr_arccot_negzero", -M_PI / 2.);
+
+    // coth(a) = cosh(a) / sinh(a)
+    createSupportFunction(module, builder, "coth", 1, args);
+    builder.CreateRet(builder.CreateFDiv(
+            callLibFunc(builder, LibFunc::cosh, args[0]),
+            callLibFunc(builder, LibFunc::sinh, args[0])));
+
+    // arccoth(a) = (log(1 + 1/a) - log(1 - 1/a)) / 2
+    {
+        createSupportFunction(module, builder, "arccoth", 1, args);
+        Value *r = builder.CreateFDiv(one, args[0]);
+        Value *lp = callLibFunc(builder, LibFunc::log, builder.CreateFAdd(one, r));
+        Value *lm = callLibFunc(builder, LibFunc::log, builder.CreateFSub(one, r));
+        builder.CreateRet(builder.CreateFMul(builder.CreateFSub(lp, lm), half));
+    }
+
+    // arcsech(z) = log(1/z + sqrt(1/z + 1) * sqrt(1/z - 1))
+    {
+        createSupportFunction(module, builder, "arcsech", 1, args);
+        Value *r = builder.CreateFDiv(one, args[0]);
+        Value *sp = callLibFunc(builder, LibFunc::sqrt, builder.CreateFAdd(r, one));
+        Value *sm = callLibFunc(builder, LibFunc::sqrt, builder.CreateFSub(r, one));
+        builder.CreateRet(callLibFunc(builder, LibFunc::log,
+                builder.CreateFAdd(r, builder.CreateFMul(sp, sm))));
+    }
+
+    // arccsch(z) = log(1/z + sqrt(1/(z*z) + 1))
+    {
+        createSupportFunction(module, builder, "arccsch", 1, args);
+        Value *r = builder.CreateFDiv(one, args[0]);
+        Value *r2 = builder.CreateFDiv(one, builder.CreateFMul(args[0], args[0]));
+        Value *s = callLibFunc(builder, LibFunc::sqrt, builder.CreateFAdd(r2, one));
+        builder.CreateRet(callLibFunc(builder, LibFunc::log,
+                builder.CreateFAdd(r, s)));
+    }
+
+    // rr_logd(base, number) = log(number) / log(base)
+    {
+        createSupportFunction(module, builder, "rr_logd", 2, args);
+        builder.CreateRet(builder.CreateFDiv(
+                callLibFunc(builder, LibFunc::log, args[1]),
+                callLibFunc(builder, LibFunc::log, args[0])));
+    }
+
+    // rr_rootd(a, b) = a != 0 ? pow(b, 1/a) : 1
+    {
+        createSupportFunction(module, builder, "rr_rootd", 2, args);
+        Value *zero = ConstantFP::get(builder.getDoubleTy(), 0.0);
+        Value *powArgs[] = {args[1], builder.CreateFDiv(one, args[0])};
+        Value *pow = builder.CreateCall(getLibFunc(module, LibFunc::pow),
+                powArgs);
+        builder.CreateRet(builder.CreateSelect(
+                builder.CreateFCmpUNE(args[0], zero), pow, one));
+    }
+}
+
+bool SBMLSupportIRBuilder::isSupportFunction(const llvm::Function* func)
+{
+    if (func == 0 || func->isDeclaration() || !func->hasInternalLinkage())
+    {
+        return false;
+    }
+
+    for (unsigned i = 0; i < numSupportFunctions; ++i)
+    {
+        if (func->getName() == supportFunctionNames[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned SBMLSupportIRBuilder::inlineCalls(llvm::Function* func)
+{
+    // collect first, inlining invalidates the instruction iterators.
+    vector<CallInst*> calls;
+
+    for (Function::iterator bb = func->begin(); bb != func->end(); ++bb)
+    {
+        for (BasicBlock::iterator i = bb->begin(); i != bb->end(); ++i)
+        {
+            CallInst *call = dyn_cast<CallInst>(&*i);
+            if (call && isSupportFunction(call->getCalledFunction()))
+            {
+                calls.push_back(call);
+            }
+        }
+    }
+
+    unsigned count = 0;
+    for (vector<CallInst*>::iterator i = calls.begin(); i != calls.end(); ++i)
+    {
+        InlineFunctionInfo info;
+        if (InlineFunction(*i, info))
+        {
+            ++count;
+        }
+        else
+        {
+            Log(Logger::LOG_WARNING) << "could not inline call to "
+                    << string((*i)->getCalledFunction()->getName());
+        }
+    }
+
+    return count;
+}
+
+} /* namespace rrllvm */
@@ -0,0 +1,48 @@
+#ifndef SBMLSUPPORTIRBUILDER_H_
+#define SBMLSUPPORTIRBUILDER_H_
+
+#include "LLVMIncludes.h"
+
+namespace rrllvm
+{
+
+/**
+ * Most of the SBML math functions that are not in libm (sec, cot, arccoth,
+ * root, log with base...) are one or two line functions. Originally these
+ * were compiled C functions (see SBMLSupportFunctions.h) which the execution
+ * engine mapped into the generated module, however the optimizer can not see
+ * through a global mapping, so every call was an opaque call which prevented
+ * any sort of constant folding or common sub-expression elimination.
+ *
+ * Here, we generate the IR for these functions directly in each module, they
+ * are marked as internal and always inline, and are inlined into the
+ * generated model functions before the function pass manager runs.
+ */
+class SBMLSupportIRBuilder
+{
+public:
+
+    /**
+     * create the IR definitions of the support functions in the given module.
+     *
+     * The libm functions that these are implemented in terms of must already
+     * be declared in the module.
+     */
+    static void createFunctions(llvm::Module *module);
+
+    /**
+     * inline all calls to the support functions in the given function.
+     *
+     * @returns the number of call sites that were inlined.
+     */
+    static unsigned inlineCalls(llvm::Function *func);
+
+    /**
+     * is the given function one of the generated support functions.
+     */
+    static bool isSupportFunction(const llvm::Function *func);
+};
+
+} /* namespace rrllvm */
+
+#endif /* SBMLSUPPORTIRBUILDER_H_ */
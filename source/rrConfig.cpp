@@ -8,6 +8,7 @@
 #include "rrUtils.h"
 #include "rrConfig.h"
 #include "rrLogger.h"
+#include "ModelGenerator.h"
 
 #if (__cplusplus >= 201103L) || defined(_MSC_VER)
 #include <memory>
@@ -96,6 +97,10 @@ static Variant values[] =  {
     Variant(false),    // LOADSBMLOPTIONS_OPTIMIZE_DEAD_CODE_ELIMINATION
     Variant(false),    // LOADSBMLOPTIONS_OPTIMIZE_INSTRUCTION_SIMPLIFIER
     Variant(false),    // LOADSBMLOPTIONS_USE_MCJIT
+    Variant(false),    // LOADSBMLOPTIONS_FAST_MATH
+    Variant(false),    // LOADSBMLOPTIONS_OPTIMIZE_ASSIGNMENT_RULES
+    Variant(false),    // LOADSBMLOPTIONS_COMPACT
+    Variant(false),    // LOADSBMLOPTIONS_OPTIMIZE_NATIVE
     Variant(50),       // SIMULATEOPTIONS_STEPS,
     Variant(5),        // SIMULATEOPTIONS_DURATION,
     Variant(1.e-10),   // SIMULATEOPTIONS_ABSOLUTE,
@@ -113,7 +118,11 @@ static Variant values[] =  {
     Variant(0),        // ROADRUNNER_DISABLE_WARNINGS
     Variant(false),    // ROADRUNNER_DISABLE_PYTHON_DYNAMIC_PROPERTIES
     Variant(int(AllChecksON & UnitsCheckOFF)),          //SBML_APPLICABLEVALIDATORS
-    Variant(0.00001)   // ROADRUNNER_JACOBIAN_STEP_SIZE
+    Variant(0.00001),  // ROADRUNNER_JACOBIAN_STEP_SIZE
+    Variant(0),        // LLVM_MODEL_CACHE_SIZE
+    Variant(0),        // LLVM_MODEL_CACHE_MEMORY
+    Variant(1),        // LLVM_CODEGEN_THREADS
+    Variant(100)       // ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD
 };
 
 static bool initialized = false;
@@ -157,6 +166,10 @@ static void getKeyNames(StringIntMap& keys)
     keys["LOADSBMLOPTIONS_OPTIMIZE_DEAD_CODE_ELIMINATION"] = rr::Config::LOADSBMLOPTIONS_OPTIMIZE_DEAD_CODE_ELIMINATION;
     keys["LOADSBMLOPTIONS_OPTIMIZE_INSTRUCTION_SIMPLIFIER"] = rr::Config::LOADSBMLOPTIONS_OPTIMIZE_INSTRUCTION_SIMPLIFIER;
     keys["LOADSBMLOPTIONS_USE_MCJIT"] = rr::Config::LOADSBMLOPTIONS_USE_MCJIT;
+    keys["LOADSBMLOPTIONS_FAST_MATH"] = rr::Config::LOADSBMLOPTIONS_FAST_MATH;
+    keys["LOADSBMLOPTIONS_OPTIMIZE_ASSIGNMENT_RULES"] = rr::Config::LOADSBMLOPTIONS_OPTIMIZE_ASSIGNMENT_RULES;
+    keys["LOADSBMLOPTIONS_COMPACT"] = rr::Config::LOADSBMLOPTIONS_COMPACT;
+    keys["LOADSBMLOPTIONS_OPTIMIZE_NATIVE"] = rr::Config::LOADSBMLOPTIONS_OPTIMIZE_NATIVE;
     keys["SIMULATEOPTIONS_STEPS"] = rr::Config::SIMULATEOPTIONS_STEPS;
     keys["SIMULATEOPTIONS_DURATION"] = rr::Config::SIMULATEOPTIONS_DURATION;
     keys["SIMULATEOPTIONS_ABSOLUTE"] = rr::Config::SIMULATEOPTIONS_ABSOLUTE;
@@ -176,6 +189,10 @@ static void getKeyNames(StringIntMap& keys)
     keys["SBML_APPLICABLEVALIDATORS"] = rr::Config::SBML_APPLICABLEVALIDATORS;
 
     keys["ROADRUNNER_JACOBIAN_STEP_SIZE"] = rr::Config::ROADRUNNER_JACOBIAN_STEP_SIZE;
+    keys["LLVM_MODEL_CACHE_SIZE"] = rr::Config::LLVM_MODEL_CACHE_SIZE;
+    keys["LLVM_MODEL_CACHE_MEMORY"] = rr::Config::LLVM_MODEL_CACHE_MEMORY;
+    keys["LLVM_CODEGEN_THREADS"] = rr::Config::LLVM_CODEGEN_THREADS;
+    keys["ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD"] = rr::Config::ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD;
 
 
     assert(rr::Config::CONFIG_END == sizeof(values) / sizeof(Variant) &&
@@ -279,6 +296,12 @@ void Config::setValue(Keys key, const Variant& value)
     readDefaultConfig();
     CHECK_RANGE(key);
     values[key] = value;
+
+    // a lower limit releases the retained models now, not on the next load
+    if (key == LLVM_MODEL_CACHE_SIZE || key == LLVM_MODEL_CACHE_MEMORY)
+    {
+        ModelGenerator::trimModelCache();
+    }
 }
 
 void Config::readConfigFile(const std::string& path)
@@ -154,6 +154,38 @@ public:
          */
         LOADSBMLOPTIONS_USE_MCJIT,
 
+        /**
+         * Generate floating point code with relaxed IEEE semantics,
+         * see LoadSBMLOptions::FAST_MATH.
+         *
+         * Defaults to false.
+         */
+        LOADSBMLOPTIONS_FAST_MATH,
+
+        /**
+         * Evaluate the assignment rules used by each generated function once
+         * per call, see LoadSBMLOptions::OPTIMIZE_ASSIGNMENT_RULES.
+         *
+         * Defaults to false.
+         */
+        LOADSBMLOPTIONS_OPTIMIZE_ASSIGNMENT_RULES,
+
+        /**
+         * Release the LLVM IR once the model is compiled, see
+         * LoadSBMLOptions::COMPACT.
+         *
+         * Defaults to false.
+         */
+        LOADSBMLOPTIONS_COMPACT,
+
+        /**
+         * Build legacy C models with the system compiler at -O3, see
+         * LoadSBMLOptions::OPTIMIZE_NATIVE.
+         *
+         * Defaults to false.
+         */
+        LOADSBMLOPTIONS_OPTIMIZE_NATIVE,
+
 
         /**
          * The number of steps at which the output is sampled. The samples are evenly spaced.
@@ -315,6 +347,57 @@ public:
          */
         ROADRUNNER_JACOBIAN_STEP_SIZE,
 
+        /**
+         * The LLVM model generator keeps strong references to this many of
+         * the most recently used compiled models, so that re-loading a
+         * model whose last instance has been deleted does not re-compile it.
+         *
+         * 0 means no count limit. If both this and LLVM_MODEL_CACHE_MEMORY
+         * are 0, compiled models are only shared between models that are
+         * currently in use.
+         *
+         * Defaults to 0.
+         */
+        LLVM_MODEL_CACHE_SIZE,
+
+        /**
+         * Upper limit, in megabytes, of the estimated memory used by the
+         * compiled models retained by the LLVM model cache, the least
+         * recently used models are released first.
+         *
+         * 0 means no memory limit, only LLVM_MODEL_CACHE_SIZE applies.
+         *
+         * Defaults to 0.
+         */
+        LLVM_MODEL_CACHE_MEMORY,
+
+        /**
+         * Number of threads used to generate and optimize the functions of
+         * a single model. Each additional thread builds its functions in
+         * its own temporary LLVM context, which is linked into the model's
+         * module and released before the functions are compiled to native
+         * code on the calling thread, so the loaded model does not use any
+         * more memory than with a single thread.
+         *
+         * A value of 0 uses one thread per processor. Requires an LLVM built
+         * with thread support, otherwise a single thread is used.
+         *
+         * Defaults to 1, all functions are generated sequentially.
+         */
+        LLVM_CODEGEN_THREADS,
+
+        /**
+         * Models with at least this many floating species use the sparse
+         * structural analysis for conserved moiety conversion and for the
+         * link, Nr, L0 and conservation matrices, instead of the dense
+         * QR factorization of LibStructural.
+         *
+         * A value of 0 or less always uses the dense analysis.
+         *
+         * Defaults to 100.
+         */
+        ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD,
+
         /**
          * Needs to be the last item in the enum, no mater how many
          * other items are added, this is used internally to create
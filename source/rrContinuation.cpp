@@ -0,0 +1,430 @@
+#pragma hdrstop
+#include "rrContinuation.h"
+#include "rrSteadyStateSearch.h"
+#include "rrExecutableModel.h"
+#include "rrException.h"
+#include "rrLogger.h"
+#include "rr-libstruct/lsLibla.h"
+
+#include <sundials/sundials_dense.h>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+namespace rr
+{
+
+ContinuationOptions::ContinuationOptions() :
+        initialStep(0.01), minStep(1.e-6), maxStep(1.0), maxPoints(1000),
+        maxIterations(10), tolerance(1.e-9)
+{
+}
+
+Continuation::Continuation(ExecutableModel *model, int parameterIndex,
+        const ContinuationOptions& options) :
+        model(model), parameterIndex(parameterIndex), options(options),
+        n(model->getStateVector(0))
+{
+    f.resize(n);
+    uTrial.resize(n + 1);
+    fTrial.resize(n);
+    lu.resize((n + 1) * (n + 1));
+    pivots.resize(n + 1);
+    work.resize((n + 1) * (n + 1));
+    workPivots.resize(n + 1);
+    jac.resize(n, n);
+}
+
+Continuation::~Continuation()
+{
+}
+
+/**
+ * column pointers of a column major square matrix, for the sundials
+ * dense routines.
+ */
+static std::vector<double*> columns(std::vector<double>& a, int size)
+{
+    std::vector<double*> result(size);
+    for (int j = 0; j < size; ++j)
+    {
+        result[j] = &a[j * size];
+    }
+    return result;
+}
+
+double Continuation::rates(const std::vector<double>& u,
+        std::vector<double>& rates)
+{
+    model->setGlobalParameterValues(1, &parameterIndex, &u[n]);
+    model->getStateVectorRate(model->getTime(), &u[0], &rates[0]);
+
+    double norm = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        if (!(fabs(rates[i]) <= std::numeric_limits<double>::max()))
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+        norm = std::max(norm, fabs(rates[i]));
+    }
+    return norm;
+}
+
+bool Continuation::factor(const std::vector<double>& u,
+        const std::vector<double>& row, std::vector<double>& a,
+        std::vector<long>& p, bool keepJacobian)
+{
+    const int m = n + 1;
+
+    rates(u, f);
+    uTrial = u;
+
+    for (int j = 0; j < m; ++j)
+    {
+        const double h = 1.e-7 * std::max(fabs(u[j]), 1.e-3);
+        uTrial[j] = u[j] + h;
+        rates(uTrial, fTrial);
+        uTrial[j] = u[j];
+
+        for (int i = 0; i < n; ++i)
+        {
+            a[j * m + i] = (fTrial[i] - f[i]) / h;
+        }
+        a[j * m + n] = row[j];
+
+        if (keepJacobian && j < n)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                jac(i, j) = a[j * m + i];
+            }
+        }
+    }
+
+    std::vector<double*> cols = columns(a, m);
+    return denseGETRF(&cols[0], m, m, &p[0]) == 0;
+}
+
+bool Continuation::correct(std::vector<double>& u,
+        const std::vector<double>& uPred, const std::vector<double>& row,
+        int& iterations)
+{
+    const int m = n + 1;
+    std::vector<double> r(m);
+
+    std::vector<double> *a = &lu;
+    std::vector<long> *p = &pivots;
+    bool refactored = false;
+    double lastNorm = std::numeric_limits<double>::infinity();
+
+    for (iterations = 0; iterations <= options.maxIterations; ++iterations)
+    {
+        double norm = rates(u, r);
+
+        if (!(norm < std::numeric_limits<double>::infinity()))
+        {
+            return false;
+        }
+
+        double constraint = 0;
+        for (int i = 0; i < m; ++i)
+        {
+            constraint += row[i] * (u[i] - uPred[i]);
+        }
+        r[n] = constraint;
+
+        if (norm <= options.tolerance
+                && fabs(constraint) <= options.tolerance * std::max(1.0, fabs(u[n])))
+        {
+            return true;
+        }
+
+        if (iterations == options.maxIterations)
+        {
+            return false;
+        }
+
+        // the chord iterations have stopped contracting, use a fresh
+        // Jacobian once, then give up so the step gets smaller.
+        if (iterations > 0 && norm > 0.5 * lastNorm)
+        {
+            if (refactored || !factor(u, row, work, workPivots, false))
+            {
+                return false;
+            }
+            a = &work;
+            p = &workPivots;
+            refactored = true;
+        }
+
+        lastNorm = norm;
+
+        for (int i = 0; i < m; ++i)
+        {
+            r[i] = -r[i];
+        }
+
+        std::vector<double*> cols = columns(*a, m);
+        denseGETRS(&cols[0], m, &(*p)[0], &r[0]);
+
+        for (int i = 0; i < m; ++i)
+        {
+            u[i] += r[i];
+        }
+    }
+
+    return false;
+}
+
+void Continuation::classify(int& unstableReal, int& unstableComplex,
+        double& leadingComplex)
+{
+    std::vector<ls::Complex> eigen = ls::getEigenValues(jac);
+
+    double scale = 1.0;
+    for (unsigned i = 0; i < eigen.size(); ++i)
+    {
+        scale = std::max(scale, std::abs(eigen[i]));
+    }
+
+    const double eps = 1.e-8 * scale;
+
+    unstableReal = 0;
+    unstableComplex = 0;
+    leadingComplex = -std::numeric_limits<double>::infinity();
+
+    for (unsigned i = 0; i < eigen.size(); ++i)
+    {
+        bool complex = fabs(eigen[i].imag()) > eps;
+
+        if (complex)
+        {
+            leadingComplex = std::max(leadingComplex, eigen[i].real());
+        }
+
+        if (eigen[i].real() > eps)
+        {
+            (complex ? unstableComplex : unstableReal)++;
+        }
+    }
+}
+
+/**
+ * tangent from the factored bordered matrix, the solution of
+ * A t = e_{n+1}, normalized.
+ */
+static void tangent(std::vector<double>& lu, std::vector<long>& pivots,
+        std::vector<double>& t)
+{
+    const int m = t.size();
+    std::fill(t.begin(), t.end(), 0.0);
+    t[m - 1] = 1.0;
+
+    std::vector<double*> cols = columns(lu, m);
+    denseGETRS(&cols[0], m, &pivots[0], &t[0]);
+
+    double norm = 0;
+    for (int i = 0; i < m; ++i)
+    {
+        norm += t[i] * t[i];
+    }
+    norm = sqrt(norm);
+
+    for (int i = 0; i < m; ++i)
+    {
+        t[i] /= norm;
+    }
+}
+
+void Continuation::run(const std::vector<double>& y, double start,
+        double end, ls::DoubleMatrix& result,
+        std::vector<BifurcationPoint>& bifurcations)
+{
+    if (n == 0)
+    {
+        throw CoreException("the model has no state variables to continue");
+    }
+
+    const double lo = std::min(start, end);
+    const double hi = std::max(start, end);
+    const int numFloating = model->getNumFloatingSpecies();
+    const int cols = numFloating + 2;
+
+    // the first point, a steady state at the start value
+    std::vector<double> u(y);
+    u.push_back(start);
+    model->setGlobalParameterValues(1, &parameterIndex, &start);
+
+    SteadyStateSearch search(model, 100, options.tolerance);
+    std::vector<double> y0(y);
+    if (!search.solve(y0))
+    {
+        throw CoreException("Could not find a steady state at the start "
+                "of the continuation");
+    }
+    std::copy(y0.begin(), y0.end(), u.begin());
+
+    // the bordered row of the first factorization, a natural parameter step
+    std::vector<double> row(n + 1, 0.0);
+    row[n] = end >= start ? 1.0 : -1.0;
+
+    if (!factor(u, row, lu, pivots, true))
+    {
+        throw CoreException("Singular Jacobian at the start of the "
+                "continuation, models with conservation laws require "
+                "conserved moiety analysis");
+    }
+
+    std::vector<double> t(n + 1);
+    tangent(lu, pivots, t);
+
+    // rows are streamed into here, and copied into the result at the end
+    std::vector<double> rows;
+    std::vector<double> concentrations(numFloating);
+    int points = 0;
+    double h = options.initialStep;
+
+    int unstableReal, unstableComplex;
+    double leadingComplex;
+    classify(unstableReal, unstableComplex, leadingComplex);
+
+    for (;;)
+    {
+        model->setGlobalParameterValues(1, &parameterIndex, &u[n]);
+        model->setStateVector(&u[0]);
+        model->getStateVectorRate(model->getTime(), 0, 0);
+        if (numFloating)
+        {
+            model->getFloatingSpeciesConcentrations(numFloating, 0,
+                    &concentrations[0]);
+        }
+
+        rows.push_back(u[n]);
+        rows.insert(rows.end(), concentrations.begin(), concentrations.end());
+        rows.push_back(unstableReal + unstableComplex);
+        ++points;
+
+        if (points >= options.maxPoints)
+        {
+            break;
+        }
+
+        // predictor corrector step, shrink the step until the corrector
+        // converges.
+        std::vector<double> uPred(n + 1);
+        std::vector<double> uNew;
+        int iterations = 0;
+        bool converged = false;
+
+        while (!converged && h >= options.minStep)
+        {
+            for (int i = 0; i <= n; ++i)
+            {
+                uPred[i] = u[i] + h * t[i];
+            }
+            uNew = uPred;
+
+            converged = correct(uNew, uPred, row, iterations);
+
+            if (!converged)
+            {
+                h *= 0.5;
+            }
+        }
+
+        if (!converged)
+        {
+            Log(Logger::LOG_WARNING) << "Continuation stopped at parameter "
+                    << u[n] << ", step size smaller than " << options.minStep;
+            break;
+        }
+
+        if (uNew[n] < lo || uNew[n] > hi)
+        {
+            break;
+        }
+
+        // one Jacobian and factorization at the new point, for the tangent,
+        // the eigenvalues, and the chord iterations of the next step.
+        if (!factor(uNew, t, lu, pivots, true))
+        {
+            Log(Logger::LOG_WARNING) << "Continuation stopped at parameter "
+                    << uNew[n] << ", singular bordered Jacobian";
+            break;
+        }
+
+        std::vector<double> tNew(n + 1);
+        tangent(lu, pivots, tNew);
+
+        int newReal, newComplex;
+        double newLeading;
+        classify(newReal, newComplex, newLeading);
+
+        if ((t[n] > 0) != (tNew[n] > 0))
+        {
+            double s = t[n] / (t[n] - tNew[n]);
+            BifurcationPoint b;
+            b.type = BifurcationPoint::FOLD;
+            b.row = points - 1;
+            b.parameter = (1 - s) * u[n] + s * uNew[n];
+            for (int i = 0; i < n; ++i)
+            {
+                b.stateVector.push_back((1 - s) * u[i] + s * uNew[i]);
+            }
+            bifurcations.push_back(b);
+
+            Log(Logger::LOG_NOTICE) << "Fold near parameter " << b.parameter;
+        }
+
+        if (newComplex != unstableComplex)
+        {
+            double s = 0.5;
+            if (leadingComplex > -std::numeric_limits<double>::infinity()
+                    && newLeading > -std::numeric_limits<double>::infinity()
+                    && leadingComplex != newLeading)
+            {
+                s = std::min(1.0, std::max(0.0,
+                        leadingComplex / (leadingComplex - newLeading)));
+            }
+
+            BifurcationPoint b;
+            b.type = BifurcationPoint::HOPF;
+            b.row = points - 1;
+            b.parameter = (1 - s) * u[n] + s * uNew[n];
+            for (int i = 0; i < n; ++i)
+            {
+                b.stateVector.push_back((1 - s) * u[i] + s * uNew[i]);
+            }
+            bifurcations.push_back(b);
+
+            Log(Logger::LOG_NOTICE) << "Hopf point near parameter " << b.parameter;
+        }
+
+        // adapt the step to how hard the corrector had to work
+        if (iterations <= 3)
+        {
+            h = std::min(1.5 * h, options.maxStep);
+        }
+        else if (iterations > 6)
+        {
+            h = std::max(0.5 * h, options.minStep);
+        }
+
+        u.swap(uNew);
+        row.swap(t);
+        t.swap(tNew);
+        unstableReal = newReal;
+        unstableComplex = newComplex;
+        leadingComplex = newLeading;
+    }
+
+    result.resize(points, cols);
+    std::copy(rows.begin(), rows.end(), result.getArray());
+
+    Log(Logger::LOG_NOTICE) << "Continuation traced " << points
+            << " points and found " << bifurcations.size() << " bifurcations";
+}
+
+} /* namespace rr */
@@ -0,0 +1,186 @@
+#ifndef RRCONTINUATION_H_
+#define RRCONTINUATION_H_
+
+#include "rrOSSpecifics.h"
+#include "rr-libstruct/lsMatrix.h"
+
+#include <vector>
+#include <complex>
+
+namespace rr
+{
+
+class ExecutableModel;
+
+/**
+ * Options for RoadRunner::continueSteadyState, the steps are arclength
+ * steps in the (state vector, parameter) space.
+ */
+struct RR_DECLSPEC ContinuationOptions
+{
+    /**
+     * initializes the struct with the default options.
+     */
+    ContinuationOptions();
+
+    double initialStep;
+    double minStep;
+    double maxStep;
+
+    /**
+     * maximum number of points on the branch, including the first.
+     */
+    int maxPoints;
+
+    /**
+     * maximum number of corrector iterations per step.
+     */
+    int maxIterations;
+
+    /**
+     * the corrector has converged when the max norm of the state vector
+     * rate is below tolerance.
+     */
+    double tolerance;
+};
+
+/**
+ * A fold or Hopf point found by RoadRunner::continueSteadyState.
+ */
+struct RR_DECLSPEC BifurcationPoint
+{
+    enum Type
+    {
+        /**
+         * the branch turns back in the parameter, a real eigenvalue
+         * crosses zero.
+         */
+        FOLD,
+
+        /**
+         * a complex pair of eigenvalues crosses the imaginary axis.
+         */
+        HOPF
+    };
+
+    Type type;
+
+    /**
+     * the bifurcation lies between this row of the result and the next.
+     */
+    int row;
+
+    /**
+     * parameter value and state vector, linearly interpolated between
+     * the two rows.
+     */
+    double parameter;
+    std::vector<double> stateVector;
+};
+
+/**
+ * @internal
+ * Pseudo-arclength continuation of the steady states of a model in one
+ * global parameter.
+ *
+ * The unknowns are u = (y, p), the state vector and the parameter. From a
+ * point u_k on the branch, with tangent t_k, a step of length h predicts
+ * u_k + h t_k, and the corrector solves
+ *
+ *     F(y, p) = 0,  t_{k-1}' (u - u_k - h t_k) = 0
+ *
+ * with chord Newton iterations, which use the LU factorization of the
+ * bordered matrix [dF/dy dF/dp; t_{k-1}'] at u_k. The same factorization
+ * gives the tangent, t_k solves [dF/dy dF/dp; t_{k-1}'] t_k = e_{n+1}, so
+ * each step needs one Jacobian and one factorization, unless the chord
+ * iterations stop contracting.
+ *
+ * Folds are detected by a sign change in the parameter component of the
+ * tangent, Hopf points by a change in the number of complex eigenvalues of
+ * dF/dy with a positive real part.
+ */
+class Continuation
+{
+public:
+    /**
+     * continuation of the given model in the global parameter with the
+     * given index, the model is not owned.
+     */
+    Continuation(ExecutableModel *model, int parameterIndex,
+            const ContinuationOptions& options);
+
+    ~Continuation();
+
+    /**
+     * trace the branch from the steady state near y at the parameter value
+     * start, in the direction of end, until the parameter leaves
+     * [start, end], the maximum number of points is reached, or the step
+     * becomes smaller than the minimum step.
+     *
+     * Each point is appended to result as a row of the parameter, the
+     * floating species concentrations and the number of eigenvalues with a
+     * positive real part. The model is left in an unspecified state.
+     */
+    void run(const std::vector<double>& y, double start, double end,
+            ls::DoubleMatrix& result, std::vector<BifurcationPoint>& bifurcations);
+
+private:
+    ExecutableModel *model;
+    int parameterIndex;
+    ContinuationOptions options;
+    int n;
+
+    /**
+     * work space, the rates, the perturbed point and its rates.
+     */
+    std::vector<double> f;
+    std::vector<double> uTrial;
+    std::vector<double> fTrial;
+
+    /**
+     * column major bordered matrix and its LU factors at the last point on
+     * the branch, and a copy that the corrector refactors when the chord
+     * iterations stall.
+     */
+    std::vector<double> lu;
+    std::vector<long> pivots;
+    std::vector<double> work;
+    std::vector<long> workPivots;
+
+    /**
+     * row major dF/dy at the last point, for the eigenvalues.
+     */
+    ls::DoubleMatrix jac;
+
+    /**
+     * evaluate F at u = (y, p) into rates, returns the max norm, or
+     * infinity if the rates are not finite.
+     */
+    double rates(const std::vector<double>& u, std::vector<double>& rates);
+
+    /**
+     * forward difference [dF/dy dF/dp] at u into the first n rows of the
+     * column major (n + 1) x (n + 1) matrix a, the last row is set to row,
+     * and factor it. Returns false if it is singular.
+     */
+    bool factor(const std::vector<double>& u, const std::vector<double>& row,
+            std::vector<double>& a, std::vector<long>& p, bool keepJacobian);
+
+    /**
+     * chord Newton corrector from u towards the hyperplane through uPred
+     * normal to row, returns false if it did not converge.
+     */
+    bool correct(std::vector<double>& u, const std::vector<double>& uPred,
+            const std::vector<double>& row, int& iterations);
+
+    /**
+     * eigenvalues of jac, and the number of real and complex ones with a
+     * positive real part.
+     */
+    void classify(int& unstableReal, int& unstableComplex,
+            double& leadingComplex);
+};
+
+} /* namespace rr */
+
+#endif /* RRCONTINUATION_H_ */
@@ -0,0 +1,384 @@
+#pragma hdrstop
+// on Windows, this needs to go first to get M_PI
+#define _USE_MATH_DEFINES
+
+#include "rrEnsembleStatistics.h"
+#include "rrException.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <utility>
+
+// min and max macros on windows
+#undef max
+#undef min
+
+using namespace std;
+using ls::DoubleMatrix;
+
+namespace rr
+{
+
+static const double nan = std::numeric_limits<double>::quiet_NaN();
+
+TDigest::TDigest(double compression) :
+        compression(compression),
+        totalWeight(0),
+        min(std::numeric_limits<double>::infinity()),
+        max(-std::numeric_limits<double>::infinity())
+{
+}
+
+void TDigest::add(double value, double weight)
+{
+    bufferMeans.push_back(value);
+    bufferWeights.push_back(weight);
+    totalWeight += weight;
+    min = std::min(min, value);
+    max = std::max(max, value);
+
+    if (bufferMeans.size() >= compression)
+    {
+        compress();
+    }
+}
+
+void TDigest::merge(const TDigest& other)
+{
+    // the other buffer first, so the result does not depend on when
+    // the other digest was last compressed.
+    for (unsigned i = 0; i < other.bufferMeans.size(); ++i)
+    {
+        add(other.bufferMeans[i], other.bufferWeights[i]);
+    }
+
+    for (unsigned i = 0; i < other.means.size(); ++i)
+    {
+        add(other.means[i], other.weights[i]);
+    }
+
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+/**
+ * the k1 scale function of Dunning and Ertl, maps a quantile to an index
+ * which increases by one for each centroid.
+ */
+static double scale(double q, double compression)
+{
+    return compression / (2 * M_PI) * asin(2 * q - 1);
+}
+
+static double inverseScale(double k, double compression)
+{
+    if (k >= compression / 4)
+    {
+        return 1;
+    }
+    return (sin(k * 2 * M_PI / compression) + 1) / 2;
+}
+
+void TDigest::compress()
+{
+    if (bufferMeans.empty())
+    {
+        return;
+    }
+
+    vector<pair<double, double> > items;
+    items.reserve(means.size() + bufferMeans.size());
+
+    for (unsigned i = 0; i < means.size(); ++i)
+    {
+        items.push_back(make_pair(means[i], weights[i]));
+    }
+
+    for (unsigned i = 0; i < bufferMeans.size(); ++i)
+    {
+        items.push_back(make_pair(bufferMeans[i], bufferWeights[i]));
+    }
+
+    bufferMeans.clear();
+    bufferWeights.clear();
+
+    std::sort(items.begin(), items.end());
+
+    means.clear();
+    weights.clear();
+
+    double weightSoFar = 0;
+    double limit = inverseScale(scale(0, compression) + 1, compression) * totalWeight;
+
+    double mean = items[0].first;
+    double weight = items[0].second;
+
+    for (unsigned i = 1; i < items.size(); ++i)
+    {
+        if (weightSoFar + weight + items[i].second <= limit)
+        {
+            weight += items[i].second;
+            mean += (items[i].first - mean) * items[i].second / weight;
+        }
+        else
+        {
+            means.push_back(mean);
+            weights.push_back(weight);
+            weightSoFar += weight;
+
+            limit = inverseScale(scale(weightSoFar / totalWeight, compression) + 1,
+                    compression) * totalWeight;
+
+            mean = items[i].first;
+            weight = items[i].second;
+        }
+    }
+
+    means.push_back(mean);
+    weights.push_back(weight);
+}
+
+double TDigest::quantile(double q) const
+{
+    if (bufferMeans.size())
+    {
+        TDigest tmp = *this;
+        tmp.compress();
+        return tmp.quantile(q);
+    }
+
+    if (means.empty())
+    {
+        return nan;
+    }
+
+    if (means.size() == 1)
+    {
+        return means[0];
+    }
+
+    q = std::max(0.0, std::min(1.0, q));
+
+    const double index = q * totalWeight;
+
+    // between the minimum and the center of the first centroid
+    if (index < weights[0] / 2)
+    {
+        return min + (means[0] - min) * index / (weights[0] / 2);
+    }
+
+    // interpolate between the centers of adjacent centroids
+    double center = weights[0] / 2;
+    for (unsigned i = 0; i + 1 < means.size(); ++i)
+    {
+        double next = center + (weights[i] + weights[i + 1]) / 2;
+        if (index <= next)
+        {
+            return means[i] + (means[i + 1] - means[i]) *
+                    (index - center) / (next - center);
+        }
+        center = next;
+    }
+
+    // between the center of the last centroid and the maximum
+    double last = weights.back() / 2;
+    return means.back() + (max - means.back()) *
+            std::min(1.0, (index - center) / last);
+}
+
+EnsembleStatistics::EnsembleStatistics(double compression) :
+        compression(compression),
+        rows(0),
+        cols(0)
+{
+}
+
+void EnsembleStatistics::reset(int r, int c)
+{
+    rows = r;
+    cols = c;
+
+    counts.assign(rows, 0);
+    means.assign(rows * cols, 0);
+    m2.assign(rows * cols, 0);
+    mins.assign(rows * cols, std::numeric_limits<double>::infinity());
+    maxs.assign(rows * cols, -std::numeric_limits<double>::infinity());
+
+    digests.clear();
+    if (compression > 0)
+    {
+        digests.assign(rows * cols, TDigest(compression));
+    }
+}
+
+void EnsembleStatistics::add(int row, const double *values)
+{
+    double n = ++counts[row];
+
+    for (int j = 0; j < cols; ++j)
+    {
+        int i = row * cols + j;
+        double x = values[j];
+
+        // Welford's update
+        double delta = x - means[i];
+        means[i] += delta / n;
+        m2[i] += delta * (x - means[i]);
+
+        mins[i] = std::min(mins[i], x);
+        maxs[i] = std::max(maxs[i], x);
+
+        if (digests.size())
+        {
+            digests[i].add(x);
+        }
+    }
+}
+
+void EnsembleStatistics::merge(const EnsembleStatistics& other)
+{
+    if (other.rows != rows || other.cols != cols)
+    {
+        throw CoreException("Can not merge ensemble statistics of different sizes");
+    }
+
+    for (int row = 0; row < rows; ++row)
+    {
+        double na = counts[row];
+        double nb = other.counts[row];
+        double n = na + nb;
+
+        counts[row] += other.counts[row];
+
+        if (nb == 0)
+        {
+            continue;
+        }
+
+        for (int j = 0; j < cols; ++j)
+        {
+            int i = row * cols + j;
+
+            // Chan et al. pairwise combination of the Welford sums
+            double delta = other.means[i] - means[i];
+            means[i] += delta * nb / n;
+            m2[i] += other.m2[i] + delta * delta * na * nb / n;
+
+            mins[i] = std::min(mins[i], other.mins[i]);
+            maxs[i] = std::max(maxs[i], other.maxs[i]);
+
+            if (digests.size() && other.digests.size())
+            {
+                digests[i].merge(other.digests[i]);
+            }
+        }
+    }
+}
+
+int EnsembleStatistics::numRows() const
+{
+    return rows;
+}
+
+int EnsembleStatistics::numCols() const
+{
+    return cols;
+}
+
+double EnsembleStatistics::getCompression() const
+{
+    return compression;
+}
+
+unsigned long EnsembleStatistics::getCount() const
+{
+    return counts.size() ? counts[0] : 0;
+}
+
+DoubleMatrix EnsembleStatistics::getMean() const
+{
+    DoubleMatrix result(rows, cols);
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int j = 0; j < cols; ++j)
+        {
+            result(row, j) = counts[row] ? means[row * cols + j] : nan;
+        }
+    }
+    return result;
+}
+
+DoubleMatrix EnsembleStatistics::getVariance() const
+{
+    DoubleMatrix result(rows, cols);
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int j = 0; j < cols; ++j)
+        {
+            result(row, j) = counts[row] > 1 ?
+                    m2[row * cols + j] / (counts[row] - 1) : nan;
+        }
+    }
+    return result;
+}
+
+DoubleMatrix EnsembleStatistics::getStandardDeviation() const
+{
+    DoubleMatrix result = getVariance();
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int j = 0; j < cols; ++j)
+        {
+            result(row, j) = sqrt(result(row, j));
+        }
+    }
+    return result;
+}
+
+DoubleMatrix EnsembleStatistics::getMin() const
+{
+    DoubleMatrix result(rows, cols);
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int j = 0; j < cols; ++j)
+        {
+            result(row, j) = counts[row] ? mins[row * cols + j] : nan;
+        }
+    }
+    return result;
+}
+
+DoubleMatrix EnsembleStatistics::getMax() const
+{
+    DoubleMatrix result(rows, cols);
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int j = 0; j < cols; ++j)
+        {
+            result(row, j) = counts[row] ? maxs[row * cols + j] : nan;
+        }
+    }
+    return result;
+}
+
+DoubleMatrix EnsembleStatistics::getQuantile(double q) const
+{
+    if (digests.empty() && rows * cols > 0)
+    {
+        throw CoreException("Quantiles were not computed, the ensemble "
+                "statistics compression is zero");
+    }
+
+    DoubleMatrix result(rows, cols);
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int j = 0; j < cols; ++j)
+        {
+            result(row, j) = digests[row * cols + j].quantile(q);
+        }
+    }
+    return result;
+}
+
+} /* namespace rr */
@@ -0,0 +1,167 @@
+#ifndef RRENSEMBLESTATISTICS_H_
+#define RRENSEMBLESTATISTICS_H_
+
+#include "rrOSSpecifics.h"
+#include "rr-libstruct/lsMatrix.h"
+
+#include <vector>
+
+namespace rr
+{
+
+#ifndef SWIG
+
+/**
+ * @internal
+ * Mergeable approximate quantile estimator, the merging t-digest of
+ * Dunning and Ertl, "Computing Extremely Accurate Quantiles Using t-Digests".
+ *
+ * Values are collected in a buffer which is periodically merged into a
+ * sorted list of weighted centroids. The centroids are small near the
+ * tails and large near the median, so extreme quantiles are accurate, and
+ * the number of centroids is bounded by the compression, independent of
+ * the number of values.
+ */
+class TDigest
+{
+public:
+    TDigest(double compression = 100);
+
+    void add(double value, double weight = 1);
+
+    /**
+     * add all the values of another digest to this one.
+     */
+    void merge(const TDigest& other);
+
+    /**
+     * estimate the q'th quantile, NaN if no values were added.
+     */
+    double quantile(double q) const;
+
+private:
+    double compression;
+    double totalWeight;
+    double min;
+    double max;
+
+    /**
+     * sorted centroids.
+     */
+    std::vector<double> means;
+    std::vector<double> weights;
+
+    /**
+     * values not yet merged into the centroids.
+     */
+    std::vector<double> bufferMeans;
+    std::vector<double> bufferWeights;
+
+    /**
+     * merge the buffer into the centroids.
+     */
+    void compress();
+};
+
+#endif
+
+/**
+ * Summary statistics of a stochastic ensemble.
+ *
+ * Accumulates the mean and variance, with Welford's algorithm, and an
+ * approximate distribution, with a t-digest, of each selection at each
+ * time point. The memory used depends only on the number of time points
+ * and selections, and not on the number of trajectories, so very large
+ * ensembles can be summarized without storing them.
+ *
+ * Statistics accumulated on different threads are combined with merge.
+ */
+class RR_DECLSPEC EnsembleStatistics
+{
+public:
+
+    /**
+     * @param compression the t-digest compression, higher values give
+     * more accurate quantiles but use more memory, up to 32 * compression
+     * bytes per time point and selection. Quantiles are not computed if
+     * this is zero.
+     */
+    EnsembleStatistics(double compression = 100);
+
+    /**
+     * clear the statistics and size them for the given number of
+     * time points and selections.
+     */
+    void reset(int rows, int cols);
+
+    /**
+     * add the selection values of one trajectory at time point row,
+     * values must be of length numCols().
+     */
+    void add(int row, const double *values);
+
+    /**
+     * add the statistics of another set of trajectories. Both must
+     * have the same size.
+     */
+    void merge(const EnsembleStatistics& other);
+
+    /**
+     * number of time points
+     */
+    int numRows() const;
+
+    /**
+     * number of selections
+     */
+    int numCols() const;
+
+    double getCompression() const;
+
+    /**
+     * number of trajectories that were added.
+     */
+    unsigned long getCount() const;
+
+    ls::DoubleMatrix getMean() const;
+
+    /**
+     * the sample variance.
+     */
+    ls::DoubleMatrix getVariance() const;
+
+    ls::DoubleMatrix getStandardDeviation() const;
+
+    ls::DoubleMatrix getMin() const;
+
+    ls::DoubleMatrix getMax() const;
+
+    /**
+     * approximate q'th quantile, 0 <= q <= 1, of each selection at
+     * each time point, i.e. getQuantile(0.5) is the median.
+     */
+    ls::DoubleMatrix getQuantile(double q) const;
+
+private:
+    double compression;
+    int rows;
+    int cols;
+
+    /**
+     * number of values added at each time point
+     */
+    std::vector<unsigned long> counts;
+
+    /**
+     * row major, rows x cols
+     */
+    std::vector<double> means;
+    std::vector<double> m2;
+    std::vector<double> mins;
+    std::vector<double> maxs;
+    std::vector<TDigest> digests;
+};
+
+} /* namespace rr */
+
+#endif /* RRENSEMBLESTATISTICS_H_ */
@@ -102,7 +102,11 @@ std::ostream& operator <<(std::ostream &stream, ExecutableModel* model)
     return stream;
 }
 
-
+int ExecutableModel::getStateVectorJacobian(double time, const double *y,
+        double *jac)
+{
+    return -1;
+}
 
 
 
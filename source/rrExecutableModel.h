@@ -6,6 +6,7 @@
 #include <string>
 #include <list>
 #include <ostream>
+#include <istream>
 
 #if (__cplusplus >= 201103L) || defined(_MSC_VER)
 #include <memory>
@@ -548,6 +549,81 @@ public:
      */
     virtual void getStateVectorRate(double time, const double *y, double* dydt=0) = 0;
 
+    /**
+     * evaluate the Jacobian of the state vector rate, the partial derivatives
+     * of getStateVectorRate with respect to the state vector.
+     *
+     * @param[in] time current simulator time
+     * @param[in] y state vector, if null the current model state is used,
+     *         otherwise it must have the size returned by getStateVector.
+     * @param[out] jac row major n by n matrix, where n is the state vector
+     *         size, jac[i * n + j] = d dydt[i] / d y[j].
+     *
+     * @return 0 on success, or -1 if the model can not provide an exact
+     *         Jacobian, in which case the caller should use finite differences
+     *         of getStateVectorRate. The default implementation returns -1.
+     */
+    virtual int getStateVectorJacobian(double time, const double *y, double *jac);
+
+    /**
+     * number of algebraic rules. Each of these determines a variable which
+     * is part of the state vector, but has a zero rate in getStateVectorRate,
+     * its value is given by the constraint instead.
+     */
+    virtual int getNumAlgebraicRules() = 0;
+
+    /**
+     * state vector index of the variable determined by the given
+     * algebraic rule.
+     */
+    virtual int getAlgebraicRuleStateVectorIndex(int index) = 0;
+
+    /**
+     * number of reactions which are marked as fast. getStateVectorRate
+     * treats these as normal reactions, integrators which handle the
+     * constraints keep them at equilibrium.
+     */
+    virtual int getNumFastReactions() = 0;
+
+    /**
+     * reaction index of the given fast reaction.
+     */
+    virtual int getFastReactionIndex(int index) = 0;
+
+    /**
+     * evaluate the algebraic constraints on the state vector, these are all
+     * zero for a consistent state.
+     *
+     * @param[in] time current simulator time
+     * @param[in] y state vector, if null the current model state is used,
+     *         otherwise it must have the size returned by getStateVector.
+     * @param[out] residuals if not null, the value of the math of each
+     *         algebraic rule, followed by the rate of each fast reaction.
+     *
+     * @return the number of constraints, getNumAlgebraicRules() +
+     *         getNumFastReactions().
+     */
+    virtual int getStateVectorConstraints(double time, const double *y,
+            double *residuals) = 0;
+
+    /**
+     * write the complete run time state of the model, the time, all of the
+     * model values and any pending delayed events, in a binary format to
+     * the stream.
+     *
+     * The state can only be restored into a model created from the same
+     * sbml document on the same platform.
+     */
+    virtual void saveState(std::ostream &out) = 0;
+
+    /**
+     * restore a state written by saveState. The values are copied directly
+     * into the model, no initial conditions or assignments are evaluated.
+     *
+     * Throws an exception if the state does not match this model.
+     */
+    virtual void loadState(std::istream &in) = 0;
+
     virtual void testConstraints() = 0;
 
     virtual std::string getInfo() = 0;
@@ -0,0 +1,752 @@
+#pragma hdrstop
+#include "rrParameterFit.h"
+#include "rrPhiloxRandom.h"
+#include "rrException.h"
+#include "rrLogger.h"
+#include "rrWorkerPool.h"
+
+#include <sundials/sundials_dense.h>
+
+#include <Poco/Runnable.h>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+namespace rr
+{
+
+FitParameter::FitParameter(const std::string& id) :
+        id(id), lower(-HUGE_VAL), upper(HUGE_VAL), logScale(false)
+{
+}
+
+FitParameter::FitParameter(const std::string& id, double lower, double upper,
+        bool logScale) :
+        id(id), lower(lower), upper(upper), logScale(logScale)
+{
+}
+
+FitOptions::FitOptions() :
+        maxIterations(100), tolerance(1.e-6), differenceStep(1.e-5),
+        nThreads(0)
+{
+}
+
+GlobalFitOptions::GlobalFitOptions() :
+        populationSize(0), maxGenerations(1000), weight(0.7), crossover(0.9),
+        seed(0), tolerance(1.e-6), polish(true), nThreads(0)
+{
+}
+
+double ResidualFunction::sumOfSquares(const std::vector<double>& p,
+        double limit)
+{
+    std::vector<double> r(size());
+    evaluate(p, r.size() ? &r[0] : 0);
+
+    double sum = 0;
+    for (unsigned i = 0; i < r.size(); ++i)
+    {
+        sum += r[i] * r[i];
+    }
+    return sum;
+}
+
+static double toInternal(const FitParameter& p, double value)
+{
+    return p.logScale ? log(value) : value;
+}
+
+static double toExternal(const FitParameter& p, double x)
+{
+    return p.logScale ? exp(x) : x;
+}
+
+/**
+ * computes every stride'th column of the Jacobian, beginning with first,
+ * on its own residual function.
+ */
+class JacobianWorker : public Poco::Runnable
+{
+public:
+    JacobianWorker(LevenbergMarquardt& lm, ResidualFunction *function,
+            const std::vector<double>& x, const std::vector<double>& r,
+            std::vector<double>& jac, int first, int stride) :
+        lm(lm), function(function), x(x), r(r), jac(jac), first(first),
+        stride(stride)
+    {
+    }
+
+    virtual void run()
+    {
+        try
+        {
+            std::vector<double> xj(x);
+            std::vector<double> rj(lm.n);
+
+            for (int j = first; j < lm.m; j += stride)
+            {
+                double h = lm.parameters[j].logScale || x[j] == 0 ?
+                        lm.options.differenceStep :
+                        lm.options.differenceStep * fabs(x[j]);
+
+                if (x[j] + h > lm.upper[j])
+                {
+                    h = -h;
+                }
+
+                xj[j] = x[j] + h;
+                double chi2 = lm.evaluate(function, xj, rj);
+                xj[j] = x[j];
+
+                if (!(chi2 < std::numeric_limits<double>::infinity()))
+                {
+                    throw CoreException("Could not evaluate the residuals "
+                            "for the derivative with respect to "
+                            + lm.parameters[j].id);
+                }
+
+                double *col = &jac[j * lm.n];
+                for (int i = 0; i < lm.n; ++i)
+                {
+                    col[i] = (rj[i] - r[i]) / h;
+                }
+            }
+        }
+        catch (std::exception& e)
+        {
+            error = e.what();
+        }
+        catch (...)
+        {
+            error = "unknown error";
+        }
+    }
+
+    std::string error;
+
+private:
+    LevenbergMarquardt& lm;
+    ResidualFunction *function;
+    const std::vector<double>& x;
+    const std::vector<double>& r;
+    std::vector<double>& jac;
+    int first;
+    int stride;
+};
+
+/**
+ * column pointers of a column major square matrix, for the sundials
+ * dense routines.
+ */
+static std::vector<double*> columns(std::vector<double>& a, int size)
+{
+    std::vector<double*> result(size);
+    for (int j = 0; j < size; ++j)
+    {
+        result[j] = &a[j * size];
+    }
+    return result;
+}
+
+LevenbergMarquardt::LevenbergMarquardt(
+        const std::vector<ResidualFunction*>& functions,
+        const std::vector<FitParameter>& parameters,
+        const FitOptions& options) :
+        functions(functions), parameters(parameters), options(options),
+        m(parameters.size()), n(functions.size() ? functions[0]->size() : 0),
+        evaluations(0), pool(0)
+{
+    if (functions.empty())
+    {
+        throw CoreException("parameter fit needs at least one residual function");
+    }
+
+    for (int j = 0; j < m; ++j)
+    {
+        const FitParameter& p = parameters[j];
+
+        if (!(p.lower <= p.upper))
+        {
+            throw CoreException("The lower bound of " + p.id
+                    + " is larger than its upper bound");
+        }
+
+        if (p.logScale && p.upper <= 0)
+        {
+            throw CoreException("The log scaled parameter " + p.id
+                    + " must have a positive upper bound");
+        }
+
+        lower.push_back(p.logScale && p.lower <= 0 ? -HUGE_VAL :
+                toInternal(j, p.lower));
+        upper.push_back(toInternal(j, p.upper));
+    }
+
+    pool = new WorkerPool(std::min((int)functions.size(), m));
+}
+
+LevenbergMarquardt::~LevenbergMarquardt()
+{
+    delete pool;
+}
+
+double LevenbergMarquardt::toInternal(int j, double p) const
+{
+    return rr::toInternal(parameters[j], p);
+}
+
+double LevenbergMarquardt::toExternal(int j, double x) const
+{
+    return rr::toExternal(parameters[j], x);
+}
+
+double LevenbergMarquardt::evaluate(ResidualFunction *f,
+        const std::vector<double>& x, std::vector<double>& r)
+{
+    std::vector<double> p(m);
+    for (int j = 0; j < m; ++j)
+    {
+        p[j] = toExternal(j, x[j]);
+    }
+
+    try
+    {
+        f->evaluate(p, n ? &r[0] : 0);
+    }
+    catch (std::exception& e)
+    {
+        Log(Logger::LOG_INFORMATION) << "Residuals could not be evaluated: "
+                << e.what();
+        return std::numeric_limits<double>::infinity();
+    }
+
+    double chi2 = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        chi2 += r[i] * r[i];
+    }
+
+    return chi2 < std::numeric_limits<double>::infinity() ? chi2 :
+            std::numeric_limits<double>::infinity();
+}
+
+void LevenbergMarquardt::jacobian(const std::vector<double>& x,
+        const std::vector<double>& r, std::vector<double>& jac)
+{
+    const int nThreads = pool->size();
+
+    std::vector<JacobianWorker*> workers(nThreads);
+    for (int i = 0; i < nThreads; ++i)
+    {
+        workers[i] = new JacobianWorker(*this, functions[i], x, r, jac, i,
+                nThreads);
+    }
+
+    std::string error;
+    try
+    {
+        pool->run(workers);
+    }
+    catch (std::exception& e)
+    {
+        error = e.what();
+    }
+
+    for (int i = 0; i < nThreads; ++i)
+    {
+        if (error.empty())
+        {
+            error = workers[i]->error;
+        }
+        delete workers[i];
+    }
+
+    evaluations += m;
+
+    if (!error.empty())
+    {
+        throw CoreException("Error in parameter fit: " + error);
+    }
+}
+
+FitResult LevenbergMarquardt::fit(const std::vector<double>& initial)
+{
+    if ((int)initial.size() != m)
+    {
+        throw CoreException("parameter fit needs an initial value for each parameter");
+    }
+
+    if (n == 0)
+    {
+        throw CoreException("there are no data points to fit");
+    }
+
+    std::vector<double> x(m);
+    for (int j = 0; j < m; ++j)
+    {
+        if (parameters[j].logScale && initial[j] <= 0)
+        {
+            throw CoreException("The log scaled parameter " + parameters[j].id
+                    + " must be positive");
+        }
+        x[j] = std::min(upper[j], std::max(lower[j], toInternal(j, initial[j])));
+    }
+
+    std::vector<double> r(n);
+    std::vector<double> rTrial(n);
+    std::vector<double> xTrial(m);
+    std::vector<double> jac(n * m);
+    std::vector<double> a(m * m);
+    std::vector<double> d(m * m);
+    std::vector<double> g(m);
+    std::vector<double> dx(m);
+    std::vector<long> pivots(m);
+
+    evaluations = 0;
+
+    double chi2 = evaluate(functions[0], x, r);
+    ++evaluations;
+
+    if (!(chi2 < std::numeric_limits<double>::infinity()))
+    {
+        throw CoreException("Could not evaluate the residuals at the initial "
+                "parameter values");
+    }
+
+    FitResult result;
+    result.converged = m == 0 || chi2 == 0;
+
+    double lambda = 1.e-3;
+    int iteration = 0;
+
+    for (; iteration < options.maxIterations && !result.converged; ++iteration)
+    {
+        jacobian(x, r, jac);
+
+        // normal equations J'J dx = -J'r
+        for (int k = 0; k < m; ++k)
+        {
+            const double *ck = &jac[k * n];
+            for (int l = 0; l <= k; ++l)
+            {
+                const double *cl = &jac[l * n];
+                double sum = 0;
+                for (int i = 0; i < n; ++i)
+                {
+                    sum += ck[i] * cl[i];
+                }
+                a[k * m + l] = sum;
+                a[l * m + k] = sum;
+            }
+
+            double sum = 0;
+            for (int i = 0; i < n; ++i)
+            {
+                sum += ck[i] * r[i];
+            }
+            g[k] = sum;
+        }
+
+        // increase the damping until a step decreases the sum of squares
+        bool accepted = false;
+
+        while (!accepted && lambda <= 1.e12)
+        {
+            d = a;
+            for (int j = 0; j < m; ++j)
+            {
+                d[j * m + j] += lambda * std::max(a[j * m + j], 1.e-12);
+            }
+
+            std::vector<double*> cols = columns(d, m);
+            if (denseGETRF(&cols[0], m, m, &pivots[0]) != 0)
+            {
+                lambda *= 10;
+                continue;
+            }
+
+            for (int j = 0; j < m; ++j)
+            {
+                dx[j] = -g[j];
+            }
+            denseGETRS(&cols[0], m, &pivots[0], &dx[0]);
+
+            double stepSize = 0;
+            for (int j = 0; j < m; ++j)
+            {
+                xTrial[j] = std::min(upper[j], std::max(lower[j], x[j] + dx[j]));
+                stepSize = std::max(stepSize, fabs(xTrial[j] - x[j])
+                        / (fabs(x[j]) + options.tolerance));
+            }
+
+            double chi2Trial = evaluate(functions[0], xTrial, rTrial);
+            ++evaluations;
+
+            if (chi2Trial < chi2)
+            {
+                accepted = true;
+
+                const double decrease = (chi2 - chi2Trial) / chi2;
+
+                x.swap(xTrial);
+                r.swap(rTrial);
+                chi2 = chi2Trial;
+                lambda = std::max(lambda / 10, 1.e-12);
+
+                result.converged = decrease < options.tolerance
+                        || stepSize < options.tolerance || chi2 == 0;
+            }
+            else
+            {
+                lambda *= 10;
+            }
+        }
+
+        if (!accepted)
+        {
+            // no step in the direction of steepest descent decreases the
+            // sum of squares, a minimum to the accuracy of the derivatives.
+            result.converged = true;
+        }
+    }
+
+    result.values.resize(m);
+    for (int j = 0; j < m; ++j)
+    {
+        result.values[j] = toExternal(j, x[j]);
+    }
+
+    result.chiSquare = chi2;
+    result.iterations = iteration;
+
+    // covariance from the Jacobian at the solution, s^2 (J'J)^-1
+    result.standardErrors.assign(m, std::numeric_limits<double>::quiet_NaN());
+
+    if (m)
+    {
+        jacobian(x, r, jac);
+
+        for (int k = 0; k < m; ++k)
+        {
+            for (int l = 0; l < m; ++l)
+            {
+                double sum = 0;
+                for (int i = 0; i < n; ++i)
+                {
+                    sum += jac[k * n + i] * jac[l * n + i];
+                }
+                a[l * m + k] = sum;
+            }
+        }
+
+        std::vector<double*> cols = columns(a, m);
+        if (denseGETRF(&cols[0], m, m, &pivots[0]) == 0)
+        {
+            const double s2 = chi2 / std::max(1, n - m);
+
+            for (int j = 0; j < m; ++j)
+            {
+                std::fill(dx.begin(), dx.end(), 0.0);
+                dx[j] = 1.0;
+                denseGETRS(&cols[0], m, &pivots[0], &dx[0]);
+
+                if (dx[j] >= 0)
+                {
+                    double se = sqrt(dx[j] * s2);
+                    result.standardErrors[j] = parameters[j].logScale ?
+                            result.values[j] * se : se;
+                }
+            }
+        }
+    }
+
+    result.evaluations = evaluations;
+
+    Log(Logger::LOG_NOTICE) << "Parameter fit " << (result.converged ?
+            "converged" : "did not converge") << " after " << iteration
+            << " iterations and " << evaluations << " evaluations, chi square "
+            << chi2;
+
+    return result;
+}
+
+/**
+ * evaluates the cost of every stride'th member, beginning with first, on
+ * its own residual function.
+ */
+class PopulationWorker : public Poco::Runnable
+{
+public:
+    PopulationWorker(DifferentialEvolution& de, ResidualFunction *function,
+            const std::vector<std::vector<double> >& x,
+            const std::vector<double>& limits, std::vector<double>& cost,
+            int first, int stride) :
+        de(de), function(function), x(x), limits(limits), cost(cost),
+        first(first), stride(stride)
+    {
+    }
+
+    virtual void run()
+    {
+        std::vector<double> p(de.m);
+
+        for (unsigned i = first; i < x.size(); i += stride)
+        {
+            for (int j = 0; j < de.m; ++j)
+            {
+                p[j] = toExternal(de.parameters[j], x[i][j]);
+            }
+
+            // a failed simulation is just a bad member
+            try
+            {
+                double c = function->sumOfSquares(p, limits[i]);
+                cost[i] = c < std::numeric_limits<double>::infinity() ? c :
+                        std::numeric_limits<double>::infinity();
+            }
+            catch (std::exception& e)
+            {
+                Log(Logger::LOG_INFORMATION) << "Residuals could not be "
+                        "evaluated: " << e.what();
+                cost[i] = std::numeric_limits<double>::infinity();
+            }
+            catch (...)
+            {
+                cost[i] = std::numeric_limits<double>::infinity();
+            }
+        }
+    }
+
+private:
+    DifferentialEvolution& de;
+    ResidualFunction *function;
+    const std::vector<std::vector<double> >& x;
+    const std::vector<double>& limits;
+    std::vector<double>& cost;
+    int first;
+    int stride;
+};
+
+DifferentialEvolution::DifferentialEvolution(
+        const std::vector<ResidualFunction*>& functions,
+        const std::vector<FitParameter>& parameters,
+        const GlobalFitOptions& options) :
+        functions(functions), parameters(parameters), options(options),
+        m(parameters.size()), pool(0)
+{
+    if (functions.empty())
+    {
+        throw CoreException("parameter fit needs at least one residual function");
+    }
+
+    for (int j = 0; j < m; ++j)
+    {
+        const FitParameter& p = parameters[j];
+
+        if (!(p.lower <= p.upper) || !(fabs(p.lower) < HUGE_VAL)
+                || !(fabs(p.upper) < HUGE_VAL))
+        {
+            throw CoreException("The global search needs finite bounds "
+                    "for " + p.id);
+        }
+
+        if (p.logScale && p.lower <= 0)
+        {
+            throw CoreException("The log scaled parameter " + p.id
+                    + " must have a positive lower bound");
+        }
+
+        lower.push_back(toInternal(p, p.lower));
+        upper.push_back(toInternal(p, p.upper));
+    }
+
+    pool = new WorkerPool(functions.size());
+}
+
+DifferentialEvolution::~DifferentialEvolution()
+{
+    delete pool;
+}
+
+void DifferentialEvolution::evaluate(const std::vector<std::vector<double> >& x,
+        const std::vector<double>& limits, std::vector<double>& cost)
+{
+    const int nThreads = std::max(1, std::min(pool->size(), (int)x.size()));
+
+    std::vector<PopulationWorker*> workers(nThreads);
+    for (int i = 0; i < nThreads; ++i)
+    {
+        workers[i] = new PopulationWorker(*this, functions[i], x, limits,
+                cost, i, nThreads);
+    }
+
+    try
+    {
+        pool->run(workers);
+    }
+    catch (...)
+    {
+        for (int i = 0; i < nThreads; ++i)
+        {
+            delete workers[i];
+        }
+        throw;
+    }
+
+    for (int i = 0; i < nThreads; ++i)
+    {
+        delete workers[i];
+    }
+}
+
+FitResult DifferentialEvolution::fit(const std::vector<double>& initial)
+{
+    if ((int)initial.size() != m)
+    {
+        throw CoreException("parameter fit needs an initial value for each parameter");
+    }
+
+    const int size = std::max(4, options.populationSize > 0 ?
+            options.populationSize : 10 * m);
+
+    PhiloxRandom random(options.seed);
+
+    std::vector<std::vector<double> > x(size, std::vector<double>(m));
+    std::vector<std::vector<double> > trials(size, std::vector<double>(m));
+    std::vector<double> cost(size);
+    std::vector<double> trialCost(size);
+    std::vector<double> limits(size, std::numeric_limits<double>::infinity());
+
+    for (int i = 0; i < size; ++i)
+    {
+        for (int j = 0; j < m; ++j)
+        {
+            x[i][j] = lower[j] + random.uniform() * (upper[j] - lower[j]);
+        }
+    }
+
+    // the initial point is a member, so the search is never worse than it
+    for (int j = 0; j < m; ++j)
+    {
+        if (!parameters[j].logScale || initial[j] > 0)
+        {
+            x[0][j] = std::min(upper[j], std::max(lower[j],
+                    toInternal(parameters[j], initial[j])));
+        }
+    }
+
+    evaluate(x, limits, cost);
+    int evaluations = size;
+
+    FitResult result;
+    result.converged = false;
+
+    int best = 0;
+    int generation = 0;
+
+    for (;; ++generation)
+    {
+        best = 0;
+        double worst = cost[0];
+        for (int i = 1; i < size; ++i)
+        {
+            best = cost[i] < cost[best] ? i : best;
+            worst = std::max(worst, cost[i]);
+        }
+
+        if (worst - cost[best] <= options.tolerance * cost[best])
+        {
+            result.converged = true;
+            break;
+        }
+
+        if (generation >= options.maxGenerations)
+        {
+            break;
+        }
+
+        for (int i = 0; i < size; ++i)
+        {
+            int r1, r2, r3;
+            do { r1 = (int)(random.uniform() * size); } while (r1 == i);
+            do { r2 = (int)(random.uniform() * size); } while (r2 == i || r2 == r1);
+            do { r3 = (int)(random.uniform() * size); } while (r3 == i || r3 == r1 || r3 == r2);
+
+            const int jrand = (int)(random.uniform() * m);
+
+            for (int j = 0; j < m; ++j)
+            {
+                double t = x[i][j];
+
+                if (random.uniform() < options.crossover || j == jrand)
+                {
+                    t = x[r1][j] + options.weight * (x[r2][j] - x[r3][j]);
+
+                    // half way back to the bound from the parent
+                    if (t < lower[j])
+                    {
+                        t = 0.5 * (x[i][j] + lower[j]);
+                    }
+                    else if (t > upper[j])
+                    {
+                        t = 0.5 * (x[i][j] + upper[j]);
+                    }
+                }
+
+                trials[i][j] = t;
+            }
+        }
+
+        // a trial only replaces its parent if it is no worse, so its
+        // simulation can stop once it is.
+        evaluate(trials, cost, trialCost);
+        evaluations += size;
+
+        for (int i = 0; i < size; ++i)
+        {
+            if (trialCost[i] <= cost[i])
+            {
+                x[i].swap(trials[i]);
+                cost[i] = trialCost[i];
+            }
+        }
+    }
+
+    result.values.resize(m);
+    for (int j = 0; j < m; ++j)
+    {
+        result.values[j] = toExternal(parameters[j], x[best][j]);
+    }
+    result.standardErrors.assign(m, std::numeric_limits<double>::quiet_NaN());
+    result.chiSquare = cost[best];
+    result.iterations = generation;
+
+    Log(Logger::LOG_NOTICE) << "Differential evolution " << (result.converged ?
+            "converged" : "did not converge") << " after " << generation
+            << " generations and " << evaluations << " evaluations, chi square "
+            << cost[best];
+
+    if (options.polish && m > 0 && cost[best] < std::numeric_limits<double>::infinity())
+    {
+        FitOptions local;
+        LevenbergMarquardt lm(functions, parameters, local);
+        FitResult polished = lm.fit(result.values);
+        evaluations += polished.evaluations;
+
+        // the standard errors are only valid at the polished point
+        if (polished.chiSquare <= result.chiSquare)
+        {
+            result.values = polished.values;
+            result.chiSquare = polished.chiSquare;
+            result.standardErrors = polished.standardErrors;
+        }
+    }
+
+    result.evaluations = evaluations;
+
+    return result;
+}
+
+} /* namespace rr */
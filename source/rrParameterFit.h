@@ -0,0 +1,326 @@
+#ifndef RRPARAMETERFIT_H_
+#define RRPARAMETERFIT_H_
+
+#include "rrOSSpecifics.h"
+
+#include <string>
+#include <vector>
+
+namespace rr
+{
+
+class WorkerPool;
+
+/**
+ * A global parameter to be estimated by RoadRunner::fitParameters, with
+ * optional bounds.
+ */
+struct RR_DECLSPEC FitParameter
+{
+    /**
+     * an unbounded parameter, the bounds are -HUGE_VAL and HUGE_VAL.
+     */
+    FitParameter(const std::string& id = "");
+
+    FitParameter(const std::string& id, double lower, double upper,
+            bool logScale = false);
+
+    std::string id;
+    double lower;
+    double upper;
+
+    /**
+     * estimate the log of the parameter, for positive parameters which
+     * span orders of magnitude. The parameter and its lower bound, if it
+     * is finite, must then be positive.
+     */
+    bool logScale;
+};
+
+/**
+ * Options for RoadRunner::fitParameters.
+ */
+struct RR_DECLSPEC FitOptions
+{
+    /**
+     * initializes the struct with the default options.
+     */
+    FitOptions();
+
+    /**
+     * maximum number of Levenberg-Marquardt iterations, each of which
+     * computes one Jacobian.
+     */
+    int maxIterations;
+
+    /**
+     * the fit has converged when the relative decrease of the sum of
+     * squares, or the relative size of the step, is below tolerance.
+     */
+    double tolerance;
+
+    /**
+     * relative finite difference step, an absolute step for log scaled
+     * parameters.
+     */
+    double differenceStep;
+
+    /**
+     * number of threads the residuals are evaluated on, one per processor
+     * if <= 0.
+     */
+    int nThreads;
+};
+
+/**
+ * Options for RoadRunner::globalFitParameters.
+ */
+struct RR_DECLSPEC GlobalFitOptions
+{
+    /**
+     * initializes the struct with the default options.
+     */
+    GlobalFitOptions();
+
+    /**
+     * number of members of the population, ten per parameter if <= 0.
+     */
+    int populationSize;
+
+    int maxGenerations;
+
+    /**
+     * differential weight and crossover probability of the
+     * DE/rand/1/bin scheme.
+     */
+    double weight;
+    double crossover;
+
+    unsigned long seed;
+
+    /**
+     * the search has converged when the spread of the costs in the
+     * population is below tolerance times the best cost.
+     */
+    double tolerance;
+
+    /**
+     * refine the best member with a Levenberg-Marquardt fit, which also
+     * gives the standard errors.
+     */
+    bool polish;
+
+    /**
+     * number of threads the population is evaluated on, one per processor
+     * if <= 0.
+     */
+    int nThreads;
+};
+
+/**
+ * The result of RoadRunner::fitParameters and globalFitParameters.
+ */
+struct RR_DECLSPEC FitResult
+{
+    /**
+     * the estimated parameters, in the order they were given.
+     */
+    std::vector<double> values;
+
+    /**
+     * asymptotic standard errors from the Jacobian at the solution, NaN if
+     * a parameter is not identifiable from the data.
+     */
+    std::vector<double> standardErrors;
+
+    /**
+     * sum of the squared weighted residuals.
+     */
+    double chiSquare;
+
+    int iterations;
+
+    /**
+     * number of times the residuals were evaluated, including the
+     * finite differences.
+     */
+    int evaluations;
+
+    bool converged;
+};
+
+/**
+ * @internal
+ * The residuals of a model with a given set of parameter values.
+ *
+ * Each thread of the fit has its own instance, so an implementation only
+ * has to be safe to use at the same time as the other instances.
+ */
+class ResidualFunction
+{
+public:
+    virtual ~ResidualFunction() {};
+
+    /**
+     * the number of residuals.
+     */
+    virtual int size() const = 0;
+
+    /**
+     * evaluate the residuals at the parameter values p into residuals,
+     * which has room for size() values.
+     */
+    virtual void evaluate(const std::vector<double>& p, double *residuals) = 0;
+
+    /**
+     * the sum of the squared residuals at p. An implementation may stop as
+     * soon as the partial sum is larger than limit, and return the
+     * partial sum.
+     */
+    virtual double sumOfSquares(const std::vector<double>& p, double limit);
+};
+
+/**
+ * @internal
+ * Levenberg-Marquardt least squares fit with bounds and log scaling.
+ *
+ * The parameters are transformed to log space if they are log scaled, and
+ * steps are projected onto the bounds. The forward difference Jacobian
+ * columns are independent, so they are distributed over the residual
+ * functions, one thread each. The trial steps are evaluated one at a time
+ * on the first function, so the result does not depend on the number of
+ * threads.
+ */
+class LevenbergMarquardt
+{
+public:
+    /**
+     * the functions are not owned, there must be at least one.
+     */
+    LevenbergMarquardt(const std::vector<ResidualFunction*>& functions,
+            const std::vector<FitParameter>& parameters,
+            const FitOptions& options);
+
+    ~LevenbergMarquardt();
+
+    /**
+     * fit from the initial parameter values.
+     */
+    FitResult fit(const std::vector<double>& initial);
+
+private:
+    std::vector<ResidualFunction*> functions;
+    std::vector<FitParameter> parameters;
+    FitOptions options;
+
+    /**
+     * number of parameters and residuals.
+     */
+    int m;
+    int n;
+
+    /**
+     * bounds of the internal, possibly log scaled, parameters.
+     */
+    std::vector<double> lower;
+    std::vector<double> upper;
+
+    int evaluations;
+
+    /**
+     * runs the jacobian columns on the residual functions, the threads
+     * are re-used by every iteration.
+     */
+    WorkerPool *pool;
+
+    double toInternal(int j, double p) const;
+    double toExternal(int j, double x) const;
+
+    /**
+     * evaluate the residuals at the internal parameters x on the given
+     * function, returns the sum of squares, or infinity if the residuals
+     * could not be evaluated or are not finite.
+     */
+    double evaluate(ResidualFunction *f, const std::vector<double>& x,
+            std::vector<double>& r);
+
+    /**
+     * forward difference Jacobian at x, whose residuals are r, column major
+     * n x m into jac, on all the functions.
+     */
+    void jacobian(const std::vector<double>& x, const std::vector<double>& r,
+            std::vector<double>& jac);
+
+    friend class JacobianWorker;
+
+    // not copyable
+    LevenbergMarquardt(const LevenbergMarquardt&);
+    LevenbergMarquardt& operator=(const LevenbergMarquardt&);
+};
+
+/**
+ * @internal
+ * Differential evolution, DE/rand/1/bin, global search within the bounds of
+ * the parameters, which must all be finite.
+ *
+ * The first member of the population is the initial point, the others are
+ * uniformly distributed within the bounds, in log space for log scaled
+ * parameters. Each generation, a trial is built for every member, and
+ * replaces it if its cost is not larger. The trials are evaluated in
+ * parallel, one thread per residual function, and a trial simulation is
+ * stopped as soon as its partial cost exceeds the cost of the member it
+ * competes with, as it would be rejected anyway.
+ *
+ * The random numbers are drawn on the calling thread, so the result does
+ * not depend on the number of threads.
+ */
+class DifferentialEvolution
+{
+public:
+    /**
+     * the functions are not owned, there must be at least one.
+     */
+    DifferentialEvolution(const std::vector<ResidualFunction*>& functions,
+            const std::vector<FitParameter>& parameters,
+            const GlobalFitOptions& options);
+
+    ~DifferentialEvolution();
+
+    /**
+     * search from the initial parameter values, followed by a local fit
+     * if the options ask for it.
+     */
+    FitResult fit(const std::vector<double>& initial);
+
+private:
+    std::vector<ResidualFunction*> functions;
+    std::vector<FitParameter> parameters;
+    GlobalFitOptions options;
+    int m;
+
+    std::vector<double> lower;
+    std::vector<double> upper;
+
+    /**
+     * runs the population evaluations on the residual functions, the
+     * threads are re-used by every generation.
+     */
+    WorkerPool *pool;
+
+    /**
+     * evaluate the rows of x, the internal parameters, into cost, with
+     * each evaluation stopped at its limit.
+     */
+    void evaluate(const std::vector<std::vector<double> >& x,
+            const std::vector<double>& limits, std::vector<double>& cost);
+
+    friend class PopulationWorker;
+
+    // not copyable
+    DifferentialEvolution(const DifferentialEvolution&);
+    DifferentialEvolution& operator=(const DifferentialEvolution&);
+};
+
+} /* namespace rr */
+
+#endif /* RRPARAMETERFIT_H_ */
@@ -0,0 +1,87 @@
+#pragma hdrstop
+#include "rrPhiloxRandom.h"
+#include "rrRoadRunnerOptions.h"
+
+#include <Poco/Timestamp.h>
+
+namespace rr
+{
+
+static const uint32_t PHILOX_M0 = 0xD2511F53;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57;
+static const uint32_t PHILOX_W0 = 0x9E3779B9;
+static const uint32_t PHILOX_W1 = 0xBB67AE85;
+
+static inline void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo)
+{
+    uint64_t p = (uint64_t)a * (uint64_t)b;
+    hi = (uint32_t)(p >> 32);
+    lo = (uint32_t)p;
+}
+
+PhiloxRandom::PhiloxRandom(uint64_t s, uint64_t stream)
+{
+    seed(s, stream);
+}
+
+void PhiloxRandom::seed(uint64_t s, uint64_t stream)
+{
+    key[0] = (uint32_t)s;
+    key[1] = (uint32_t)(s >> 32);
+    counter[0] = 0;
+    counter[1] = 0;
+    counter[2] = (uint32_t)stream;
+    counter[3] = (uint32_t)(stream >> 32);
+
+    // generate on first use
+    index = 4;
+}
+
+void PhiloxRandom::seed(const SimulateOptions& options)
+{
+    uint64_t s = options.hasKey("seed") ?
+            (uint64_t)options.getValue("seed").convert<long>() : timeSeed();
+    uint64_t stream = options.hasKey("trajectory") ?
+            (uint64_t)options.getValue("trajectory").convert<long>() : 0;
+    seed(s, stream);
+}
+
+void PhiloxRandom::generate()
+{
+    uint32_t ctr[4] = {counter[0], counter[1], counter[2], counter[3]};
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (int round = 0; round < 10; ++round)
+    {
+        uint32_t hi0, lo0, hi1, lo1;
+        mulhilo(PHILOX_M0, ctr[0], hi0, lo0);
+        mulhilo(PHILOX_M1, ctr[2], hi1, lo1);
+
+        ctr[0] = hi1 ^ ctr[1] ^ k0;
+        ctr[1] = lo1;
+        ctr[2] = hi0 ^ ctr[3] ^ k1;
+        ctr[3] = lo0;
+
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    output[0] = ctr[0];
+    output[1] = ctr[1];
+    output[2] = ctr[2];
+    output[3] = ctr[3];
+    index = 0;
+
+    // 64 bit block counter, the upper half of the counter is the stream.
+    if (++counter[0] == 0)
+    {
+        ++counter[1];
+    }
+}
+
+uint64_t PhiloxRandom::timeSeed()
+{
+    return (uint64_t)Poco::Timestamp().epochMicroseconds();
+}
+
+} /* namespace rr */
@@ -0,0 +1,94 @@
+#ifndef RRPHILOXRANDOM_H_
+#define RRPHILOXRANDOM_H_
+
+#include "rrOSSpecifics.h"
+
+#if defined(_MSC_VER)
+#include "msc_stdint.h"
+#else
+#include <stdint.h>
+#endif
+
+namespace rr
+{
+
+class SimulateOptions;
+
+/**
+ * Counter based random number generator, the Philox4x32-10 generator of
+ * Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC11.
+ *
+ * Each output block is a pure function of a key, the seed, and a counter,
+ * so there is no shared state between generators. The counter is split
+ * into a block counter and a stream number, so every (seed, stream) pair
+ * is an independent sequence. The stochastic integrators use the
+ * trajectory index as the stream, so a given trajectory produces the
+ * same numbers regardless of which thread runs it, or in which order.
+ */
+class RR_DECLSPEC PhiloxRandom
+{
+public:
+
+    /**
+     * create a generator for the given seed and stream.
+     */
+    PhiloxRandom(uint64_t seed = 0, uint64_t stream = 0);
+
+    /**
+     * restart the generator at the beginning of the given
+     * seed and stream.
+     */
+    void seed(uint64_t seed, uint64_t stream = 0);
+
+    /**
+     * seed from the "seed" and "trajectory" keys of the simulate options.
+     * The trajectory is used as the stream number, and defaults to zero.
+     * If there is no seed key, the generator is seeded from the current
+     * time, so each run is different.
+     */
+    void seed(const SimulateOptions& options);
+
+    /**
+     * next 32 random bits.
+     */
+    uint32_t next()
+    {
+        if (index >= 4)
+        {
+            generate();
+        }
+        return output[index++];
+    }
+
+    /**
+     * uniform random number in the open interval (0, 1), with
+     * 53 bits of randomness.
+     */
+    double uniform()
+    {
+        uint32_t a = next() >> 5;
+        uint32_t b = next() >> 6;
+        return (a * 67108864.0 + b + 0.5) / 9007199254740992.0;
+    }
+
+    /**
+     * a seed derived from the current time, for when no seed is given.
+     */
+    static uint64_t timeSeed();
+
+private:
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t output[4];
+    unsigned index;
+
+    /**
+     * fill the output block from the current counter, and
+     * increment the block counter.
+     */
+    void generate();
+};
+
+} /* namespace rr */
+
+#endif /* RRPHILOXRANDOM_H_ */
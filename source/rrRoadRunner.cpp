@@ -24,15 +24,26 @@
 #include "rrNLEQInterface.h"
 #include "rrSBMLReader.h"
 #include "rrConfig.h"
+#include "rrEnsembleStatistics.h"
+#include "rrTransferFunction.h"
+#include "rrPhiloxRandom.h"
+#include "rrWorkerPool.h"
+#include "conservation/SparseStructuralAnalysis.h"
+
+#include <sundials/sundials_dense.h>
 
 #include <sbml/conversion/SBMLLocalParameterConverter.h>
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <math.h>
 #include <assert.h>
 #include <rr-libstruct/lsLibStructural.h>
 #include <Poco/File.h>
 #include <Poco/Mutex.h>
+#include <Poco/Runnable.h>
+#include <Poco/Environment.h>
 #include <list>
 
 
@@ -167,11 +178,34 @@ public:
 
     std::string mCurrentSBML;
 
+    /**
+     * the model generator options the current model was created with,
+     * used to create additional copies of the model, i.e. for ensembles.
+     */
+    uint32_t modelGeneratorOpt;
+
+    /**
+     * the model library the current model was loaded from, empty if it
+     * was created from mCurrentSBML.
+     */
+    std::string modelLibraryPath;
+
     /**
      * structural analysis library.
      */
     LibStructural* mLS;
 
+    /**
+     * sparse structural analysis, used instead of mLS for the structural
+     * matrices of large models. Created on demand by getSparseStructural.
+     */
+    conservation::SparseStructuralAnalysis* mSparseLS;
+
+    /**
+     * has the current sbml been checked for the sparse analysis.
+     */
+    bool mSparseLSChecked;
+
     /**
      * options that are specific to the simulation
      */
@@ -207,6 +241,20 @@ public:
     std::string configurationXML;
 
 
+    /**
+     * unscaled concentration and flux response coefficients at the last
+     * steady state, the columns are all of the global parameters followed
+     * by all of the boundary species.
+     */
+    ls::DoubleMatrix concentrationResponse;
+    ls::DoubleMatrix fluxResponse;
+
+    /**
+     * the model values the response coefficients were computed with, they
+     * are valid as long as getResponseKey returns the same values.
+     */
+    std::vector<double> responseKey;
+
     friend class aFinalizer;
 
 
@@ -224,7 +272,11 @@ public:
                 mSteadyStateSelection(),
                 model(0),
                 mCurrentSBML(),
+                modelGeneratorOpt(0),
+                modelLibraryPath(),
                 mLS(0),
+                mSparseLS(0),
+                mSparseLSChecked(false),
                 simulateOpt(),
                 mInstanceID(0),
                 dirtySimulateOptions(true)
@@ -246,7 +298,11 @@ public:
                 mSteadyStateSelection(),
                 model(0),
                 mCurrentSBML(),
+                modelGeneratorOpt(0),
+                modelLibraryPath(),
                 mLS(0),
+                mSparseLS(0),
+                mSparseLSChecked(false),
                 simulateOpt(),
                 mInstanceID(0),
                 dirtySimulateOptions(true)
@@ -261,9 +317,48 @@ public:
         delete model;
         delete integrator;
         delete mLS;
+        delete mSparseLS;
         mInstanceCount--;
     }
 
+    /**
+     * create another instance of the current model, from the same source
+     * as the current model, for the workers of ensembles, steady state
+     * searches and parameter fits. The new model is at its initial state.
+     */
+    ExecutableModel *createModelCopy()
+    {
+        ExecutableModel *copy = 0;
+
+        if (!modelLibraryPath.empty())
+        {
+            copy = ModelGenerator::loadModelLibrary(modelLibraryPath, 0, 0);
+        }
+        else if (!mCurrentSBML.empty())
+        {
+            copy = mModelGenerator->createModel(mCurrentSBML,
+                    modelGeneratorOpt & ~LoadSBMLOptions::RECOMPILE);
+        }
+        else
+        {
+            throw CoreException("The current model has no source to create "
+                    "more instances of it from");
+        }
+
+        // i.e. the library file was replaced since it was loaded
+        if (copy->getModelName() != model->getModelName()
+                || copy->getNumFloatingSpecies() != model->getNumFloatingSpecies()
+                || copy->getNumGlobalParameters() != model->getNumGlobalParameters()
+                || copy->getNumConservedMoieties() != model->getNumConservedMoieties())
+        {
+            delete copy;
+            throw CoreException("The source of the current model no longer "
+                    "describes it, can not create more instances of it");
+        }
+
+        return copy;
+    }
+
 
 
     void setParameterValue(const ParameterType parameterType,
@@ -340,6 +435,152 @@ public:
         return 0;
     }
 
+    /**
+     * the values which determine the steady state and the response
+     * coefficients at it, including the stoichiometry, which can be
+     * changed with setValue.
+     */
+    std::vector<double> getResponseKey()
+    {
+        int numGlobalParameters = model->getNumGlobalParameters();
+        int numBoundarySpecies = model->getNumBoundarySpecies();
+        int numCompartments = model->getNumCompartments();
+        int numFloatingSpecies = model->getNumFloatingSpecies();
+        int numReactions = model->getNumReactions();
+
+        std::vector<double> key(numGlobalParameters + numBoundarySpecies +
+                numCompartments + numFloatingSpecies +
+                numFloatingSpecies * numReactions + 1, 0.0);
+        double *p = &key[0];
+
+        model->getGlobalParameterValues(numGlobalParameters, 0, p);
+        p += numGlobalParameters;
+        model->getBoundarySpeciesConcentrations(numBoundarySpecies, 0, p);
+        p += numBoundarySpecies;
+        model->getCompartmentVolumes(numCompartments, 0, p);
+        p += numCompartments;
+        model->getFloatingSpeciesAmounts(numFloatingSpecies, 0, p);
+        p += numFloatingSpecies;
+
+        for (int i = 0; i < numFloatingSpecies; i++)
+        {
+            for (int j = 0; j < numReactions; j++)
+            {
+                *p++ = model->getStoichiometry(i, j);
+            }
+        }
+
+        return key;
+    }
+
+    /**
+     * unscaled elasticities of all the reaction rates with respect to the
+     * given parameters, one column per parameter. All the rates are
+     * evaluated together for each perturbation of a parameter. The column
+     * of a parameter which can not be set, i.e. is defined by a rule, is NaN.
+     */
+    ls::DoubleMatrix getUnscaledParameterElasticities(
+            const std::vector<ParameterType>& parameterTypes,
+            const std::vector<int>& parameterIndices)
+    {
+        const int numReactions = model->getNumReactions();
+        const int numParameters = parameterTypes.size();
+
+        ls::DoubleMatrix uelastParam(numReactions, numParameters);
+        std::vector<double> fi(numReactions + 1), fi2(numReactions + 1);
+        std::vector<double> fd(numReactions + 1), fd2(numReactions + 1);
+
+        for (int j = 0; numReactions && j < numParameters; j++)
+        {
+            ParameterType parameterType = parameterTypes[j];
+            int parameterIndex = parameterIndices[j];
+            double originalParameterValue = getParameterValue(parameterType, parameterIndex);
+
+            double hstep = mDiffStepSize*originalParameterValue;
+            if (fabs(hstep) < 1E-12)
+            {
+                hstep = mDiffStepSize;
+            }
+
+            try
+            {
+                setParameterValue(parameterType, parameterIndex, originalParameterValue + hstep);
+                model->getReactionRates(numReactions, 0, &fi[0]);
+
+                setParameterValue(parameterType, parameterIndex, originalParameterValue + 2*hstep);
+                model->getReactionRates(numReactions, 0, &fi2[0]);
+
+                setParameterValue(parameterType, parameterIndex, originalParameterValue - hstep);
+                model->getReactionRates(numReactions, 0, &fd[0]);
+
+                setParameterValue(parameterType, parameterIndex, originalParameterValue - 2*hstep);
+                model->getReactionRates(numReactions, 0, &fd2[0]);
+
+                setParameterValue(parameterType, parameterIndex, originalParameterValue);
+
+                for (int i = 0; i < numReactions; i++)
+                {
+                    uelastParam[i][j] = 1/(12*hstep)*((fd2[i] + 8*fi[i]) - (8*fd[i] + fi2[i]));
+                }
+            }
+            catch (const std::exception&)
+            {
+                // not settable, only this column is unknown
+                try
+                {
+                    setParameterValue(parameterType, parameterIndex, originalParameterValue);
+                }
+                catch (const std::exception&)
+                {
+                }
+
+                for (int i = 0; i < numReactions; i++)
+                {
+                    uelastParam[i][j] = std::numeric_limits<double>::quiet_NaN();
+                }
+            }
+        }
+
+        return uelastParam;
+    }
+
+    /**
+     * the sparse structural analysis of the current sbml, or NULL if the
+     * model is small enough for LibStructural.
+     */
+    conservation::SparseStructuralAnalysis* getSparseStructural()
+    {
+        Mutex::ScopedLock lock(roadRunnerMutex);
+
+        if (!mSparseLSChecked && !mCurrentSBML.empty())
+        {
+            libsbml::SBMLDocument *doc = libsbml::readSBMLFromString(mCurrentSBML.c_str());
+
+            if (conservation::SparseStructuralAnalysis::isSparseModel(doc->getModel()))
+            {
+                mSparseLS = new conservation::SparseStructuralAnalysis(doc->getModel());
+            }
+
+            delete doc;
+            mSparseLSChecked = true;
+        }
+
+        return mSparseLS;
+    }
+
+    /**
+     * discard the structural analyses of the previous sbml.
+     */
+    void clearStructural()
+    {
+        Mutex::ScopedLock lock(roadRunnerMutex);
+        delete mLS;
+        delete mSparseLS;
+        mLS = 0;
+        mSparseLS = 0;
+        mSparseLSChecked = false;
+    }
+
     // Changes a given parameter type by the given increment
     void changeParameter(ParameterType parameterType, int reactionIndex, int parameterIndex,
                                         double originalValue, double increment)
@@ -479,6 +720,21 @@ string RoadRunner::getExtendedVersionInfo()
     return info.str();
 }
 
+unsigned long RoadRunner::getModelCacheHits()
+{
+    return ModelGenerator::getModelCacheHits();
+}
+
+unsigned long RoadRunner::getModelCacheMisses()
+{
+    return ModelGenerator::getModelCacheMisses();
+}
+
+void RoadRunner::purgeModelCache()
+{
+    ModelGenerator::purgeModelCache();
+}
+
 
 
 LibStructural* RoadRunner::getLibStruct()
@@ -642,64 +898,105 @@ RoadRunnerData *RoadRunner::getSimulationResult()
 }
 
 
-double RoadRunner::getValue(const SelectionRecord& record)
+/**
+ * get the value of a selection that only depends on the model state,
+ * i.e. everything except the MCA and eigenvalue selections.
+ *
+ * @returns false if the selection needs the RoadRunner object.
+ */
+static bool getModelValue(ExecutableModel *model, const SelectionRecord& record,
+        double& dResult)
 {
-    if (!impl->model)
-    {
-        throw CoreException(gEmptyModelMessage);
-    }
-
-    double dResult;
-
     switch (record.selectionType)
     {
     case SelectionRecord::FLOATING_CONCENTRATION:
 
         dResult = 0;
-        impl->model->getFloatingSpeciesConcentrations(1, &record.index, &dResult);
+        model->getFloatingSpeciesConcentrations(1, &record.index, &dResult);
         break;
 
     case SelectionRecord::BOUNDARY_CONCENTRATION:
-        impl->model->getBoundarySpeciesConcentrations(1, &record.index, &dResult);
+        model->getBoundarySpeciesConcentrations(1, &record.index, &dResult);
         break;
 
     case SelectionRecord::REACTION_RATE:
         dResult = 0;
-        impl->model->getReactionRates(1, &record.index, &dResult);
+        model->getReactionRates(1, &record.index, &dResult);
         break;
 
     case SelectionRecord::FLOATING_AMOUNT_RATE:
         dResult = 0;
-        impl->model->computeAllRatesOfChange();
-        impl->model->getFloatingSpeciesAmountRates(1, &record.index, &dResult);
+        model->computeAllRatesOfChange();
+        model->getFloatingSpeciesAmountRates(1, &record.index, &dResult);
         break;
 
     case SelectionRecord::COMPARTMENT:
-        impl->model->getCompartmentVolumes(1, &record.index, &dResult);
+        model->getCompartmentVolumes(1, &record.index, &dResult);
         break;
 
     case SelectionRecord::GLOBAL_PARAMETER:
     {
-        if (record.index > ((impl->model->getNumGlobalParameters()) - 1))
+        if (record.index > ((model->getNumGlobalParameters()) - 1))
         {
-            int index = record.index - impl->model->getNumGlobalParameters();
-            impl->model->getConservedMoietyValues(1, &index, &dResult);
+            int index = record.index - model->getNumGlobalParameters();
+            model->getConservedMoietyValues(1, &index, &dResult);
         }
         else
         {
-            impl->model->getGlobalParameterValues(1, &record.index, &dResult);
+            model->getGlobalParameterValues(1, &record.index, &dResult);
         }
     }
     break;
 
     case SelectionRecord::FLOATING_AMOUNT:
-        impl->model->getFloatingSpeciesAmounts(1, &record.index, &dResult);
+        model->getFloatingSpeciesAmounts(1, &record.index, &dResult);
         break;
 
     case SelectionRecord::BOUNDARY_AMOUNT:
-        impl->model->getBoundarySpeciesAmounts(1, &record.index, &dResult);
+        model->getBoundarySpeciesAmounts(1, &record.index, &dResult);
+        break;
+
+    case SelectionRecord::ELASTICITY:
+    case SelectionRecord::UNSCALED_ELASTICITY:
+    case SelectionRecord::CONTROL:
+    case SelectionRecord::UNSCALED_CONTROL:
+    case SelectionRecord::EIGENVALUE:
+        return false;
+
+    case SelectionRecord::INITIAL_CONCENTRATION:
+        model->getFloatingSpeciesInitConcentrations(1, &record.index, &dResult);
+        break;
+    case SelectionRecord::STOICHIOMETRY:
+    {
+        int speciesIndex = model->getFloatingSpeciesIndex(record.p1);
+        int reactionIndex = model->getReactionIndex(record.p2);
+        dResult = model->getStoichiometry(speciesIndex, reactionIndex);
+    }
+        break;
+
+    default:
+        dResult = 0.0;
         break;
+    }
+    return true;
+}
+
+double RoadRunner::getValue(const SelectionRecord& record)
+{
+    if (!impl->model)
+    {
+        throw CoreException(gEmptyModelMessage);
+    }
 
+    double dResult;
+
+    if (getModelValue(impl->model, record, dResult))
+    {
+        return dResult;
+    }
+
+    switch (record.selectionType)
+    {
     case SelectionRecord::ELASTICITY:
         dResult = getEE(record.p1, record.p2, false);
         break;
@@ -745,16 +1042,6 @@ double RoadRunner::getValue(const SelectionRecord& record)
         return std::numeric_limits<double>::quiet_NaN();
     }
     break;
-    case SelectionRecord::INITIAL_CONCENTRATION:
-        impl->model->getFloatingSpeciesInitConcentrations(1, &record.index, &dResult);
-        break;
-    case SelectionRecord::STOICHIOMETRY:
-    {
-        int speciesIndex = impl->model->getFloatingSpeciesIndex(record.p1);
-        int reactionIndex = impl->model->getReactionIndex(record.p2);
-        return impl->model->getStoichiometry(speciesIndex, reactionIndex);
-    }
-        break;
 
     default:
         dResult = 0.0;
@@ -802,6 +1089,10 @@ void RoadRunner::getSelectedValues(std::vector<double>& results,
 
 vector<double> RoadRunner::getConservedMoietyValues()
 {
+    if (conservation::SparseStructuralAnalysis *sparse = impl->getSparseStructural())
+    {
+        return sparse->getConservedSums();
+    }
     return getLibStruct()->getConservedSums();
 }
 
@@ -809,7 +1100,62 @@ void RoadRunner::load(const string& uriOrSbml, const LoadSBMLOptions *options)
 {
     Mutex::ScopedLock lock(roadRunnerMutex);
 
+    loadSBML(uriOrSbml, options);
+
+    //Finally intitilaize the model..
+    createIntegrator();
+
+    if (!options || !(options->loadFlags & LoadSBMLOptions::NO_DEFAULT_SELECTIONS))
+    {
+        createDefaultSelectionLists();
+    }
+}
+
+void RoadRunner::loadModelLibrary(const string& path, const LoadSBMLOptions *options)
+{
+    Mutex::ScopedLock lock(roadRunnerMutex);
+
+    Log(lDebug)<<"Loading model library " << path;
+
+    delete impl->model;
+    impl->model = 0;
+    impl->responseKey.clear();
+    impl->clearStructural();
+
+    unsigned libraryOpt = 0;
+    impl->modelLibraryPath.clear();
+    impl->model = ModelGenerator::loadModelLibrary(path,
+            &impl->mCurrentSBML, &libraryOpt);
+    impl->modelLibraryPath = path;
+
+    // these have no effect on a compiled library
+    const unsigned ignoredOpt = LoadSBMLOptions::RECOMPILE | LoadSBMLOptions::COMPACT;
+
+    if (options && (options->modelGeneratorOpt & ~ignoredOpt) != (libraryOpt & ~ignoredOpt))
+    {
+        Log(Logger::LOG_WARNING) << "The model library " << path << " was compiled "
+                << "with different options, the model is created with the options "
+                << "of the library, " << libraryOpt << ", instead of "
+                << options->modelGeneratorOpt;
+    }
+
+    impl->modelGeneratorOpt = libraryOpt;
+    impl->conservedMoietyAnalysis = libraryOpt
+            & LoadSBMLOptions::CONSERVED_MOIETIES;
+
+    //Finally intitilaize the model..
+    createIntegrator();
+
+    if (!options || !(options->loadFlags & LoadSBMLOptions::NO_DEFAULT_SELECTIONS))
+    {
+        createDefaultSelectionLists();
+    }
+}
+
+void RoadRunner::loadSBML(const string& uriOrSbml, const LoadSBMLOptions *options)
+{
     impl->mCurrentSBML = SBMLReader::read(uriOrSbml);
+    impl->modelLibraryPath.clear();
 
     //clear temp folder of roadrunner generated files, only if roadRunner instance == 1
     Log(lDebug)<<"Loading SBML into simulator";
@@ -820,11 +1166,14 @@ void RoadRunner::load(const string& uriOrSbml, const LoadSBMLOptions *options)
 
     delete impl->model;
     impl->model = 0;
+    impl->responseKey.clear();
+    impl->clearStructural();
 
     if (options)
     {
         impl->conservedMoietyAnalysis = options->modelGeneratorOpt
                 & LoadSBMLOptions::CONSERVED_MOIETIES;
+        impl->modelGeneratorOpt = options->modelGeneratorOpt;
         impl->model = impl->mModelGenerator->createModel(impl->mCurrentSBML, options->modelGeneratorOpt);
     }
     else
@@ -833,16 +1182,20 @@ void RoadRunner::load(const string& uriOrSbml, const LoadSBMLOptions *options)
         opt.modelGeneratorOpt = getConservedMoietyAnalysis() ?
                 opt.modelGeneratorOpt | LoadSBMLOptions::CONSERVED_MOIETIES :
                 opt.modelGeneratorOpt & ~LoadSBMLOptions::CONSERVED_MOIETIES;
+        impl->modelGeneratorOpt = opt.modelGeneratorOpt;
         impl->model = impl->mModelGenerator->createModel(impl->mCurrentSBML, opt.modelGeneratorOpt);
     }
+}
 
-    //Finally intitilaize the model..
-    createIntegrator();
-
-    if (!options || !(options->loadFlags & LoadSBMLOptions::NO_DEFAULT_SELECTIONS))
+void RoadRunner::compileModelLibrary(const string& path)
+{
+    if (!impl->model)
     {
-        createDefaultSelectionLists();
+        throw CoreException(gEmptyModelMessage);
     }
+
+    ModelGenerator::compileModelLibrary(impl->mCurrentSBML,
+            impl->modelGeneratorOpt, path);
 }
 
 bool RoadRunner::createDefaultSelectionLists()
@@ -881,6 +1234,7 @@ bool RoadRunner::unLoadModel()
     {
         delete impl->model;
         impl->model = NULL;
+        impl->responseKey.clear();
         return true;
     }
     return false;
@@ -907,82 +1261,202 @@ void RoadRunner::reset()
     }
 }
 
-bool RoadRunner::populateResult()
-{
-    vector<string> list(impl->mSelectionList.size());
+/**
+ * saved state file header, the format version is incremented whenever the
+ * layout of the saved model state changes.
+ */
+static const char stateMagic[4] = {'R', 'R', 'S', 'T'};
+static const unsigned stateVersion = 1;
 
-    for(int i = 0; i < impl->mSelectionList.size(); ++i)
+void RoadRunner::saveState(std::ostream& out)
+{
+    if (!impl->model)
     {
-        list[i] = impl->mSelectionList[i].to_string();
+        throw CoreException(gEmptyModelMessage);
     }
 
-    impl->mRoadRunnerData.setColumnNames(list);
-    impl->mRoadRunnerData.setData(impl->simulationResult);
-    return true;
-}
+    string name = impl->model->getModelName();
+    unsigned nameSize = name.size();
 
+    out.write(stateMagic, sizeof(stateMagic));
+    out.write((const char*)&stateVersion, sizeof(stateVersion));
+    out.write((const char*)&nameSize, sizeof(nameSize));
+    out.write(name.c_str(), nameSize);
 
-std::vector<rr::SelectionRecord>& RoadRunner::getSelections()
-{
-    return impl->mSelectionList;
+    impl->model->saveState(out);
 }
 
-
-double RoadRunner::steadyState()
+void RoadRunner::loadState(std::istream& in)
 {
     if (!impl->model)
     {
         throw CoreException(gEmptyModelMessage);
     }
 
-    if (!impl->conservedMoietyAnalysis &&
-            (Config::getBool(Config::ROADRUNNER_DISABLE_WARNINGS)
-                & Config::ROADRUNNER_DISABLE_WARNINGS_STEADYSTATE) == 0)
+    char magic[sizeof(stateMagic)] = {0};
+    unsigned version = 0;
+    unsigned nameSize = 0;
+
+    in.read(magic, sizeof(magic));
+    in.read((char*)&version, sizeof(version));
+    in.read((char*)&nameSize, sizeof(nameSize));
+
+    if (!in || memcmp(magic, stateMagic, sizeof(magic)) != 0)
     {
-        Log(Logger::LOG_WARNING) << "Conserved Moiety Analysis is not enabled, steady state may fail with singular Jacobian";
-        Log(Logger::LOG_WARNING) << "Conserved Moiety Analysis may be enabled via the conservedMoeityAnalysis property or "
-                                    "via the configuration file or the Config class setValue, see roadrunner documentation";
-        Log(Logger::LOG_WARNING) << "to remove this warning, set ROADRUNNER_DISABLE_WARNINGS to 1 or 3 in the config file";
+        throw CoreException("Not a RoadRunner saved state");
     }
 
-    if (impl->mUseKinsol)
+    if (version != stateVersion)
     {
-        Log(Logger::LOG_ERROR) << "Kinsol solver is not enabled...";
-        throw Exception("Kinsol solver is not enabled");
+        throw CoreException("Unsupported saved state version " +
+                toString((int)version) + ", expected " +
+                toString((int)stateVersion));
     }
 
-    NLEQInterface steadyStateSolver(impl->model);
-
-    if (impl->configurationXML.length() > 0)
+    string name(nameSize, '\0');
+    if (nameSize)
     {
-        Configurable::loadXmlConfig(impl->configurationXML, &steadyStateSolver);
+        in.read(&name[0], nameSize);
     }
 
-    //Get a std vector for the solver
-    vector<double> someAmounts(impl->model->getNumIndFloatingSpecies(), 0);
-    impl->model->getFloatingSpeciesAmounts(someAmounts.size(), 0, &someAmounts[0]);
-
-    double ss = steadyStateSolver.solve(someAmounts);
-    if(ss < 0)
+    if (!in || name != impl->model->getModelName())
     {
-        Log(Logger::LOG_ERROR)<<"Steady State solver failed...";
+        throw CoreException("Saved state is from model '" + name +
+                "', not the currently loaded model '" +
+                impl->model->getModelName() + "'");
     }
-    impl->model->convertToConcentrations();
 
-    return ss;
+    impl->model->loadState(in);
+
+    // the integrator keeps its own copy of the state vector,
+    // start it again from the restored state.
+    impl->integrator->restart(impl->model->getTime());
 }
 
+void RoadRunner::saveState(const std::string& filename)
+{
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
 
+    if (!out)
+    {
+        throw CoreException("Could not open " + filename + " for writing");
+    }
 
+    saveState(out);
 
-void RoadRunner::setConservedMoietyAnalysis(bool bValue)
-{
-    if(bValue == impl->conservedMoietyAnalysis)
+    if (!out.flush())
     {
-        Log(lDebug)<<"The compute and assign conservation laws flag already set to : "<<toString(bValue);
+        throw CoreException("Error writing state to " + filename);
     }
 
-    impl->conservedMoietyAnalysis = bValue;
+    Log(Logger::LOG_NOTICE) << "saved state at time " <<
+            impl->model->getTime() << " to " << filename;
+}
+
+void RoadRunner::loadState(const std::string& filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+
+    if (!in)
+    {
+        throw CoreException("Could not open " + filename + " for reading");
+    }
+
+    loadState(in);
+
+    Log(Logger::LOG_NOTICE) << "loaded state at time " <<
+            impl->model->getTime() << " from " << filename;
+}
+
+std::string RoadRunner::saveStateS()
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    saveState(out);
+    return out.str();
+}
+
+void RoadRunner::loadStateS(const std::string& state)
+{
+    std::istringstream in(state, std::ios::in | std::ios::binary);
+    loadState(in);
+}
+
+bool RoadRunner::populateResult()
+{
+    vector<string> list(impl->mSelectionList.size());
+
+    for(int i = 0; i < impl->mSelectionList.size(); ++i)
+    {
+        list[i] = impl->mSelectionList[i].to_string();
+    }
+
+    impl->mRoadRunnerData.setColumnNames(list);
+    impl->mRoadRunnerData.setData(impl->simulationResult);
+    return true;
+}
+
+
+std::vector<rr::SelectionRecord>& RoadRunner::getSelections()
+{
+    return impl->mSelectionList;
+}
+
+
+double RoadRunner::steadyState()
+{
+    if (!impl->model)
+    {
+        throw CoreException(gEmptyModelMessage);
+    }
+
+    if (!impl->conservedMoietyAnalysis &&
+            (Config::getBool(Config::ROADRUNNER_DISABLE_WARNINGS)
+                & Config::ROADRUNNER_DISABLE_WARNINGS_STEADYSTATE) == 0)
+    {
+        Log(Logger::LOG_WARNING) << "Conserved Moiety Analysis is not enabled, steady state may fail with singular Jacobian";
+        Log(Logger::LOG_WARNING) << "Conserved Moiety Analysis may be enabled via the conservedMoeityAnalysis property or "
+                                    "via the configuration file or the Config class setValue, see roadrunner documentation";
+        Log(Logger::LOG_WARNING) << "to remove this warning, set ROADRUNNER_DISABLE_WARNINGS to 1 or 3 in the config file";
+    }
+
+    if (impl->mUseKinsol)
+    {
+        Log(Logger::LOG_ERROR) << "Kinsol solver is not enabled...";
+        throw Exception("Kinsol solver is not enabled");
+    }
+
+    NLEQInterface steadyStateSolver(impl->model);
+
+    if (impl->configurationXML.length() > 0)
+    {
+        Configurable::loadXmlConfig(impl->configurationXML, &steadyStateSolver);
+    }
+
+    //Get a std vector for the solver
+    vector<double> someAmounts(impl->model->getNumIndFloatingSpecies(), 0);
+    impl->model->getFloatingSpeciesAmounts(someAmounts.size(), 0, &someAmounts[0]);
+
+    double ss = steadyStateSolver.solve(someAmounts);
+    if(ss < 0)
+    {
+        Log(Logger::LOG_ERROR)<<"Steady State solver failed...";
+    }
+    impl->model->convertToConcentrations();
+
+    return ss;
+}
+
+
+
+
+void RoadRunner::setConservedMoietyAnalysis(bool bValue)
+{
+    if(bValue == impl->conservedMoietyAnalysis)
+    {
+        Log(lDebug)<<"The compute and assign conservation laws flag already set to : "<<toString(bValue);
+    }
+
+    impl->conservedMoietyAnalysis = bValue;
 
     if(impl->model != NULL)
     {
@@ -1173,165 +1647,607 @@ void RoadRunner::evalModel()
 }
 
 
-const DoubleMatrix* RoadRunner::simulate(const SimulateOptions* opt)
+/**
+ * Stochastic fixed step integration.
+ *
+ * The stochastic integrators frequently overshoot the requested time,
+ * and may return infinity when no more reactions can fire, so the state
+ * they return is recorded for every output time they passed over.
+ *
+ * output(row, time) is called to record the selections for each of the
+ * steps + 1 rows.
+ */
+template <typename Output>
+static void stochasticFixedStep(Integrator *integrator, double timeStart,
+        double timeEnd, int steps, Output& output)
 {
-    get_self();
-
-    _setSimulateOptions(opt);
+    int numPoints = steps + 1;
 
-    const double timeEnd = self.simulateOpt.duration + self.simulateOpt.start;
-    const double timeStart = self.simulateOpt.start;
+    if (numPoints <= 1)
+    {
+        numPoints = 2;
+    }
 
-    // evalute the model with its current state
-    self.model->getStateVectorRate(timeStart, 0, 0);
+    const double hstep = (timeEnd - timeStart) / (numPoints - 1);
 
-    // Variable Time Step Integration
-    if (self.simulateOpt.integratorFlags & SimulateOptions::VARIABLE_STEP )
+    try
     {
-        Log(Logger::LOG_NOTICE) << "Performing variable step integration";
+        // add current state as first row
+        output(0, timeStart);
 
-        DoubleVectorList results;
-        std::vector<double> row(self.mSelectionList.size());
+        integrator->restart(timeStart);
 
-        try
-        {
-            // add current state as first row
-            getSelectedValues(row, timeStart);
-            results.push_back(row);
+        double tout = timeStart;           // the exact times the integrator returns
+        double next = timeStart + hstep;   // because of fixed steps, the times when the
+                                           // value is recorded.
 
-            self.integrator->restart(timeStart);
+        // index gets bumped in do-while loop.
+        for (int i = 1; i < steps + 1;)
+        {
+            Log(Logger::LOG_DEBUG) << "step: " << i << "t0: " << tout << "hstep: " << next - tout;
 
-            double tout = timeStart;
+            // stochastic frequently overshoots time end
+            // may also be infinite
+            tout = integrator->integrate(tout, next - tout);
 
+            assert((tout >= next)
+                    && "stochastic integrator did not integrate to end time");
 
-            while(tout < timeEnd)
+            // get the output, always get at least one output
+            do
             {
-                Log(Logger::LOG_DEBUG) << "variable step, start: " << tout
-                        << ", end: " << timeEnd;
-                tout = self.integrator->integrate(tout, timeEnd);
-                if (!isfinite(tout))
-                {
-                    // time step is at infinity so bail, but get the last value
-                    getSelectedValues(row, timeEnd);
-                    results.push_back(row);
-                    break;
-                }
-                getSelectedValues(row, tout);
-                results.push_back(row);
+                output(i, next);
+                i++;
+                next = timeStart + i * hstep;
             }
+            while((i < steps + 1) && tout > next);
         }
-        catch (EventListenerException& e)
-        {
-            Log(Logger::LOG_NOTICE) << e.what();
-        }
+    }
+    catch (EventListenerException& e)
+    {
+        Log(Logger::LOG_NOTICE) << e.what();
+    }
+}
 
-        // stuff list values into result matrix
-        self.simulationResult.resize(results.size(), row.size());
-        uint rowi = 0;
-        for (DoubleVectorList::const_iterator i = results.begin();
-                i != results.end(); ++i, ++rowi)
+/**
+ * records the RoadRunner selections into a row of the result.
+ */
+class SelectionOutput
+{
+public:
+    SelectionOutput(RoadRunner& r, DoubleMatrix& result) :
+        r(r), selections(r.getSelections()), result(result) {}
+
+    void operator()(int row, double time)
+    {
+        for (unsigned j = 0; j < selections.size(); ++j)
         {
-            // evidently [] operator gets row, go figure...
-            double* prow = self.simulationResult[rowi];
-            std::copy(i->begin(), i->end(), prow);
+            result(row, j) = selections[j].selectionType == SelectionRecord::TIME ?
+                    time : r.getValue(selections[j]);
         }
     }
 
-    // Stochastic Fixed Step Integration
-    // do fixed time step simulation, these are different for deterministic
-    // and stochastic.
-    else if(SimulateOptions::getIntegratorType(self.simulateOpt.integrator) ==
-            SimulateOptions::STOCHASTIC)
+private:
+    RoadRunner& r;
+    const std::vector<SelectionRecord>& selections;
+    DoubleMatrix& result;
+};
+
+/**
+ * records the selections of a model, used by the ensemble trajectories
+ * which each have their own model. The values are written into the rows
+ * of result starting at rowOffset, and / or added to statistics.
+ */
+class ModelOutput
+{
+public:
+    ModelOutput(ExecutableModel *model,
+            const std::vector<SelectionRecord>& selections,
+            DoubleMatrix *result, int rowOffset,
+            EnsembleStatistics *statistics) :
+        model(model), selections(selections), result(result),
+        rowOffset(rowOffset), statistics(statistics),
+        values(selections.size()) {}
+
+    void operator()(int row, double time)
     {
-        Log(Logger::LOG_NOTICE)
-                << "Performing stochastic fixed step integration for "
-                << self.simulateOpt.steps + 1 << " steps";
+        for (unsigned j = 0; j < selections.size(); ++j)
+        {
+            values[j] = time;
+            if (selections[j].selectionType != SelectionRecord::TIME)
+            {
+                getModelValue(model, selections[j], values[j]);
+            }
+        }
 
-        int numPoints = self.simulateOpt.steps + 1;
+        if (result)
+        {
+            std::copy(values.begin(), values.end(), (*result)[rowOffset + row]);
+        }
 
-        if (numPoints <= 1)
+        if (statistics && values.size())
         {
-            numPoints = 2;
+            statistics->add(row, &values[0]);
         }
+    }
 
-        const double hstep = (timeEnd - timeStart) / (numPoints - 1);
-        int nrCols = self.mSelectionList.size();
+private:
+    ExecutableModel *model;
+    const std::vector<SelectionRecord>& selections;
+    DoubleMatrix *result;
+    int rowOffset;
+    EnsembleStatistics *statistics;
+    std::vector<double> values;
+};
 
-        Log(Logger::LOG_DEBUG) << "starting simulation with " << nrCols << " selected columns";
+/**
+ * the model state every ensemble trajectory starts from.
+ */
+struct EnsembleState
+{
+    double time;
+    std::vector<double> globalParameters;
+    std::vector<double> compartmentVolumes;
+    std::vector<double> boundarySpecies;
+    std::vector<double> conservedMoieties;
+    std::vector<double> stateVector;
 
-        // ignored if same
-        self.simulationResult.resize(self.simulateOpt.steps + 1, nrCols);
+    EnsembleState(ExecutableModel *model) :
+        time(model->getTime()),
+        globalParameters(model->getNumGlobalParameters()),
+        compartmentVolumes(model->getNumCompartments()),
+        boundarySpecies(model->getNumBoundarySpecies()),
+        conservedMoieties(model->getNumConservedMoieties()),
+        stateVector(model->getStateVector(0))
+    {
+        model->getGlobalParameterValues(globalParameters.size(), 0,
+                data(globalParameters));
+        model->getCompartmentVolumes(compartmentVolumes.size(), 0,
+                data(compartmentVolumes));
+        model->getBoundarySpeciesConcentrations(boundarySpecies.size(), 0,
+                data(boundarySpecies));
+        model->getConservedMoietyValues(conservedMoieties.size(), 0,
+                data(conservedMoieties));
+        model->getStateVector(data(stateVector));
+    }
 
-        try
+    void apply(ExecutableModel *model) const
+    {
+        model->setGlobalParameterValues(globalParameters.size(), 0,
+                data(globalParameters));
+        model->setCompartmentVolumes(compartmentVolumes.size(), 0,
+                data(compartmentVolumes));
+        model->setBoundarySpeciesConcentrations(boundarySpecies.size(), 0,
+                data(boundarySpecies));
+        model->setConservedMoietyValues(conservedMoieties.size(), 0,
+                data(conservedMoieties));
+        model->setStateVector(data(stateVector));
+        model->setTime(time);
+    }
+
+private:
+    static double *data(std::vector<double>& v)
+    {
+        return v.empty() ? 0 : &v[0];
+    }
+
+    static const double *data(const std::vector<double>& v)
+    {
+        return v.empty() ? 0 : &v[0];
+    }
+};
+
+/**
+ * Runs a set of ensemble trajectories on a single model.
+ *
+ * Trajectory k uses random stream k of the ensemble seed, and is
+ * written into rows k * (steps + 1) to (k + 1) * (steps + 1) - 1 of the
+ * result, so the result does not depend on which worker runs it.
+ *
+ * If statistics is given, each worker accumulates its own trajectories
+ * into it, the workers' statistics are merged when they are done.
+ */
+class EnsembleWorker : public Poco::Runnable
+{
+public:
+    EnsembleWorker(ExecutableModel *model, bool ownsModel,
+            const SimulateOptions& opt, const EnsembleState& state,
+            const std::vector<SelectionRecord>& selections,
+            DoubleMatrix *result, EnsembleStatistics *statistics) :
+        model(model), ownsModel(ownsModel), options(opt), state(state),
+        selections(selections), result(result), statistics(statistics),
+        integrator(0)
+    {
+        integrator = Integrator::New(&options, model);
+    }
+
+    ~EnsembleWorker()
+    {
+        delete integrator;
+        if (ownsModel)
         {
-            // add current state as first row
-            getSelectedValues(self.simulationResult, 0, timeStart);
+            delete model;
+        }
+    }
 
-            self.integrator->restart(timeStart);
+    void addTrajectory(int k)
+    {
+        trajectories.push_back(k);
+    }
 
-            double tout = timeStart;           // the exact times the integrator returns
-            double next = timeStart + hstep;   // because of fixed steps, the times when the
-                                               // value is recorded.
+    virtual void run()
+    {
+        try
+        {
+            const double timeStart = options.start;
+            const double timeEnd = options.start + options.duration;
+            const int rows = options.steps + 1;
 
-            // index gets bumped in do-while loop.
-            for (int i = 1; i < self.simulateOpt.steps + 1;)
+            for (unsigned i = 0; i < trajectories.size(); ++i)
             {
-                Log(Logger::LOG_DEBUG) << "step: " << i << "t0: " << tout << "hstep: " << next - tout;
+                int k = trajectories[i];
 
-                // stochastic frequently overshoots time end
-                // may also be infinite
-                tout = self.integrator->integrate(tout, next - tout);
+                state.apply(model);
+                model->getStateVectorRate(timeStart, 0, 0);
 
-                assert((tout >= next)
-                        && "stochastic integrator did not integrate to end time");
+                options.setValue("trajectory", (long)k);
+                integrator->setSimulateOptions(&options);
 
-                // get the output, always get at least one output
-                do
-                {
-                    getSelectedValues(self.simulationResult, i, next);
-                    i++;
-                    next = timeStart + i * hstep;
-                }
-                while((i < self.simulateOpt.steps + 1) && tout > next);
+                ModelOutput output(model, selections, result, k * rows,
+                        statistics);
+                stochasticFixedStep(integrator, timeStart, timeEnd,
+                        options.steps, output);
             }
         }
-        catch (EventListenerException& e)
+        catch (std::exception& e)
         {
-            Log(Logger::LOG_NOTICE) << e.what();
+            error = e.what();
+        }
+        catch (...)
+        {
+            error = "unknown error";
         }
     }
 
-    // Deterministic Fixed Step Integration
-    else
-    {
-        Log(Logger::LOG_INFORMATION)
-                << "Perfroming deterministic fixed step integration for  "
-                << self.simulateOpt.steps + 1 << " steps";
+    std::string error;
 
-        int numPoints = self.simulateOpt.steps + 1;
+private:
+    ExecutableModel *model;
+    bool ownsModel;
+    SimulateOptions options;
+    const EnsembleState& state;
+    const std::vector<SelectionRecord>& selections;
+    DoubleMatrix *result;
+    EnsembleStatistics *statistics;
+    Integrator *integrator;
+    std::vector<int> trajectories;
+};
 
-        if (numPoints <= 1)
+/**
+ * watches the tolerance scaled norm of the state vector rate at the output
+ * times of a deterministic simulation, see
+ * SimulateOptions::STEADY_STATE_TERMINATION.
+ */
+class SteadyStateMonitor
+{
+public:
+    SteadyStateMonitor(ExecutableModel *model, const SimulateOptions& opt,
+            double timeSpan) :
+                model(model),
+                enabled(false),
+                threshold(1.0),
+                window(0.1 * timeSpan),
+                newton(false),
+                absolute(opt.absolute),
+                relative(opt.relative),
+                below(false),
+                belowTime(0)
+    {
+        if ((opt.flags & SimulateOptions::STEADY_STATE_TERMINATION) == 0)
         {
-            numPoints = 2;
+            return;
         }
 
-        double hstep = (timeEnd - timeStart) / (numPoints - 1);
-        int nrCols = self.mSelectionList.size();
+        if (model->getNumEvents() > 0)
+        {
+            Log(Logger::LOG_NOTICE) << "Steady state termination is not "
+                    "used for models with events";
+            return;
+        }
 
-        Log(Logger::LOG_DEBUG) << "starting simulation with " << nrCols << " selected columns";
+        if (opt.hasKey("steadyStateThreshold"))
+        {
+            threshold = opt.getValue("steadyStateThreshold").convert<double>();
+        }
 
-        // ignored if same
-        self.simulationResult.resize(self.simulateOpt.steps + 1, nrCols);
+        if (opt.hasKey("steadyStateWindow"))
+        {
+            window = opt.getValue("steadyStateWindow").convert<double>();
+        }
 
-        try
+        if (opt.hasKey("steadyStateNewton"))
         {
-            // add current state as first row
+            newton = opt.getValue("steadyStateNewton").convert<bool>();
+        }
+
+        int n = model->getStateVector(0);
+        y.resize(n);
+        dydt.resize(n);
+
+        enabled = n > 0;
+    }
+
+    /**
+     * check the current model state, returns true once the rates stayed
+     * below the threshold for the whole window.
+     */
+    bool reached(double time)
+    {
+        if (!enabled)
+        {
+            return false;
+        }
+
+        model->getStateVector(&y[0]);
+        model->getStateVectorRate(time, 0, &dydt[0]);
+
+        double norm = 0;
+        for (unsigned i = 0; i < y.size(); ++i)
+        {
+            double r = dydt[i] / (absolute + relative * fabs(y[i]));
+            norm += r * r;
+        }
+        norm = sqrt(norm / y.size());
+
+        if (!(norm < threshold))
+        {
+            below = false;
+            return false;
+        }
+
+        if (!below)
+        {
+            below = true;
+            belowTime = time;
+        }
+
+        if (time - belowTime < window)
+        {
+            return false;
+        }
+
+        Log(Logger::LOG_NOTICE) << "Steady state reached at time " << time
+                << ", scaled rate norm: " << norm;
+
+        if (newton)
+        {
+            refine();
+        }
+
+        return true;
+    }
+
+private:
+    /**
+     * polish the state with the NLEQ solver, keep the integrated
+     * state if it fails.
+     */
+    void refine()
+    {
+        try
+        {
+            NLEQInterface solver(model);
+            double ss = solver.solve(y);
+
+            if (ss >= 0)
+            {
+                model->convertToConcentrations();
+                return;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            Log(Logger::LOG_NOTICE) << "Steady state solver failed: " << e.what();
+        }
+
+        model->setStateVector(&y[0]);
+    }
+
+    ExecutableModel *model;
+    bool enabled;
+    double threshold;
+    double window;
+    bool newton;
+    double absolute;
+    double relative;
+    bool below;
+    double belowTime;
+    std::vector<double> y;
+    std::vector<double> dydt;
+};
+
+const DoubleMatrix* RoadRunner::simulate(const SimulateOptions* opt)
+{
+    get_self();
+
+    _setSimulateOptions(opt);
+
+    const double timeEnd = self.simulateOpt.duration + self.simulateOpt.start;
+    const double timeStart = self.simulateOpt.start;
+
+    // evalute the model with its current state
+    self.model->getStateVectorRate(timeStart, 0, 0);
+
+    // Variable Time Step Integration
+    if (self.simulateOpt.integratorFlags & SimulateOptions::VARIABLE_STEP )
+    {
+        Log(Logger::LOG_NOTICE) << "Performing variable step integration";
+
+        DoubleVectorList results;
+        std::vector<double> row(self.mSelectionList.size());
+
+        try
+        {
+            // add current state as first row
+            getSelectedValues(row, timeStart);
+            results.push_back(row);
+
+            self.integrator->restart(timeStart);
+
+            double tout = timeStart;
+
+
+            while(tout < timeEnd)
+            {
+                Log(Logger::LOG_DEBUG) << "variable step, start: " << tout
+                        << ", end: " << timeEnd;
+                tout = self.integrator->integrate(tout, timeEnd);
+                if (!isfinite(tout))
+                {
+                    // time step is at infinity so bail, but get the last value
+                    getSelectedValues(row, timeEnd);
+                    results.push_back(row);
+                    break;
+                }
+                getSelectedValues(row, tout);
+                results.push_back(row);
+            }
+        }
+        catch (EventListenerException& e)
+        {
+            Log(Logger::LOG_NOTICE) << e.what();
+        }
+
+        // stuff list values into result matrix
+        self.simulationResult.resize(results.size(), row.size());
+        uint rowi = 0;
+        for (DoubleVectorList::const_iterator i = results.begin();
+                i != results.end(); ++i, ++rowi)
+        {
+            // evidently [] operator gets row, go figure...
+            double* prow = self.simulationResult[rowi];
+            std::copy(i->begin(), i->end(), prow);
+        }
+    }
+
+    // Stochastic Fixed Step Integration
+    // do fixed time step simulation, these are different for deterministic
+    // and stochastic.
+    else if(SimulateOptions::getIntegratorType(self.simulateOpt.integrator) ==
+            SimulateOptions::STOCHASTIC)
+    {
+        Log(Logger::LOG_NOTICE)
+                << "Performing stochastic fixed step integration for "
+                << self.simulateOpt.steps + 1 << " steps";
+
+        int nrCols = self.mSelectionList.size();
+
+        Log(Logger::LOG_DEBUG) << "starting simulation with " << nrCols << " selected columns";
+
+        // ignored if same
+        self.simulationResult.resize(self.simulateOpt.steps + 1, nrCols);
+
+        SelectionOutput output(*this, self.simulationResult);
+        stochasticFixedStep(self.integrator, timeStart, timeEnd,
+                self.simulateOpt.steps, output);
+    }
+
+    // Deterministic Fixed Step Integration at the given output times
+    else if (self.simulateOpt.times.size())
+    {
+        const std::vector<double>& times = self.simulateOpt.times;
+
+        Log(Logger::LOG_INFORMATION)
+                << "Performing deterministic fixed step integration for "
+                << times.size() << " output times";
+
+        for (unsigned i = 1; i < times.size(); ++i)
+        {
+            if (times[i] < times[i - 1])
+            {
+                throw CoreException("The simulation output times must be non-decreasing");
+            }
+        }
+
+        int nrCols = self.mSelectionList.size();
+
+        // ignored if same
+        self.simulationResult.resize(times.size(), nrCols);
+
+        try
+        {
+            // add current state as first row
+            getSelectedValues(self.simulationResult, 0, times[0]);
+
+            self.integrator->restart(times[0]);
+
+            SteadyStateMonitor steadyState(self.model, self.simulateOpt,
+                    times.back() - times.front());
+
+            for (unsigned i = 1; i < times.size(); i++)
+            {
+                if (times[i] > times[i - 1])
+                {
+                    self.integrator->integrate(times[i - 1], times[i] - times[i - 1]);
+                }
+                // checked first, the steady state may be refined, which
+                // changes the state this row has to show.
+                bool steady = steadyState.reached(times[i]);
+
+                getSelectedValues(self.simulationResult, i, times[i]);
+
+                if (steady)
+                {
+                    // the rest of the output is the steady state
+                    for (unsigned j = i + 1; j < times.size(); ++j)
+                    {
+                        self.model->setTime(times[j]);
+                        getSelectedValues(self.simulationResult, j, times[j]);
+                    }
+                    break;
+                }
+            }
+        }
+        catch (EventListenerException& e)
+        {
+            Log(Logger::LOG_NOTICE) << e.what();
+        }
+    }
+
+    // Deterministic Fixed Step Integration
+    else
+    {
+        Log(Logger::LOG_INFORMATION)
+                << "Perfroming deterministic fixed step integration for  "
+                << self.simulateOpt.steps + 1 << " steps";
+
+        int numPoints = self.simulateOpt.steps + 1;
+
+        if (numPoints <= 1)
+        {
+            numPoints = 2;
+        }
+
+        double hstep = (timeEnd - timeStart) / (numPoints - 1);
+        int nrCols = self.mSelectionList.size();
+
+        Log(Logger::LOG_DEBUG) << "starting simulation with " << nrCols << " selected columns";
+
+        // ignored if same
+        self.simulationResult.resize(self.simulateOpt.steps + 1, nrCols);
+
+        try
+        {
+            // add current state as first row
             getSelectedValues(self.simulationResult, 0, timeStart);
 
             self.integrator->restart(timeStart);
 
             double tout = timeStart;
 
+            SteadyStateMonitor steadyState(self.model, self.simulateOpt,
+                    timeEnd - timeStart);
+
             for (int i = 1; i < self.simulateOpt.steps + 1; i++)
             {
                 Log(Logger::LOG_DEBUG)<<"Step "<<i;
@@ -1342,7 +2258,23 @@ const DoubleMatrix* RoadRunner::simulate(const SimulateOptions* opt)
                 // will return a value just slightly off from the exact time
                 // value.
                 tout = timeStart + i * hstep;
+
+                // checked first, the steady state may be refined, which
+                // changes the state this row has to show.
+                bool steady = steadyState.reached(tout);
+
                 getSelectedValues(self.simulationResult, i, tout);
+
+                if (steady)
+                {
+                    // the rest of the output is the steady state
+                    for (int j = i + 1; j < self.simulateOpt.steps + 1; j++)
+                    {
+                        self.model->setTime(timeStart + j * hstep);
+                        getSelectedValues(self.simulationResult, j, timeStart + j * hstep);
+                    }
+                    break;
+                }
             }
         }
         catch (EventListenerException& e)
@@ -1359,29 +2291,24 @@ const DoubleMatrix* RoadRunner::simulate(const SimulateOptions* opt)
 }
 
 
-double RoadRunner::integrate(double t0, double tf, const SimulateOptions* o)
+DoubleMatrix RoadRunner::simulateEnsemble(int nTrajectories, unsigned long seed,
+        const SimulateOptions* opt, int nThreads)
 {
-    if (!impl->model)
-    {
-        throw CoreException(gEmptyModelMessage);
-    }
-
-    _setSimulateOptions(o);
-
-    try
-    {
-        impl->model->setTime(t0);
-        return impl->integrator->integrate(t0, tf);
-    }
-    catch (EventListenerException& e)
-    {
-        Log(Logger::LOG_NOTICE) << e.what();
-        return impl->model->getTime();
-    }
+    DoubleMatrix result;
+    runEnsemble(nTrajectories, seed, opt, nThreads, &result, 0);
+    return result;
 }
 
+void RoadRunner::simulateEnsembleStatistics(int nTrajectories,
+        unsigned long seed, EnsembleStatistics& statistics,
+        const SimulateOptions* opt, int nThreads)
+{
+    runEnsemble(nTrajectories, seed, opt, nThreads, 0, &statistics);
+}
 
-double RoadRunner::oneStep(const double currentTime, const double stepSize, const bool reset)
+void RoadRunner::runEnsemble(int nTrajectories, unsigned long seed,
+        const SimulateOptions* opt, int nThreads, DoubleMatrix* result,
+        EnsembleStatistics* statistics)
 {
     get_self();
 
@@ -1390,36 +2317,202 @@ double RoadRunner::oneStep(const double currentTime, const double stepSize, cons
         throw CoreException(gEmptyModelMessage);
     }
 
-    self.copySimulateOpt.flags = reset ?
-            self.copySimulateOpt.flags | SimulateOptions::RESET_MODEL :
-            self.copySimulateOpt.flags & ~SimulateOptions::RESET_MODEL;
+    if (nTrajectories <= 0)
+    {
+        throw CoreException("number of ensemble trajectories must be positive");
+    }
 
-    _setSimulateOptions(0);
+    _setSimulateOptions(opt);
 
-    try
+    if (SimulateOptions::getIntegratorType(self.simulateOpt.integrator) !=
+            SimulateOptions::STOCHASTIC)
     {
-        return self.integrator->integrate(currentTime, stepSize);
+        throw CoreException("simulateEnsemble requires a stochastic integrator");
     }
-    catch (EventListenerException& e)
+
+    for (unsigned j = 0; j < self.mSelectionList.size(); ++j)
     {
-        Log(Logger::LOG_NOTICE) << e.what();
-        return self.model->getTime();
+        double value;
+        if (self.mSelectionList[j].selectionType != SelectionRecord::TIME &&
+                !getModelValue(self.model, self.mSelectionList[j], value))
+        {
+            throw CoreException("The selection " + self.mSelectionList[j].to_string()
+                    + " is not supported in ensemble simulations");
+        }
     }
-}
 
+    if (nThreads <= 0)
+    {
+        nThreads = Poco::Environment::processorCount();
+    }
 
-DoubleMatrix RoadRunner::getEigenvalues()
-{
-    try
+    nThreads = std::max(1, std::min(nThreads, nTrajectories));
+
+    const int rows = self.simulateOpt.steps + 1;
+    const int cols = self.mSelectionList.size();
+
+    Log(Logger::LOG_NOTICE) << "Performing ensemble of " << nTrajectories
+            << " stochastic trajectories on " << nThreads << " threads";
+
+    if (result)
     {
-        if (!impl->model)
+        result->resize(nTrajectories * rows, cols);
+    }
+
+    // per thread accumulators, memory does not depend on the number
+    // of trajectories.
+    std::vector<EnsembleStatistics> workerStatistics;
+    if (statistics)
+    {
+        if (statistics->numRows() != rows || statistics->numCols() != cols)
         {
-            throw CoreException(gEmptyModelMessage);
+            statistics->reset(rows, cols);
         }
 
-        vector<Complex> vals = getEigenvaluesCpx();
+        workerStatistics.resize(nThreads,
+                EnsembleStatistics(statistics->getCompression()));
 
-        DoubleMatrix result(vals.size(), 2);
+        for (int i = 0; i < nThreads; ++i)
+        {
+            workerStatistics[i].reset(rows, cols);
+        }
+    }
+
+    // evalute the model with its current state
+    self.model->getStateVectorRate(self.simulateOpt.start, 0, 0);
+
+    const EnsembleState state(self.model);
+
+    SimulateOptions workerOpt = self.simulateOpt;
+    workerOpt.setValue("seed", (long)seed);
+
+    // the first worker uses the current model, the others each get their own
+    // copy, made from the same sbml or model library.
+    std::vector<EnsembleWorker*> workers(nThreads);
+    try
+    {
+        for (int i = 0; i < nThreads; ++i)
+        {
+            ExecutableModel *model = i == 0 ? self.model :
+                    self.createModelCopy();
+
+            workers[i] = new EnsembleWorker(model, i != 0, workerOpt, state,
+                    self.mSelectionList, result,
+                    statistics ? &workerStatistics[i] : 0);
+        }
+    }
+    catch (...)
+    {
+        for (int i = 0; i < nThreads; ++i)
+        {
+            delete workers[i];
+        }
+        throw;
+    }
+
+    // static assignment, each trajectory has its own random stream so
+    // the assignment does not effect the results.
+    for (int k = 0; k < nTrajectories; ++k)
+    {
+        workers[k % nThreads]->addTrajectory(k);
+    }
+
+    std::string error;
+    try
+    {
+        WorkerPool(nThreads).run(workers);
+    }
+    catch (std::exception& e)
+    {
+        error = e.what();
+    }
+
+    for (int i = 0; i < nThreads; ++i)
+    {
+        if (error.empty())
+        {
+            error = workers[i]->error;
+        }
+        delete workers[i];
+    }
+
+    // leave the current model as it was before the ensemble
+    state.apply(self.model);
+
+    if (!error.empty())
+    {
+        throw CoreException("Error in ensemble simulation: " + error);
+    }
+
+    // merge in worker order, so the statistics only depend on the
+    // number of threads, not on how they were scheduled.
+    for (unsigned i = 0; i < workerStatistics.size(); ++i)
+    {
+        statistics->merge(workerStatistics[i]);
+    }
+}
+
+double RoadRunner::integrate(double t0, double tf, const SimulateOptions* o)
+{
+    if (!impl->model)
+    {
+        throw CoreException(gEmptyModelMessage);
+    }
+
+    _setSimulateOptions(o);
+
+    try
+    {
+        impl->model->setTime(t0);
+        return impl->integrator->integrate(t0, tf);
+    }
+    catch (EventListenerException& e)
+    {
+        Log(Logger::LOG_NOTICE) << e.what();
+        return impl->model->getTime();
+    }
+}
+
+
+double RoadRunner::oneStep(const double currentTime, const double stepSize, const bool reset)
+{
+    get_self();
+
+    if (!self.model)
+    {
+        throw CoreException(gEmptyModelMessage);
+    }
+
+    self.copySimulateOpt.flags = reset ?
+            self.copySimulateOpt.flags | SimulateOptions::RESET_MODEL :
+            self.copySimulateOpt.flags & ~SimulateOptions::RESET_MODEL;
+
+    _setSimulateOptions(0);
+
+    try
+    {
+        return self.integrator->integrate(currentTime, stepSize);
+    }
+    catch (EventListenerException& e)
+    {
+        Log(Logger::LOG_NOTICE) << e.what();
+        return self.model->getTime();
+    }
+}
+
+
+DoubleMatrix RoadRunner::getEigenvalues()
+{
+    try
+    {
+        if (!impl->model)
+        {
+            throw CoreException(gEmptyModelMessage);
+        }
+
+        vector<Complex> vals = getEigenvaluesCpx();
+
+        DoubleMatrix result(vals.size(), 2);
 
         for (int i = 0; i < vals.size(); i++)
         {
@@ -1472,6 +2565,13 @@ DoubleMatrix RoadRunner::getFullJacobian()
         }
         DoubleMatrix uelast = getUnscaledElasticityMatrix();
 
+        conservation::SparseStructuralAnalysis *sparse = impl->getSparseStructural();
+        if (sparse && impl->conservedMoietyAnalysis)
+        {
+            DoubleMatrix sm = sparse->getReorderedStoichiometryMatrix();
+            return ls::mult(sm, uelast);
+        }
+
         // ptr to libstruct owned obj.
         DoubleMatrix *rsm;
         LibStructural *ls = getLibStruct();
@@ -1590,6 +2690,10 @@ DoubleMatrix RoadRunner::getLinkMatrix()
            throw CoreException(gEmptyModelMessage);
        }
        //return _L;
+        if (conservation::SparseStructuralAnalysis *sparse = impl->getSparseStructural())
+        {
+            return sparse->getLinkMatrix();
+        }
         return *getLibStruct()->getLinkMatrix();
     }
     catch (const Exception& e)
@@ -1607,6 +2711,10 @@ DoubleMatrix RoadRunner::getNrMatrix()
             throw CoreException(gEmptyModelMessage);
        }
         //return _Nr;
+        if (conservation::SparseStructuralAnalysis *sparse = impl->getSparseStructural())
+        {
+            return sparse->getNrMatrix();
+        }
         return *getLibStruct()->getNrMatrix();
     }
     catch (const Exception& e)
@@ -1622,6 +2730,11 @@ DoubleMatrix RoadRunner::getL0Matrix()
         throw CoreException(gEmptyModelMessage);
     }
     //return _L0;
+    if (conservation::SparseStructuralAnalysis *sparse = impl->getSparseStructural())
+    {
+        return sparse->getL0Matrix();
+    }
+
     // returns a NEW matrix,
     // nice consistent API yes?!?!?
     DoubleMatrix *tmp = getLibStruct()->getL0Matrix();
@@ -1639,6 +2752,11 @@ DoubleMatrix RoadRunner::getConservationMatrix()
     {
        if (impl->model)
        {
+           if (conservation::SparseStructuralAnalysis *sparse = impl->getSparseStructural())
+           {
+               return sparse->getConservationMatrix();
+           }
+
            DoubleMatrix* aMat = getLibStruct()->getGammaMatrix();
             if (aMat)
             {
@@ -1670,6 +2788,10 @@ int RoadRunner::getNumberOfDependentSpecies()
         if (impl->model)
         {
             //return mStructAnalysis.GetInstance()->getNumDepSpecies();
+            if (conservation::SparseStructuralAnalysis *sparse = impl->getSparseStructural())
+            {
+                return sparse->getNumDepSpecies();
+            }
             return getLibStruct()->getNumDepSpecies();
         }
 
@@ -1689,6 +2811,10 @@ int RoadRunner::getNumberOfIndependentSpecies()
     {
         if (impl->model)
         {
+            if (conservation::SparseStructuralAnalysis *sparse = impl->getSparseStructural())
+            {
+                return sparse->getNumIndSpecies();
+            }
             return getLibStruct()->getNumIndSpecies();
         }
         //return StructAnalysis.getNumIndSpecies();
@@ -2344,6 +3470,25 @@ double RoadRunner::getuCC(const string& variableName, const string& parameterNam
             throw CoreException("Unable to locate parameter: [" + parameterName + "]");
         }
 
+        if (parameterType != ptConservationParameter)
+        {
+            updateResponseCoefficients();
+
+            int column = parameterType == ptGlobalParameter ? parameterIndex :
+                    impl->model->getNumGlobalParameters() + parameterIndex;
+
+            double value = variableType == vtFlux ?
+                    impl->fluxResponse[variableIndex][column] :
+                    impl->concentrationResponse[variableIndex][column];
+
+            // parameters which could not be perturbed, i.e. ones defined by
+            // rules, are handled the same as before below.
+            if (isfinite(value))
+            {
+                return value;
+            }
+        }
+
         // Get the original parameter value
         originalParameterValue = impl->getParameterValue(parameterType, parameterIndex);
 
@@ -2447,11 +3592,112 @@ double RoadRunner::getCC(const string& variableName, const string& parameterName
         throw CoreException("Unable to locate parameter: [" + parameterName + "]");
     }
 
-    steadyState();
+    // leaves the model at the steady state
+    double ucc = getuCC(variableName, parameterName);
 
     double variableValue = getVariableValue(variableType, variableIndex);
     double parameterValue = impl->getParameterValue(parameterType, parameterIndex);
-    return getuCC(variableName, parameterName)*parameterValue/variableValue;
+    return ucc*parameterValue/variableValue;
+}
+
+// Use the formulas: dS/dp = -L Jac^-1 Nr elast_p, dJ/dp = elast dS/dp + elast_p
+void RoadRunner::updateResponseCoefficients()
+{
+    get_self();
+
+    if (self.responseKey.size() && self.responseKey == self.getResponseKey())
+    {
+        return;
+    }
+
+    self.responseKey.clear();
+
+    steadyState();
+
+    const int numReactions = self.model->getNumReactions();
+    const int numFloatingSpecies = self.model->getNumFloatingSpecies();
+    const int numGlobalParameters = self.model->getNumGlobalParameters();
+    const int numParameters = numGlobalParameters + self.model->getNumBoundarySpecies();
+
+    std::vector<ParameterType> parameterTypes(numParameters);
+    std::vector<int> parameterIndices(numParameters);
+    for (int j = 0; j < numParameters; j++)
+    {
+        parameterTypes[j] = j < numGlobalParameters ? ptGlobalParameter : ptBoundaryParameter;
+        parameterIndices[j] = j < numGlobalParameters ? j : j - numGlobalParameters;
+    }
+
+    DoubleMatrix uelastParam = self.getUnscaledParameterElasticities(
+            parameterTypes, parameterIndices);
+
+    self.concentrationResponse = DoubleMatrix(numFloatingSpecies, numParameters);
+    self.fluxResponse = uelastParam;
+
+    if (numReactions && numFloatingSpecies && numParameters)
+    {
+        DoubleMatrix uelast = getUnscaledElasticityMatrix();
+        DoubleMatrix Nr = getNrMatrix();
+        DoubleMatrix LinkMatrix = getLinkMatrix();
+        DoubleMatrix Jac, T2;
+        mult(Nr, uelast, T2);
+        mult(T2, LinkMatrix, Jac);
+        mult(Nr, uelastParam, T2);
+
+        const int n = Jac.RSize();
+
+        if (n > 0)
+        {
+            // one factorization of the reduced Jacobian, back substitute
+            // for each parameter.
+            DlsMat jac = NewDenseMat(n, n);
+            long int *pivots = NewLintArray(n);
+
+            for (int i = 0; i < n; i++)
+            {
+                for (int k = 0; k < n; k++)
+                {
+                    DENSE_ELEM(jac, i, k) = Jac[i][k];
+                }
+            }
+
+            if (DenseGETRF(jac, pivots) != 0)
+            {
+                DestroyMat(jac);
+                DestroyArray(pivots);
+                throw CoreException("Unable to compute response coefficients, "
+                        "the reduced Jacobian is singular");
+            }
+
+            DoubleMatrix T3(n, numParameters);
+            vector<double> b(n);
+
+            for (int j = 0; j < numParameters; j++)
+            {
+                for (int i = 0; i < n; i++)
+                {
+                    b[i] = -T2[i][j];
+                }
+
+                DenseGETRS(jac, pivots, &b[0]);
+
+                for (int i = 0; i < n; i++)
+                {
+                    T3[i][j] = b[i];
+                }
+            }
+
+            DestroyMat(jac);
+            DestroyArray(pivots);
+
+            // include the dependent species
+            mult(LinkMatrix, T3, self.concentrationResponse);
+
+            // fluxResponse = uelastParam + uelast concentrationResponse
+            gemm(1.0, uelast, self.concentrationResponse, 1.0, self.fluxResponse);
+        }
+    }
+
+    self.responseKey = self.getResponseKey();
 }
 
 
@@ -2696,14 +3942,15 @@ DoubleMatrix RoadRunner::getUnscaledConcentrationControlCoefficientMatrix()
         // Compute the Jacobian first
         DoubleMatrix uelast     = getUnscaledElasticityMatrix();
         DoubleMatrix Nr         = getNrMatrix();
-        DoubleMatrix T1 = mult(Nr, uelast);
         DoubleMatrix LinkMatrix = getLinkMatrix();
-        DoubleMatrix Jac = mult(T1, LinkMatrix);
+        DoubleMatrix Jac;
+        mult(Nr, uelast, Jac);
+        mult(Jac, LinkMatrix, Jac);
 
         // Compute -Jac
-        DoubleMatrix T2 = Jac * (-1.0);
+        Jac *= -1.0;
 
-        ComplexMatrix temp(T2); //Get a complex matrix from a double one. Imag part is zero
+        ComplexMatrix temp(Jac); //Get a complex matrix from a double one. Imag part is zero
         ComplexMatrix Inv = GetInverse(temp);
 
         // &&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&
@@ -2711,8 +3958,8 @@ DoubleMatrix RoadRunner::getUnscaledConcentrationControlCoefficientMatrix()
         DoubleMatrix T3 = mult(Inv, Nr); // Compute ( - Jac)^-1 . Nr
 
         // Finally include the dependent set as well.
-        DoubleMatrix T4 = mult(LinkMatrix, T3); // Compute L (iwI - Jac)^-1 . Nr
-        return T4;
+        mult(LinkMatrix, T3, Jac); // Compute L (iwI - Jac)^-1 . Nr
+        return Jac;
     }
     catch (const Exception& e)
     {
@@ -2776,7 +4023,8 @@ DoubleMatrix RoadRunner::getUnscaledFluxControlCoefficientMatrix()
             DoubleMatrix ucc = getUnscaledConcentrationControlCoefficientMatrix();
             DoubleMatrix uee = getUnscaledElasticityMatrix();
 
-            DoubleMatrix T1 = mult(uee, ucc);
+            DoubleMatrix T1;
+            mult(uee, ucc, T1);
 
             // Add an identity matrix I to T1, that is add a 1 to every diagonal of T1
             for (int i=0; i<T1.RSize(); i++)
@@ -2874,469 +4122,1228 @@ vector<double> RoadRunner::getReactionRates()
     return rates;
 }
 
-Integrator* RoadRunner::getIntegrator()
-{
-    return impl->integrator;
-}
+Integrator* RoadRunner::getIntegrator()
+{
+    return impl->integrator;
+}
+
+
+void RoadRunner::setValue(const string& sId, double dValue)
+{
+    if (!impl->model)
+    {
+        throw CoreException(gEmptyModelMessage);
+    }
+
+    impl->model->setValue(sId, dValue);
+
+    SelectionRecord sel(sId);
+
+    if (sel.selectionType == SelectionRecord::INITIAL_FLOATING_AMOUNT ||
+            sel.selectionType == SelectionRecord::INITIAL_FLOATING_CONCENTRATION)
+    {
+        reset();
+    }
+}
+
+
+double RoadRunner::getValue(const std::string& sel)
+{
+    return getValue(createSelection(sel));
+}
+
+
+vector<double> RoadRunner::getSelectedValues()
+{
+    if (!impl->model)
+    {
+        throw CoreException(gEmptyModelMessage);
+    }
+
+    vector<double> result;
+    result.resize(impl->mSelectionList.size());
+
+    for (int i = 0; i < impl->mSelectionList.size(); i++)
+    {
+        result[i] = getNthSelectedOutput(i, impl->model->getTime());
+    }
+    return result;
+}
+
+
+static std::vector<std::string> createSelectionList(const SimulateOptions& o)
+{
+    //read from settings the variables found in the amounts and concentrations lists
+    std::vector<std::string> theList;
+    SelectionRecord record;
+
+    theList.push_back("time");
+
+    int nrOfVars = o.variables.size();
+
+    for(int i = 0; i < o.amounts.size(); i++)
+    {
+        theList.push_back(o.amounts[i]);        //In the setSelection list below, the [] selects the correct 'type'
+    }
+
+    for(int i = 0; i < o.concentrations.size(); i++)
+    {
+        theList.push_back("[" + o.concentrations[i] + "]");
+    }
+
+    //We may have variables
+    //A variable 'exists' only in "variables", not in the amount or concentration section
+
+    for(int i = 0; i < o.variables.size(); i++)
+    {
+        string aVar = o.variables[i];
+
+        if ((find(o.amounts.begin(), o.amounts.end(), aVar) == o.amounts.end()) &&
+                (find(o.concentrations.begin(), o.concentrations.end(), aVar)
+                        == o.concentrations.end()))
+        {
+            theList.push_back(o.variables[i]);
+        }
+    }
+
+    return theList;
+}
+
+
+_xmlNode *RoadRunner::createConfigNode()
+{
+    // the top level capabilities
+    _xmlNode *capies = Configurable::createCapabilitiesNode("RoadRunner",
+            "RoadRunner Capabilities");
+
+    // capability for this class
+    _xmlNode *caps = Configurable::createCapabilityNode("RoadRunner Core", "",
+            "Core RoadRunner Capability");
+
+    Configurable::addChild(caps, Configurable::createParameterNode("Conservation",
+                    "enables (=true) or disables (=false) the conservation analysis of models for timecourse simulations.",
+                    (int) impl->conservedMoietyAnalysis));
+
+    Configurable::addChild(capies, caps);
+
+    // capability for child objects
+    Configurable *intConf = dynamic_cast<Configurable*>(impl->integrator);
+    if (intConf)
+    {
+        Configurable::addChild(capies, intConf->createConfigNode());
+    }
+
+
+    // nleq only exists during steadyState, so we need to create a tmp
+    // one and load it with the xml if we given.
+    NLEQInterface nleq(0);
+
+    if (impl->configurationXML.length() > 0)
+    {
+        Configurable::loadXmlConfig(impl->configurationXML, &nleq);
+    }
+
+    Configurable::addChild(capies, nleq.createConfigNode());
+
+    return capies;
+}
+
+void RoadRunner::loadConfig(const _xmlDoc* doc)
+{
+    Configurable *intConf = dynamic_cast<Configurable*>(impl->integrator);
+    if (intConf)
+    {
+        intConf->loadConfig(doc);
+    }
+}
+
+std::string RoadRunner::getConfigurationXML()
+{
+    return Configurable::xmlFromConfigNode(createConfigNode());
+}
+
+void RoadRunner::setConfigurationXML(const std::string& xml)
+{
+    impl->configurationXML = xml;
+    Configurable::loadXmlConfig(xml, this);
+}
+
+SelectionRecord RoadRunner::createSelection(const std::string& str)
+{
+    if (!impl->model)
+    {
+        throw Exception("Can not create selection without a model");
+    }
+
+    SelectionRecord sel(str);
+
+    if (sel.selectionType == SelectionRecord::UNKNOWN)
+    {
+        throw Exception("invalid selection string " + str);
+    }
+
+    // check to see that we have valid selection ids
+    switch(sel.selectionType)
+    {
+    case SelectionRecord::TIME:
+        // time is always fine...
+        break;
+    case SelectionRecord::UNKNOWN_ELEMENT:
+        // check for sbml element types
+
+        if ((sel.index = impl->model->getFloatingSpeciesIndex(sel.p1)) >= 0)
+        {
+            sel.selectionType = SelectionRecord::FLOATING_AMOUNT;
+            break;
+        }
+        else if ((sel.index = impl->model->getBoundarySpeciesIndex(sel.p1)) >= 0)
+        {
+            sel.selectionType = SelectionRecord::BOUNDARY_AMOUNT;
+            break;
+        }
+        else if ((sel.index = impl->model->getCompartmentIndex(sel.p1)) >= 0)
+        {
+            sel.selectionType = SelectionRecord::COMPARTMENT;
+            break;
+        }
+        else if ((sel.index = impl->model->getGlobalParameterIndex(sel.p1)) >= 0)
+        {
+            sel.selectionType = SelectionRecord::GLOBAL_PARAMETER;
+            break;
+        }
+        else if ((sel.index = impl->model->getReactionIndex(sel.p1)) >= 0)
+        {
+            sel.selectionType = SelectionRecord::REACTION_RATE;
+            break;
+        }
+        else
+        {
+            throw Exception("No sbml element exists for symbol '" + str + "'");
+            break;
+        }
+    case SelectionRecord::UNKNOWN_CONCENTRATION:
+        if ((sel.index = impl->model->getFloatingSpeciesIndex(sel.p1)) >= 0)
+        {
+            sel.selectionType = SelectionRecord::FLOATING_CONCENTRATION;
+            break;
+        }
+        else if ((sel.index = impl->model->getBoundarySpeciesIndex(sel.p1)) >= 0)
+        {
+            sel.selectionType = SelectionRecord::BOUNDARY_CONCENTRATION;
+            break;
+        }
+        else
+        {
+            string msg = "No sbml element exists for concentration selection '" + str + "'";
+            Log(Logger::LOG_ERROR) << msg;
+            throw Exception(msg);
+            break;
+        }
+    case SelectionRecord::FLOATING_AMOUNT_RATE:
+        if ((sel.index = impl->model->getFloatingSpeciesIndex(sel.p1)) >= 0)
+        {
+            break;
+        }
+        else
+        {
+            throw Exception("Invalid id '" + str + "' for floating amount rate");
+            break;
+        }
+    case SelectionRecord::ELASTICITY:
+    case SelectionRecord::UNSCALED_ELASTICITY:
+    case SelectionRecord::CONTROL:
+    case SelectionRecord::UNSCALED_CONTROL:
+        // check that the control coef args are valid
+        if (impl->model->getReactionIndex(sel.p1) >= 0 ||
+                impl->model->getFloatingSpeciesIndex(sel.p1) >= 0)
+
+        {
+            if (impl->model->getGlobalParameterIndex(sel.p2) >= 0 ||
+                    impl->model->getBoundarySpeciesIndex(sel.p2) >= 0 ||
+                    impl->model->getConservedMoietyIndex(sel.p2) >= 0)
+            {
+                Log(Logger::LOG_INFORMATION) <<
+                        "Valid metabolic control selection: " << sel.to_repr();
+            }
+            else
+            {
+                throw Exception("The second argument to a metabolic control "
+                        "coefficient selection, " + sel.p2 + ", must be either "
+                        "a global parameter, boundary species or conserved sum");
+            }
+        }
+        else
+        {
+            throw Exception("The first argument to a metabolic control "
+                    "coefficient selection, " + sel.p1 + ", must be either "
+                    "a reaction, floating species or conserved sum");
+        }
+
+        break;
+    case SelectionRecord::EIGENVALUE:
+        if ((sel.index = impl->model->getFloatingSpeciesIndex(sel.p1)) >= 0)
+        {
+            break;
+        }
+        else
+        {
+            throw Exception("eigen argument '" + sel.p1 + "' is not a floating species.");
+        }
+        break;
+    case SelectionRecord::STOICHIOMETRY:
+        if (impl->model->getFloatingSpeciesIndex(sel.p1) >= 0)
+        {
+            if (impl->model->getReactionIndex(sel.p2) >= 0)
+            {
+                break;
+            }
+            else
+            {
+                throw Exception("second argument to stoich '" + sel.p2 + "' is not a reaction id.");
+            }
+        }
+        else
+        {
+            throw Exception("first argument to stoich '" + sel.p1 + "' is not a floating species id.");
+        }
+        break;
+    case SelectionRecord::INITIAL_CONCENTRATION:
+        if ((sel.index = impl->model->getFloatingSpeciesIndex(sel.p1)) >= 0)
+        {
+            break;
+        }
+        else
+        {
+            throw Exception("Invalid id '" + sel.p1 + "' for floating initial concentration");
+            break;
+        }
+    default:
+        Log(Logger::LOG_ERROR) << "A new SelectionRecord should not have this value: "
+            << sel.to_repr();
+        break;
+    }
+
+    return sel;
+}
+
+void RoadRunner::setSelections(const vector<string>& _selList)
+{
+    impl->mSelectionList.clear();
+
+    for(int i = 0; i < _selList.size(); ++i)
+    {
+        impl->mSelectionList.push_back(createSelection(_selList[i]));
+    }
+}
+
+void RoadRunner::setSelections(const std::vector<rr::SelectionRecord>& ss)
+{
+    impl->mSelectionList = ss;
+}
+
+void RoadRunner::setSteadyStateSelections(const vector<string>& ss)
+{
+    impl->mSteadyStateSelection.clear();
+
+    for(int i = 0; i < ss.size(); ++i)
+    {
+        impl->mSteadyStateSelection.push_back(createSelection(ss[i]));
+    }
+}
+
+void RoadRunner::setSteadyStateSelections(const std::vector<rr::SelectionRecord>& ss)
+{
+    impl->mSteadyStateSelection = ss;
+}
+
+
+
+//Compute the frequency response, startW, Number Of Decades, Number of Points, parameterName, variableName
+Matrix<double> RoadRunner::getFrequencyResponse(double startFrequency,
+        int numberOfDecades, int numberOfPoints,
+        const string& parameterName, const string& variableName,
+        bool useDB, bool useHz)
+{
+    if (!impl->model)
+    {
+        throw CoreException(gEmptyModelMessage);
+    }
+
+    try
+    {
+        vector<string> reactionNames = getReactionIds();
+        vector<string> speciesNames = getFloatingSpeciesIds();
+
+        // Prepare the dv/dp array
+        Matrix< Complex > dvdp(reactionNames.size(), 1);
+
+        //Guess we don't need to simulate here?? (TK)
+        //        SimulateOptions opt;
+        //        opt.start = 0;
+        //        opt.duration = 50.0;
+        //        opt.steps = 1;
+        //        simulate(&opt);
+        if(steadyState() > 1E-2)
+        {
+            throw Exception("Unable to locate steady state during frequency response computation");
+        }
+
+        ComplexMatrix uelast(getUnscaledElasticityMatrix());
+        ComplexMatrix Nr = getNrMatrix();
+        ComplexMatrix LinkMatrix = getLinkMatrix();
+
+        // Compute dv/dp
+        for (int j = 0; j < reactionNames.size(); j++)
+        {
+            double val = getUnscaledParameterElasticity(reactionNames[j], parameterName);
+            dvdp(j, 0) = Complex(val, 0.0);
+            Log(lDebug)<<"dv/dp: " << dvdp(j, 0);
+        }
+
+        // Compute the Jacobian first
+        ComplexMatrix T1;
+        mult(Nr, uelast, T1);
+        Log(lInfo)<<T1;
+
+        ComplexMatrix Jac;
+        mult(T1, LinkMatrix, Jac);
+
+        // Stores iwI - Jac, only the diagonal changes with the frequency
+        ComplexMatrix T2(Jac);
+        T2 *= Complex(-1, 0);
+
+        ComplexMatrix T3(LinkMatrix.RSize(), 1);            // Stores (iwI - Jac)^-1 . Nr
+        ComplexMatrix T4(Nr.RSize(), Nr.CSize());
+        ComplexMatrix T5(LinkMatrix.RSize(), 1);
+        ComplexMatrix Inv(Nr.RSize(), LinkMatrix.CSize());
+
+        // resultArray stores frequency, gain and phase
+        Matrix<double> resultArray(numberOfPoints, 3);
+
+        // Main loop, generate log spaced frequency numbers and compute the gain and phase at each frequency
+        vector<double> w(logspace(startFrequency, numberOfDecades, numberOfPoints));
+
+        for (int i = 0; i < numberOfPoints; i++)
+        {
+            Complex diagVal(0.0, w[i]);
+
+            // Compute iwI - Jac
+            for (int j = 0; j < T2.RSize(); j++)
+            {
+                T2(j, j) = diagVal - Jac(j, j);
+            }
+
+            Inv = GetInverse(T2);       // Compute (iwI - Jac)^-1
+            mult(Inv, Nr, T3);          // Compute (iwI - Jac)^-1 . Nr
+
+            // dvdp does not depend on the frequency, it was computed above.
+            mult(T3, dvdp, T4);         // Compute(iwI - Jac)^-1 . Nr . dvdp
+
+            // Finally include the dependent set as well.
+            mult(LinkMatrix, T4, T5);   // Compute L (iwI - Jac)^-1 . Nr . dvdp
+
+            for (int j = 0; j < speciesNames.size(); j++)
+            {
+                if (speciesNames[j] == variableName)
+                {
+                    double dw = abs(T5(j, 0));
+                    if (useDB)
+                    {
+                        dw = 20.0*log10(dw);
+                    }
+                    resultArray(i,1) = dw;
+                    Complex val(T5(j, 0));
+
+                    double phase = (180.0/M_PI) * rr::phase(val) + getAdjustment(val);
+                    resultArray(i,2) = phase;
+                    break;
+                }
+            }
+            if (useHz)
+            {
+                // Store frequency, convert to Hz by dividing by 2Pi
+                resultArray[i][0] = w[i]/(2.*M_PI);
+            }
+            else
+            {
+                // Store frequency, leave as rad/sec
+                resultArray[i][0] = w[i];
+            }
+        }
+        return resultArray;
+    }
+    catch(const Exception& e)
+    {
+      throw Exception("Unexpected error in getFrequencyResponse(): " +  e.Message());
+    }
+}
+
+
+
+// Use the formula: G(iw) = C (iwI - Jac)^-1 Nr elast_p + D, where the rows of C
+// are L for species and elast L for fluxes, and D is zero for species and
+// elast_p for fluxes.
+std::vector<ComplexMatrix> RoadRunner::getTransferFunction(
+        const std::vector<double>& frequencies,
+        const std::vector<std::string>& variables,
+        const std::vector<std::string>& parameters, int nThreads)
+{
+    get_self();
+
+    if (!self.model)
+    {
+        throw CoreException(gEmptyModelMessage);
+    }
+
+    if (variables.empty() || parameters.empty())
+    {
+        throw CoreException("The transfer function needs at least one variable and one parameter");
+    }
+
+    std::vector<ParameterType> parameterTypes(parameters.size());
+    std::vector<int> parameterIndices(parameters.size());
+    for (unsigned j = 0; j < parameters.size(); j++)
+    {
+        if ((parameterIndices[j] = self.model->getGlobalParameterIndex(parameters[j])) >= 0)
+        {
+            parameterTypes[j] = ptGlobalParameter;
+        }
+        else if ((parameterIndices[j] = self.model->getBoundarySpeciesIndex(parameters[j])) >= 0)
+        {
+            parameterTypes[j] = ptBoundaryParameter;
+        }
+        else
+        {
+            throw CoreException("Unable to locate parameter: [" + parameters[j] + "]");
+        }
+    }
+
+    std::vector<VariableType> variableTypes(variables.size());
+    std::vector<int> variableIndices(variables.size());
+    for (unsigned i = 0; i < variables.size(); i++)
+    {
+        if ((variableIndices[i] = self.model->getReactionIndex(variables[i])) >= 0)
+        {
+            variableTypes[i] = vtFlux;
+        }
+        else if ((variableIndices[i] = self.model->getFloatingSpeciesIndex(variables[i])) >= 0)
+        {
+            variableTypes[i] = vtSpecies;
+        }
+        else
+        {
+            throw CoreException("Unable to locate variable: [" + variables[i] + "]");
+        }
+    }
+
+    if (steadyState() > 1E-2)
+    {
+        throw CoreException("Unable to locate steady state during frequency response computation");
+    }
+
+    const int numReactions = self.model->getNumReactions();
+    const int numFloatingSpecies = self.model->getNumFloatingSpecies();
+    const int numInputs = parameters.size();
+    const int numOutputs = variables.size();
 
+    DoubleMatrix uelastParam = self.getUnscaledParameterElasticities(
+            parameterTypes, parameterIndices);
 
-void RoadRunner::setValue(const string& sId, double dValue)
-{
-    if (!impl->model)
+    DoubleMatrix Jac, B, LinkMatrix, elastLink;
+
+    if (numReactions && numFloatingSpecies)
     {
-        throw CoreException(gEmptyModelMessage);
+        DoubleMatrix uelast = getUnscaledElasticityMatrix();
+        DoubleMatrix Nr = getNrMatrix();
+        LinkMatrix = getLinkMatrix();
+        mult(Nr, uelast, Jac);
+        mult(Jac, LinkMatrix, Jac);
+        mult(Nr, uelastParam, B);
+        mult(uelast, LinkMatrix, elastLink);
     }
 
-    impl->model->setValue(sId, dValue);
+    const int n = Jac.size() ? Jac.RSize() : 0;
 
-    SelectionRecord sel(sId);
+    DoubleMatrix C(numOutputs, n);
+    DoubleMatrix D(numOutputs, numInputs);
 
-    if (sel.selectionType == SelectionRecord::INITIAL_FLOATING_AMOUNT ||
-            sel.selectionType == SelectionRecord::INITIAL_FLOATING_CONCENTRATION)
+    for (int i = 0; i < numOutputs; i++)
     {
-        reset();
+        int k = variableIndices[i];
+
+        for (int l = 0; l < n; l++)
+        {
+            C[i][l] = variableTypes[i] == vtFlux ? elastLink[k][l] : LinkMatrix[k][l];
+        }
+
+        if (variableTypes[i] == vtFlux)
+        {
+            for (int j = 0; j < numInputs; j++)
+            {
+                D[i][j] = uelastParam[k][j];
+            }
+        }
     }
-}
 
+    TransferFunction tf(Jac, B, C, D);
 
-double RoadRunner::getValue(const std::string& sel)
-{
-    return getValue(createSelection(sel));
+    return tf.evaluate(frequencies, nThreads);
 }
 
-
-vector<double> RoadRunner::getSelectedValues()
+std::vector<SteadyStateRoot> RoadRunner::findSteadyStates(int nStarts,
+        double maxValue, unsigned long seed, int nThreads)
 {
-    if (!impl->model)
+    get_self();
+
+    if (!self.model)
     {
         throw CoreException(gEmptyModelMessage);
     }
 
-    vector<double> result;
-    result.resize(impl->mSelectionList.size());
-
-    for (int i = 0; i < impl->mSelectionList.size(); i++)
+    if (nStarts <= 0)
     {
-        result[i] = getNthSelectedOutput(i, impl->model->getTime());
+        throw CoreException("number of steady state starts must be positive");
     }
-    return result;
-}
-
-
-static std::vector<std::string> createSelectionList(const SimulateOptions& o)
-{
-    //read from settings the variables found in the amounts and concentrations lists
-    std::vector<std::string> theList;
-    SelectionRecord record;
-
-    theList.push_back("time");
-
-    int nrOfVars = o.variables.size();
 
-    for(int i = 0; i < o.amounts.size(); i++)
+    const int n = self.model->getStateVector(0);
+    std::vector<double> y(n);
+    if (n)
     {
-        theList.push_back(o.amounts[i]);        //In the setSelection list below, the [] selects the correct 'type'
+        self.model->getStateVector(&y[0]);
     }
 
-    for(int i = 0; i < o.concentrations.size(); i++)
+    if (maxValue <= 0)
     {
-        theList.push_back("[" + o.concentrations[i] + "]");
+        for (int j = 0; j < n; ++j)
+        {
+            maxValue = std::max(maxValue, 10 * fabs(y[j]));
+        }
+        maxValue = maxValue > 0 ? maxValue : 1.0;
     }
 
-    //We may have variables
-    //A variable 'exists' only in "variables", not in the amount or concentration section
+    // Latin hypercube, each column has one start in each of the nStarts
+    // strata of [0, maxValue], in random order.
+    PhiloxRandom random(seed);
+    DoubleMatrix starts(nStarts, n);
+    std::vector<int> strata(nStarts);
 
-    for(int i = 0; i < o.variables.size(); i++)
+    for (int j = 0; j < n; ++j)
     {
-        string aVar = o.variables[i];
+        for (int i = 0; i < nStarts; ++i)
+        {
+            strata[i] = i;
+        }
 
-        if ((find(o.amounts.begin(), o.amounts.end(), aVar) == o.amounts.end()) &&
-                (find(o.concentrations.begin(), o.concentrations.end(), aVar)
-                        == o.concentrations.end()))
+        for (int i = nStarts - 1; i > 0; --i)
         {
-            theList.push_back(o.variables[i]);
+            std::swap(strata[i], strata[(int)(random.uniform() * (i + 1))]);
+        }
+
+        for (int i = 0; i < nStarts; ++i)
+        {
+            starts(i, j) = maxValue * (strata[i] + random.uniform()) / nStarts;
         }
     }
 
-    return theList;
+    return searchSteadyStates(starts, nThreads);
 }
 
-
-_xmlNode *RoadRunner::createConfigNode()
+std::vector<SteadyStateRoot> RoadRunner::findSteadyStates(
+        const DoubleMatrix& initialStates, int nThreads)
 {
-    // the top level capabilities
-    _xmlNode *capies = Configurable::createCapabilitiesNode("RoadRunner",
-            "RoadRunner Capabilities");
-
-    // capability for this class
-    _xmlNode *caps = Configurable::createCapabilityNode("RoadRunner Core", "",
-            "Core RoadRunner Capability");
-
-    Configurable::addChild(caps, Configurable::createParameterNode("Conservation",
-                    "enables (=true) or disables (=false) the conservation analysis of models for timecourse simulations.",
-                    (int) impl->conservedMoietyAnalysis));
-
-    Configurable::addChild(capies, caps);
+    get_self();
 
-    // capability for child objects
-    Configurable *intConf = dynamic_cast<Configurable*>(impl->integrator);
-    if (intConf)
+    if (!self.model)
     {
-        Configurable::addChild(capies, intConf->createConfigNode());
+        throw CoreException(gEmptyModelMessage);
     }
 
-
-    // nleq only exists during steadyState, so we need to create a tmp
-    // one and load it with the xml if we given.
-    NLEQInterface nleq(0);
-
-    if (impl->configurationXML.length() > 0)
+    if (initialStates.CSize() != (unsigned)self.model->getStateVector(0))
     {
-        Configurable::loadXmlConfig(impl->configurationXML, &nleq);
+        throw CoreException("the initial states must have a column for each "
+                "state vector element");
     }
 
-    Configurable::addChild(capies, nleq.createConfigNode());
-
-    return capies;
+    return searchSteadyStates(initialStates, nThreads);
 }
 
-void RoadRunner::loadConfig(const _xmlDoc* doc)
+std::vector<SteadyStateRoot> RoadRunner::searchSteadyStates(
+        const DoubleMatrix& starts, int nThreads)
 {
-    Configurable *intConf = dynamic_cast<Configurable*>(impl->integrator);
-    if (intConf)
+    get_self();
+
+    // Newton's method on the full state vector is singular when the
+    // floating species are bound by conservation laws.
+    if (!self.conservedMoietyAnalysis)
     {
-        intConf->loadConfig(doc);
+        conservation::SparseStructuralAnalysis *sparse = self.getSparseStructural();
+        int numDependent = sparse ? sparse->getNumDepSpecies()
+                : getLibStruct()->getNumDepSpecies();
+
+        if (numDependent > 0)
+        {
+            throw CoreException("The model has " + toString(numDependent) +
+                    " conservation laws, searching for steady states requires "
+                    "conserved moiety analysis, see "
+                    "setConservedMoietyAnalysis");
+        }
     }
-}
 
-std::string RoadRunner::getConfigurationXML()
-{
-    return Configurable::xmlFromConfigNode(createConfigNode());
-}
+    const int nStarts = starts.RSize();
+    const int n = starts.CSize();
 
-void RoadRunner::setConfigurationXML(const std::string& xml)
-{
-    impl->configurationXML = xml;
-    Configurable::loadXmlConfig(xml, this);
-}
+    std::vector<SteadyStateRoot> result;
 
-SelectionRecord RoadRunner::createSelection(const std::string& str)
-{
-    if (!impl->model)
+    if (nStarts == 0)
     {
-        throw Exception("Can not create selection without a model");
+        return result;
     }
 
-    SelectionRecord sel(str);
-
-    if (sel.selectionType == SelectionRecord::UNKNOWN)
+    if (nThreads <= 0)
     {
-        throw Exception("invalid selection string " + str);
+        nThreads = Poco::Environment::processorCount();
     }
 
-    // check to see that we have valid selection ids
-    switch(sel.selectionType)
-    {
-    case SelectionRecord::TIME:
-        // time is always fine...
-        break;
-    case SelectionRecord::UNKNOWN_ELEMENT:
-        // check for sbml element types
+    nThreads = std::max(1, std::min(nThreads, nStarts));
 
-        if ((sel.index = impl->model->getFloatingSpeciesIndex(sel.p1)) >= 0)
-        {
-            sel.selectionType = SelectionRecord::FLOATING_AMOUNT;
-            break;
-        }
-        else if ((sel.index = impl->model->getBoundarySpeciesIndex(sel.p1)) >= 0)
-        {
-            sel.selectionType = SelectionRecord::BOUNDARY_AMOUNT;
-            break;
-        }
-        else if ((sel.index = impl->model->getCompartmentIndex(sel.p1)) >= 0)
-        {
-            sel.selectionType = SelectionRecord::COMPARTMENT;
-            break;
-        }
-        else if ((sel.index = impl->model->getGlobalParameterIndex(sel.p1)) >= 0)
-        {
-            sel.selectionType = SelectionRecord::GLOBAL_PARAMETER;
-            break;
-        }
-        else if ((sel.index = impl->model->getReactionIndex(sel.p1)) >= 0)
-        {
-            sel.selectionType = SelectionRecord::REACTION_RATE;
-            break;
-        }
-        else
-        {
-            throw Exception("No sbml element exists for symbol '" + str + "'");
-            break;
-        }
-    case SelectionRecord::UNKNOWN_CONCENTRATION:
-        if ((sel.index = impl->model->getFloatingSpeciesIndex(sel.p1)) >= 0)
-        {
-            sel.selectionType = SelectionRecord::FLOATING_CONCENTRATION;
-            break;
-        }
-        else if ((sel.index = impl->model->getBoundarySpeciesIndex(sel.p1)) >= 0)
+    Log(Logger::LOG_NOTICE) << "Searching for steady states from " << nStarts
+            << " starts on " << nThreads << " threads";
+
+    // evalute the model with its current state
+    self.model->getStateVectorRate(self.model->getTime(), 0, 0);
+
+    const EnsembleState state(self.model);
+
+    // the first search uses the current model, the others each get their
+    // own copy with the same parameters.
+    std::vector<ExecutableModel*> models(nThreads, (ExecutableModel*)0);
+    DoubleMatrix roots;
+    std::vector<bool> converged;
+
+    try
+    {
+        models[0] = self.model;
+        for (int i = 1; i < nThreads; ++i)
         {
-            sel.selectionType = SelectionRecord::BOUNDARY_CONCENTRATION;
-            break;
+            models[i] = self.createModelCopy();
+            state.apply(models[i]);
         }
-        else
+
+        SteadyStateSearch::solve(models, starts, roots, converged);
+    }
+    catch (...)
+    {
+        for (int i = 1; i < nThreads; ++i)
         {
-            string msg = "No sbml element exists for concentration selection '" + str + "'";
-            Log(Logger::LOG_ERROR) << msg;
-            throw Exception(msg);
-            break;
+            delete models[i];
         }
-    case SelectionRecord::FLOATING_AMOUNT_RATE:
-        if ((sel.index = impl->model->getFloatingSpeciesIndex(sel.p1)) >= 0)
+        state.apply(self.model);
+        throw;
+    }
+
+    for (int i = 1; i < nThreads; ++i)
+    {
+        delete models[i];
+    }
+
+    // merge the roots which are the same up to the Newton tolerance, in
+    // start order, so the result does not depend on the number of threads.
+    std::vector<int> unique;
+    std::vector<int> hits;
+
+    for (int i = 0; i < nStarts; ++i)
+    {
+        if (!converged[i])
         {
-            break;
+            continue;
         }
-        else
+
+        double scale = 1.0;
+        for (int j = 0; j < n; ++j)
         {
-            throw Exception("Invalid id '" + str + "' for floating amount rate");
-            break;
+            scale = std::max(scale, fabs(roots[i][j]));
         }
-    case SelectionRecord::ELASTICITY:
-    case SelectionRecord::UNSCALED_ELASTICITY:
-    case SelectionRecord::CONTROL:
-    case SelectionRecord::UNSCALED_CONTROL:
-        // check that the control coef args are valid
-        if (impl->model->getReactionIndex(sel.p1) >= 0 ||
-                impl->model->getFloatingSpeciesIndex(sel.p1) >= 0)
 
+        unsigned k = 0;
+        for (; k < unique.size(); ++k)
         {
-            if (impl->model->getGlobalParameterIndex(sel.p2) >= 0 ||
-                    impl->model->getBoundarySpeciesIndex(sel.p2) >= 0 ||
-                    impl->model->getConservedMoietyIndex(sel.p2) >= 0)
+            double diff = 0;
+            for (int j = 0; j < n; ++j)
             {
-                Log(Logger::LOG_INFORMATION) <<
-                        "Valid metabolic control selection: " << sel.to_repr();
+                diff = std::max(diff, fabs(roots[i][j] - roots[unique[k]][j]));
             }
-            else
+
+            if (diff <= 1.e-4 * scale)
             {
-                throw Exception("The second argument to a metabolic control "
-                        "coefficient selection, " + sel.p2 + ", must be either "
-                        "a global parameter, boundary species or conserved sum");
+                break;
             }
         }
-        else
-        {
-            throw Exception("The first argument to a metabolic control "
-                    "coefficient selection, " + sel.p1 + ", must be either "
-                    "a reaction, floating species or conserved sum");
-        }
 
-        break;
-    case SelectionRecord::EIGENVALUE:
-        if ((sel.index = impl->model->getFloatingSpeciesIndex(sel.p1)) >= 0)
+        if (k == unique.size())
         {
-            break;
+            unique.push_back(i);
+            hits.push_back(1);
         }
         else
         {
-            throw Exception("eigen argument '" + sel.p1 + "' is not a floating species.");
+            hits[k]++;
         }
-        break;
-    case SelectionRecord::STOICHIOMETRY:
-        if (impl->model->getFloatingSpeciesIndex(sel.p1) >= 0)
+    }
+
+    // the eigenvalues use LAPACK, which is not reentrant, so the roots are
+    // classified here, one after another.
+    SteadyStateSearch search(self.model);
+    const int numFloating = self.model->getNumFloatingSpecies();
+    std::vector<double> jac;
+
+    try
+    {
+        for (unsigned k = 0; k < unique.size(); ++k)
         {
-            if (impl->model->getReactionIndex(sel.p2) >= 0)
+            SteadyStateRoot root;
+            root.stateVector.assign(roots[unique[k]], roots[unique[k]] + n);
+            root.hits = hits[k];
+
+            if (n)
+            {
+                self.model->setStateVector(&root.stateVector[0]);
+            }
+            self.model->getStateVectorRate(self.model->getTime(), 0, 0);
+
+            root.floatingSpeciesConcentrations.resize(numFloating);
+            if (numFloating)
+            {
+                self.model->getFloatingSpeciesConcentrations(numFloating, 0,
+                        &root.floatingSpeciesConcentrations[0]);
+            }
+
+            bool negative = false;
+            for (int j = 0; j < numFloating; ++j)
+            {
+                negative = negative
+                        || root.floatingSpeciesConcentrations[j] < -1.e-9;
+            }
+
+            if (negative)
             {
-                break;
+                continue;
             }
-            else
+
+            search.jacobian(root.stateVector, jac);
+
+            root.stable = true;
+            if (n)
             {
-                throw Exception("second argument to stoich '" + sel.p2 + "' is not a reaction id.");
+                DoubleMatrix mat(n, n);
+                for (int i = 0; i < n; ++i)
+                {
+                    std::copy(&jac[i * n], &jac[i * n] + n, mat[i]);
+                }
+                root.eigenvalues = ls::getEigenValues(mat);
+
+                double maxAbs = 1.0;
+                for (unsigned j = 0; j < root.eigenvalues.size(); ++j)
+                {
+                    maxAbs = std::max(maxAbs, std::abs(root.eigenvalues[j]));
+                }
+
+                for (unsigned j = 0; j < root.eigenvalues.size(); ++j)
+                {
+                    root.stable = root.stable
+                            && root.eigenvalues[j].real() <= 1.e-8 * maxAbs;
+                }
             }
+
+            result.push_back(root);
         }
-        else
-        {
-            throw Exception("first argument to stoich '" + sel.p1 + "' is not a floating species id.");
-        }
-        break;
-    case SelectionRecord::INITIAL_CONCENTRATION:
-        if ((sel.index = impl->model->getFloatingSpeciesIndex(sel.p1)) >= 0)
-        {
-            break;
-        }
-        else
-        {
-            throw Exception("Invalid id '" + sel.p1 + "' for floating initial concentration");
-            break;
-        }
-    default:
-        Log(Logger::LOG_ERROR) << "A new SelectionRecord should not have this value: "
-            << sel.to_repr();
-        break;
+    }
+    catch (...)
+    {
+        state.apply(self.model);
+        throw;
     }
 
-    return sel;
+    // leave the current model as it was before the search
+    state.apply(self.model);
+
+    Log(Logger::LOG_NOTICE) << "Found " << result.size()
+            << " distinct steady states";
+
+    return result;
 }
 
-void RoadRunner::setSelections(const vector<string>& _selList)
+DoubleMatrix RoadRunner::continueSteadyState(const std::string& parameterId,
+        double start, double end, const ContinuationOptions* options,
+        std::vector<BifurcationPoint>* bifurcations)
 {
-    impl->mSelectionList.clear();
+    get_self();
 
-    for(int i = 0; i < _selList.size(); ++i)
+    if (!self.model)
     {
-        impl->mSelectionList.push_back(createSelection(_selList[i]));
+        throw CoreException(gEmptyModelMessage);
+    }
+
+    int index = self.model->getGlobalParameterIndex(parameterId);
+    if (index < 0)
+    {
+        throw CoreException("Continuation parameter " + parameterId
+                + " is not a global parameter");
+    }
+
+    std::vector<double> y(self.model->getStateVector(0));
+    if (y.size())
+    {
+        self.model->getStateVector(&y[0]);
+    }
+
+    // evalute the model with its current state
+    self.model->getStateVectorRate(self.model->getTime(), 0, 0);
+
+    const EnsembleState state(self.model);
+
+    ContinuationOptions defaultOptions;
+    Continuation continuation(self.model, index,
+            options ? *options : defaultOptions);
+
+    DoubleMatrix result;
+    std::vector<BifurcationPoint> points;
+
+    try
+    {
+        continuation.run(y, start, end, result, points);
     }
+    catch (...)
+    {
+        state.apply(self.model);
+        throw;
+    }
+
+    // leave the current model as it was before the continuation
+    state.apply(self.model);
+
+    if (bifurcations)
+    {
+        bifurcations->insert(bifurcations->end(), points.begin(), points.end());
+    }
+
+    return result;
 }
 
-void RoadRunner::setSelections(const std::vector<rr::SelectionRecord>& ss)
+/**
+ * the selections of one experimental data set, and the columns of the data
+ * they are compared with.
+ */
+struct FitData
 {
-    impl->mSelectionList = ss;
-}
+    const RoadRunnerData *data;
+    int timeColumn;
+    std::vector<int> columns;
+    std::vector<SelectionRecord> selections;
+};
 
-void RoadRunner::setSteadyStateSelections(const vector<string>& ss)
+/**
+ * Simulates the data sets on its own model and integrator, and returns
+ * the weighted differences to the observations.
+ */
+class FitResidual : public ResidualFunction
 {
-    impl->mSteadyStateSelection.clear();
+public:
+    FitResidual(ExecutableModel *model, bool ownsModel,
+            const SimulateOptions& opt, const EnsembleState& state,
+            const std::vector<int>& parameters,
+            const std::vector<FitData>& data) :
+        model(model), ownsModel(ownsModel), options(opt), state(state),
+        parameters(parameters), data(data), residuals(0), integrator(0)
+    {
+        for (unsigned d = 0; d < data.size(); ++d)
+        {
+            residuals += data[d].data->rSize() * data[d].columns.size();
+        }
 
-    for(int i = 0; i < ss.size(); ++i)
+        integrator = Integrator::New(&options, model);
+    }
+
+    ~FitResidual()
     {
-        impl->mSteadyStateSelection.push_back(createSelection(ss[i]));
+        delete integrator;
+        if (ownsModel)
+        {
+            delete model;
+        }
     }
-}
 
-void RoadRunner::setSteadyStateSelections(const std::vector<rr::SelectionRecord>& ss)
+    virtual int size() const
+    {
+        return residuals;
+    }
+
+    virtual void evaluate(const std::vector<double>& p, double *r)
+    {
+        simulate(p, r, HUGE_VAL);
+    }
+
+    virtual double sumOfSquares(const std::vector<double>& p, double limit)
+    {
+        return simulate(p, 0, limit);
+    }
+
+private:
+    ExecutableModel *model;
+    bool ownsModel;
+    SimulateOptions options;
+    const EnsembleState& state;
+    const std::vector<int>& parameters;
+    const std::vector<FitData>& data;
+    int residuals;
+    Integrator *integrator;
+
+    /**
+     * simulate the data sets, writing the residuals into r if it is not
+     * null, and return their sum of squares. Stops after the first row
+     * where the sum is larger than limit.
+     */
+    double simulate(const std::vector<double>& p, double *r, double limit)
+    {
+        double sum = 0;
+        int k = 0;
+
+        for (unsigned d = 0; d < data.size(); ++d)
+        {
+            const FitData& fd = data[d];
+            const DoubleMatrix& values = fd.data->getData();
+            const bool weighted = fd.data->hasWeights();
+
+            state.apply(model);
+            if (p.size())
+            {
+                model->setGlobalParameterValues(p.size(), &parameters[0], &p[0]);
+            }
+
+            double t = values(0, fd.timeColumn);
+            model->setTime(t);
+            model->getStateVectorRate(t, 0, 0);
+            integrator->restart(t);
+
+            for (unsigned row = 0; row < values.numRows(); ++row)
+            {
+                const double tout = values(row, fd.timeColumn);
+                if (tout > t)
+                {
+                    t = integrator->integrate(t, tout - t);
+                }
+
+                for (unsigned j = 0; j < fd.columns.size(); ++j)
+                {
+                    const double observed = values(row, fd.columns[j]);
+
+                    double residual = 0;
+
+                    // missing observations are NaN
+                    if (observed == observed)
+                    {
+                        double value = 0;
+                        getModelValue(model, fd.selections[j], value);
+
+                        const double weight = weighted ?
+                                fd.data->getWeight(row, fd.columns[j]) : 1.0;
+
+                        residual = weight * (value - observed);
+                    }
+
+                    sum += residual * residual;
+                    if (r)
+                    {
+                        r[k++] = residual;
+                    }
+                }
+
+                if (sum > limit)
+                {
+                    return sum;
+                }
+            }
+        }
+
+        return sum;
+    }
+};
+
+FitResult RoadRunner::fitParameters(const std::vector<RoadRunnerData>& data,
+        const std::vector<FitParameter>& parameters, const FitOptions* opt)
 {
-    impl->mSteadyStateSelection = ss;
+    return runParameterFit(data, parameters, opt ? *opt : FitOptions(), 0);
 }
 
+FitResult RoadRunner::globalFitParameters(const std::vector<RoadRunnerData>& data,
+        const std::vector<FitParameter>& parameters,
+        const GlobalFitOptions* opt)
+{
+    const GlobalFitOptions global = opt ? *opt : GlobalFitOptions();
 
+    FitOptions options;
+    options.nThreads = global.nThreads;
 
-//Compute the frequency response, startW, Number Of Decades, Number of Points, parameterName, variableName
-Matrix<double> RoadRunner::getFrequencyResponse(double startFrequency,
-        int numberOfDecades, int numberOfPoints,
-        const string& parameterName, const string& variableName,
-        bool useDB, bool useHz)
+    return runParameterFit(data, parameters, options, &global);
+}
+
+FitResult RoadRunner::runParameterFit(const std::vector<RoadRunnerData>& data,
+        const std::vector<FitParameter>& parameters, const FitOptions& options,
+        const GlobalFitOptions* global)
 {
-    if (!impl->model)
+    get_self();
+
+    if (!self.model)
     {
         throw CoreException(gEmptyModelMessage);
     }
 
-    try
+    if (SimulateOptions::getIntegratorType(self.simulateOpt.integrator) !=
+            SimulateOptions::DETERMINISTIC)
     {
-        vector<string> reactionNames = getReactionIds();
-        vector<string> speciesNames = getFloatingSpeciesIds();
+        throw CoreException("Parameter fits require a deterministic integrator");
+    }
 
-        // Prepare the dv/dp array
-        Matrix< Complex > dvdp(reactionNames.size(), 1);
+    std::vector<int> indices(parameters.size());
+    std::vector<double> initial(parameters.size());
 
-        //Guess we don't need to simulate here?? (TK)
-        //        SimulateOptions opt;
-        //        opt.start = 0;
-        //        opt.duration = 50.0;
-        //        opt.steps = 1;
-        //        simulate(&opt);
-        if(steadyState() > 1E-2)
+    for (unsigned j = 0; j < parameters.size(); ++j)
+    {
+        indices[j] = self.model->getGlobalParameterIndex(parameters[j].id);
+        if (indices[j] < 0)
         {
-            throw Exception("Unable to locate steady state during frequency response computation");
+            throw CoreException("Fit parameter " + parameters[j].id
+                    + " is not a global parameter");
         }
+        self.model->getGlobalParameterValues(1, &indices[j], &initial[j]);
+    }
 
-        ComplexMatrix uelast(getUnscaledElasticityMatrix());
-        ComplexMatrix Nr = getNrMatrix();
-        ComplexMatrix LinkMatrix = getLinkMatrix();
+    std::vector<FitData> fitData(data.size());
 
-        // Compute dv/dp
-        for (int j = 0; j < reactionNames.size(); j++)
+    for (unsigned d = 0; d < data.size(); ++d)
+    {
+        FitData& fd = fitData[d];
+        fd.data = &data[d];
+        fd.timeColumn = -1;
+
+        const std::vector<std::string>& names = data[d].getColumnNames();
+
+        if (data[d].rSize() == 0 || (int)names.size() != data[d].cSize())
         {
-            double val = getUnscaledParameterElasticity(reactionNames[j], parameterName);
-            dvdp(j, 0) = Complex(val, 0.0);
-            Log(lDebug)<<"dv/dp: " << dvdp(j, 0);
+            throw CoreException("Every fit data set needs rows and a name "
+                    "for each column");
         }
 
-        // Compute the Jacobian first
-        ComplexMatrix T1(Nr.RSize(), uelast.CSize());
-        T1 = mult(Nr, uelast);
-        Log(lInfo)<<T1;
+        for (unsigned j = 0; j < names.size(); ++j)
+        {
+            if (toUpper(names[j]) == "TIME")
+            {
+                fd.timeColumn = j;
+                continue;
+            }
 
-        ComplexMatrix Jac(Nr.RSize(), LinkMatrix.CSize());
-        Jac = mult(T1, LinkMatrix);
+            SelectionRecord sel = createSelection(names[j]);
+            double value;
+            if (!getModelValue(self.model, sel, value))
+            {
+                throw CoreException("The selection " + names[j]
+                        + " is not supported in parameter fits");
+            }
 
-        ComplexMatrix Id(Nr.RSize(), Nr.RSize());
+            fd.columns.push_back(j);
+            fd.selections.push_back(sel);
+        }
 
-        //Create Identity matrix
-        for(int i = 0; i < Id.RSize(); i++)
+        if (fd.timeColumn < 0)
         {
-            Id(i,i) = Complex(1,0);
+            throw CoreException("Every fit data set needs a time column");
         }
+    }
 
-        ComplexMatrix T2(Nr.RSize(), LinkMatrix.CSize());   // Stores iwI - Jac  and (iwI - Jac)^-1
-        ComplexMatrix T3(LinkMatrix.RSize(), 1);            // Stores (iwI - Jac)^-1 . Nr
-        ComplexMatrix T4(Nr.RSize(), Nr.CSize());
-        ComplexMatrix T5(LinkMatrix.RSize(), 1);
-        ComplexMatrix Inv(Nr.RSize(), LinkMatrix.CSize());
+    int nThreads = options.nThreads;
+    if (nThreads <= 0)
+    {
+        nThreads = Poco::Environment::processorCount();
+    }
 
-        // resultArray stores frequency, gain and phase
-        Matrix<double> resultArray(numberOfPoints, 3);
+    // the Jacobian has a column per parameter, and a generation a trial per
+    // member of the population, more threads are not used.
+    const int work = global ? std::max(4, global->populationSize > 0 ?
+            global->populationSize : 10 * (int)parameters.size()) :
+            (int)parameters.size();
+    nThreads = std::max(1, std::min(nThreads, work));
 
-        // Main loop, generate log spaced frequency numbers and compute the gain and phase at each frequency
-        vector<double> w(logspace(startFrequency, numberOfDecades, numberOfPoints));
+    Log(Logger::LOG_NOTICE) << "Fitting " << parameters.size()
+            << " parameters to " << data.size() << " data sets on "
+            << nThreads << " threads";
 
-        for (int i = 0; i < numberOfPoints; i++)
-        {
-            Complex diagVal(0.0, w[i]);
+    // evalute the model with its current state
+    self.model->getStateVectorRate(self.model->getTime(), 0, 0);
 
-            T1 = multDiag(Id, diagVal); // Compute iwI
-            T2 = subtract(T1, Jac);     // Compute iwI - Jac //// Compute (iwI - Jac)^-1
-            Inv = GetInverse(T2);
-            T3  = mult(Inv, Nr);        // Compute (iwI - Jac)^-1 . Nr
+    const EnsembleState state(self.model);
 
-            for (int j = 0; j < reactionNames.size(); j++)
-            {
-                double realPart = getUnscaledParameterElasticity(reactionNames[j], parameterName);
-                dvdp(j, 0) = ls::Complex(realPart, 0.0);
-            }
+    SimulateOptions simOpt = self.simulateOpt;
+    simOpt.integratorFlags &= ~(SimulateOptions::MULTI_STEP
+            | SimulateOptions::VARIABLE_STEP | SimulateOptions::DENSE_OUTPUT);
 
-            T4 = mult(T3, dvdp);    // Compute(iwI - Jac)^-1 . Nr . dvdp
+    // the first function uses the current model, the others each get their
+    // own copy, made from the same sbml or model library.
+    std::vector<ResidualFunction*> functions(nThreads, (ResidualFunction*)0);
+    FitResult result;
 
-            // Finally include the dependent set as well.
-            T5 = mult(LinkMatrix, T4); // Compute L (iwI - Jac)^-1 . Nr . dvdp
+    try
+    {
+        for (int i = 0; i < nThreads; ++i)
+        {
+            ExecutableModel *model = i == 0 ? self.model :
+                    self.createModelCopy();
 
-            for (int j = 0; j < speciesNames.size(); j++)
-            {
-                if (speciesNames[j] == variableName)
-                {
-                    double dw = abs(T5(j, 0));
-                    if (useDB)
-                    {
-                        dw = 20.0*log10(dw);
-                    }
-                    resultArray(i,1) = dw;
-                    Complex val(T5(j, 0));
+            functions[i] = new FitResidual(model, i != 0, simOpt, state,
+                    indices, fitData);
+        }
 
-                    double phase = (180.0/M_PI) * rr::phase(val) + getAdjustment(val);
-                    resultArray(i,2) = phase;
-                    break;
-                }
-            }
-            if (useHz)
-            {
-                // Store frequency, convert to Hz by dividing by 2Pi
-                resultArray[i][0] = w[i]/(2.*M_PI);
-            }
-            else
-            {
-                // Store frequency, leave as rad/sec
-                resultArray[i][0] = w[i];
-            }
+        if (global)
+        {
+            DifferentialEvolution de(functions, parameters, *global);
+            result = de.fit(initial);
+        }
+        else
+        {
+            LevenbergMarquardt lm(functions, parameters, options);
+            result = lm.fit(initial);
         }
-        return resultArray;
     }
-    catch(const Exception& e)
+    catch (...)
     {
-      throw Exception("Unexpected error in getFrequencyResponse(): " +  e.Message());
+        for (int i = 0; i < nThreads; ++i)
+        {
+            delete functions[i];
+        }
+        state.apply(self.model);
+        throw;
+    }
+
+    for (int i = 0; i < nThreads; ++i)
+    {
+        delete functions[i];
+    }
+
+    // leave the model as it was before the fit, with the fitted values
+    state.apply(self.model);
+    if (indices.size())
+    {
+        self.model->setGlobalParameterValues(indices.size(), &indices[0],
+                &result.values[0]);
     }
-}
 
+    // the integrator of the current model still holds the state of the
+    // fit simulations.
+    if (self.integrator)
+    {
+        self.integrator->restart(self.model->getTime());
+    }
 
+    return result;
+}
 
 double RoadRunner::getUnscaledParameterElasticity(const string& reactionName, const string& parameterName)
 {
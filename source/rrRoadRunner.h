@@ -7,10 +7,14 @@
 #include "rrRoadRunnerData.h"
 #include "rrRoadRunnerOptions.h"
 #include "Configurable.h"
+#include "rrSteadyStateSearch.h"
+#include "rrContinuation.h"
+#include "rrParameterFit.h"
 
 #include <string>
 #include <vector>
 #include <list>
+#include <iosfwd>
 
 namespace ls
 {
@@ -24,6 +28,7 @@ class ModelGenerator;
 class SBMLModelSimulation;
 class ExecutableModel;
 class Integrator;
+class EnsembleStatistics;
 
 /**
  * The main RoadRunner class.
@@ -148,6 +153,43 @@ public:
      */
     const DoubleMatrix *simulate(const SimulateOptions* options = 0);
 
+    /**
+     * run an ensemble of stochastic simulations of the current model.
+     *
+     * Each trajectory starts from the current model state and is integrated
+     * with fixed steps using the stochastic integrator given in the options.
+     * Trajectory k draws its random numbers from stream k of the seed, so the
+     * result is the same for any number of threads, and the same as
+     * simulating with the "seed" and "trajectory" simulate option keys set.
+     *
+     * The current model is left in the state it was in before the ensemble.
+     *
+     * @param nTrajectories number of trajectories.
+     * @param seed random seed of the ensemble.
+     * @param options simulate options, same as simulate.
+     * @param nThreads number of threads, the number of processor cores if
+     *        zero or negative.
+     *
+     * @returns a matrix of nTrajectories * (steps + 1) rows with a column for
+     * each selection, trajectory k is in rows k * (steps + 1) to
+     * (k + 1) * (steps + 1) - 1.
+     */
+    ls::DoubleMatrix simulateEnsemble(int nTrajectories, unsigned long seed,
+            const SimulateOptions* options = 0, int nThreads = 0);
+
+    /**
+     * run an ensemble of stochastic simulations, same as simulateEnsemble,
+     * but only keep the summary statistics of the selections at each
+     * time point, so the memory used does not depend on the number of
+     * trajectories.
+     *
+     * The trajectories are added to statistics, which is cleared first if
+     * its number of time points or selections are different.
+     */
+    void simulateEnsembleStatistics(int nTrajectories, unsigned long seed,
+            EnsembleStatistics& statistics, const SimulateOptions* options = 0,
+            int nThreads = 0);
+
     /**
      * RoadRunner keeps a copy of the simulation data around until the
      * next call to simulate. This matrix can be obtained here.
@@ -194,6 +236,35 @@ public:
      */
     void reset();
 
+    /**
+     * Save the complete current simulation state, the time, all of the
+     * model values and any pending delayed events, to a binary file.
+     *
+     * The state can later be restored with loadState into a RoadRunner
+     * object which has the same model loaded, on the same platform. This
+     * allows a long simulation to be stopped and resumed, or several
+     * simulations to be started from a single state without re-running
+     * the transient.
+     */
+    void saveState(const std::string& filename);
+
+    /**
+     * Restore a state written by saveState. The saved values are copied
+     * directly into the model, no initial conditions are evaluated, and
+     * the integrator is restarted from the restored time.
+     */
+    void loadState(const std::string& filename);
+
+    /**
+     * Same as saveState, but returns the state as a binary string.
+     */
+    std::string saveStateS();
+
+    /**
+     * Restore a state returned by saveStateS.
+     */
+    void loadStateS(const std::string& state);
+
     /**
      * @internal
      * set the floating species initial concentrations.
@@ -228,6 +299,37 @@ public:
     void load(const std::string& uriOrSBML,
             const LoadSBMLOptions* options = 0);
 
+    /**
+     * load a model library made by compileModelLibrary, the model is
+     * created without compiling anything.
+     *
+     * The model is created with the options the library was compiled with,
+     * a warning is logged if the model generator options in options differ
+     * from these, only the load flags of options are used.
+     *
+     * The library contains the sbml, which is parsed with libsbml for the
+     * structural analysis, such as the stoichiometric matrix and the
+     * conserved moieties, so loading a library still needs libsbml.
+     */
+    void loadModelLibrary(const std::string& path,
+            const LoadSBMLOptions* options = 0);
+
+    /**
+     * compile the currently loaded model ahead of time into a model library
+     * at path, with the options it was loaded with. If path has a shared
+     * library extension (.so, .dylib or .dll), the object code is linked with
+     * the system C compiler, or $CC, otherwise path is a native object file.
+     *
+     * Loading the library with loadModelLibrary is much faster than
+     * compiling the sbml,
+     * and all the processes that load it share its code, which is what
+     * makes it useful for starting many worker processes.
+     *
+     * A library can only be loaded by the same roadrunner version, on the
+     * same platform, that compiled it.
+     */
+    void compileModelLibrary(const std::string& path);
+
     /**
      * creates a new xml element that represent the current state of this
      * Configurable object and all if its child objects.
@@ -368,6 +470,116 @@ public:
             const string& parameterName, const string& variableName,
             bool useDB, bool useHz);
 
+    /**
+     * Compute the transfer function from the given parameters to the given
+     * variables at the steady state, at each of the given angular
+     * frequencies (rad/sec).
+     *
+     * The variables may be floating species or reactions, the parameters
+     * global parameters or boundary species. The reduced Jacobian is
+     * brought into Hessenberg form once, each frequency then only costs
+     * O(n^2) per parameter. The frequencies are evaluated on nThreads
+     * threads, or one per processor if nThreads <= 0.
+     *
+     * @returns one complex matrix for each frequency, the rows are the
+     * variables and the columns the parameters.
+     */
+    std::vector<ls::ComplexMatrix> getTransferFunction(
+            const std::vector<double>& frequencies,
+            const std::vector<std::string>& variables,
+            const std::vector<std::string>& parameters, int nThreads = 0);
+
+    /**
+     * Search for all the steady states of a possibly multistable model.
+     *
+     * A damped Newton iteration on the state vector rate is started from
+     * nStarts points of a Latin hypercube over [0, maxValue] in each state
+     * vector element. The starts are distributed over nThreads threads, or
+     * one per processor if nThreads <= 0, each with its own copy of the
+     * model. The parameters are those of the current model, which is left
+     * in the state it was in before.
+     *
+     * Roots which agree to a relative tolerance of 1e-4 are merged, and roots
+     * with negative concentrations are discarded.
+     *
+     * Models with conservation laws must have conserved moiety analysis
+     * enabled, otherwise a CoreException is thrown.
+     *
+     * @param maxValue upper bound of the starting values, if <= 0, ten times
+     *        the largest element of the current state vector, or one if the
+     *        state vector is zero.
+     * @param seed random seed of the Latin hypercube.
+     *
+     * @returns the distinct steady states in the order they were first found,
+     * with their eigenvalues, stability and the number of starts which
+     * converged to them.
+     */
+    std::vector<SteadyStateRoot> findSteadyStates(int nStarts,
+            double maxValue = 0, unsigned long seed = 0, int nThreads = 0);
+
+    /**
+     * Same as findSteadyStates, but start from each row of initialStates,
+     * which must have a column for each state vector element.
+     */
+    std::vector<SteadyStateRoot> findSteadyStates(
+            const ls::DoubleMatrix& initialStates, int nThreads = 0);
+
+    /**
+     * Trace the branch of steady states through the current state as the
+     * global parameter parameterId goes from start towards end, with
+     * pseudo-arclength continuation, so the branch is followed around folds.
+     *
+     * Each point is a row of the result, the parameter value, the floating
+     * species concentrations, and the number of eigenvalues of the Jacobian
+     * with a positive real part, so a zero in the last column is a stable
+     * steady state. If bifurcations is given, the folds and Hopf points
+     * that were passed are appended to it.
+     *
+     * The current model is left in the state it was in before.
+     */
+    ls::DoubleMatrix continueSteadyState(const std::string& parameterId,
+            double start, double end, const ContinuationOptions* options = 0,
+            std::vector<BifurcationPoint>* bifurcations = 0);
+
+    /**
+     * Estimate global parameters from experimental time courses with a
+     * Levenberg-Marquardt least squares fit.
+     *
+     * Each data set needs a "time" column, the other columns are selections
+     * such as "S1" or "[S1]", compared with the simulation at the times of
+     * the rows. NaN values are missing observations. If a data set has
+     * weights, each residual is multiplied by its weight, so the weights
+     * should be one over the standard deviation of the observations.
+     *
+     * Every simulation starts from the current state of the model at the
+     * time of the first row of the data set, with the integrator in the
+     * current simulate options. The finite difference Jacobian columns are
+     * evaluated in parallel, on copies of the model.
+     *
+     * The fitted values are set in the model.
+     */
+    FitResult fitParameters(const std::vector<RoadRunnerData>& data,
+            const std::vector<FitParameter>& parameters,
+            const FitOptions* options = 0);
+
+    /**
+     * Estimate global parameters with a differential evolution search
+     * within their bounds, which must all be finite, for problems where a
+     * local fit gets stuck in a local minimum.
+     *
+     * The data sets and parameters are as in fitParameters, the current
+     * values are one member of the initial population. Each generation is
+     * evaluated in parallel on copies of the model, and a simulation is
+     * stopped as soon as its partial sum of squares shows it will be
+     * rejected. The best member is then refined with fitParameters if the
+     * options ask for it.
+     *
+     * The fitted values are set in the model.
+     */
+    FitResult globalFitParameters(const std::vector<RoadRunnerData>& data,
+            const std::vector<FitParameter>& parameters,
+            const GlobalFitOptions* options = 0);
+
     /**
      * This method turns on / off the computation and adherence to conservation laws.
      */
@@ -389,6 +601,23 @@ public:
      */
     static std::string getExtendedVersionInfo();
 
+    /**
+     * Number of model loads that re-used an already compiled model,
+     * see Config::LLVM_MODEL_CACHE_SIZE.
+     */
+    static unsigned long getModelCacheHits();
+
+    /**
+     * Number of model loads that had to compile the sbml.
+     */
+    static unsigned long getModelCacheMisses();
+
+    /**
+     * Release all the compiled models retained by the model cache,
+     * models that are in use are not affected.
+     */
+    static void purgeModelCache();
+
 
     /**
      * Get unscaled control coefficient with respect to a global parameter
@@ -397,6 +626,12 @@ public:
      *
      * parameterName must be eithe a global parameter, boundary species, or
      * conserved sum.
+     *
+     * The coefficients for all global parameters and boundary species are
+     * computed together from a single steady state and factorization of the
+     * reduced Jacobian, and are re-used until a model value changes.
+     * Conserved sums are computed by perturbing them and finding the new
+     * steady states.
      */
     double getuCC(const std::string& variableName, const std::string& parameterName);
 
@@ -800,6 +1035,30 @@ private:
      */
     void createIntegrator();
 
+    /**
+     * runs the ensemble trajectories on nThreads threads, writing them
+     * into result, and / or accumulating them into statistics.
+     */
+    void runEnsemble(int nTrajectories, unsigned long seed,
+            const SimulateOptions* options, int nThreads,
+            ls::DoubleMatrix* result, EnsembleStatistics* statistics);
+
+    /**
+     * solves from the rows of starts on nThreads threads, then merges and
+     * classifies the roots.
+     */
+    std::vector<SteadyStateRoot> searchSteadyStates(
+            const ls::DoubleMatrix& starts, int nThreads);
+
+    /**
+     * sets up the residual functions of a parameter fit, one per thread,
+     * and runs a Levenberg-Marquardt fit, or a differential evolution
+     * search if global is given.
+     */
+    FitResult runParameterFit(const std::vector<RoadRunnerData>& data,
+            const std::vector<FitParameter>& parameters,
+            const FitOptions& options, const GlobalFitOptions* global);
+
     bool createDefaultSelectionLists();
 
     /**
@@ -819,6 +1078,25 @@ private:
      */
     void _setSimulateOptions(const SimulateOptions* opt);
 
+    /**
+     * compute the steady state and the unscaled response coefficients of all
+     * the floating species and reactions to all the global parameters and
+     * boundary species, unless the model values have not changed since the
+     * last time.
+     */
+    void updateResponseCoefficients();
+
+    /**
+     * write and read the state header and the model state.
+     */
+    void saveState(std::ostream& out);
+    void loadState(std::istream& in);
+
+    /**
+     * the part of load that compiles the sbml.
+     */
+    void loadSBML(const std::string& uriOrSBML, const LoadSBMLOptions* options);
+
     /**
      * private implementation class, can only access if inside
      * the implementation file.
@@ -61,6 +61,18 @@ LoadSBMLOptions::LoadSBMLOptions()
     if (Config::getBool(Config::LOADSBMLOPTIONS_USE_MCJIT))
         modelGeneratorOpt |= LoadSBMLOptions::USE_MCJIT;
 
+    if (Config::getBool(Config::LOADSBMLOPTIONS_FAST_MATH))
+        modelGeneratorOpt |= LoadSBMLOptions::FAST_MATH;
+
+    if (Config::getBool(Config::LOADSBMLOPTIONS_OPTIMIZE_ASSIGNMENT_RULES))
+        modelGeneratorOpt |= LoadSBMLOptions::OPTIMIZE_ASSIGNMENT_RULES;
+
+    if (Config::getBool(Config::LOADSBMLOPTIONS_COMPACT))
+        modelGeneratorOpt |= LoadSBMLOptions::COMPACT;
+
+    if (Config::getBool(Config::LOADSBMLOPTIONS_OPTIMIZE_NATIVE))
+        modelGeneratorOpt |= LoadSBMLOptions::OPTIMIZE_NATIVE;
+
     loadFlags = 0;
 }
 
@@ -101,6 +113,21 @@ static void getConfigValues(SimulateOptions *s)
     else if (Config::getString(Config::SIMULATEOPTIONS_INTEGRATOR) == "GILLESPIE") {
         s->integrator = SimulateOptions::GILLESPIE;
     }
+    else if (Config::getString(Config::SIMULATEOPTIONS_INTEGRATOR) == "TAU_LEAPING") {
+        s->integrator = SimulateOptions::TAU_LEAPING;
+    }
+    else if (Config::getString(Config::SIMULATEOPTIONS_INTEGRATOR) == "HYBRID") {
+        s->integrator = SimulateOptions::HYBRID;
+    }
+    else if (Config::getString(Config::SIMULATEOPTIONS_INTEGRATOR) == "RK45") {
+        s->integrator = SimulateOptions::RK45;
+    }
+    else if (Config::getString(Config::SIMULATEOPTIONS_INTEGRATOR) == "ROSENBROCK") {
+        s->integrator = SimulateOptions::ROSENBROCK;
+    }
+    else if (Config::getString(Config::SIMULATEOPTIONS_INTEGRATOR) == "IDA") {
+        s->integrator = SimulateOptions::IDA;
+    }
     else {
         Log(Logger::LOG_WARNING) << "Invalid integrator specified in configuration: "
                 << Config::getString(Config::SIMULATEOPTIONS_INTEGRATOR)
@@ -296,7 +323,7 @@ bool SimulateOptions::hasKey(const std::string& key) const
 
 SimulateOptions::IntegratorType SimulateOptions::getIntegratorType(Integrator i)
 {
-    if (i == CVODE) {
+    if (i == CVODE || i == RK45 || i == ROSENBROCK || i == IDA) {
         return DETERMINISTIC;
     } else {
         return STOCHASTIC;
@@ -329,6 +356,26 @@ std::string SimulateOptions::toString() const
         ss << "gillespie" << std::endl;
     }
 
+    else if (integrator == TAU_LEAPING ) {
+        ss << "tauleaping" << std::endl;
+    }
+
+    else if (integrator == HYBRID ) {
+        ss << "hybrid" << std::endl;
+    }
+
+    else if (integrator == RK45 ) {
+        ss << "rk45" << std::endl;
+    }
+
+    else if (integrator == ROSENBROCK ) {
+        ss << "rosenbrock" << std::endl;
+    }
+
+    else if (integrator == IDA ) {
+        ss << "ida" << std::endl;
+    }
+
     else {
         ss << "unknown" << std::endl;
     }
@@ -339,16 +386,26 @@ std::string SimulateOptions::toString() const
 
     ss << "variableStep: " << rr::toString((bool)(integratorFlags & VARIABLE_STEP)) << std::endl;
 
+    ss << "denseOutput: " << rr::toString((bool)(integratorFlags & DENSE_OUTPUT)) << std::endl;
+
     ss << "reset: " << rr::toString((bool)(flags & RESET_MODEL)) << std::endl;
 
     ss << "structuredResult: " << rr::toString((bool)(flags & STRUCTURED_RESULT)) << std::endl;
 
+    ss << "steadyStateTermination: " << rr::toString((bool)(flags & STEADY_STATE_TERMINATION)) << std::endl;
+
     ss << "steps: " << steps << std::endl;
 
     ss << "start: " << start << std::endl;
 
     ss << "duration: " << duration << std::endl;
 
+    if (times.size())
+    {
+        ss << "times: " << times.size() << " from " << times.front()
+                << " to " << times.back() << std::endl;
+    }
+
     ss << "relative: " << relative << std::endl;
 
     ss << "absolute: " << absolute << std::endl;
@@ -131,7 +131,63 @@ struct RR_DECLSPEC LoadSBMLOptions
          * The MCJIT is the new LLVM JIT engine, it is not as well tested as the
          * original JIT engine. Does NOT work on LLVM 3.1
          */
-        USE_MCJIT =                       (0x1 << 10)
+        USE_MCJIT =                       (0x1 << 10),
+
+        /**
+         * Generate floating point code with relaxed IEEE semantics,
+         * allows the optimizer to re-associate and contract arithmetic,
+         * use the LLVM exp, log and pow intrinsics, expand powers with small
+         * integer exponents into multiplications and run the SLP vectorizer.
+         *
+         * Defaults to false.
+         *
+         * Results may differ from the strict code in the last few bits,
+         * and NaN or Inf values are not guaranteed to propagate. Requires
+         * LLVM 3.3 or later, ignored otherwise.
+         */
+        FAST_MATH =                       (0x1 << 11),
+
+        /**
+         * Evaluate each assignment rule that a generated function (reaction
+         * rates, rate rules, jacobian, event assignments, ...) depends on
+         * once at the start of the function, in dependency order, and
+         * re-use the value, instead of re-generating the rule expression
+         * everywhere the symbol is used. Rules only used in the branches of
+         * a piecewise are still evaluated in their branch.
+         *
+         * Defaults to false.
+         */
+        OPTIMIZE_ASSIGNMENT_RULES =       (0x1 << 12),
+
+        /**
+         * Once all the model functions have been compiled to native code,
+         * release the LLVM IR that the execution engine would otherwise
+         * keep for the life time of the model. Only the native code and
+         * the symbol tables are kept, this can considerably reduce the
+         * memory used by each loaded model.
+         *
+         * Implies eager compilation of every generated function.
+         *
+         * Defaults to false.
+         */
+        COMPACT =                         (0x1 << 13),
+
+        /**
+         * Legacy C back end only, build the model with the system C
+         * compiler ($CC or gcc) at -O3, instead of compiling it in memory
+         * with libtcc, or with the configured compiler without
+         * optimization. $CC may be any compiler which takes gcc style
+         * options, optionally with a launcher such as ccache. Compiling
+         * takes longer, but the model runs faster, which pays off for long
+         * simulations. The compiled library is cached, so this is only paid
+         * once for each model, unlike models compiled in memory by libtcc,
+         * which are compiled again by every load.
+         *
+         * Ignored by the LLVM back end.
+         *
+         * Defaults to false.
+         */
+        OPTIMIZE_NATIVE =                 (0x1 << 14)
     };
 
     enum LoadOpt
@@ -187,15 +243,56 @@ public:
          * Simulate should return a raw result matrix without
          * adding any column names.
          */
-        STRUCTURED_RESULT       = (0x1 << 1)  // => 0x00000010
+        STRUCTURED_RESULT       = (0x1 << 1), // => 0x00000010
+
+        /**
+         * Stop a deterministic fixed step simulation once the model has
+         * reached a steady state, and fill the remaining output rows with
+         * the steady state values.
+         *
+         * At each output time the rms norm of the state vector rate, each
+         * rate scaled by absolute + relative * |value|, is compared with
+         * the threshold. The steady state is reached once the norm stayed
+         * below it for the whole window. The following keys may be set:
+         *
+         * steadyStateThreshold: defaults to 1, i.e. each value changes by
+         * less than its tolerance per unit of time.
+         *
+         * steadyStateWindow: in model time, defaults to a tenth of the
+         * simulated time.
+         *
+         * steadyStateNewton: refine the final state with the NLEQ steady
+         * state solver, defaults to false. The integrated state is kept
+         * if the solver fails.
+         *
+         * This is not used for models with events, which could change the
+         * state at any later time.
+         */
+        STEADY_STATE_TERMINATION = (0x1 << 2) // => 0x00000100
     };
 
     /**
      * the list of ODE solvers RoadRunner currently supports.
+     *
+     * TAU_LEAPING is an adaptive explicit tau-leaping stochastic integrator,
+     * much faster than GILLESPIE for models with large molecule counts.
+     *
+     * HYBRID integrates the fast reactions of abundant species with CVODE
+     * and simulates the rest stochastically.
+     *
+     * RK45 is an explicit Dormand-Prince 5(4) integrator with dense output,
+     * for non-stiff models, which switches to CVODE BDF when it detects
+     * stiffness.
+     *
+     * ROSENBROCK is a linearly implicit Rodas4 integrator for small stiff
+     * models, which uses the exact model Jacobian when it is available.
+     *
+     * IDA integrates the model as a differential algebraic system, algebraic
+     * rules and fast reactions are solved as constraints.
      */
     enum Integrator
     {
-        CVODE,  GILLESPIE
+        CVODE,  GILLESPIE, TAU_LEAPING, HYBRID, RK45, ROSENBROCK, IDA
     };
 
     /**
@@ -243,7 +340,18 @@ public:
          * integrator to best choose an adaptive time step and the resulting
          * matrix will have a non-uniform time column
          */
-        VARIABLE_STEP             = (0x1 << 2) // => 0b00000100
+        VARIABLE_STEP             = (0x1 << 2), // => 0b00000100
+
+        /**
+         * Let the CVODE integrator take its natural internal steps and
+         * interpolate the values at the output times, instead of
+         * integrating to each output time. The cost of a simulation then
+         * hardly depends on the number of output points.
+         *
+         * Only used in fixed step simulations, the RK45 and ROSENBROCK
+         * integrators always interpolate their output.
+         */
+        DENSE_OUTPUT              = (0x1 << 3) // => 0b00001000
     };
 
     /**
@@ -369,6 +477,18 @@ public:
      */
     int maximumNumSteps;
 
+    /**
+     * Output times for a deterministic fixed step simulation. If this is
+     * not empty, the result has a row for each of these times, which must
+     * be non-decreasing, and start, duration and steps are ignored. The
+     * simulation starts at the first time.
+     *
+     * In Python this is the times property.
+     */
+    #ifndef SWIG
+    std::vector<double> times;
+    #endif
+
     /**
      * set an arbitrary key
      */
@@ -0,0 +1,270 @@
+#pragma hdrstop
+#include "rrSteadyStateSearch.h"
+#include "rrExecutableModel.h"
+#include "rrException.h"
+#include "rrLogger.h"
+#include "rrWorkerPool.h"
+
+#include <sundials/sundials_dense.h>
+
+#include <Poco/Runnable.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <math.h>
+
+namespace rr
+{
+
+SteadyStateSearch::SteadyStateSearch(ExecutableModel *model,
+        int maxIterations, double tolerance) :
+        model(model), maxIterations(maxIterations), tolerance(tolerance),
+        n(model->getStateVector(0))
+{
+    f.resize(n);
+    yTrial.resize(n);
+    fTrial.resize(n);
+    step.resize(n);
+    jac.resize(n * n);
+    pivots.resize(n);
+}
+
+SteadyStateSearch::~SteadyStateSearch()
+{
+}
+
+double SteadyStateSearch::rates(const std::vector<double>& y,
+        std::vector<double>& rates)
+{
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    model->getStateVectorRate(model->getTime(), &y[0], &rates[0]);
+
+    double norm = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        if (!(fabs(rates[i]) <= std::numeric_limits<double>::max()))
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+        norm = std::max(norm, fabs(rates[i]));
+    }
+    return norm;
+}
+
+void SteadyStateSearch::jacobian(const std::vector<double>& y,
+        std::vector<double>& result)
+{
+    result.resize(n * n);
+    differences(y, n ? &result[0] : 0, false);
+}
+
+void SteadyStateSearch::differences(const std::vector<double>& y,
+        double *result, bool columnMajor)
+{
+    rates(y, f);
+    yTrial = y;
+
+    for (int j = 0; j < n; ++j)
+    {
+        const double h = 1.e-7 * std::max(fabs(y[j]), 1.e-3);
+        yTrial[j] = y[j] + h;
+        rates(yTrial, fTrial);
+        yTrial[j] = y[j];
+
+        for (int i = 0; i < n; ++i)
+        {
+            result[columnMajor ? j * n + i : i * n + j] = (fTrial[i] - f[i]) / h;
+        }
+    }
+}
+
+bool SteadyStateSearch::solve(std::vector<double>& y)
+{
+    double norm = rates(y, f);
+
+    std::vector<double*> cols(n);
+    for (int j = 0; j < n; ++j)
+    {
+        cols[j] = &jac[j * n];
+    }
+
+    for (int iter = 0; iter <= maxIterations; ++iter)
+    {
+        if (norm <= tolerance)
+        {
+            return true;
+        }
+
+        if (iter == maxIterations || !(norm < std::numeric_limits<double>::infinity()))
+        {
+            return false;
+        }
+
+        // column major for the sundials LU
+        differences(y, &jac[0], true);
+
+        if (denseGETRF(&cols[0], n, n, &pivots[0]) != 0)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            step[i] = -f[i];
+        }
+        denseGETRS(&cols[0], n, &pivots[0], &step[0]);
+
+        // halve the step until the residual decreases
+        double lambda = 1.0;
+        double trialNorm = std::numeric_limits<double>::infinity();
+
+        while (lambda >= 1.e-8)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                yTrial[i] = y[i] + lambda * step[i];
+            }
+
+            trialNorm = rates(yTrial, fTrial);
+
+            if (trialNorm < (1.0 - 1.e-4 * lambda) * norm)
+            {
+                break;
+            }
+
+            lambda *= 0.5;
+        }
+
+        if (lambda < 1.e-8)
+        {
+            // no decrease, stagnated short of the tolerance, which is not
+            // a steady state however small the rates are.
+            return false;
+        }
+
+        y.swap(yTrial);
+        f.swap(fTrial);
+        norm = trialNorm;
+    }
+
+    return false;
+}
+
+/**
+ * solves every stride'th start, beginning with first, on its own model.
+ */
+class SteadyStateSearchWorker : public Poco::Runnable
+{
+public:
+    SteadyStateSearchWorker(ExecutableModel *model,
+            const ls::DoubleMatrix& starts, ls::DoubleMatrix& roots,
+            std::vector<bool>& converged, int first, int stride) :
+        model(model), starts(starts), roots(roots), converged(converged),
+        first(first), stride(stride)
+    {
+    }
+
+    virtual void run()
+    {
+        try
+        {
+            SteadyStateSearch search(model);
+            const int n = starts.CSize();
+            std::vector<double> y(n);
+
+            for (unsigned i = first; i < starts.RSize(); i += stride)
+            {
+                std::copy(starts[i], starts[i] + n, y.begin());
+                results.push_back(search.solve(y));
+                std::copy(y.begin(), y.end(), roots[i]);
+            }
+        }
+        catch (std::exception& e)
+        {
+            error = e.what();
+        }
+        catch (...)
+        {
+            error = "unknown error";
+        }
+    }
+
+    /**
+     * the elements of a std::vector<bool> can not be written by different
+     * threads, so the results are only copied once the threads are done.
+     */
+    void collect()
+    {
+        unsigned k = 0;
+        for (unsigned i = first; i < starts.RSize() && k < results.size();
+                i += stride, ++k)
+        {
+            converged[i] = results[k] != 0;
+        }
+    }
+
+    std::string error;
+
+private:
+    ExecutableModel *model;
+    const ls::DoubleMatrix& starts;
+    ls::DoubleMatrix& roots;
+    std::vector<bool>& converged;
+    int first;
+    int stride;
+    std::vector<char> results;
+};
+
+void SteadyStateSearch::solve(const std::vector<ExecutableModel*>& models,
+        const ls::DoubleMatrix& starts, ls::DoubleMatrix& roots,
+        std::vector<bool>& converged)
+{
+    const int nThreads = models.size();
+
+    roots.resize(starts.RSize(), starts.CSize());
+    converged.assign(starts.RSize(), false);
+
+    if (nThreads == 0 || starts.RSize() == 0)
+    {
+        return;
+    }
+
+    std::vector<SteadyStateSearchWorker*> workers(nThreads);
+    for (int i = 0; i < nThreads; ++i)
+    {
+        workers[i] = new SteadyStateSearchWorker(models[i], starts, roots,
+                converged, i, nThreads);
+    }
+
+    std::string error;
+    try
+    {
+        WorkerPool(nThreads).run(workers);
+    }
+    catch (std::exception& e)
+    {
+        error = e.what();
+    }
+
+    for (int i = 0; i < nThreads; ++i)
+    {
+        if (error.empty())
+        {
+            error = workers[i]->error;
+        }
+        workers[i]->collect();
+        delete workers[i];
+    }
+
+    if (!error.empty())
+    {
+        throw CoreException("Error in steady state search: " + error);
+    }
+}
+
+} /* namespace rr */
@@ -0,0 +1,125 @@
+#ifndef RRSTEADYSTATESEARCH_H_
+#define RRSTEADYSTATESEARCH_H_
+
+#include "rrOSSpecifics.h"
+#include "rr-libstruct/lsMatrix.h"
+
+#include <vector>
+#include <complex>
+
+namespace rr
+{
+
+class ExecutableModel;
+
+/**
+ * A steady state found by RoadRunner::findSteadyStates.
+ */
+struct RR_DECLSPEC SteadyStateRoot
+{
+    /**
+     * the model state vector at the steady state, the rate rule
+     * variables followed by the independent floating species amounts.
+     */
+    std::vector<double> stateVector;
+
+    /**
+     * the concentrations of all the floating species.
+     */
+    std::vector<double> floatingSpeciesConcentrations;
+
+    /**
+     * eigenvalues of the Jacobian of the state vector rate.
+     */
+    std::vector<std::complex<double> > eigenvalues;
+
+    /**
+     * true if no eigenvalue has a positive real part. Zero eigenvalues
+     * are allowed, they are the conservation laws of models which are
+     * loaded without conserved moiety analysis.
+     */
+    bool stable;
+
+    /**
+     * number of starting points whose Newton iteration converged to this
+     * steady state.
+     */
+    int hits;
+};
+
+/**
+ * @internal
+ * Damped Newton iteration for the steady states of a model, and the finite
+ * difference Jacobian of its state vector rate.
+ *
+ * Unlike the NLEQ solver, which keeps its state in static variables, an
+ * instance only uses its own work space and model, so several instances
+ * on different models can run at the same time.
+ */
+class SteadyStateSearch
+{
+public:
+    /**
+     * a solver for the given model, the model is not owned.
+     */
+    SteadyStateSearch(ExecutableModel *model, int maxIterations = 100,
+            double tolerance = 1.e-9);
+
+    ~SteadyStateSearch();
+
+    /**
+     * Newton iteration on the state vector rate, starting from y. On
+     * success, y is the steady state and true is returned. The model is
+     * left in an unspecified state.
+     */
+    bool solve(std::vector<double>& y);
+
+    /**
+     * forward difference Jacobian of the state vector rate at y,
+     * row major in jac.
+     */
+    void jacobian(const std::vector<double>& y, std::vector<double>& jac);
+
+    /**
+     * solve from each row of starts, with one thread per model, model k
+     * gets rows k, k + models.size(), ... Row i of roots is the steady
+     * state found from row i of starts if converged[i] is true.
+     */
+    static void solve(const std::vector<ExecutableModel*>& models,
+            const ls::DoubleMatrix& starts, ls::DoubleMatrix& roots,
+            std::vector<bool>& converged);
+
+private:
+    ExecutableModel *model;
+    int maxIterations;
+    double tolerance;
+    int n;
+
+    /**
+     * work space, the rates, the trial point and its rates, the
+     * Newton step and the column major Jacobian and its pivots.
+     */
+    std::vector<double> f;
+    std::vector<double> yTrial;
+    std::vector<double> fTrial;
+    std::vector<double> step;
+    std::vector<double> jac;
+    std::vector<long> pivots;
+
+    /**
+     * forward differences of the rates at y into the n x n result, leaves
+     * the rates at y in f.
+     */
+    void differences(const std::vector<double>& y, double *result,
+            bool columnMajor);
+
+    /**
+     * evaluate the rates at y into rates, returns the max norm, or
+     * infinity if the rates are not finite.
+     */
+    double rates(const std::vector<double>& y, std::vector<double>& rates);
+};
+
+} /* namespace rr */
+
+#endif /* RRSTEADYSTATESEARCH_H_ */
@@ -0,0 +1,357 @@
+#pragma hdrstop
+#include "rrTransferFunction.h"
+#include "rrException.h"
+#include "rrLogger.h"
+#include "rrWorkerPool.h"
+
+#include <Poco/Runnable.h>
+#include <Poco/Environment.h>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+namespace rr
+{
+
+TransferFunction::TransferFunction(const ls::DoubleMatrix& A,
+        const ls::DoubleMatrix& B, const ls::DoubleMatrix& C,
+        const ls::DoubleMatrix& D) :
+        n(A.size() ? A.RSize() : 0), m(D.CSize()), p(D.RSize())
+{
+    if (n > 0 && (A.CSize() != (unsigned)n || B.RSize() != (unsigned)n
+            || B.CSize() != (unsigned)m || C.RSize() != (unsigned)p
+            || C.CSize() != (unsigned)n))
+    {
+        throw CoreException("Incompatible matrix dimensions in transfer function");
+    }
+
+    hess.resize(n * n);
+    b.resize(n * m);
+    c.resize(p * n);
+    d.resize(p * m);
+
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            hess[i * n + j] = A(i, j);
+        }
+
+        for (int j = 0; j < m; ++j)
+        {
+            b[i * m + j] = B(i, j);
+        }
+    }
+
+    for (int i = 0; i < p; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            c[i * n + j] = C(i, j);
+        }
+
+        for (int j = 0; j < m; ++j)
+        {
+            d[i * m + j] = D(i, j);
+        }
+    }
+
+    reduce();
+}
+
+void TransferFunction::reduce()
+{
+    std::vector<double> v(n);
+
+    for (int k = 0; k < n - 2; ++k)
+    {
+        // Householder vector which zeros column k below the subdiagonal
+        const int len = n - k - 1;
+        double norm = 0;
+        for (int i = 0; i < len; ++i)
+        {
+            v[i] = hess[(k + 1 + i) * n + k];
+            norm += v[i] * v[i];
+        }
+        norm = sqrt(norm);
+
+        if (norm == 0)
+        {
+            continue;
+        }
+
+        const double alpha = v[0] > 0 ? -norm : norm;
+        v[0] -= alpha;
+
+        double vv = 0;
+        for (int i = 0; i < len; ++i)
+        {
+            vv += v[i] * v[i];
+        }
+
+        if (vv == 0)
+        {
+            continue;
+        }
+
+        const double scale = 2.0 / vv;
+
+        // H = P H from the left, and b = P b
+        for (int j = k; j < n; ++j)
+        {
+            double s = 0;
+            for (int i = 0; i < len; ++i)
+            {
+                s += v[i] * hess[(k + 1 + i) * n + j];
+            }
+            s *= scale;
+            for (int i = 0; i < len; ++i)
+            {
+                hess[(k + 1 + i) * n + j] -= s * v[i];
+            }
+        }
+
+        for (int j = 0; j < m; ++j)
+        {
+            double s = 0;
+            for (int i = 0; i < len; ++i)
+            {
+                s += v[i] * b[(k + 1 + i) * m + j];
+            }
+            s *= scale;
+            for (int i = 0; i < len; ++i)
+            {
+                b[(k + 1 + i) * m + j] -= s * v[i];
+            }
+        }
+
+        // H = H P from the right, and c = c P
+        for (int i = 0; i < n; ++i)
+        {
+            double s = 0;
+            for (int l = 0; l < len; ++l)
+            {
+                s += hess[i * n + k + 1 + l] * v[l];
+            }
+            s *= scale;
+            for (int l = 0; l < len; ++l)
+            {
+                hess[i * n + k + 1 + l] -= s * v[l];
+            }
+        }
+
+        for (int i = 0; i < p; ++i)
+        {
+            double s = 0;
+            for (int l = 0; l < len; ++l)
+            {
+                s += c[i * n + k + 1 + l] * v[l];
+            }
+            s *= scale;
+            for (int l = 0; l < len; ++l)
+            {
+                c[i * n + k + 1 + l] -= s * v[l];
+            }
+        }
+
+        hess[(k + 1) * n + k] = alpha;
+        for (int i = k + 2; i < n; ++i)
+        {
+            hess[i * n + k] = 0;
+        }
+    }
+}
+
+void TransferFunction::evaluate(double w, ls::ComplexMatrix& result) const
+{
+    result.resize(p, m);
+
+    for (int i = 0; i < p; ++i)
+    {
+        for (int j = 0; j < m; ++j)
+        {
+            result(i, j) = complex(d[i * m + j], 0);
+        }
+    }
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    // M = i w I - H, and the right hand sides X = Q' B
+    std::vector<complex> mat(n * n);
+    std::vector<complex> x(n * m);
+
+    for (int i = 0; i < n; ++i)
+    {
+        // entries left of the subdiagonal are zero
+        for (int j = std::max(0, i - 1); j < n; ++j)
+        {
+            mat[i * n + j] = complex(-hess[i * n + j], 0);
+        }
+        mat[i * n + i] += complex(0, w);
+
+        for (int j = 0; j < m; ++j)
+        {
+            x[i * m + j] = complex(b[i * m + j], 0);
+        }
+    }
+
+    // Gaussian elimination with partial pivoting, only the subdiagonal
+    // needs to be eliminated, and the only pivot candidate is the next row.
+    for (int k = 0; k < n - 1; ++k)
+    {
+        if (std::abs(mat[(k + 1) * n + k]) > std::abs(mat[k * n + k]))
+        {
+            for (int j = k; j < n; ++j)
+            {
+                std::swap(mat[k * n + j], mat[(k + 1) * n + j]);
+            }
+            for (int j = 0; j < m; ++j)
+            {
+                std::swap(x[k * m + j], x[(k + 1) * m + j]);
+            }
+        }
+
+        if (mat[k * n + k] == complex(0, 0))
+        {
+            continue;
+        }
+
+        const complex l = mat[(k + 1) * n + k] / mat[k * n + k];
+        mat[(k + 1) * n + k] = 0;
+        for (int j = k + 1; j < n; ++j)
+        {
+            mat[(k + 1) * n + j] -= l * mat[k * n + j];
+        }
+        for (int j = 0; j < m; ++j)
+        {
+            x[(k + 1) * m + j] -= l * x[k * m + j];
+        }
+    }
+
+    // back substitution
+    for (int i = n - 1; i >= 0; --i)
+    {
+        const complex diag = mat[i * n + i];
+
+        if (diag == complex(0, 0))
+        {
+            const double nan = std::numeric_limits<double>::quiet_NaN();
+            for (int r = 0; r < p; ++r)
+            {
+                for (int j = 0; j < m; ++j)
+                {
+                    result(r, j) = complex(nan, nan);
+                }
+            }
+            return;
+        }
+
+        for (int j = 0; j < m; ++j)
+        {
+            complex s = x[i * m + j];
+            for (int l = i + 1; l < n; ++l)
+            {
+                s -= mat[i * n + l] * x[l * m + j];
+            }
+            x[i * m + j] = s / diag;
+        }
+    }
+
+    // G = C Q X + D
+    for (int i = 0; i < p; ++i)
+    {
+        for (int j = 0; j < m; ++j)
+        {
+            complex s = result(i, j);
+            for (int l = 0; l < n; ++l)
+            {
+                s += c[i * n + l] * x[l * m + j];
+            }
+            result(i, j) = s;
+        }
+    }
+}
+
+/**
+ * evaluates every stride'th frequency, starting with first.
+ */
+class TransferFunctionWorker : public Poco::Runnable
+{
+public:
+    TransferFunctionWorker(const TransferFunction& tf,
+            const std::vector<double>& w, std::vector<ls::ComplexMatrix>& result,
+            int first, int stride) :
+        tf(tf), w(w), result(result), first(first), stride(stride)
+    {
+    }
+
+    virtual void run()
+    {
+        for (unsigned i = first; i < w.size(); i += stride)
+        {
+            tf.evaluate(w[i], result[i]);
+        }
+    }
+
+private:
+    const TransferFunction& tf;
+    const std::vector<double>& w;
+    std::vector<ls::ComplexMatrix>& result;
+    int first;
+    int stride;
+};
+
+std::vector<ls::ComplexMatrix> TransferFunction::evaluate(
+        const std::vector<double>& w, int nThreads) const
+{
+    std::vector<ls::ComplexMatrix> result(w.size());
+
+    if (w.empty())
+    {
+        return result;
+    }
+
+    if (nThreads <= 0)
+    {
+        nThreads = Poco::Environment::processorCount();
+    }
+
+    nThreads = std::max(1, std::min(nThreads, (int)w.size()));
+
+    Log(Logger::LOG_DEBUG) << "evaluating transfer function of order " << n
+            << " at " << w.size() << " frequencies on " << nThreads << " threads";
+
+    // each worker only writes its own elements of result, which does not
+    // change size while the threads run.
+    std::vector<TransferFunctionWorker*> workers(nThreads);
+    for (int i = 0; i < nThreads; ++i)
+    {
+        workers[i] = new TransferFunctionWorker(*this, w, result, i, nThreads);
+    }
+
+    try
+    {
+        WorkerPool(nThreads).run(workers);
+    }
+    catch (...)
+    {
+        for (int i = 0; i < nThreads; ++i)
+        {
+            delete workers[i];
+        }
+        throw;
+    }
+
+    for (int i = 0; i < nThreads; ++i)
+    {
+        delete workers[i];
+    }
+
+    return result;
+}
+
+} /* namespace rr */
@@ -0,0 +1,75 @@
+#ifndef RRTRANSFERFUNCTION_H_
+#define RRTRANSFERFUNCTION_H_
+
+#include "rrOSSpecifics.h"
+#include "rr-libstruct/lsMatrix.h"
+
+#include <vector>
+#include <complex>
+
+namespace rr
+{
+
+/**
+ * @internal
+ * Evaluates the transfer function of a linear system
+ *
+ *     G(i w) = C (i w I - A)^-1 B + D
+ *
+ * at many frequencies.
+ *
+ * A is reduced once to upper Hessenberg form, A = Q H Q', with Householder
+ * reflections, and B and C are transformed to Q' B and C Q. At each
+ * frequency only the Hessenberg system (i w I - H) X = Q' B has to be
+ * solved, which takes O(n^2) operations per input instead of the O(n^3)
+ * of a full factorization or inverse.
+ *
+ * The object is not modified by evaluate, so any number of threads can
+ * evaluate different frequencies at the same time.
+ */
+class TransferFunction
+{
+public:
+    /**
+     * A is n x n, B is n x m, C is p x n and D is p x m. If A is empty,
+     * the transfer function is just D.
+     */
+    TransferFunction(const ls::DoubleMatrix& A, const ls::DoubleMatrix& B,
+            const ls::DoubleMatrix& C, const ls::DoubleMatrix& D);
+
+    /**
+     * evaluate G(i w) into the p x m result. If i w is an eigenvalue of A,
+     * the result is NaN.
+     */
+    void evaluate(double w, ls::ComplexMatrix& result) const;
+
+    /**
+     * evaluate all the frequencies, distributed over nThreads threads,
+     * or the number of processors if nThreads <= 0.
+     */
+    std::vector<ls::ComplexMatrix> evaluate(const std::vector<double>& w,
+            int nThreads) const;
+
+private:
+    typedef std::complex<double> complex;
+
+    int n, m, p;
+
+    /**
+     * row major H, Q' B and C Q, and D.
+     */
+    std::vector<double> hess;
+    std::vector<double> b;
+    std::vector<double> c;
+    std::vector<double> d;
+
+    /**
+     * reduce hess to Hessenberg form, and apply the same reflections
+     * to b and c.
+     */
+    void reduce();
+};
+
+} /* namespace rr */
+
+#endif /* RRTRANSFERFUNCTION_H_ */
@@ -0,0 +1,66 @@
+#pragma hdrstop
+#include "rrWorkerPool.h"
+#include "rrException.h"
+
+#include <Poco/Runnable.h>
+#include <Poco/ThreadPool.h>
+
+#include <algorithm>
+
+namespace rr
+{
+
+WorkerPool::WorkerPool(int nWorkers) :
+        nWorkers(std::max(1, nWorkers)), threads(0)
+{
+    if (this->nWorkers > 1)
+    {
+        // minimum capacity is the maximum, so idle threads are kept until
+        // the pool is deleted.
+        threads = new Poco::ThreadPool(this->nWorkers - 1, this->nWorkers - 1);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    delete threads;
+}
+
+int WorkerPool::size() const
+{
+    return nWorkers;
+}
+
+void WorkerPool::runAll(const std::vector<Poco::Runnable*>& workers)
+{
+    if ((int)workers.size() > nWorkers)
+    {
+        throw CoreException("more workers than the worker pool can run");
+    }
+
+    try
+    {
+        for (unsigned i = 1; i < workers.size(); ++i)
+        {
+            threads->start(*workers[i]);
+        }
+    }
+    catch (...)
+    {
+        // wait for the ones that did start, they use the caller's data.
+        threads->joinAll();
+        throw;
+    }
+
+    if (workers.size())
+    {
+        workers[0]->run();
+    }
+
+    if (threads)
+    {
+        threads->joinAll();
+    }
+}
+
+} /* namespace rr */
@@ -0,0 +1,68 @@
+#ifndef RRWORKERPOOL_H_
+#define RRWORKERPOOL_H_
+
+#include "rrOSSpecifics.h"
+
+#include <vector>
+
+namespace Poco
+{
+class Runnable;
+class ThreadPool;
+}
+
+namespace rr
+{
+
+/**
+ * Runs a set of workers in parallel, the first in the calling thread and
+ * each of the others on one of the pool's threads.
+ *
+ * The threads are created with the pool and re-used by every call to run,
+ * so an algorithm which runs its workers repeatedly, i.e. a parameter fit
+ * that evaluates the jacobian every iteration, does not create threads
+ * each time.
+ *
+ * Workers must not throw, they record their own errors, which the caller
+ * checks once run returns.
+ */
+class RR_DECLSPEC WorkerPool
+{
+public:
+    /**
+     * a pool that runs up to nWorkers workers at once, nWorkers - 1
+     * threads are created. A pool of one worker runs everything in the
+     * calling thread.
+     */
+    explicit WorkerPool(int nWorkers);
+
+    ~WorkerPool();
+
+    /**
+     * the maximum number of workers run can be given.
+     */
+    int size() const;
+
+    /**
+     * run all the workers, and wait for all of them to finish.
+     */
+    template <typename Worker>
+    void run(const std::vector<Worker*>& workers)
+    {
+        runAll(std::vector<Poco::Runnable*>(workers.begin(), workers.end()));
+    }
+
+private:
+    void runAll(const std::vector<Poco::Runnable*>& workers);
+
+    int nWorkers;
+    Poco::ThreadPool *threads;
+
+    // not copyable
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+};
+
+} /* namespace rr */
+
+#endif /* RRWORKERPOOL_H_ */
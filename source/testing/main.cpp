@@ -95,6 +95,36 @@ int main(int argc, char* argv[])
     //    clog<<"Running TestSuite Tests\n";
     runner1.RunTestsIf(Test::GetTestList(), "SBML_l2v4",       True(), 0);
 
+    clog<<"Running ModelGeneration Tests\n";
+    runner1.RunTestsIf(Test::GetTestList(), "ModelGeneration", True(), 0);
+
+    clog<<"Running Integrators Tests\n";
+    runner1.RunTestsIf(Test::GetTestList(), "Integrators", True(), 0);
+
+    clog<<"Running Ensembles Tests\n";
+    runner1.RunTestsIf(Test::GetTestList(), "Ensembles", True(), 0);
+
+    clog<<"Running SimulationState Tests\n";
+    runner1.RunTestsIf(Test::GetTestList(), "SimulationState", True(), 0);
+
+    clog<<"Running MCA Tests\n";
+    runner1.RunTestsIf(Test::GetTestList(), "MCA", True(), 0);
+
+    clog<<"Running Structural Tests\n";
+    runner1.RunTestsIf(Test::GetTestList(), "Structural", True(), 0);
+
+    clog<<"Running Matrix Tests\n";
+    runner1.RunTestsIf(Test::GetTestList(), "Matrix", True(), 0);
+
+    clog<<"Running Multistability Tests\n";
+    runner1.RunTestsIf(Test::GetTestList(), "Multistability", True(), 0);
+
+    clog<<"Running ParameterFit Tests\n";
+    runner1.RunTestsIf(Test::GetTestList(), "ParameterFit", True(), 0);
+
+    clog<<"Running ModelCache Tests\n";
+    runner1.RunTestsIf(Test::GetTestList(), "ModelCache", True(), 0);
+
     //Finish outputs result to xml file
     runner1.Finish();
     //    Pause();
@@ -0,0 +1,242 @@
+#include "unit_test/UnitTest++.h"
+#include "rrLogger.h"
+#include "rrRoadRunner.h"
+#include "rrRoadRunnerOptions.h"
+#include "rrEnsembleStatistics.h"
+#include "rrException.h"
+#include "rrStringUtils.h"
+#include "rrUtils.h"
+#include "Poco/SharedLibrary.h"
+
+#include <math.h>
+
+using namespace UnitTest;
+using namespace rr;
+using namespace std;
+
+extern string             gSBMLModelsPath;
+extern string             gTempFolder;
+
+SUITE(Ensembles)
+{
+    const int nTrajectories = 16;
+    const unsigned long seed = 1234;
+
+    SimulateOptions ensembleOptions()
+    {
+        SimulateOptions opt;
+        opt.integrator = SimulateOptions::GILLESPIE;
+        opt.start = 0;
+        opt.duration = 5;
+        opt.steps = 10;
+        return opt;
+    }
+
+    TEST(REPRODUCIBLE_THREADS)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_SimpleConservedCycle.xml"));
+        SimulateOptions opt = ensembleOptions();
+
+        ls::DoubleMatrix serial = r.simulateEnsemble(nTrajectories, seed, &opt, 1);
+        ls::DoubleMatrix parallel = r.simulateEnsemble(nTrajectories, seed, &opt, 4);
+
+        CHECK_EQUAL((unsigned)(nTrajectories * (opt.steps + 1)), serial.RSize());
+        CHECK_EQUAL(serial.RSize(), parallel.RSize());
+        CHECK_EQUAL(serial.CSize(), parallel.CSize());
+
+        for (unsigned i = 0; i < serial.RSize() && i < parallel.RSize(); ++i)
+        {
+            for (unsigned j = 0; j < serial.CSize() && j < parallel.CSize(); ++j)
+            {
+                CHECK_EQUAL(serial[i][j], parallel[i][j]);
+            }
+        }
+    }
+
+    TEST(TRAJECTORY_SAME_AS_SIMULATE)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_SimpleConservedCycle.xml"));
+        SimulateOptions opt = ensembleOptions();
+        const int rows = opt.steps + 1;
+
+        ls::DoubleMatrix ensemble = r.simulateEnsemble(nTrajectories, seed, &opt, 2);
+
+        for (int k = 0; k < nTrajectories; k += 5)
+        {
+            SimulateOptions trajectoryOpt = opt;
+            trajectoryOpt.setValue("seed", (long)seed);
+            trajectoryOpt.setValue("trajectory", (long)k);
+
+            r.reset();
+            const ls::DoubleMatrix& trajectory = *r.simulate(&trajectoryOpt);
+
+            CHECK_EQUAL((unsigned)rows, trajectory.RSize());
+            CHECK_EQUAL(ensemble.CSize(), trajectory.CSize());
+
+            for (unsigned i = 0; i < (unsigned)rows && i < trajectory.RSize(); ++i)
+            {
+                for (unsigned j = 0; j < ensemble.CSize() && j < trajectory.CSize(); ++j)
+                {
+                    CHECK_EQUAL(ensemble[k * rows + i][j], trajectory[i][j]);
+                }
+            }
+        }
+    }
+
+    TEST(DIFFERENT_SEEDS)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_SimpleConservedCycle.xml"));
+        SimulateOptions opt = ensembleOptions();
+
+        ls::DoubleMatrix a = r.simulateEnsemble(nTrajectories, seed, &opt);
+        ls::DoubleMatrix b = r.simulateEnsemble(nTrajectories, seed + 1, &opt);
+
+        bool different = false;
+        for (unsigned i = 0; i < a.RSize(); ++i)
+        {
+            for (unsigned j = 1; j < a.CSize(); ++j)
+            {
+                different = different || a[i][j] != b[i][j];
+            }
+        }
+        CHECK(different);
+    }
+
+    TEST(DETERMINISTIC_INTEGRATOR)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_SimpleConservedCycle.xml"));
+        SimulateOptions opt = ensembleOptions();
+        opt.integrator = SimulateOptions::CVODE;
+
+        CHECK_THROW(r.simulateEnsemble(nTrajectories, seed, &opt), CoreException);
+    }
+
+    TEST(MODEL_LIBRARY_THREADS)
+    {
+        string path = joinPath(gTempFolder, "ensemble_cycle_model"
+                + Poco::SharedLibrary::suffix());
+
+        RoadRunner compiled(joinPath(gSBMLModelsPath, "ss_SimpleConservedCycle.xml"));
+        compiled.compileModelLibrary(path);
+
+        // the worker models are loaded from the library, not compiled, and
+        // start from the state of the current model
+        RoadRunner r;
+        r.loadModelLibrary(path);
+        r.setValue("k1", 0.3);
+
+        SimulateOptions opt = ensembleOptions();
+        ls::DoubleMatrix serial = r.simulateEnsemble(nTrajectories, seed, &opt, 1);
+        ls::DoubleMatrix parallel = r.simulateEnsemble(nTrajectories, seed, &opt, 4);
+
+        CHECK_EQUAL((unsigned)(nTrajectories * (opt.steps + 1)), serial.RSize());
+        CHECK_EQUAL(serial.RSize(), parallel.RSize());
+        CHECK_EQUAL(serial.CSize(), parallel.CSize());
+
+        for (unsigned i = 0; i < serial.RSize() && i < parallel.RSize(); ++i)
+        {
+            for (unsigned j = 0; j < serial.CSize() && j < parallel.CSize(); ++j)
+            {
+                CHECK_EQUAL(serial[i][j], parallel[i][j]);
+            }
+        }
+
+        CHECK_EQUAL(0.3, r.getValue("k1"));
+    }
+
+    TEST(STATISTICS_SAME_AS_ENSEMBLE)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_SimpleConservedCycle.xml"));
+        SimulateOptions opt = ensembleOptions();
+        const int rows = opt.steps + 1;
+
+        ls::DoubleMatrix ensemble = r.simulateEnsemble(nTrajectories, seed, &opt);
+
+        EnsembleStatistics statistics;
+        r.simulateEnsembleStatistics(nTrajectories, seed, statistics, &opt, 3);
+
+        CHECK_EQUAL((unsigned long)nTrajectories, statistics.getCount());
+        CHECK_EQUAL(rows, statistics.numRows());
+        CHECK_EQUAL((int)ensemble.CSize(), statistics.numCols());
+
+        ls::DoubleMatrix mean = statistics.getMean();
+        ls::DoubleMatrix variance = statistics.getVariance();
+        ls::DoubleMatrix min = statistics.getMin();
+        ls::DoubleMatrix max = statistics.getMax();
+        ls::DoubleMatrix median = statistics.getQuantile(0.5);
+
+        for (int i = 0; i < rows && i < statistics.numRows(); ++i)
+        {
+            for (int j = 0; j < statistics.numCols(); ++j)
+            {
+                double sum = 0, sumSq = 0, lo = ensemble[i][j], hi = ensemble[i][j];
+                for (int k = 0; k < nTrajectories; ++k)
+                {
+                    double value = ensemble[k * rows + i][j];
+                    sum += value;
+                    lo = value < lo ? value : lo;
+                    hi = value > hi ? value : hi;
+                }
+
+                double m = sum / nTrajectories;
+                for (int k = 0; k < nTrajectories; ++k)
+                {
+                    double d = ensemble[k * rows + i][j] - m;
+                    sumSq += d * d;
+                }
+
+                CHECK_CLOSE(m, mean[i][j], 1e-10 * (1 + fabs(m)));
+                CHECK_CLOSE(sumSq / (nTrajectories - 1), variance[i][j],
+                        1e-8 * (1 + sumSq));
+                CHECK_EQUAL(lo, min[i][j]);
+                CHECK_EQUAL(hi, max[i][j]);
+                CHECK(median[i][j] >= lo && median[i][j] <= hi);
+            }
+        }
+    }
+
+    TEST(STATISTICS_MERGE)
+    {
+        EnsembleStatistics all, even, odd;
+        all.reset(1, 1);
+        even.reset(1, 1);
+        odd.reset(1, 1);
+
+        for (int i = 1; i <= 1000; ++i)
+        {
+            double value = i;
+            all.add(0, &value);
+            (i % 2 ? odd : even).add(0, &value);
+        }
+
+        even.merge(odd);
+
+        CHECK_EQUAL(1000ul, all.getCount());
+        CHECK_EQUAL(1000ul, even.getCount());
+
+        // mean and sample variance of 1 ... n are (n + 1) / 2 and n (n + 1) / 12
+        CHECK_CLOSE(500.5, all.getMean()[0][0], 1e-10);
+        CHECK_CLOSE(500.5, even.getMean()[0][0], 1e-10);
+        CHECK_CLOSE(1000. * 1001. / 12., all.getVariance()[0][0], 1e-6);
+        CHECK_CLOSE(1000. * 1001. / 12., even.getVariance()[0][0], 1e-6);
+        CHECK_EQUAL(1., even.getMin()[0][0]);
+        CHECK_EQUAL(1000., even.getMax()[0][0]);
+
+        CHECK_CLOSE(500.5, all.getQuantile(0.5)[0][0], 5);
+        CHECK_CLOSE(500.5, even.getQuantile(0.5)[0][0], 5);
+        CHECK_CLOSE(990.5, all.getQuantile(0.99)[0][0], 2);
+        CHECK_CLOSE(10.5, even.getQuantile(0.01)[0][0], 2);
+    }
+
+    TEST(STATISTICS_NO_QUANTILES)
+    {
+        EnsembleStatistics statistics(0);
+        statistics.reset(1, 1);
+
+        double value = 1;
+        statistics.add(0, &value);
+
+        CHECK_CLOSE(1, statistics.getMean()[0][0], 1e-15);
+        CHECK_THROW(statistics.getQuantile(0.5), CoreException);
+    }
+}
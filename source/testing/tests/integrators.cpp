@@ -0,0 +1,773 @@
+#include "unit_test/UnitTest++.h"
+#include "rrLogger.h"
+#include "rrRoadRunner.h"
+#include "rrRoadRunnerOptions.h"
+#include "rrException.h"
+#include "rrStringUtils.h"
+#include "rrUtils.h"
+#include "rrExecutableModel.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+using namespace UnitTest;
+using namespace rr;
+using namespace std;
+
+extern string             gSBMLModelsPath;
+
+SUITE(Integrators)
+{
+    // S1 -> S2 -> , first order, so the mean of the stochastic
+    // trajectories is the deterministic solution.
+    const char* decayModel =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<sbml xmlns=\"http://www.sbml.org/sbml/level3/version1/core\" level=\"3\" version=\"1\">"
+        "  <model id=\"decay\">"
+        "    <listOfCompartments>"
+        "      <compartment id=\"c\" size=\"1\" constant=\"true\"/>"
+        "    </listOfCompartments>"
+        "    <listOfSpecies>"
+        "      <species id=\"S1\" compartment=\"c\" initialAmount=\"1000\" hasOnlySubstanceUnits=\"true\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "      <species id=\"S2\" compartment=\"c\" initialAmount=\"0\" hasOnlySubstanceUnits=\"true\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "    </listOfSpecies>"
+        "    <listOfParameters>"
+        "      <parameter id=\"k1\" value=\"0.5\" constant=\"true\"/>"
+        "      <parameter id=\"k2\" value=\"0.2\" constant=\"true\"/>"
+        "    </listOfParameters>"
+        "    <listOfReactions>"
+        "      <reaction id=\"J0\" reversible=\"false\" fast=\"false\">"
+        "        <listOfReactants>"
+        "          <speciesReference species=\"S1\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfReactants>"
+        "        <listOfProducts>"
+        "          <speciesReference species=\"S2\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfProducts>"
+        "        <kineticLaw>"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><times/><ci>k1</ci><ci>S1</ci></apply>"
+        "          </math>"
+        "        </kineticLaw>"
+        "      </reaction>"
+        "      <reaction id=\"J1\" reversible=\"false\" fast=\"false\">"
+        "        <listOfReactants>"
+        "          <speciesReference species=\"S2\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfReactants>"
+        "        <kineticLaw>"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><times/><ci>k2</ci><ci>S2</ci></apply>"
+        "          </math>"
+        "        </kineticLaw>"
+        "      </reaction>"
+        "    </listOfReactions>"
+        "  </model>"
+        "</sbml>";
+
+    // Robertson's chemical kinetics problem, the standard stiff test case.
+    const char* robertsonModel =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<sbml xmlns=\"http://www.sbml.org/sbml/level3/version1/core\" level=\"3\" version=\"1\">"
+        "  <model id=\"robertson\">"
+        "    <listOfCompartments>"
+        "      <compartment id=\"c\" size=\"1\" constant=\"true\"/>"
+        "    </listOfCompartments>"
+        "    <listOfSpecies>"
+        "      <species id=\"A\" compartment=\"c\" initialConcentration=\"1\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "      <species id=\"B\" compartment=\"c\" initialConcentration=\"0\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "      <species id=\"C\" compartment=\"c\" initialConcentration=\"0\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "    </listOfSpecies>"
+        "    <listOfParameters>"
+        "      <parameter id=\"k1\" value=\"0.04\" constant=\"true\"/>"
+        "      <parameter id=\"k2\" value=\"3e7\" constant=\"true\"/>"
+        "      <parameter id=\"k3\" value=\"1e4\" constant=\"true\"/>"
+        "    </listOfParameters>"
+        "    <listOfReactions>"
+        "      <reaction id=\"J1\" reversible=\"false\" fast=\"false\">"
+        "        <listOfReactants>"
+        "          <speciesReference species=\"A\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfReactants>"
+        "        <listOfProducts>"
+        "          <speciesReference species=\"B\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfProducts>"
+        "        <kineticLaw>"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><times/><ci>k1</ci><ci>A</ci></apply>"
+        "          </math>"
+        "        </kineticLaw>"
+        "      </reaction>"
+        "      <reaction id=\"J2\" reversible=\"false\" fast=\"false\">"
+        "        <listOfReactants>"
+        "          <speciesReference species=\"B\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfReactants>"
+        "        <listOfProducts>"
+        "          <speciesReference species=\"C\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfProducts>"
+        "        <kineticLaw>"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><times/><ci>k2</ci><ci>B</ci><ci>B</ci></apply>"
+        "          </math>"
+        "        </kineticLaw>"
+        "      </reaction>"
+        "      <reaction id=\"J3\" reversible=\"false\" fast=\"false\">"
+        "        <listOfReactants>"
+        "          <speciesReference species=\"B\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfReactants>"
+        "        <listOfProducts>"
+        "          <speciesReference species=\"A\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfProducts>"
+        "        <listOfModifiers>"
+        "          <modifierSpeciesReference species=\"C\"/>"
+        "        </listOfModifiers>"
+        "        <kineticLaw>"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><times/><ci>k3</ci><ci>B</ci><ci>C</ci></apply>"
+        "          </math>"
+        "        </kineticLaw>"
+        "      </reaction>"
+        "    </listOfReactions>"
+        "  </model>"
+        "</sbml>";
+
+    // S1 decays, y = 2 S1 is determined by an algebraic rule, and x
+    // has a rate rule with the same solution as S1.
+    const char* algebraicModel =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<sbml xmlns=\"http://www.sbml.org/sbml/level3/version1/core\" level=\"3\" version=\"1\">"
+        "  <model id=\"algebraic\">"
+        "    <listOfCompartments>"
+        "      <compartment id=\"c\" size=\"1\" constant=\"true\"/>"
+        "    </listOfCompartments>"
+        "    <listOfSpecies>"
+        "      <species id=\"S1\" compartment=\"c\" initialConcentration=\"1\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "    </listOfSpecies>"
+        "    <listOfParameters>"
+        "      <parameter id=\"k\" value=\"0.3\" constant=\"true\"/>"
+        "      <parameter id=\"x\" value=\"1\" constant=\"false\"/>"
+        "      <parameter id=\"y\" value=\"2\" constant=\"false\"/>"
+        "    </listOfParameters>"
+        "    <listOfRules>"
+        "      <algebraicRule>"
+        "        <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "          <apply><minus/><ci>y</ci><apply><times/><cn>2</cn><ci>S1</ci></apply></apply>"
+        "        </math>"
+        "      </algebraicRule>"
+        "      <rateRule variable=\"x\">"
+        "        <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "          <apply><times/><apply><minus/><ci>k</ci></apply><ci>x</ci></apply>"
+        "        </math>"
+        "      </rateRule>"
+        "    </listOfRules>"
+        "    <listOfReactions>"
+        "      <reaction id=\"J0\" reversible=\"false\" fast=\"false\">"
+        "        <listOfReactants>"
+        "          <speciesReference species=\"S1\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfReactants>"
+        "        <kineticLaw>"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><divide/><apply><times/><ci>k</ci><ci>y</ci></apply><cn>2</cn></apply>"
+        "          </math>"
+        "        </kineticLaw>"
+        "      </reaction>"
+        "    </listOfReactions>"
+        "  </model>"
+        "</sbml>";
+
+    // S0 -> S1 is slow, S1 <-> S2 is fast, so S2 = S1 / 2 at all times and
+    // S1 + S2 = 1 - exp(-k0 t).
+    const char* fastReactionModel =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<sbml xmlns=\"http://www.sbml.org/sbml/level3/version1/core\" level=\"3\" version=\"1\">"
+        "  <model id=\"fast_reaction\">"
+        "    <listOfCompartments>"
+        "      <compartment id=\"c\" size=\"1\" constant=\"true\"/>"
+        "    </listOfCompartments>"
+        "    <listOfSpecies>"
+        "      <species id=\"S0\" compartment=\"c\" initialConcentration=\"1\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "      <species id=\"S1\" compartment=\"c\" initialConcentration=\"0\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "      <species id=\"S2\" compartment=\"c\" initialConcentration=\"0\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "    </listOfSpecies>"
+        "    <listOfParameters>"
+        "      <parameter id=\"k0\" value=\"0.4\" constant=\"true\"/>"
+        "      <parameter id=\"kf\" value=\"1\" constant=\"true\"/>"
+        "      <parameter id=\"kr\" value=\"2\" constant=\"true\"/>"
+        "    </listOfParameters>"
+        "    <listOfReactions>"
+        "      <reaction id=\"J0\" reversible=\"false\" fast=\"false\">"
+        "        <listOfReactants>"
+        "          <speciesReference species=\"S0\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfReactants>"
+        "        <listOfProducts>"
+        "          <speciesReference species=\"S1\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfProducts>"
+        "        <kineticLaw>"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><times/><ci>k0</ci><ci>S0</ci></apply>"
+        "          </math>"
+        "        </kineticLaw>"
+        "      </reaction>"
+        "      <reaction id=\"J1\" reversible=\"true\" fast=\"true\">"
+        "        <listOfReactants>"
+        "          <speciesReference species=\"S1\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfReactants>"
+        "        <listOfProducts>"
+        "          <speciesReference species=\"S2\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfProducts>"
+        "        <kineticLaw>"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><minus/><apply><times/><ci>kf</ci><ci>S1</ci></apply><apply><times/><ci>kr</ci><ci>S2</ci></apply></apply>"
+        "          </math>"
+        "        </kineticLaw>"
+        "      </reaction>"
+        "    </listOfReactions>"
+        "  </model>"
+        "</sbml>";
+
+    // S1 -> , with events between the output times of a 0.5 step, one
+    // on time, which adds 5 at t = 2.3, and one on the state, which sets
+    // S1 to 3 whenever it falls below 1, first at t = 2.3 + 2 ln(8.166).
+    const char* eventModel =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<sbml xmlns=\"http://www.sbml.org/sbml/level3/version1/core\" level=\"3\" version=\"1\">"
+        "  <model id=\"events\">"
+        "    <listOfCompartments>"
+        "      <compartment id=\"c\" size=\"1\" constant=\"true\"/>"
+        "    </listOfCompartments>"
+        "    <listOfSpecies>"
+        "      <species id=\"S1\" compartment=\"c\" initialConcentration=\"10\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "    </listOfSpecies>"
+        "    <listOfParameters>"
+        "      <parameter id=\"k\" value=\"0.5\" constant=\"true\"/>"
+        "    </listOfParameters>"
+        "    <listOfReactions>"
+        "      <reaction id=\"J1\" reversible=\"false\" fast=\"false\">"
+        "        <listOfReactants>"
+        "          <speciesReference species=\"S1\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfReactants>"
+        "        <kineticLaw>"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><times/><ci>k</ci><ci>S1</ci></apply>"
+        "          </math>"
+        "        </kineticLaw>"
+        "      </reaction>"
+        "    </listOfReactions>"
+        "    <listOfEvents>"
+        "      <event id=\"E1\" useValuesFromTriggerTime=\"true\">"
+        "        <trigger initialValue=\"false\" persistent=\"true\">"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><gt/>"
+        "              <csymbol encoding=\"text\" definitionURL=\"http://www.sbml.org/sbml/symbols/time\">time</csymbol>"
+        "              <cn>2.3</cn>"
+        "            </apply>"
+        "          </math>"
+        "        </trigger>"
+        "        <listOfEventAssignments>"
+        "          <eventAssignment variable=\"S1\">"
+        "            <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "              <apply><plus/><ci>S1</ci><cn>5</cn></apply>"
+        "            </math>"
+        "          </eventAssignment>"
+        "        </listOfEventAssignments>"
+        "      </event>"
+        "      <event id=\"E2\" useValuesFromTriggerTime=\"true\">"
+        "        <trigger initialValue=\"false\" persistent=\"true\">"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><lt/><ci>S1</ci><cn>1</cn></apply>"
+        "          </math>"
+        "        </trigger>"
+        "        <listOfEventAssignments>"
+        "          <eventAssignment variable=\"S1\">"
+        "            <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "              <cn>3</cn>"
+        "            </math>"
+        "          </eventAssignment>"
+        "        </listOfEventAssignments>"
+        "      </event>"
+        "    </listOfEvents>"
+        "  </model>"
+        "</sbml>";
+
+    SimulateOptions simulateOptions(SimulateOptions::Integrator integrator)
+    {
+        SimulateOptions opt;
+        opt.integrator = integrator;
+        opt.flags |= SimulateOptions::RESET_MODEL;
+        opt.start = 0;
+        opt.duration = 10;
+        opt.steps = 20;
+        return opt;
+    }
+
+    /**
+     * simulate the model from its initial state with tight tolerances.
+     */
+    ls::DoubleMatrix simulateAccurate(const string& sbmlOrPath,
+            SimulateOptions::Integrator integrator, double duration, int steps,
+            unsigned integratorFlags = 0)
+    {
+        RoadRunner r(sbmlOrPath);
+
+        SimulateOptions opt = simulateOptions(integrator);
+        opt.duration = duration;
+        opt.steps = steps;
+        opt.absolute = 1e-12;
+        opt.relative = 1e-8;
+        opt.integratorFlags |= integratorFlags;
+        return *r.simulate(&opt);
+    }
+
+    /**
+     * simulate the model from its initial state with tight tolerances,
+     * reporting the given times.
+     */
+    ls::DoubleMatrix simulateTimes(const string& sbmlOrPath,
+            const vector<double>& times, unsigned integratorFlags = 0)
+    {
+        RoadRunner r(sbmlOrPath);
+
+        SimulateOptions opt = simulateOptions(SimulateOptions::CVODE);
+        opt.times = times;
+        opt.absolute = 1e-12;
+        opt.relative = 1e-8;
+        opt.integratorFlags |= integratorFlags;
+        return *r.simulate(&opt);
+    }
+
+    /**
+     * mean of nTrajectories stochastic simulations, each with its own seed.
+     */
+    ls::DoubleMatrix stochasticMean(RoadRunner& r, SimulateOptions opt,
+            int nTrajectories)
+    {
+        ls::DoubleMatrix mean;
+
+        for (int k = 0; k < nTrajectories; ++k)
+        {
+            opt.setValue("seed", (long)(k + 1));
+            const ls::DoubleMatrix& result = *r.simulate(&opt);
+
+            if (k == 0)
+            {
+                mean = ls::DoubleMatrix(result.RSize(), result.CSize());
+            }
+
+            for (unsigned i = 0; i < result.RSize(); ++i)
+            {
+                for (unsigned j = 0; j < result.CSize(); ++j)
+                {
+                    mean[i][j] += result[i][j] / nTrajectories;
+                }
+            }
+        }
+        return mean;
+    }
+
+    /**
+     * check that each value is within tolerance of the expected value,
+     * relative to max(scale, |expected|).
+     */
+    void checkEqualResults(const ls::DoubleMatrix& expected,
+            const ls::DoubleMatrix& actual, double tolerance, double scale = 1)
+    {
+        CHECK_EQUAL(expected.RSize(), actual.RSize());
+        CHECK_EQUAL(expected.CSize(), actual.CSize());
+
+        for (unsigned i = 0; i < expected.RSize() && i < actual.RSize(); i++)
+        {
+            for (unsigned j = 0; j < expected.CSize() && j < actual.CSize(); j++)
+            {
+                CHECK_CLOSE(expected[i][j], actual[i][j],
+                        tolerance * max(scale, fabs(expected[i][j])));
+            }
+        }
+    }
+
+    TEST(TAU_LEAPING_MEAN)
+    {
+        RoadRunner r(decayModel);
+
+        SimulateOptions opt = simulateOptions(SimulateOptions::CVODE);
+        ls::DoubleMatrix expected = *r.simulate(&opt);
+
+        opt = simulateOptions(SimulateOptions::TAU_LEAPING);
+        ls::DoubleMatrix mean = stochasticMean(r, opt, 200);
+
+        // the standard error of the mean is about 1 molecule
+        checkEqualResults(expected, mean, 0.02, 1000);
+    }
+
+    TEST(HYBRID_MEAN)
+    {
+        RoadRunner r(decayModel);
+
+        SimulateOptions opt = simulateOptions(SimulateOptions::CVODE);
+        ls::DoubleMatrix expected = *r.simulate(&opt);
+
+        // J0 starts out fast and J1 slow, J1 becomes fast as S2 grows
+        opt = simulateOptions(SimulateOptions::HYBRID);
+        checkEqualResults(expected, stochasticMean(r, opt, 200), 0.02, 1000);
+
+        // J1 stays in the SSA partition
+        opt.setValue("hybridPartition", string("static"));
+        checkEqualResults(expected, stochasticMean(r, opt, 200), 0.02, 1000);
+    }
+
+    TEST(RK45_MODELS)
+    {
+        const char* models[] = {"feedback.xml", "ss_threestep.xml", "functest.xml"};
+
+        for (unsigned i = 0; i < sizeof(models) / sizeof(models[0]); ++i)
+        {
+            string path = joinPath(gSBMLModelsPath, models[i]);
+            checkEqualResults(
+                    simulateAccurate(path, SimulateOptions::CVODE, 20, 100),
+                    simulateAccurate(path, SimulateOptions::RK45, 20, 100),
+                    1e-5);
+        }
+    }
+
+    TEST(RK45_STIFF_SWITCH)
+    {
+        // RK45 detects the stiffness and hands the model over to CVODE
+        checkEqualResults(
+                simulateAccurate(robertsonModel, SimulateOptions::CVODE, 40, 40,
+                        SimulateOptions::STIFF),
+                simulateAccurate(robertsonModel, SimulateOptions::RK45, 40, 40),
+                1e-4, 1e-4);
+    }
+
+    TEST(ROSENBROCK_MODELS)
+    {
+        const char* models[] = {"feedback.xml", "ss_threestep.xml", "functest.xml"};
+
+        for (unsigned i = 0; i < sizeof(models) / sizeof(models[0]); ++i)
+        {
+            string path = joinPath(gSBMLModelsPath, models[i]);
+            checkEqualResults(
+                    simulateAccurate(path, SimulateOptions::CVODE, 20, 100),
+                    simulateAccurate(path, SimulateOptions::ROSENBROCK, 20, 100),
+                    1e-5);
+        }
+    }
+
+    TEST(ROSENBROCK_STIFF)
+    {
+        checkEqualResults(
+                simulateAccurate(robertsonModel, SimulateOptions::CVODE, 40, 40,
+                        SimulateOptions::STIFF),
+                simulateAccurate(robertsonModel, SimulateOptions::ROSENBROCK, 40, 40),
+                1e-4, 1e-4);
+    }
+
+    TEST(STATE_VECTOR_JACOBIAN)
+    {
+        const string models[] = {joinPath(gSBMLModelsPath, "feedback.xml"),
+                robertsonModel};
+
+        for (unsigned m = 0; m < sizeof(models) / sizeof(models[0]); ++m)
+        {
+            RoadRunner r(models[m]);
+
+            // away from the initial state, where some of the rates are zero
+            SimulateOptions opt = simulateOptions(SimulateOptions::CVODE);
+            opt.duration = 1;
+            r.simulate(&opt);
+
+            ExecutableModel *model = r.getModel();
+            const double time = model->getTime();
+            const int n = model->getStateVector(0);
+
+            vector<double> y(n), jac(n * n), up(n), down(n);
+            model->getStateVector(&y[0]);
+
+            CHECK_EQUAL(0, model->getStateVectorJacobian(time, &y[0], &jac[0]));
+
+            // central differences of the rates
+            for (int j = 0; j < n; ++j)
+            {
+                const double h = 1e-6 * max(1e-3, fabs(y[j]));
+                vector<double> yh = y;
+
+                yh[j] = y[j] + h;
+                model->getStateVectorRate(time, &yh[0], &up[0]);
+                yh[j] = y[j] - h;
+                model->getStateVectorRate(time, &yh[0], &down[0]);
+
+                for (int i = 0; i < n; ++i)
+                {
+                    double fd = (up[i] - down[i]) / (2 * h);
+                    CHECK_CLOSE(fd, jac[i * n + j], 1e-5 * max(1.0, fabs(fd)));
+                }
+            }
+        }
+    }
+
+    TEST(IDA_ALGEBRAIC_RULE)
+    {
+        RoadRunner r(algebraicModel);
+
+        vector<string> selections;
+        selections.push_back("time");
+        selections.push_back("[S1]");
+        selections.push_back("x");
+        selections.push_back("y");
+        r.setSelections(selections);
+
+        SimulateOptions opt = simulateOptions(SimulateOptions::IDA);
+        opt.absolute = 1e-12;
+        opt.relative = 1e-8;
+        const ls::DoubleMatrix& result = *r.simulate(&opt);
+
+        CHECK_EQUAL((unsigned)(opt.steps + 1), result.RSize());
+        for (unsigned i = 0; i < result.RSize(); ++i)
+        {
+            double expected = exp(-0.3 * result[i][0]);
+            CHECK_CLOSE(expected, result[i][1], 1e-6);
+            CHECK_CLOSE(expected, result[i][2], 1e-6);
+            CHECK_CLOSE(2 * expected, result[i][3], 2e-6);
+        }
+    }
+
+    TEST(IDA_FAST_REACTION)
+    {
+        RoadRunner r(fastReactionModel);
+
+        vector<string> selections;
+        selections.push_back("time");
+        selections.push_back("[S0]");
+        selections.push_back("[S1]");
+        selections.push_back("[S2]");
+        r.setSelections(selections);
+
+        SimulateOptions opt = simulateOptions(SimulateOptions::IDA);
+        opt.absolute = 1e-12;
+        opt.relative = 1e-8;
+        const ls::DoubleMatrix& result = *r.simulate(&opt);
+
+        CHECK_EQUAL((unsigned)(opt.steps + 1), result.RSize());
+        for (unsigned i = 0; i < result.RSize(); ++i)
+        {
+            double s0 = exp(-0.4 * result[i][0]);
+            CHECK_CLOSE(s0, result[i][1], 1e-6);
+            CHECK_CLOSE(2 * (1 - s0) / 3, result[i][2], 1e-6);
+            CHECK_CLOSE((1 - s0) / 3, result[i][3], 1e-6);
+        }
+    }
+
+    TEST(DENSE_OUTPUT)
+    {
+        const string models[] = {joinPath(gSBMLModelsPath, "feedback.xml"),
+                joinPath(gSBMLModelsPath, "ss_threestep.xml"),
+                joinPath(gSBMLModelsPath, "functest.xml"), eventModel};
+
+        // interpolated instead of integrated to each output time
+        for (unsigned m = 0; m < sizeof(models) / sizeof(models[0]); ++m)
+        {
+            checkEqualResults(
+                    simulateAccurate(models[m], SimulateOptions::CVODE, 10, 20),
+                    simulateAccurate(models[m], SimulateOptions::CVODE, 10, 20,
+                            SimulateOptions::DENSE_OUTPUT), 1e-5);
+        }
+    }
+
+    TEST(DENSE_OUTPUT_EVENTS)
+    {
+        // both events happen between output times
+        const double t2 = 2.3 + 2 * log(10 * exp(-1.15) + 5);
+
+        for (int dense = 0; dense < 2; ++dense)
+        {
+            ls::DoubleMatrix result = simulateAccurate(eventModel,
+                    SimulateOptions::CVODE, 10, 20,
+                    dense ? SimulateOptions::DENSE_OUTPUT : 0);
+
+            CHECK_EQUAL(21u, result.RSize());
+            CHECK_EQUAL(2u, result.CSize());
+            if (result.RSize() != 21 || result.CSize() != 2)
+            {
+                continue;
+            }
+
+            for (unsigned i = 0; i < result.RSize(); ++i)
+            {
+                const double t = result[i][0];
+                CHECK_CLOSE(0.5 * i, t, 1e-12);
+
+                double expected;
+                if (t < 2.3)
+                {
+                    expected = 10 * exp(-0.5 * t);
+                }
+                else if (t < t2)
+                {
+                    expected = (10 * exp(-1.15) + 5) * exp(-0.5 * (t - 2.3));
+                }
+                else if (t < t2 + 2 * log(3.0))
+                {
+                    expected = 3 * exp(-0.5 * (t - t2));
+                }
+                else
+                {
+                    continue;
+                }
+
+                CHECK_CLOSE(expected, result[i][1], 1e-5);
+            }
+        }
+    }
+
+    TEST(OUTPUT_TIMES)
+    {
+        // a subset of the uniform grid gives the same rows
+        const double grid[] = {0, 0.5, 2, 2.5, 7, 7, 10};
+        vector<double> times(grid, grid + sizeof(grid) / sizeof(grid[0]));
+        const int rows[] = {0, 1, 4, 5, 14, 14, 20};
+
+        const string models[] = {joinPath(gSBMLModelsPath, "feedback.xml"),
+                eventModel};
+
+        for (unsigned m = 0; m < sizeof(models) / sizeof(models[0]); ++m)
+        {
+            ls::DoubleMatrix uniform = simulateAccurate(models[m],
+                    SimulateOptions::CVODE, 10, 20);
+
+            ls::DoubleMatrix expected(times.size(), uniform.CSize());
+            for (unsigned i = 0; i < times.size(); ++i)
+            {
+                for (unsigned j = 0; j < uniform.CSize(); ++j)
+                {
+                    expected[i][j] = uniform[rows[i]][j];
+                }
+            }
+
+            checkEqualResults(expected, simulateTimes(models[m], times), 1e-5);
+            checkEqualResults(expected, simulateTimes(models[m], times,
+                    SimulateOptions::DENSE_OUTPUT), 1e-5);
+        }
+
+        // non-uniform times just before and after the timed event
+        const double eventGrid[] = {0, 0.3, 1.7, 2.29, 2.31, 4, 6};
+        times.assign(eventGrid, eventGrid + sizeof(eventGrid) / sizeof(eventGrid[0]));
+
+        for (int dense = 0; dense < 2; ++dense)
+        {
+            ls::DoubleMatrix result = simulateTimes(eventModel, times,
+                    dense ? SimulateOptions::DENSE_OUTPUT : 0);
+
+            CHECK_EQUAL(times.size(), result.RSize());
+            for (unsigned i = 0; i < times.size() && i < result.RSize(); ++i)
+            {
+                const double t = times[i];
+                const double expected = t < 2.3 ? 10 * exp(-0.5 * t) :
+                        (10 * exp(-1.15) + 5) * exp(-0.5 * (t - 2.3));
+
+                CHECK_CLOSE(t, result[i][0], 1e-12);
+                CHECK_CLOSE(expected, result[i][1], 1e-5);
+            }
+        }
+
+        // the times must not decrease
+        times[2] = 0.1;
+        CHECK_THROW(simulateTimes(eventModel, times), CoreException);
+    }
+
+    /**
+     * the first row from which all the following rows have the same
+     * values, apart from the time.
+     */
+    unsigned firstConstantRow(const ls::DoubleMatrix& result)
+    {
+        unsigned row = result.RSize() - 1;
+        while (row > 0)
+        {
+            bool same = true;
+            for (unsigned j = 1; j < result.CSize(); ++j)
+            {
+                same = same && result[row - 1][j] == result[row][j];
+            }
+            if (!same)
+            {
+                break;
+            }
+            --row;
+        }
+        return row;
+    }
+
+    TEST(STEADY_STATE_TERMINATION)
+    {
+        // Xo -> S1 -> S2 -> S3 -> X1, relaxes to S1 = k1 / k2, ...
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_threestep.xml"));
+
+        vector<string> selections;
+        selections.push_back("time");
+        selections.push_back("[S1]");
+        selections.push_back("[S2]");
+        selections.push_back("[S3]");
+        r.setSelections(selections);
+
+        const double k1 = r.getValue("k1");
+        const double steadyState[] = {k1 / r.getValue("k2"),
+                k1 / r.getValue("k3"), k1 / r.getValue("k4")};
+
+        SimulateOptions opt = simulateOptions(SimulateOptions::CVODE);
+        opt.duration = 1000;
+        opt.steps = 100;
+        const ls::DoubleMatrix full = *r.simulate(&opt);
+
+        for (int newton = 0; newton < 2; ++newton)
+        {
+            opt.flags |= SimulateOptions::STEADY_STATE_TERMINATION;
+            opt.setValue("steadyStateNewton", (bool)newton);
+            ls::DoubleMatrix result = *r.simulate(&opt);
+
+            CHECK_EQUAL(101u, result.RSize());
+            CHECK_EQUAL(4u, result.CSize());
+            if (result.RSize() != 101 || result.CSize() != 4)
+            {
+                continue;
+            }
+
+            // stopped well before the end, the window is a tenth of the
+            // simulated time
+            const unsigned row = firstConstantRow(result);
+            CHECK(row > 10 && row < 50);
+
+            for (unsigned i = 0; i < result.RSize(); ++i)
+            {
+                CHECK_CLOSE(10.0 * i, result[i][0], 1e-9);
+            }
+
+            for (unsigned j = 1; j < 4; ++j)
+            {
+                // the integrated rows are the same as without termination
+                for (unsigned i = 0; i < row; ++i)
+                {
+                    CHECK_CLOSE(full[i][j], result[i][j], 1e-9);
+                }
+
+                // and the rest hold the steady state
+                for (unsigned i = row; i < result.RSize(); ++i)
+                {
+                    CHECK_CLOSE(steadyState[j - 1], result[i][j],
+                            newton ? 1e-9 : 1e-4);
+                }
+            }
+        }
+    }
+
+    TEST(STEADY_STATE_TERMINATION_EVENTS)
+    {
+        // the events could change the state at any time, so the simulation
+        // always runs to the end
+        SimulateOptions opt = simulateOptions(SimulateOptions::CVODE);
+        opt.duration = 50;
+        opt.steps = 100;
+
+        RoadRunner r(eventModel);
+        const ls::DoubleMatrix full = *r.simulate(&opt);
+
+        opt.flags |= SimulateOptions::STEADY_STATE_TERMINATION;
+        checkEqualResults(full, *r.simulate(&opt), 1e-12);
+    }
+}
@@ -0,0 +1,191 @@
+#include "unit_test/UnitTest++.h"
+#include "rrLogger.h"
+#include "rr-libstruct/lsMatrix.h"
+
+#include <math.h>
+
+using namespace UnitTest;
+using namespace std;
+
+SUITE(Matrix)
+{
+    /**
+     * rows x cols matrix with distinct, non integer entries.
+     */
+    ls::DoubleMatrix makeMatrix(unsigned rows, unsigned cols, double offset)
+    {
+        ls::DoubleMatrix m(rows, cols);
+        for (unsigned i = 0; i < rows; ++i)
+        {
+            for (unsigned j = 0; j < cols; ++j)
+            {
+                m[i][j] = offset + 1.5 * i - 0.25 * j + 0.1 * i * j;
+            }
+        }
+        return m;
+    }
+
+    ls::DoubleMatrix naiveProduct(const ls::DoubleMatrix& a,
+            const ls::DoubleMatrix& b)
+    {
+        ls::DoubleMatrix c(a.RSize(), b.CSize());
+        for (unsigned i = 0; i < a.RSize(); ++i)
+        {
+            for (unsigned j = 0; j < b.CSize(); ++j)
+            {
+                for (unsigned k = 0; k < a.CSize(); ++k)
+                {
+                    c[i][j] += a[i][k] * b[k][j];
+                }
+            }
+        }
+        return c;
+    }
+
+    void checkEqualMatrices(const ls::DoubleMatrix& expected,
+            const ls::DoubleMatrix& actual)
+    {
+        CHECK_EQUAL(expected.RSize(), actual.RSize());
+        CHECK_EQUAL(expected.CSize(), actual.CSize());
+
+        for (unsigned i = 0; i < expected.RSize() && i < actual.RSize(); ++i)
+        {
+            for (unsigned j = 0; j < expected.CSize() && j < actual.CSize(); ++j)
+            {
+                CHECK_CLOSE(expected[i][j], actual[i][j],
+                        1e-12 * (1 + fabs(expected[i][j])));
+            }
+        }
+    }
+
+    TEST(GEMM_NON_SQUARE)
+    {
+        ls::DoubleMatrix a = makeMatrix(2, 3, 1);
+        ls::DoubleMatrix b = makeMatrix(3, 4, -2);
+
+        // C is resized when beta is zero
+        ls::DoubleMatrix c(5, 5);
+        ls::gemm(1, a, b, 0, c);
+        checkEqualMatrices(naiveProduct(a, b), c);
+
+        ls::DoubleMatrix d;
+        ls::mult(b, makeMatrix(4, 1, 0.5), d);
+        checkEqualMatrices(naiveProduct(b, makeMatrix(4, 1, 0.5)), d);
+
+        // row and column vectors
+        ls::DoubleMatrix row = makeMatrix(1, 3, 2);
+        ls::DoubleMatrix column = makeMatrix(3, 1, -1);
+        ls::mult(row, column, d);
+        checkEqualMatrices(naiveProduct(row, column), d);
+        ls::mult(column, row, d);
+        checkEqualMatrices(naiveProduct(column, row), d);
+    }
+
+    TEST(GEMM_ALPHA_BETA)
+    {
+        ls::DoubleMatrix a = makeMatrix(3, 2, 1);
+        ls::DoubleMatrix b = makeMatrix(2, 4, 3);
+        ls::DoubleMatrix c = makeMatrix(3, 4, -1);
+
+        ls::DoubleMatrix expected = naiveProduct(a, b);
+        for (unsigned i = 0; i < expected.RSize(); ++i)
+        {
+            for (unsigned j = 0; j < expected.CSize(); ++j)
+            {
+                expected[i][j] = 2 * expected[i][j] + 0.5 * c[i][j];
+            }
+        }
+
+        ls::gemm(2, a, b, 0.5, c);
+        checkEqualMatrices(expected, c);
+
+        // C must already have the size of the product if it is accumulated
+        ls::DoubleMatrix wrong(3, 3);
+        CHECK_THROW(ls::gemm(1, a, b, 1, wrong), const char*);
+        CHECK_THROW(ls::gemm(1, a, a, 0, wrong), const char*);
+    }
+
+    TEST(GEMM_ALIASING)
+    {
+        ls::DoubleMatrix a = makeMatrix(2, 3, 1);
+        ls::DoubleMatrix b = makeMatrix(3, 3, -2);
+        ls::DoubleMatrix expected = naiveProduct(a, b);
+
+        // result is the left operand, and changes size
+        ls::DoubleMatrix c = makeMatrix(3, 2, 4);
+        ls::DoubleMatrix e = makeMatrix(2, 3, 1);
+        ls::DoubleMatrix ce = naiveProduct(c, e);
+        ls::mult(c, e, c);
+        checkEqualMatrices(ce, c);
+
+        // result is the right operand
+        ls::mult(a, b, b);
+        checkEqualMatrices(expected, b);
+
+        // both operands and the result are the same matrix
+        ls::DoubleMatrix s = makeMatrix(3, 3, 0.5);
+        ls::DoubleMatrix ss = naiveProduct(s, s);
+        ls::mult(s, s, s);
+        checkEqualMatrices(ss, s);
+
+        // accumulated into an operand, C = A C + C
+        ls::DoubleMatrix sq = makeMatrix(3, 3, 1);
+        ls::DoubleMatrix t = makeMatrix(3, 3, -1);
+        ls::DoubleMatrix expectedAcc = naiveProduct(sq, t);
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            for (unsigned j = 0; j < 3; ++j)
+            {
+                expectedAcc[i][j] += t[i][j];
+            }
+        }
+        ls::gemm(1, sq, t, 1, t);
+        checkEqualMatrices(expectedAcc, t);
+    }
+
+    TEST(GEMM_COMPLEX_ALIASING)
+    {
+        ls::ComplexMatrix a(2, 3), b(3, 2);
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            for (unsigned j = 0; j < 3; ++j)
+            {
+                a[i][j] = ls::Complex(i + 1, 0.5 * j);
+                b[j][i] = ls::Complex(j - 1.0, i + 0.25);
+            }
+        }
+
+        ls::ComplexMatrix expected(2, 2);
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            for (unsigned j = 0; j < 2; ++j)
+            {
+                for (unsigned k = 0; k < 3; ++k)
+                {
+                    expected[i][j] += a[i][k] * b[k][j];
+                }
+            }
+        }
+
+        ls::mult(a, b, a);
+        CHECK_EQUAL(2u, a.RSize());
+        CHECK_EQUAL(2u, a.CSize());
+
+        for (unsigned i = 0; i < 2 && i < a.RSize(); ++i)
+        {
+            for (unsigned j = 0; j < 2 && j < a.CSize(); ++j)
+            {
+                CHECK_CLOSE(expected[i][j].real(), a[i][j].real(), 1e-12);
+                CHECK_CLOSE(expected[i][j].imag(), a[i][j].imag(), 1e-12);
+            }
+        }
+    }
+
+    TEST(GEMM_EMPTY)
+    {
+        // an inner dimension of zero gives a zero matrix
+        ls::DoubleMatrix a(2, 0), b(0, 3), c;
+        ls::mult(a, b, c);
+        checkEqualMatrices(ls::DoubleMatrix(2, 3), c);
+    }
+}
@@ -0,0 +1,226 @@
+#include "unit_test/UnitTest++.h"
+#include "rrLogger.h"
+#include "rrRoadRunner.h"
+#include "rrRoadRunnerOptions.h"
+#include "rrException.h"
+#include "rrStringUtils.h"
+#include "rrUtils.h"
+
+#include <math.h>
+#include <complex>
+#include <vector>
+
+using namespace UnitTest;
+using namespace rr;
+using namespace std;
+
+extern string             gSBMLModelsPath;
+
+SUITE(MCA)
+{
+    /**
+     * d variable / d parameter at the steady state, by central differences
+     * of separate steady state solutions.
+     */
+    double finiteDifferenceResponse(RoadRunner& r, const string& variable,
+            const string& parameter)
+    {
+        const double value = r.getValue(parameter);
+        const double h = 1e-4 * max(1e-3, fabs(value));
+
+        r.setValue(parameter, value + h);
+        r.steadyState();
+        const double up = r.getValue(variable);
+
+        r.setValue(parameter, value - h);
+        r.steadyState();
+        const double down = r.getValue(variable);
+
+        r.setValue(parameter, value);
+        r.steadyState();
+
+        return (up - down) / (2 * h);
+    }
+
+    TEST(RESPONSE_COEFFICIENTS_LINEAR_CHAIN)
+    {
+        // Xo -> S1 -> S2 -> S3 -> X1, all first order, so
+        // S1 = k1 Xo / k2 and each flux is k1 Xo.
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_threeSpecies.xml"));
+        r.steadyState();
+
+        const double k1 = r.getValue("k1");
+        const double k2 = r.getValue("k2");
+        const double xo = r.getValue("Xo");
+
+        CHECK_CLOSE(xo / k2, r.getuCC("S1", "k1"), 1e-6);
+        CHECK_CLOSE(-k1 * xo / (k2 * k2), r.getuCC("S1", "k2"), 1e-6);
+        CHECK_CLOSE(k1 / k2, r.getuCC("S1", "Xo"), 1e-6);
+        CHECK_CLOSE(0, r.getuCC("S1", "k3"), 1e-6);
+        CHECK_CLOSE(xo, r.getuCC("_J1", "k1"), 1e-6);
+        CHECK_CLOSE(xo, r.getuCC("_J4", "k1"), 1e-6);
+        CHECK_CLOSE(0, r.getuCC("_J4", "k4"), 1e-6);
+
+        // scaled by the parameter over the variable
+        CHECK_CLOSE(1, r.getCC("S1", "k1"), 1e-6);
+        CHECK_CLOSE(-1, r.getCC("S1", "k2"), 1e-6);
+    }
+
+    TEST(RESPONSE_COEFFICIENTS_PARAMETER_CHANGED)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_threeSpecies.xml"));
+        r.steadyState();
+
+        const double xo = r.getValue("Xo");
+        CHECK_CLOSE(xo / r.getValue("k2"), r.getuCC("S1", "k1"), 1e-6);
+
+        // the cached coefficients must not be used for the new steady state
+        r.setValue("k2", 0.3);
+        r.steadyState();
+        CHECK_CLOSE(xo / 0.3, r.getuCC("S1", "k1"), 1e-6);
+    }
+
+    TEST(RESPONSE_COEFFICIENTS_FINITE_DIFFERENCE)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "feedback.xml"));
+        r.steadyState();
+
+        const char* variables[] = {"S1", "S2", "S3", "S4", "J0", "J4"};
+        const char* parameters[] = {"J0_VM1", "J0_Keq1", "J4_V4", "J4_KS4", "X0"};
+
+        for (unsigned i = 0; i < sizeof(variables) / sizeof(variables[0]); ++i)
+        {
+            for (unsigned j = 0; j < sizeof(parameters) / sizeof(parameters[0]); ++j)
+            {
+                double fd = finiteDifferenceResponse(r, variables[i], parameters[j]);
+                CHECK_CLOSE(fd, r.getuCC(variables[i], parameters[j]),
+                        1e-4 * (1 + fabs(fd)));
+            }
+        }
+    }
+
+    TEST(RESPONSE_COEFFICIENTS_CONSERVED_CYCLE)
+    {
+        // conserved sums still go through the finite difference path
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_SimpleConservedCycle.xml"));
+        r.setConservedMoietyAnalysis(true);
+        r.steadyState();
+
+        const char* variables[] = {"S1", "S2", "_J1"};
+        for (unsigned i = 0; i < sizeof(variables) / sizeof(variables[0]); ++i)
+        {
+            double fd = finiteDifferenceResponse(r, variables[i], "k1");
+            CHECK_CLOSE(fd, r.getuCC(variables[i], "k1"), 1e-4 * (1 + fabs(fd)));
+        }
+    }
+
+    TEST(TRANSFER_FUNCTION_LINEAR_CHAIN)
+    {
+        // S1' = k1 Xo - k2 S1, S2' = k2 S1 - k3 S2, so the transfer
+        // functions from Xo are k1 / (s + k2) and k1 k2 / ((s + k2) (s + k3)).
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_threeSpecies.xml"));
+        r.steadyState();
+
+        const double k1 = r.getValue("k1");
+        const double k2 = r.getValue("k2");
+        const double k3 = r.getValue("k3");
+        const double xo = r.getValue("Xo");
+
+        vector<double> frequencies;
+        frequencies.push_back(0);
+        frequencies.push_back(0.1);
+        frequencies.push_back(1);
+        frequencies.push_back(10);
+
+        vector<string> variables;
+        variables.push_back("S1");
+        variables.push_back("S2");
+        variables.push_back("_J2");
+
+        vector<string> parameters;
+        parameters.push_back("Xo");
+        parameters.push_back("k1");
+
+        vector<ls::ComplexMatrix> h = r.getTransferFunction(frequencies,
+                variables, parameters, 1);
+
+        CHECK_EQUAL(frequencies.size(), h.size());
+
+        for (unsigned f = 0; f < frequencies.size() && f < h.size(); ++f)
+        {
+            CHECK_EQUAL(variables.size(), h[f].RSize());
+            CHECK_EQUAL(parameters.size(), h[f].CSize());
+            if (h[f].RSize() != variables.size() || h[f].CSize() != parameters.size())
+            {
+                continue;
+            }
+
+            const complex<double> s(0, frequencies[f]);
+            const complex<double> s1 = k1 / (s + k2);
+            const complex<double> s2 = s1 * k2 / (s + k3);
+
+            const complex<double> expected[3][2] = {
+                {s1, s1 * xo / k1},
+                {s2, s2 * xo / k1},
+                {k2 * s1, k2 * s1 * xo / k1}
+            };
+
+            for (unsigned i = 0; i < 3; ++i)
+            {
+                for (unsigned j = 0; j < 2; ++j)
+                {
+                    CHECK_CLOSE(expected[i][j].real(), h[f][i][j].real(), 1e-8);
+                    CHECK_CLOSE(expected[i][j].imag(), h[f][i][j].imag(), 1e-8);
+                }
+            }
+        }
+    }
+
+    TEST(TRANSFER_FUNCTION_ZERO_FREQUENCY)
+    {
+        // at zero frequency the transfer function is the response coefficient
+        RoadRunner r(joinPath(gSBMLModelsPath, "feedback.xml"));
+        r.steadyState();
+
+        vector<double> frequencies;
+        frequencies.push_back(0);
+        frequencies.push_back(0.5);
+        frequencies.push_back(2);
+
+        vector<string> variables;
+        variables.push_back("S1");
+        variables.push_back("S4");
+        variables.push_back("J0");
+
+        vector<string> parameters;
+        parameters.push_back("J0_VM1");
+        parameters.push_back("X0");
+
+        vector<ls::ComplexMatrix> serial = r.getTransferFunction(frequencies,
+                variables, parameters, 1);
+        vector<ls::ComplexMatrix> parallel = r.getTransferFunction(frequencies,
+                variables, parameters, 3);
+
+        CHECK_EQUAL(frequencies.size(), serial.size());
+        CHECK_EQUAL(serial.size(), parallel.size());
+        if (serial.size() != frequencies.size() || parallel.size() != serial.size())
+        {
+            return;
+        }
+
+        for (unsigned i = 0; i < variables.size(); ++i)
+        {
+            for (unsigned j = 0; j < parameters.size(); ++j)
+            {
+                double cc = r.getuCC(variables[i], parameters[j]);
+                CHECK_CLOSE(cc, serial[0][i][j].real(), 1e-6 * (1 + fabs(cc)));
+                CHECK_CLOSE(0, serial[0][i][j].imag(), 1e-10);
+
+                for (unsigned f = 0; f < frequencies.size(); ++f)
+                {
+                    CHECK_EQUAL(serial[f][i][j], parallel[f][i][j]);
+                }
+            }
+        }
+    }
+}
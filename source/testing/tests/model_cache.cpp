@@ -0,0 +1,179 @@
+#include "unit_test/UnitTest++.h"
+#include "rrLogger.h"
+#include "rrRoadRunner.h"
+#include "rrRoadRunnerOptions.h"
+#include "rrConfig.h"
+#include "rrException.h"
+#include "rrStringUtils.h"
+
+#include <sstream>
+
+using namespace UnitTest;
+using namespace rr;
+using namespace std;
+
+SUITE(ModelCache)
+{
+    /**
+     * a first order decay with rate constant k, each k is a different
+     * model for the cache.
+     */
+    string decayModel(double k)
+    {
+        stringstream sbml;
+        sbml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+             << "<sbml xmlns=\"http://www.sbml.org/sbml/level3/version1/core\" level=\"3\" version=\"1\">"
+             << "  <model id=\"decay\">"
+             << "    <listOfCompartments>"
+             << "      <compartment id=\"c\" size=\"1\" constant=\"true\"/>"
+             << "    </listOfCompartments>"
+             << "    <listOfSpecies>"
+             << "      <species id=\"S1\" compartment=\"c\" initialConcentration=\"10\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+             << "    </listOfSpecies>"
+             << "    <listOfParameters>"
+             << "      <parameter id=\"k\" value=\"" << k << "\" constant=\"true\"/>"
+             << "    </listOfParameters>"
+             << "    <listOfReactions>"
+             << "      <reaction id=\"J1\" reversible=\"false\" fast=\"false\">"
+             << "        <listOfReactants>"
+             << "          <speciesReference species=\"S1\" stoichiometry=\"1\" constant=\"true\"/>"
+             << "        </listOfReactants>"
+             << "        <kineticLaw>"
+             << "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+             << "            <apply><times/><ci>k</ci><ci>S1</ci></apply>"
+             << "          </math>"
+             << "        </kineticLaw>"
+             << "      </reaction>"
+             << "    </listOfReactions>"
+             << "  </model>"
+             << "</sbml>";
+        return sbml.str();
+    }
+
+    /**
+     * sets the model cache limits, restores them and empties the cache
+     * when it goes out of scope.
+     */
+    class CacheLimits
+    {
+    public:
+        CacheLimits(int size, int memory) :
+            savedSize(Config::getInt(Config::LLVM_MODEL_CACHE_SIZE)),
+            savedMemory(Config::getInt(Config::LLVM_MODEL_CACHE_MEMORY))
+        {
+            RoadRunner::purgeModelCache();
+            Config::setValue(Config::LLVM_MODEL_CACHE_SIZE, size);
+            Config::setValue(Config::LLVM_MODEL_CACHE_MEMORY, memory);
+        }
+
+        ~CacheLimits()
+        {
+            Config::setValue(Config::LLVM_MODEL_CACHE_SIZE, savedSize);
+            Config::setValue(Config::LLVM_MODEL_CACHE_MEMORY, savedMemory);
+            RoadRunner::purgeModelCache();
+        }
+
+    private:
+        int savedSize;
+        int savedMemory;
+    };
+
+    /**
+     * loads and deletes the model, returns true if it was a cache hit.
+     */
+    bool load(double k)
+    {
+        LoadSBMLOptions opt;
+        opt.modelGeneratorOpt &= ~LoadSBMLOptions::RECOMPILE;
+
+        const unsigned long hits = RoadRunner::getModelCacheHits();
+        const unsigned long misses = RoadRunner::getModelCacheMisses();
+
+        RoadRunner r(decayModel(k), &opt);
+        CHECK_EQUAL(k, r.getValue("k"));
+
+        CHECK_EQUAL(1u, (RoadRunner::getModelCacheHits() - hits)
+                + (RoadRunner::getModelCacheMisses() - misses));
+        return RoadRunner::getModelCacheHits() > hits;
+    }
+
+    TEST(HITS_AND_MISSES)
+    {
+        CacheLimits limits(2, 0);
+
+        const unsigned long hits = RoadRunner::getModelCacheHits();
+        const unsigned long misses = RoadRunner::getModelCacheMisses();
+
+        CHECK(!load(0.11));
+        CHECK(load(0.11));
+        CHECK(load(0.11));
+        CHECK(!load(0.12));
+
+        CHECK_EQUAL(2u, RoadRunner::getModelCacheHits() - hits);
+        CHECK_EQUAL(2u, RoadRunner::getModelCacheMisses() - misses);
+    }
+
+    TEST(NOTHING_RETAINED)
+    {
+        // without limits only models in use are shared
+        CacheLimits limits(0, 0);
+
+        CHECK(!load(0.21));
+        CHECK(!load(0.21));
+
+        LoadSBMLOptions opt;
+        opt.modelGeneratorOpt &= ~LoadSBMLOptions::RECOMPILE;
+        RoadRunner r(decayModel(0.21), &opt);
+        CHECK(load(0.21));
+    }
+
+    TEST(LEAST_RECENTLY_USED)
+    {
+        CacheLimits limits(2, 0);
+
+        CHECK(!load(0.31));
+        CHECK(!load(0.32));
+        CHECK(!load(0.33));
+
+        // 0.31 was the least recently used, 0.32 is now the most recent
+        CHECK(load(0.32));
+        CHECK(!load(0.31));
+
+        // which evicted 0.33, not 0.32
+        CHECK(load(0.32));
+        CHECK(!load(0.33));
+    }
+
+    TEST(LIMIT_LOWERED)
+    {
+        CacheLimits limits(3, 0);
+
+        CHECK(!load(0.41));
+        CHECK(!load(0.42));
+        CHECK(!load(0.43));
+
+        // the two least recently used are released when the limit changes,
+        // not when the next model is loaded
+        Config::setValue(Config::LLVM_MODEL_CACHE_SIZE, 1);
+        CHECK(!load(0.42));
+        CHECK(!load(0.43));
+    }
+
+    TEST(PURGE)
+    {
+        CacheLimits limits(5, 0);
+
+        CHECK(!load(0.51));
+        CHECK(!load(0.52));
+
+        LoadSBMLOptions opt;
+        opt.modelGeneratorOpt &= ~LoadSBMLOptions::RECOMPILE;
+        RoadRunner inUse(decayModel(0.52), &opt);
+
+        RoadRunner::purgeModelCache();
+
+        // models in use are still shared
+        CHECK(!load(0.51));
+        CHECK(load(0.52));
+    }
+}
@@ -0,0 +1,536 @@
+#include "unit_test/UnitTest++.h"
+#include "rrLogger.h"
+#include "rrRoadRunner.h"
+#include "rrRoadRunnerOptions.h"
+#include "rrConfig.h"
+#include "rrExecutableModel.h"
+#include "rrException.h"
+#include "rrStringUtils.h"
+#include "rrUtils.h"
+#include "Poco/SharedLibrary.h"
+#include "Poco/DirectoryIterator.h"
+#include "Poco/File.h"
+#include "Poco/Thread.h"
+#include "Poco/Runnable.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace UnitTest;
+using namespace rr;
+using namespace std;
+
+extern string             gSBMLModelsPath;
+extern string             gTempFolder;
+extern string             gCompiler;
+extern string             gSupportCodeFolder;
+
+SUITE(ModelGeneration)
+{
+    // a reaction rate, a rate rule and an event which share a chain of
+    // assignment rules, one of them only used in a branch of a piecewise.
+    const char* assignmentRuleModel =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<sbml xmlns=\"http://www.sbml.org/sbml/level3/version1/core\" level=\"3\" version=\"1\">"
+        "  <model id=\"assignment_rules\">"
+        "    <listOfCompartments>"
+        "      <compartment id=\"c\" size=\"1\" constant=\"true\"/>"
+        "    </listOfCompartments>"
+        "    <listOfSpecies>"
+        "      <species id=\"S1\" compartment=\"c\" initialConcentration=\"10\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "      <species id=\"S2\" compartment=\"c\" initialConcentration=\"0\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+        "    </listOfSpecies>"
+        "    <listOfParameters>"
+        "      <parameter id=\"k1\" value=\"0.5\" constant=\"true\"/>"
+        "      <parameter id=\"a\" value=\"0\" constant=\"false\"/>"
+        "      <parameter id=\"b\" value=\"0\" constant=\"false\"/>"
+        "      <parameter id=\"d\" value=\"0\" constant=\"false\"/>"
+        "      <parameter id=\"x\" value=\"1\" constant=\"false\"/>"
+        "    </listOfParameters>"
+        "    <listOfRules>"
+        "      <assignmentRule variable=\"a\">"
+        "        <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "          <apply><times/><ci>k1</ci><ci>S1</ci></apply>"
+        "        </math>"
+        "      </assignmentRule>"
+        "      <assignmentRule variable=\"d\">"
+        "        <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "          <apply><plus/><ci>a</ci><ci>S2</ci></apply>"
+        "        </math>"
+        "      </assignmentRule>"
+        "      <assignmentRule variable=\"b\">"
+        "        <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "          <piecewise>"
+        "            <piece><ci>a</ci><apply><lt/><ci>S2</ci><cn>5</cn></apply></piece>"
+        "            <otherwise><apply><times/><cn>2</cn><ci>d</ci></apply></otherwise>"
+        "          </piecewise>"
+        "        </math>"
+        "      </assignmentRule>"
+        "      <rateRule variable=\"x\">"
+        "        <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "          <apply><divide/><apply><times/><apply><minus/><ci>b</ci></apply><ci>x</ci></apply><cn>10</cn></apply>"
+        "        </math>"
+        "      </rateRule>"
+        "    </listOfRules>"
+        "    <listOfReactions>"
+        "      <reaction id=\"J0\" reversible=\"false\" fast=\"false\">"
+        "        <listOfReactants>"
+        "          <speciesReference species=\"S1\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfReactants>"
+        "        <listOfProducts>"
+        "          <speciesReference species=\"S2\" stoichiometry=\"1\" constant=\"true\"/>"
+        "        </listOfProducts>"
+        "        <kineticLaw>"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><divide/><apply><times/><ci>c</ci><ci>b</ci></apply><apply><plus/><cn>1</cn><ci>a</ci></apply></apply>"
+        "          </math>"
+        "        </kineticLaw>"
+        "      </reaction>"
+        "    </listOfReactions>"
+        "    <listOfEvents>"
+        "      <event id=\"E0\" useValuesFromTriggerTime=\"true\">"
+        "        <trigger initialValue=\"false\" persistent=\"true\">"
+        "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "            <apply><gt/><ci>d</ci><cn>8</cn></apply>"
+        "          </math>"
+        "        </trigger>"
+        "        <listOfEventAssignments>"
+        "          <eventAssignment variable=\"S1\">"
+        "            <math xmlns=\"http://www.w3.org/1998/Math/MathML\">"
+        "              <apply><plus/><ci>S1</ci><ci>a</ci></apply>"
+        "            </math>"
+        "          </eventAssignment>"
+        "        </listOfEventAssignments>"
+        "      </event>"
+        "    </listOfEvents>"
+        "  </model>"
+        "</sbml>";
+
+    ls::DoubleMatrix simulateModel(const string& sbml, unsigned modelGeneratorOpt)
+    {
+        LoadSBMLOptions opt;
+        opt.modelGeneratorOpt = modelGeneratorOpt | LoadSBMLOptions::RECOMPILE;
+
+        RoadRunner rr(sbml, &opt);
+
+        vector<string> selections;
+        selections.push_back("time");
+        selections.push_back("[S1]");
+        selections.push_back("[S2]");
+        selections.push_back("x");
+        selections.push_back("b");
+        rr.setSelections(selections);
+
+        SimulateOptions sim;
+        sim.duration = 20;
+        sim.steps = 100;
+        return *rr.simulate(&sim);
+    }
+
+    void checkEqualResults(const ls::DoubleMatrix& expected,
+            const ls::DoubleMatrix& actual, double tolerance)
+    {
+        CHECK_EQUAL(expected.RSize(), actual.RSize());
+        CHECK_EQUAL(expected.CSize(), actual.CSize());
+
+        for (unsigned i = 0; i < expected.RSize() && i < actual.RSize(); i++)
+        {
+            for (unsigned j = 0; j < expected.CSize() && j < actual.CSize(); j++)
+            {
+                CHECK_CLOSE(expected[i][j], actual[i][j],
+                        tolerance * max(1.0, fabs(expected[i][j])));
+            }
+        }
+    }
+
+    /**
+     * simulates a model file with its default selections.
+     */
+    ls::DoubleMatrix simulateFile(const string& file, unsigned modelGeneratorOpt)
+    {
+        LoadSBMLOptions opt;
+        opt.modelGeneratorOpt = modelGeneratorOpt | LoadSBMLOptions::RECOMPILE;
+
+        RoadRunner rr(joinPath(gSBMLModelsPath, file), &opt);
+
+        SimulateOptions sim;
+        sim.duration = 20;
+        sim.steps = 100;
+        return *rr.simulate(&sim);
+    }
+
+    // models with powers, piecewise functions and many reactions
+    const char* models[] = {"feedback.xml", "BorisEJB.xml", "functest.xml"};
+
+    const unsigned numModels = sizeof(models) / sizeof(models[0]);
+
+    TEST(FAST_MATH)
+    {
+        // re-associated arithmetic and expanded powers only differ in the
+        // last bits of each operation
+        for (unsigned m = 0; m < numModels; ++m)
+        {
+            checkEqualResults(simulateFile(models[m], 0),
+                    simulateFile(models[m], LoadSBMLOptions::FAST_MATH), 1e-6);
+        }
+
+        checkEqualResults(simulateModel(assignmentRuleModel, 0),
+                simulateModel(assignmentRuleModel, LoadSBMLOptions::FAST_MATH), 1e-6);
+    }
+
+    /**
+     * the total of the memory usage section of the model info.
+     */
+    unsigned long reportedMemory(RoadRunner& rr)
+    {
+        string info = rr.getModel()->getInfo();
+
+        size_t section = info.find("* Memory Usage *");
+        CHECK(section != string::npos);
+
+        size_t total = info.find("Total: ", section);
+        CHECK(total != string::npos);
+        if (section == string::npos || total == string::npos)
+        {
+            return 0;
+        }
+
+        return strtoul(info.c_str() + total + 7, 0, 10);
+    }
+
+    TEST(COMPACT)
+    {
+        for (unsigned m = 0; m < numModels; ++m)
+        {
+            // the same native code, without the IR
+            checkEqualResults(simulateFile(models[m], 0),
+                    simulateFile(models[m], LoadSBMLOptions::COMPACT), 0);
+
+            LoadSBMLOptions opt;
+            opt.modelGeneratorOpt |= LoadSBMLOptions::RECOMPILE;
+            RoadRunner full(joinPath(gSBMLModelsPath, models[m]), &opt);
+
+            opt.modelGeneratorOpt |= LoadSBMLOptions::COMPACT;
+            RoadRunner compact(joinPath(gSBMLModelsPath, models[m]), &opt);
+
+            const unsigned long fullMemory = reportedMemory(full);
+            const unsigned long compactMemory = reportedMemory(compact);
+
+            CHECK(compactMemory > 0);
+            CHECK(compactMemory < fullMemory);
+        }
+    }
+
+    /**
+     * sets the number of code generation threads, and restores it when it
+     * goes out of scope.
+     */
+    class CodegenThreads
+    {
+    public:
+        CodegenThreads(int threads) :
+            saved(Config::getInt(Config::LLVM_CODEGEN_THREADS))
+        {
+            Config::setValue(Config::LLVM_CODEGEN_THREADS, threads);
+        }
+
+        ~CodegenThreads()
+        {
+            Config::setValue(Config::LLVM_CODEGEN_THREADS, saved);
+        }
+
+    private:
+        int saved;
+    };
+
+    TEST(CODEGEN_THREADS)
+    {
+        for (unsigned m = 0; m < numModels; ++m)
+        {
+            ls::DoubleMatrix serial, parallel;
+            {
+                CodegenThreads threads(1);
+                serial = simulateFile(models[m], 0);
+            }
+            {
+                // each function is generated the same way in its own module
+                CodegenThreads threads(4);
+                parallel = simulateFile(models[m], 0);
+            }
+            checkEqualResults(serial, parallel, 0);
+        }
+
+        ls::DoubleMatrix serial, parallel;
+        {
+            CodegenThreads threads(1);
+            serial = simulateModel(assignmentRuleModel,
+                    LoadSBMLOptions::OPTIMIZE_ASSIGNMENT_RULES);
+        }
+        {
+            CodegenThreads threads(3);
+            parallel = simulateModel(assignmentRuleModel,
+                    LoadSBMLOptions::OPTIMIZE_ASSIGNMENT_RULES);
+        }
+        checkEqualResults(serial, parallel, 0);
+    }
+
+    TEST(ASSIGNMENT_RULE_CACHING)
+    {
+        ls::DoubleMatrix plain = simulateModel(assignmentRuleModel, 0);
+        ls::DoubleMatrix cached = simulateModel(assignmentRuleModel,
+                LoadSBMLOptions::OPTIMIZE_ASSIGNMENT_RULES);
+
+        // the same operations in the same order, only evaluated once
+        checkEqualResults(plain, cached, 1e-10);
+    }
+
+    SimulateOptions libraryOptions()
+    {
+        SimulateOptions sim;
+        sim.flags |= SimulateOptions::RESET_MODEL;
+        sim.duration = 10;
+        sim.steps = 50;
+        return sim;
+    }
+
+    TEST(MODEL_LIBRARY)
+    {
+        string path = joinPath(gTempFolder, "feedback_model"
+                + Poco::SharedLibrary::suffix());
+
+        RoadRunner compiled(joinPath(gSBMLModelsPath, "feedback.xml"));
+        compiled.compileModelLibrary(path);
+
+        SimulateOptions sim = libraryOptions();
+        ls::DoubleMatrix expected = *compiled.simulate(&sim);
+
+        RoadRunner loaded;
+        loaded.loadModelLibrary(path);
+
+        const vector<SelectionRecord>& selections = compiled.getSelections();
+        const vector<SelectionRecord>& loadedSelections = loaded.getSelections();
+        CHECK_EQUAL(selections.size(), loadedSelections.size());
+        for (unsigned i = 0; i < selections.size() && i < loadedSelections.size(); ++i)
+        {
+            CHECK_EQUAL(selections[i].to_string(), loadedSelections[i].to_string());
+        }
+        CHECK_EQUAL(compiled.getValue("J0_VM1"), loaded.getValue("J0_VM1"));
+
+        // the same code, so the same results
+        checkEqualResults(expected, *loaded.simulate(&sim), 1e-12);
+    }
+
+    TEST(MODEL_LIBRARY_OPTIONS)
+    {
+        string path = joinPath(gTempFolder, "conserved_cycle_model"
+                + Poco::SharedLibrary::suffix());
+
+        LoadSBMLOptions opt;
+        opt.modelGeneratorOpt |= LoadSBMLOptions::CONSERVED_MOIETIES;
+
+        RoadRunner compiled(joinPath(gSBMLModelsPath, "ss_SimpleConservedCycle.xml"), &opt);
+        compiled.compileModelLibrary(path);
+
+        SimulateOptions sim = libraryOptions();
+        ls::DoubleMatrix expected = *compiled.simulate(&sim);
+
+        // the library keeps the options it was compiled with
+        RoadRunner loaded;
+        loaded.loadModelLibrary(path);
+
+        CHECK(loaded.getConservedMoietyAnalysis());
+        CHECK_EQUAL(1u, loaded.getConservationMatrix().RSize());
+        checkEqualResults(expected, *loaded.simulate(&sim), 1e-12);
+    }
+
+    TEST(MODEL_LIBRARY_INVALID)
+    {
+        RoadRunner r;
+
+        CHECK_THROW(r.loadModelLibrary(joinPath(gTempFolder,
+                "no_such_model" + Poco::SharedLibrary::suffix())), std::exception);
+
+        string path = joinPath(gTempFolder, "not_a_model"
+                + Poco::SharedLibrary::suffix());
+        {
+            ofstream out(path.c_str());
+            out << "not a shared library" << endl;
+        }
+        CHECK_THROW(r.loadModelLibrary(path), std::exception);
+    }
+
+#if defined(BUILD_LEGACY_C)
+    /**
+     * simulates feedback.xml with the legacy C back end, which writes its
+     * files to folder.
+     */
+    ls::DoubleMatrix simulateLegacyC(const string& folder, unsigned modelGeneratorOpt)
+    {
+        LoadSBMLOptions opt;
+        opt.modelGeneratorOpt = modelGeneratorOpt;
+
+        RoadRunner rr(gCompiler, folder, gSupportCodeFolder);
+        rr.load(joinPath(gSBMLModelsPath, "feedback.xml"), &opt);
+
+        SimulateOptions sim;
+        sim.duration = 20;
+        sim.steps = 100;
+        return *rr.simulate(&sim);
+    }
+
+    /**
+     * the file names of the shared libraries in folder.
+     */
+    vector<string> sharedLibraries(const string& folder)
+    {
+        vector<string> result;
+        const string suffix = Poco::SharedLibrary::suffix();
+
+        Poco::DirectoryIterator end;
+        for (Poco::DirectoryIterator i(folder); i != end; ++i)
+        {
+            const string name = i.name();
+            if (name.size() > suffix.size() && name.compare(
+                    name.size() - suffix.size(), suffix.size(), suffix) == 0)
+            {
+                result.push_back(name);
+            }
+        }
+
+        sort(result.begin(), result.end());
+        return result;
+    }
+
+    TEST(LEGACY_C_OPTIMIZE_NATIVE_CACHE)
+    {
+        // a folder of its own, emptied, so the first load is a miss
+        string folder = joinPath(gTempFolder, "optimize_native");
+        Poco::File(folder).createDirectories();
+
+        vector<string> stale = sharedLibraries(folder);
+        for (unsigned i = 0; i < stale.size(); ++i)
+        {
+            Poco::File(joinPath(folder, stale[i])).remove();
+        }
+
+        ls::DoubleMatrix native = simulateLegacyC(folder,
+                LoadSBMLOptions::OPTIMIZE_NATIVE);
+
+        vector<string> libraries = sharedLibraries(folder);
+        CHECK_EQUAL(1u, libraries.size());
+        if (libraries.size() != 1)
+        {
+            return;
+        }
+
+        // back date the library, the same content is found by its hash and
+        // loaded, not compiled and written again
+        Poco::File library(joinPath(folder, libraries[0]));
+        const Poco::Timestamp backDated = Poco::Timestamp::fromEpochTime(0);
+        library.setLastModified(backDated);
+
+        checkEqualResults(native, simulateLegacyC(folder,
+                LoadSBMLOptions::OPTIMIZE_NATIVE), 0);
+        CHECK(sharedLibraries(folder) == libraries);
+        CHECK(library.getLastModified() == backDated);
+
+        // other code is generated with conserved moieties, it is not a hit
+        simulateLegacyC(folder, LoadSBMLOptions::OPTIMIZE_NATIVE
+                | LoadSBMLOptions::CONSERVED_MOIETIES);
+        CHECK_EQUAL(2u, sharedLibraries(folder).size());
+
+#if defined(RR_USE_LIBTCC)
+        // without the option the model is compiled in memory by libtcc,
+        // nothing is written
+        checkEqualResults(native, simulateLegacyC(folder, 0), 1e-9);
+        CHECK_EQUAL(2u, sharedLibraries(folder).size());
+#endif
+    }
+
+#if defined(RR_USE_LIBTCC)
+    bool sameResults(const ls::DoubleMatrix& a, const ls::DoubleMatrix& b)
+    {
+        if (a.RSize() != b.RSize() || a.CSize() != b.CSize())
+        {
+            return false;
+        }
+
+        for (unsigned i = 0; i < a.RSize(); i++)
+        {
+            for (unsigned j = 0; j < a.CSize(); j++)
+            {
+                if (a[i][j] != b[i][j])
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * loads, simulates and deletes models compiled by libtcc in memory.
+     */
+    class InMemoryLoads : public Poco::Runnable
+    {
+    public:
+        InMemoryLoads(const string& folder) : folder(folder), equal(true)
+        {
+        }
+
+        virtual void run()
+        {
+            try
+            {
+                ls::DoubleMatrix first = simulateLegacyC(folder, 0);
+                for (int i = 0; i < 4; ++i)
+                {
+                    ls::DoubleMatrix next = simulateLegacyC(folder, 0);
+                    equal = equal && sameResults(first, next);
+                }
+            }
+            catch (std::exception& e)
+            {
+                error = e.what();
+            }
+            catch (...)
+            {
+                error = "unknown error";
+            }
+        }
+
+        string folder;
+        bool equal;
+        string error;
+    };
+
+    TEST(LEGACY_C_IN_MEMORY_THREADS)
+    {
+        // the models are compiled under the compile lock, but deleted by
+        // each thread whenever it is done with them
+        string folder = joinPath(gTempFolder, "in_memory");
+        Poco::File(folder).createDirectories();
+
+        vector<InMemoryLoads*> loads;
+        vector<Poco::Thread*> threads;
+        for (int i = 0; i < 4; ++i)
+        {
+            loads.push_back(new InMemoryLoads(folder));
+            threads.push_back(new Poco::Thread());
+            threads.back()->start(*loads.back());
+        }
+
+        for (unsigned i = 0; i < threads.size(); ++i)
+        {
+            threads[i]->join();
+            CHECK_EQUAL("", loads[i]->error);
+            CHECK(loads[i]->equal);
+            delete threads[i];
+            delete loads[i];
+        }
+    }
+#endif
+#endif
+}
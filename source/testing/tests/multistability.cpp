@@ -0,0 +1,250 @@
+#include "unit_test/UnitTest++.h"
+#include "rrLogger.h"
+#include "rrRoadRunner.h"
+#include "rrSteadyStateSearch.h"
+#include "rrContinuation.h"
+#include "rrException.h"
+#include "rrStringUtils.h"
+#include "rrUtils.h"
+#include "Poco/SharedLibrary.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace UnitTest;
+using namespace rr;
+using namespace std;
+
+extern string             gSBMLModelsPath;
+extern string             gTempFolder;
+
+SUITE(Multistability)
+{
+    // the steady states of bistable.xml, x' = 0.1 + 0.9 x^4 / (0.3 + x^4) - 0.7 x,
+    // and dx'/dx at each of them.
+    const double bistableRoots[] = {0.144735091762664, 0.682531644439784, 1.30956324950300};
+    const double bistableSlopes[] = {-0.66372285, 0.58464951, -0.46909924};
+
+    bool lessState(const SteadyStateRoot& a, const SteadyStateRoot& b)
+    {
+        return a.stateVector < b.stateVector;
+    }
+
+    void checkBistableRoots(vector<SteadyStateRoot> roots)
+    {
+        sort(roots.begin(), roots.end(), lessState);
+
+        CHECK_EQUAL(3u, roots.size());
+        for (unsigned i = 0; i < 3 && i < roots.size(); ++i)
+        {
+            CHECK_EQUAL(1u, roots[i].stateVector.size());
+            CHECK_EQUAL(1u, roots[i].floatingSpeciesConcentrations.size());
+            CHECK_EQUAL(1u, roots[i].eigenvalues.size());
+            if (roots[i].stateVector.size() != 1 || roots[i].eigenvalues.size() != 1)
+            {
+                continue;
+            }
+
+            CHECK_CLOSE(bistableRoots[i], roots[i].stateVector[0], 1e-6);
+            CHECK_CLOSE(bistableRoots[i], roots[i].floatingSpeciesConcentrations[0], 1e-6);
+            CHECK_CLOSE(bistableSlopes[i], roots[i].eigenvalues[0].real(), 1e-4);
+            CHECK_CLOSE(0, roots[i].eigenvalues[0].imag(), 1e-12);
+            CHECK_EQUAL(i != 1, roots[i].stable);
+            CHECK(roots[i].hits > 0);
+        }
+    }
+
+    TEST(FIND_BISTABLE)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "bistable.xml"));
+        const double x = r.getValue("x");
+
+        checkBistableRoots(r.findSteadyStates(100, 3, 1, 0));
+
+        // the model is left as it was
+        CHECK_EQUAL(x, r.getValue("x"));
+    }
+
+    TEST(FIND_REPRODUCIBLE_THREADS)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "bistable.xml"));
+
+        vector<SteadyStateRoot> serial = r.findSteadyStates(50, 3, 7, 1);
+        vector<SteadyStateRoot> parallel = r.findSteadyStates(50, 3, 7, 4);
+
+        CHECK_EQUAL(serial.size(), parallel.size());
+        for (unsigned i = 0; i < serial.size() && i < parallel.size(); ++i)
+        {
+            CHECK(serial[i].stateVector == parallel[i].stateVector);
+            CHECK_EQUAL(serial[i].hits, parallel[i].hits);
+        }
+    }
+
+    TEST(FIND_FROM_INITIAL_STATES)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "bistable.xml"));
+
+        // one start near each root, and one more which converges to the
+        // upper root, which must be merged with it.
+        ls::DoubleMatrix starts(4, 1);
+        starts[0][0] = 0.1;
+        starts[1][0] = 0.7;
+        starts[2][0] = 1.5;
+        starts[3][0] = 2;
+
+        vector<SteadyStateRoot> roots = r.findSteadyStates(starts, 2);
+        checkBistableRoots(roots);
+
+        int hits = 0;
+        for (unsigned i = 0; i < roots.size(); ++i)
+        {
+            hits += roots[i].hits;
+        }
+        CHECK_EQUAL(4, hits);
+    }
+
+    TEST(FIND_MODEL_LIBRARY)
+    {
+        string path = joinPath(gTempFolder, "bistable_model"
+                + Poco::SharedLibrary::suffix());
+
+        RoadRunner compiled(joinPath(gSBMLModelsPath, "bistable.xml"));
+        compiled.compileModelLibrary(path);
+
+        // the other threads search on copies loaded from the library
+        RoadRunner r;
+        r.loadModelLibrary(path);
+        checkBistableRoots(r.findSteadyStates(100, 3, 1, 4));
+    }
+
+    TEST(FIND_CONSERVED_CYCLE)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "ss_SimpleConservedCycle.xml"));
+
+        // without conserved moieties, the Jacobian is singular and every
+        // point of the line S1 + S2 = const is a root.
+        CHECK_THROW(r.findSteadyStates(10), CoreException);
+
+        r.setConservedMoietyAnalysis(true);
+        vector<SteadyStateRoot> roots = r.findSteadyStates(10, 0, 1);
+
+        // k1 S1 = k2 S2 with S1 + S2 = 10
+        CHECK_EQUAL(1u, roots.size());
+        if (roots.size() == 1)
+        {
+            CHECK_EQUAL(2u, roots[0].floatingSpeciesConcentrations.size());
+            CHECK(roots[0].stable);
+            double sum = 0;
+            for (unsigned i = 0; i < roots[0].floatingSpeciesConcentrations.size(); ++i)
+            {
+                sum += roots[0].floatingSpeciesConcentrations[i];
+            }
+            CHECK_CLOSE(10, sum, 1e-8);
+        }
+    }
+
+    /**
+     * x' of bistable.xml with the parameter k3.
+     */
+    double bistableRate(double x, double k3)
+    {
+        double x4 = x * x * x * x;
+        return 0.1 + 0.9 * x4 / (0.3 + x4) - k3 * x;
+    }
+
+    TEST(CONTINUATION_FOLD)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "bistable.xml"));
+
+        // start on the upper branch, which ends in a fold at
+        // k3 = 0.79827, x = 0.9268, and continues back on the unstable
+        // middle branch.
+        r.setValue("k3", 0.5);
+        r.setValue("x", 1.6);
+        r.steadyState();
+        CHECK(r.getValue("x") > 1);
+
+        ContinuationOptions opt;
+        opt.maxStep = 0.02;
+
+        vector<BifurcationPoint> bifurcations;
+        ls::DoubleMatrix branch = r.continueSteadyState("k3", 0.5, 1.0, &opt,
+                &bifurcations);
+
+        CHECK_EQUAL(3u, branch.CSize());
+        CHECK(branch.RSize() > 10);
+        if (branch.CSize() != 3)
+        {
+            return;
+        }
+
+        // every point is a steady state, stable before the fold
+        // and unstable after it.
+        CHECK_EQUAL(1u, bifurcations.size());
+        const int fold = bifurcations.size() ? bifurcations[0].row : 0;
+
+        for (unsigned i = 0; i < branch.RSize(); ++i)
+        {
+            CHECK_CLOSE(0, bistableRate(branch[i][1], branch[i][0]), 1e-7);
+            CHECK(branch[i][0] >= 0.5 && branch[i][0] <= 0.79828);
+            if ((int)i < fold || (int)i > fold + 1)
+            {
+                CHECK_EQUAL((int)i < fold ? 0 : 1, (int)branch[i][2]);
+            }
+        }
+
+        if (bifurcations.size() == 1)
+        {
+            CHECK_EQUAL(BifurcationPoint::FOLD, bifurcations[0].type);
+            CHECK_CLOSE(0.79827, bifurcations[0].parameter, 2e-3);
+            CHECK_EQUAL(1u, bifurcations[0].stateVector.size());
+            if (bifurcations[0].stateVector.size() == 1)
+            {
+                CHECK_CLOSE(0.9268, bifurcations[0].stateVector[0], 0.05);
+            }
+        }
+
+        // the model is left as it was
+        CHECK_EQUAL(0.5, r.getValue("k3"));
+    }
+
+    TEST(CONTINUATION_NO_FOLD)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "bistable.xml"));
+
+        // the lower branch is stable all the way
+        r.setValue("x", 0.1);
+        r.setValue("k3", 0.5);
+        r.steadyState();
+
+        ContinuationOptions opt;
+        opt.maxStep = 0.02;
+
+        vector<BifurcationPoint> bifurcations;
+        ls::DoubleMatrix branch = r.continueSteadyState("k3", 0.5, 1.0, &opt,
+                &bifurcations);
+
+        CHECK_EQUAL(0u, bifurcations.size());
+        CHECK_EQUAL(3u, branch.CSize());
+        CHECK(branch.RSize() > 1);
+        if (branch.CSize() != 3 || branch.RSize() < 1)
+        {
+            return;
+        }
+
+        CHECK_CLOSE(0.5, branch[0][0], 1e-12);
+        CHECK(branch[branch.RSize() - 1][0] > 0.95);
+        for (unsigned i = 0; i < branch.RSize(); ++i)
+        {
+            CHECK_CLOSE(0, bistableRate(branch[i][1], branch[i][0]), 1e-7);
+            CHECK(branch[i][1] < 0.332);
+            CHECK_EQUAL(0, (int)branch[i][2]);
+        }
+    }
+
+    TEST(CONTINUATION_UNKNOWN_PARAMETER)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "bistable.xml"));
+        CHECK_THROW(r.continueSteadyState("not_a_parameter", 0, 1), CoreException);
+    }
+}
@@ -0,0 +1,302 @@
+#include "unit_test/UnitTest++.h"
+#include "rrLogger.h"
+#include "rrRoadRunner.h"
+#include "rrRoadRunnerOptions.h"
+#include "rrRoadRunnerData.h"
+#include "rrParameterFit.h"
+#include "rrConstants.h"
+#include "rrException.h"
+#include "rrStringUtils.h"
+#include "rrUtils.h"
+#include "Poco/SharedLibrary.h"
+
+using namespace UnitTest;
+using namespace rr;
+using namespace std;
+
+extern string             gSBMLModelsPath;
+extern string             gTempFolder;
+
+SUITE(ParameterFit)
+{
+    // the values of k2 and k3 in ss_threestep.xml
+    const double trueK2 = 0.15;
+    const double trueK3 = 0.4;
+
+    /**
+     * loads ss_threestep.xml with tight tolerances, which are also the
+     * ones the fits simulate with.
+     */
+    void loadModel(RoadRunner& r)
+    {
+        r.load(joinPath(gSBMLModelsPath, "ss_threestep.xml"));
+
+        SimulateOptions& opt = r.getSimulateOptions();
+        opt.absolute = 1e-12;
+        opt.relative = 1e-10;
+        opt.duration = 20;
+        opt.steps = 20;
+    }
+
+    /**
+     * S1, S2 and S3 simulated from the initial state with the true
+     * parameters, the model is reset afterwards.
+     */
+    RoadRunnerData simulatedData(RoadRunner& r)
+    {
+        vector<string> names;
+        names.push_back("time");
+        names.push_back("[S1]");
+        names.push_back("[S2]");
+        names.push_back("[S3]");
+
+        r.reset();
+        r.setSelections(names);
+        RoadRunnerData data(names, *r.simulate());
+        r.reset();
+
+        return data;
+    }
+
+    vector<FitParameter> fitParameters()
+    {
+        vector<FitParameter> p;
+        p.push_back(FitParameter("k2"));
+        p.push_back(FitParameter("k3", 1e-3, 10, true));
+        return p;
+    }
+
+    vector<FitParameter> boundedParameters()
+    {
+        vector<FitParameter> p;
+        p.push_back(FitParameter("k2", 0.01, 2));
+        p.push_back(FitParameter("k3", 0.01, 2, true));
+        return p;
+    }
+
+    void checkRecovered(const FitResult& result, double tolerance)
+    {
+        CHECK_EQUAL(2u, result.values.size());
+        if (result.values.size() == 2)
+        {
+            CHECK_CLOSE(trueK2, result.values[0], tolerance * trueK2);
+            CHECK_CLOSE(trueK3, result.values[1], tolerance * trueK3);
+        }
+    }
+
+    TEST(FIT_SIMULATED_DATA)
+    {
+        RoadRunner r;
+        loadModel(r);
+        vector<RoadRunnerData> data(1, simulatedData(r));
+
+        r.setValue("k2", 0.5);
+        r.setValue("k3", 0.1);
+
+        FitResult result = r.fitParameters(data, fitParameters());
+
+        checkRecovered(result, 1e-5);
+        CHECK(result.converged);
+        CHECK(result.chiSquare < 1e-12);
+        CHECK(result.iterations > 0);
+        CHECK(result.evaluations > result.iterations);
+        CHECK_EQUAL(2u, result.standardErrors.size());
+
+        // the fitted values are set, the rest of the model is left as it was
+        if (result.values.size() == 2)
+        {
+            CHECK_EQUAL(result.values[0], r.getValue("k2"));
+            CHECK_EQUAL(result.values[1], r.getValue("k3"));
+        }
+        CHECK_EQUAL(0, r.getValue("time"));
+        CHECK_EQUAL(0, r.getValue("[S1]"));
+    }
+
+    TEST(FIT_REPRODUCIBLE_THREADS)
+    {
+        RoadRunner r;
+        loadModel(r);
+        vector<RoadRunnerData> data(1, simulatedData(r));
+
+        FitOptions opt;
+        opt.nThreads = 1;
+        r.setValue("k2", 0.5);
+        r.setValue("k3", 0.1);
+        FitResult serial = r.fitParameters(data, fitParameters(), &opt);
+
+        opt.nThreads = 2;
+        r.setValue("k2", 0.5);
+        r.setValue("k3", 0.1);
+        FitResult parallel = r.fitParameters(data, fitParameters(), &opt);
+
+        CHECK(serial.values == parallel.values);
+        CHECK_EQUAL(serial.chiSquare, parallel.chiSquare);
+        CHECK_EQUAL(serial.iterations, parallel.iterations);
+    }
+
+    TEST(FIT_MISSING_VALUES)
+    {
+        RoadRunner r;
+        loadModel(r);
+        RoadRunnerData full = simulatedData(r);
+
+        // S3 only observed at every other time, and S1 not at all
+        ls::DoubleMatrix values = full.getData();
+        for (unsigned i = 0; i < values.RSize(); ++i)
+        {
+            values[i][1] = gDoubleNaN;
+            if (i % 2)
+            {
+                values[i][3] = gDoubleNaN;
+            }
+        }
+
+        vector<RoadRunnerData> data(1,
+                RoadRunnerData(full.getColumnNames(), values));
+
+        r.setValue("k2", 0.5);
+        r.setValue("k3", 0.1);
+        FitResult result = r.fitParameters(data, fitParameters());
+
+        checkRecovered(result, 1e-5);
+        CHECK(result.chiSquare < 1e-12);
+    }
+
+    TEST(FIT_INVALID)
+    {
+        RoadRunner r;
+        loadModel(r);
+        RoadRunnerData full = simulatedData(r);
+        vector<RoadRunnerData> data(1, full);
+
+        // not a global parameter
+        vector<FitParameter> species(1, FitParameter("S1"));
+        CHECK_THROW(r.fitParameters(data, species), CoreException);
+
+        // no time column
+        vector<string> names(full.getColumnNames());
+        names[0] = "[X1]";
+        vector<RoadRunnerData> noTime(1, RoadRunnerData(names, full.getData()));
+        CHECK_THROW(r.fitParameters(noTime, fitParameters()), CoreException);
+
+        // a stochastic simulation has no residuals to differentiate
+        r.getSimulateOptions().integrator = SimulateOptions::GILLESPIE;
+        CHECK_THROW(r.fitParameters(data, fitParameters()), CoreException);
+    }
+
+    TEST(GLOBAL_FIT_BOUNDS)
+    {
+        RoadRunner r;
+        loadModel(r);
+        vector<RoadRunnerData> data(1, simulatedData(r));
+
+        GlobalFitOptions opt;
+        opt.seed = 1;
+        opt.maxGenerations = 200;
+        opt.polish = false;
+
+        // far from the true values, near the other ends of the bounds
+        r.setValue("k2", 1.8);
+        r.setValue("k3", 0.02);
+        FitResult unpolished = r.globalFitParameters(data, boundedParameters(), &opt);
+
+        checkRecovered(unpolished, 1e-2);
+        CHECK_EQUAL(2u, unpolished.standardErrors.size());
+        for (unsigned j = 0; j < unpolished.standardErrors.size(); ++j)
+        {
+            CHECK(unpolished.standardErrors[j] != unpolished.standardErrors[j]);
+        }
+
+        opt.polish = true;
+        r.setValue("k2", 1.8);
+        r.setValue("k3", 0.02);
+        FitResult polished = r.globalFitParameters(data, boundedParameters(), &opt);
+
+        checkRecovered(polished, 1e-5);
+        CHECK(polished.chiSquare <= unpolished.chiSquare);
+        CHECK(polished.chiSquare < 1e-12);
+        CHECK_EQUAL(2u, polished.standardErrors.size());
+        for (unsigned j = 0; j < polished.standardErrors.size(); ++j)
+        {
+            CHECK(polished.standardErrors[j] == polished.standardErrors[j]);
+        }
+
+        if (polished.values.size() == 2)
+        {
+            CHECK_EQUAL(polished.values[0], r.getValue("k2"));
+            CHECK_EQUAL(polished.values[1], r.getValue("k3"));
+        }
+        CHECK_EQUAL(0, r.getValue("time"));
+    }
+
+    TEST(GLOBAL_FIT_REPRODUCIBLE_THREADS)
+    {
+        RoadRunner r;
+        loadModel(r);
+        vector<RoadRunnerData> data(1, simulatedData(r));
+
+        GlobalFitOptions opt;
+        opt.seed = 42;
+        opt.maxGenerations = 50;
+        opt.polish = false;
+
+        opt.nThreads = 1;
+        r.setValue("k2", 1.8);
+        FitResult serial = r.globalFitParameters(data, boundedParameters(), &opt);
+
+        opt.nThreads = 3;
+        r.setValue("k2", 1.8);
+        FitResult parallel = r.globalFitParameters(data, boundedParameters(), &opt);
+
+        CHECK(serial.values == parallel.values);
+        CHECK_EQUAL(serial.chiSquare, parallel.chiSquare);
+        CHECK_EQUAL(serial.iterations, parallel.iterations);
+    }
+
+    TEST(GLOBAL_FIT_MODEL_LIBRARY)
+    {
+        string path = joinPath(gTempFolder, "threestep_model"
+                + Poco::SharedLibrary::suffix());
+
+        RoadRunner compiled;
+        loadModel(compiled);
+        compiled.compileModelLibrary(path);
+        vector<RoadRunnerData> data(1, simulatedData(compiled));
+
+        // the other threads evaluate the population on copies loaded
+        // from the library
+        RoadRunner r;
+        r.loadModelLibrary(path);
+        r.getSimulateOptions().absolute = 1e-12;
+        r.getSimulateOptions().relative = 1e-10;
+
+        GlobalFitOptions opt;
+        opt.seed = 1;
+        opt.maxGenerations = 200;
+        opt.nThreads = 3;
+
+        r.setValue("k2", 1.8);
+        r.setValue("k3", 0.02);
+        checkRecovered(r.globalFitParameters(data, boundedParameters(), &opt), 1e-5);
+    }
+
+    TEST(GLOBAL_FIT_INVALID_BOUNDS)
+    {
+        RoadRunner r;
+        loadModel(r);
+        vector<RoadRunnerData> data(1, simulatedData(r));
+
+        // the search samples the whole box, it must be finite
+        CHECK_THROW(r.globalFitParameters(data, fitParameters()), CoreException);
+
+        vector<FitParameter> zeroLog(1, FitParameter("k3", 0, 2, true));
+        CHECK_THROW(r.globalFitParameters(data, zeroLog), CoreException);
+
+        vector<FitParameter> reversed(1, FitParameter("k2", 2, 0.01));
+        CHECK_THROW(r.globalFitParameters(data, reversed), CoreException);
+
+        // the model is left as it was
+        CHECK_EQUAL(trueK2, r.getValue("k2"));
+        CHECK_EQUAL(trueK3, r.getValue("k3"));
+    }
+}
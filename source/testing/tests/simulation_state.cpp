@@ -0,0 +1,102 @@
+#include "unit_test/UnitTest++.h"
+#include "rrLogger.h"
+#include "rrRoadRunner.h"
+#include "rrRoadRunnerOptions.h"
+#include "rrException.h"
+#include "rrStringUtils.h"
+#include "rrUtils.h"
+
+#include <math.h>
+
+using namespace UnitTest;
+using namespace rr;
+using namespace std;
+
+extern string             gSBMLModelsPath;
+extern string             gTempFolder;
+
+SUITE(SimulationState)
+{
+    SimulateOptions continueOptions()
+    {
+        SimulateOptions opt;
+        opt.start = 5;
+        opt.duration = 5;
+        opt.steps = 10;
+        return opt;
+    }
+
+    void checkEqualResults(const ls::DoubleMatrix& expected,
+            const ls::DoubleMatrix& actual)
+    {
+        CHECK_EQUAL(expected.RSize(), actual.RSize());
+        CHECK_EQUAL(expected.CSize(), actual.CSize());
+
+        for (unsigned i = 0; i < expected.RSize() && i < actual.RSize(); i++)
+        {
+            for (unsigned j = 0; j < expected.CSize() && j < actual.CSize(); j++)
+            {
+                CHECK_CLOSE(expected[i][j], actual[i][j],
+                        1e-9 * (1 + fabs(expected[i][j])));
+            }
+        }
+    }
+
+    TEST(SAVE_LOAD_FILE)
+    {
+        string model = joinPath(gSBMLModelsPath, "feedback.xml");
+        string file = joinPath(gTempFolder, "feedback_state.rr");
+
+        RoadRunner r(model);
+        r.setValue("J0_VM1", 12);
+
+        SimulateOptions opt;
+        opt.duration = 5;
+        r.simulate(&opt);
+        r.saveState(file);
+
+        opt = continueOptions();
+        ls::DoubleMatrix expected = *r.simulate(&opt);
+
+        // a fresh instance with the same model, at its initial state
+        RoadRunner restored(model);
+        restored.loadState(file);
+
+        CHECK_CLOSE(5, restored.getValue("time"), 1e-12);
+        CHECK_CLOSE(12, restored.getValue("J0_VM1"), 1e-12);
+
+        checkEqualResults(expected, *restored.simulate(&opt));
+    }
+
+    TEST(SAVE_LOAD_STRING)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "feedback.xml"));
+
+        SimulateOptions opt;
+        opt.duration = 5;
+        r.simulate(&opt);
+        string state = r.saveStateS();
+
+        opt = continueOptions();
+        ls::DoubleMatrix expected = *r.simulate(&opt);
+
+        // restore into the instance which has moved on
+        r.loadStateS(state);
+        checkEqualResults(expected, *r.simulate(&opt));
+    }
+
+    TEST(LOAD_OTHER_MODEL)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "feedback.xml"));
+        string state = r.saveStateS();
+
+        RoadRunner other(joinPath(gSBMLModelsPath, "ss_threestep.xml"));
+        CHECK_THROW(other.loadStateS(state), CoreException);
+    }
+
+    TEST(LOAD_INVALID)
+    {
+        RoadRunner r(joinPath(gSBMLModelsPath, "feedback.xml"));
+        CHECK_THROW(r.loadStateS("not a saved state"), CoreException);
+    }
+}
@@ -0,0 +1,386 @@
+#include "unit_test/UnitTest++.h"
+#include "rrLogger.h"
+#include "rrRoadRunner.h"
+#include "rrRoadRunnerOptions.h"
+#include "rrConfig.h"
+#include "rrException.h"
+#include "rrStringUtils.h"
+#include "rrUtils.h"
+#include "conservation/SparseStructuralAnalysis.h"
+#include "rr-libstruct/lsLibStructural.h"
+
+#include <sbml/SBMLDocument.h>
+#include <sbml/SBMLReader.h>
+
+#include <list>
+#include <map>
+#include <sstream>
+#include <math.h>
+
+using namespace UnitTest;
+using namespace rr;
+using namespace std;
+
+extern string             gSBMLModelsPath;
+
+SUITE(Structural)
+{
+    // no conservation laws, one, and the three of the MAPK cascade
+    const char* models[] = {"ss_threeSpecies.xml", "ss_SimpleConservedCycle.xml",
+            "ss_TurnOnConservationAnalysis.xml", "BorisEJB.xml"};
+
+    const unsigned numModels = sizeof(models) / sizeof(models[0]);
+
+    void checkZero(const ls::DoubleMatrix& m, double tolerance)
+    {
+        for (unsigned i = 0; i < m.RSize(); ++i)
+        {
+            for (unsigned j = 0; j < m.CSize(); ++j)
+            {
+                CHECK_CLOSE(0, m[i][j], tolerance);
+            }
+        }
+    }
+
+    /**
+     * restores the sparse analysis threshold when it goes out of scope.
+     */
+    class SparseThreshold
+    {
+    public:
+        SparseThreshold(int threshold) :
+            saved(Config::getInt(Config::ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD))
+        {
+            Config::setValue(Config::ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD, threshold);
+        }
+
+        ~SparseThreshold()
+        {
+            Config::setValue(Config::ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD, saved);
+        }
+
+    private:
+        int saved;
+    };
+
+    /**
+     * S1 <-> S2 and S3 <-> 2 S4, with S1 and S3 in c1 of size 2 and S2 and
+     * S4 in c2 of size 0.5, so the conserved amounts S1 + S2 = 10 and
+     * 2 S3 + S4 = 5 are not sums of the concentrations. If setStoichiometry
+     * is false, the S2 reactant of J2 has no stoichiometry attribute.
+     */
+    string compartmentModel(bool setStoichiometry)
+    {
+        const string one = "stoichiometry=\"1\" ";
+        stringstream sbml;
+        sbml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+             << "<sbml xmlns=\"http://www.sbml.org/sbml/level3/version1/core\" level=\"3\" version=\"1\">"
+             << "  <model id=\"compartments\">"
+             << "    <listOfCompartments>"
+             << "      <compartment id=\"c1\" size=\"2\" constant=\"true\"/>"
+             << "      <compartment id=\"c2\" size=\"0.5\" constant=\"true\"/>"
+             << "    </listOfCompartments>"
+             << "    <listOfSpecies>"
+             << "      <species id=\"S1\" compartment=\"c1\" initialConcentration=\"3\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+             << "      <species id=\"S2\" compartment=\"c2\" initialAmount=\"4\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+             << "      <species id=\"S3\" compartment=\"c1\" initialConcentration=\"1\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+             << "      <species id=\"S4\" compartment=\"c2\" initialConcentration=\"2\" hasOnlySubstanceUnits=\"false\" boundaryCondition=\"false\" constant=\"false\"/>"
+             << "    </listOfSpecies>"
+             << "    <listOfReactions>"
+             << "      <reaction id=\"J1\" reversible=\"false\" fast=\"false\">"
+             << "        <listOfReactants><speciesReference species=\"S1\" " << one << "constant=\"true\"/></listOfReactants>"
+             << "        <listOfProducts><speciesReference species=\"S2\" " << one << "constant=\"true\"/></listOfProducts>"
+             << "        <kineticLaw><math xmlns=\"http://www.w3.org/1998/Math/MathML\"><ci>S1</ci></math></kineticLaw>"
+             << "      </reaction>"
+             << "      <reaction id=\"J2\" reversible=\"false\" fast=\"false\">"
+             << "        <listOfReactants><speciesReference species=\"S2\" " << (setStoichiometry ? one : "") << "constant=\"true\"/></listOfReactants>"
+             << "        <listOfProducts><speciesReference species=\"S1\" " << one << "constant=\"true\"/></listOfProducts>"
+             << "        <kineticLaw><math xmlns=\"http://www.w3.org/1998/Math/MathML\"><ci>S2</ci></math></kineticLaw>"
+             << "      </reaction>"
+             << "      <reaction id=\"J3\" reversible=\"false\" fast=\"false\">"
+             << "        <listOfReactants><speciesReference species=\"S3\" " << one << "constant=\"true\"/></listOfReactants>"
+             << "        <listOfProducts><speciesReference species=\"S4\" stoichiometry=\"2\" constant=\"true\"/></listOfProducts>"
+             << "        <kineticLaw><math xmlns=\"http://www.w3.org/1998/Math/MathML\"><ci>S3</ci></math></kineticLaw>"
+             << "      </reaction>"
+             << "      <reaction id=\"J4\" reversible=\"false\" fast=\"false\">"
+             << "        <listOfReactants><speciesReference species=\"S4\" stoichiometry=\"2\" constant=\"true\"/></listOfReactants>"
+             << "        <listOfProducts><speciesReference species=\"S3\" " << one << "constant=\"true\"/></listOfProducts>"
+             << "        <kineticLaw><math xmlns=\"http://www.w3.org/1998/Math/MathML\"><ci>S4</ci></math></kineticLaw>"
+             << "      </reaction>"
+             << "    </listOfReactions>"
+             << "  </model>"
+             << "</sbml>";
+        return sbml.str();
+    }
+
+    TEST(SPARSE_SAME_AS_LIBSTRUCTURAL)
+    {
+        for (unsigned m = 0; m < numModels; ++m)
+        {
+            libsbml::SBMLDocument *doc = libsbml::readSBMLFromFile(
+                    joinPath(gSBMLModelsPath, models[m]).c_str());
+            const libsbml::Model *model = doc->getModel();
+            CHECK(model != 0);
+            if (!model)
+            {
+                delete doc;
+                continue;
+            }
+
+            conservation::SparseStructuralAnalysis sparse(model);
+            ls::LibStructural dense(model);
+
+            // the same rank, so the same number of conservation laws
+            CHECK_EQUAL(dense.getNumIndSpecies(), sparse.getNumIndSpecies());
+            CHECK_EQUAL(dense.getNumDepSpecies(), sparse.getNumDepSpecies());
+
+            ls::DoubleMatrix n = sparse.getReorderedStoichiometryMatrix();
+            ls::DoubleMatrix nr = sparse.getNrMatrix();
+            ls::DoubleMatrix link = sparse.getLinkMatrix();
+            ls::DoubleMatrix gamma = sparse.getConservationMatrix();
+
+            CHECK_EQUAL((unsigned)sparse.getNumIndSpecies(), nr.RSize());
+            CHECK_EQUAL((unsigned)sparse.getNumDepSpecies(), gamma.RSize());
+
+            // N = L Nr, and the conservation laws are in the left null space
+            // of N. There are as many of them as LibStructural finds, so they
+            // span the same space, even if a different set of independent
+            // species was chosen.
+            if (link.CSize() == nr.RSize() && link.RSize() == n.RSize())
+            {
+                ls::DoubleMatrix residual = n;
+                ls::gemm(1, link, nr, -1, residual);
+                checkZero(residual, 1e-10);
+            }
+
+            if (gamma.RSize() && gamma.CSize() == n.RSize())
+            {
+                checkZero(ls::mult(gamma, n), 1e-10);
+            }
+
+            // both are [-L0 I], for a single law this is the same sum,
+            // whichever species is the dependent one.
+            vector<double> sums = sparse.getConservedSums();
+            vector<double> denseSums = dense.getConservedSums();
+            CHECK_EQUAL(denseSums.size(), sums.size());
+
+            if (sums.size() == 1 && denseSums.size() == 1)
+            {
+                CHECK_CLOSE(fabs(denseSums[0]), fabs(sums[0]),
+                        1e-10 * (1 + fabs(denseSums[0])));
+            }
+
+            delete doc;
+        }
+    }
+
+    TEST(SPARSE_COMPARTMENT_AMOUNTS)
+    {
+        libsbml::SBMLDocument *doc = libsbml::readSBMLFromString(
+                compartmentModel(true).c_str());
+        const libsbml::Model *model = doc->getModel();
+
+        conservation::SparseStructuralAnalysis sparse(model);
+        ls::LibStructural dense(model);
+
+        CHECK_EQUAL(2, dense.getNumDepSpecies());
+        CHECK_EQUAL(dense.getNumIndSpecies(), sparse.getNumIndSpecies());
+        CHECK_EQUAL(dense.getNumDepSpecies(), sparse.getNumDepSpecies());
+
+        ls::DoubleMatrix n = sparse.getReorderedStoichiometryMatrix();
+        ls::DoubleMatrix nr = sparse.getNrMatrix();
+        ls::DoubleMatrix link = sparse.getLinkMatrix();
+
+        if (link.CSize() == nr.RSize() && link.RSize() == n.RSize())
+        {
+            ls::DoubleMatrix residual = n;
+            ls::gemm(1, link, nr, -1, residual);
+            checkZero(residual, 1e-10);
+        }
+
+        // the initial amounts, the compartment size times the
+        // concentration for all but S2
+        map<string, double> amounts;
+        amounts["S1"] = 6;
+        amounts["S2"] = 4;
+        amounts["S3"] = 2;
+        amounts["S4"] = 1;
+
+        // S2 and S4 are the dependent species, with the sums in order
+        vector<double> sums = sparse.getConservedSums();
+        CHECK_EQUAL(2u, sums.size());
+        if (sums.size() == 2)
+        {
+            CHECK_CLOSE(10, sums[0], 1e-12);
+            CHECK_CLOSE(5, sums[1], 1e-12);
+        }
+
+        // the dense laws are combinations of the sparse ones, Gd = C Gs,
+        // with C the columns of Gd of the sparse dependent species as
+        // Gs = [-L0 I], so applied to the amounts Gd x = C T.
+        vector<string> denseSpecies = dense.getReorderedSpecies();
+        vector<string> depSpecies = sparse.getDependentSpecies();
+        ls::DoubleMatrix *gamma = dense.getGammaMatrix();
+
+        CHECK(gamma != 0 && gamma->CSize() == denseSpecies.size());
+        for (unsigned i = 0; gamma && i < gamma->RSize()
+                && gamma->CSize() == denseSpecies.size()
+                && sums.size() == depSpecies.size(); ++i)
+        {
+            double expected = 0;
+            double actual = 0;
+            for (unsigned k = 0; k < denseSpecies.size(); ++k)
+            {
+                expected += (*gamma)[i][k] * amounts[denseSpecies[k]];
+
+                for (unsigned j = 0; j < depSpecies.size(); ++j)
+                {
+                    if (depSpecies[j] == denseSpecies[k])
+                    {
+                        actual += (*gamma)[i][k] * sums[j];
+                    }
+                }
+            }
+            CHECK_CLOSE(expected, actual, 1e-10 * (1 + fabs(expected)));
+        }
+
+        delete doc;
+    }
+
+    TEST(SPARSE_UNSET_STOICHIOMETRY)
+    {
+        libsbml::SBMLDocument *set = libsbml::readSBMLFromString(
+                compartmentModel(true).c_str());
+        libsbml::SBMLDocument *unset = libsbml::readSBMLFromString(
+                compartmentModel(false).c_str());
+
+        // an unset L3 stoichiometry is 1
+        conservation::SparseStructuralAnalysis expected(set->getModel());
+        conservation::SparseStructuralAnalysis actual(unset->getModel());
+
+        ls::DoubleMatrix n = expected.getReorderedStoichiometryMatrix();
+        ls::DoubleMatrix unsetN = actual.getReorderedStoichiometryMatrix();
+        CHECK_EQUAL(n.RSize(), unsetN.RSize());
+        CHECK_EQUAL(n.CSize(), unsetN.CSize());
+
+        if (n.RSize() == unsetN.RSize() && n.CSize() == unsetN.CSize())
+        {
+            for (unsigned i = 0; i < n.RSize(); ++i)
+            {
+                for (unsigned j = 0; j < n.CSize(); ++j)
+                {
+                    CHECK_EQUAL(n[i][j], unsetN[i][j]);
+                }
+            }
+        }
+
+        CHECK(expected.getConservedSums() == actual.getConservedSums());
+
+        delete set;
+        delete unset;
+    }
+
+    TEST(SPARSE_STOICHIOMETRY_MATH)
+    {
+        const char* sbml =
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+            "<sbml xmlns=\"http://www.sbml.org/sbml/level2/version4\" level=\"2\" version=\"4\">"
+            "  <model id=\"stoichiometryMath\">"
+            "    <listOfCompartments>"
+            "      <compartment id=\"c\" size=\"1\"/>"
+            "    </listOfCompartments>"
+            "    <listOfSpecies>"
+            "      <species id=\"S1\" compartment=\"c\" initialConcentration=\"1\"/>"
+            "      <species id=\"S2\" compartment=\"c\" initialConcentration=\"0\"/>"
+            "    </listOfSpecies>"
+            "    <listOfParameters>"
+            "      <parameter id=\"n\" value=\"2\"/>"
+            "    </listOfParameters>"
+            "    <listOfReactions>"
+            "      <reaction id=\"J1\" reversible=\"false\">"
+            "        <listOfReactants>"
+            "          <speciesReference species=\"S1\">"
+            "            <stoichiometryMath>"
+            "              <math xmlns=\"http://www.w3.org/1998/Math/MathML\"><ci>n</ci></math>"
+            "            </stoichiometryMath>"
+            "          </speciesReference>"
+            "        </listOfReactants>"
+            "        <listOfProducts>"
+            "          <speciesReference species=\"S2\"/>"
+            "        </listOfProducts>"
+            "        <kineticLaw>"
+            "          <math xmlns=\"http://www.w3.org/1998/Math/MathML\"><ci>S1</ci></math>"
+            "        </kineticLaw>"
+            "      </reaction>"
+            "    </listOfReactions>"
+            "  </model>"
+            "</sbml>";
+
+        libsbml::SBMLDocument *doc = libsbml::readSBMLFromString(sbml);
+
+        // the stoichiometry is not known until the model is evaluated,
+        // so the model is left to LibStructural
+        SparseThreshold threshold(1);
+        CHECK(!conservation::SparseStructuralAnalysis::isSparseModel(doc->getModel()));
+        CHECK_THROW(conservation::SparseStructuralAnalysis sparse(doc->getModel()),
+                CoreException);
+
+        delete doc;
+    }
+
+    TEST(SPARSE_SIMULATION)
+    {
+        for (unsigned m = 0; m < numModels; ++m)
+        {
+            LoadSBMLOptions opt;
+            opt.modelGeneratorOpt |= LoadSBMLOptions::CONSERVED_MOIETIES;
+
+            string path = joinPath(gSBMLModelsPath, models[m]);
+
+            SimulateOptions sim;
+            sim.duration = 10;
+            sim.steps = 50;
+            sim.absolute = 1e-12;
+            sim.relative = 1e-9;
+
+            ls::DoubleMatrix expected, actual;
+            unsigned denseLaws = 0;
+            vector<string> selections;
+            {
+                SparseThreshold threshold(0);
+                RoadRunner r(path, &opt);
+
+                // the same columns, whichever species are independent
+                list<string> ids;
+                r.getIds(SelectionRecord::FLOATING_CONCENTRATION, ids);
+                ids.sort();
+                selections.push_back("time");
+                selections.insert(selections.end(), ids.begin(), ids.end());
+
+                r.setSelections(selections);
+                expected = *r.simulate(&sim);
+                denseLaws = r.getConservationMatrix().RSize();
+            }
+            {
+                // every model with at least one floating species is sparse
+                SparseThreshold threshold(1);
+                RoadRunner r(path, &opt);
+                r.setSelections(selections);
+                actual = *r.simulate(&sim);
+                CHECK_EQUAL(denseLaws, r.getConservationMatrix().RSize());
+            }
+
+            CHECK_EQUAL(expected.RSize(), actual.RSize());
+            CHECK_EQUAL(expected.CSize(), actual.CSize());
+
+            for (unsigned i = 0; i < expected.RSize() && i < actual.RSize(); ++i)
+            {
+                for (unsigned j = 0; j < expected.CSize() && j < actual.CSize(); ++j)
+                {
+                    CHECK_CLOSE(expected[i][j], actual[i][j],
+                            1e-7 * (1 + fabs(expected[i][j])));
+                }
+            }
+        }
+    }
+}
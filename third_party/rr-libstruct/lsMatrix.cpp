@@ -9,6 +9,12 @@
 #include "lsMatrix.h"
 #include "lsUtils.h"
 
+extern "C"
+{
+#include "f2c.h"
+#include "clapack.h"
+}
+
 //---------------------------------------------------------------------------
 namespace ls
 {
@@ -133,19 +139,7 @@ ls::DoubleMatrix mult(ls::DoubleMatrix& m1, ls::DoubleMatrix& m2)
 
     if (m1_nColumns == m2_nRows)
     {
-        result.resize(m1_nRows, m2_nColumns);
-        for (unsigned int row = 0; row < result.numRows(); row++)
-        {
-            for (unsigned int col = 0; col < m2_nColumns; col++)
-            {
-                double sum = 0.0;
-                for (unsigned int k = 0; k < m1_nColumns; k++)
-                {
-                    sum = sum + (m1[row][k] * m2[k][col]);
-                }
-                result[row][col] = sum;
-            }
-        }
+        gemm(1.0, m1, m2, 0.0, result);
         return result;
     }
 
@@ -180,18 +174,8 @@ DoubleMatrix mult(ComplexMatrix& m1, DoubleMatrix& m2)
     DoubleMatrix result(m1_nRows, m2_nColumns);
     if (m1_nColumns == m2_nRows)
     {
-        for (unsigned int row = 0; row < result.numRows(); row++)
-        {
-            for (unsigned int col = 0; col < m2_nColumns; col++)
-            {
-                double sum = 0.0;
-                for (unsigned int k = 0; k < m1_nColumns; k++)
-                {
-                    sum = sum + (real(m1[row][k]) * m2[k][col]);
-                }
-                result[row][col] = sum;
-            }
-        }
+        DoubleMatrix re = real(m1);
+        gemm(1.0, re, m2, 0.0, result);
         return result;
     }
 
@@ -224,18 +208,8 @@ DoubleMatrix mult(DoubleMatrix& m2, ComplexMatrix& m1)
     DoubleMatrix result(m1_nRows, m2_nColumns);
     if (m1_nColumns == m2_nRows)
     {
-        for (unsigned int row = 0; row < result.numRows(); row++)
-        {
-            for (unsigned int col = 0; col < m2_nColumns; col++)
-            {
-                double sum = 0.0;
-                for (unsigned int k = 0; k < m1_nColumns; k++)
-                {
-                    sum = sum + (real(m1[row][k]) * m2[k][col]);
-                }
-                result[row][col] = sum;
-            }
-        }
+        DoubleMatrix re = real(m1);
+        gemm(1.0, re, m2, 0.0, result);
         return result;
     }
 
@@ -290,29 +264,117 @@ bool sameDimensions(ComplexMatrix& x, ComplexMatrix& y)
 
 ls::ComplexMatrix mult(ls::ComplexMatrix& m1, ls::ComplexMatrix& m2)
 {
-    if(m1.CSize() != m2.RSize())
+    ComplexMatrix temp;
+    mult(m1, m2, temp);
+    return temp;
+}
+
+// ******************************************************************** }
+// BLAS backed products, into an existing result                         }
+//                                                                      }
+// The matrices are row major, which BLAS sees as the transpose, so     }
+// C = A B is computed as C' = B' A'.                                   }
+// ******************************************************************** }
+void gemm(double alpha, const DoubleMatrix& A, const DoubleMatrix& B,
+        double beta, DoubleMatrix& C)
+{
+    if (A.numCols() != B.numRows())
     {
         throw("Matrix product not defined, incompatible sizes..\n");
-      }
+    }
 
-      ComplexMatrix temp(m1.RSize(), m2.CSize());
-      Complex tempVal(0,0);
-      for(int row1 = 0; row1 < m1.RSize(); row1++)
+    if (&C == &A || &C == &B)
     {
-        for(int rescol = 0; rescol < m2.CSize(); rescol++)
-        {
-              for(int col1 = 0; col1 < m1.CSize(); col1++)
-            {
-                Complex val1 = m1(row1,col1);
-                Complex val2 = m2(col1,rescol);
-                Complex test = val1*val2;
-                tempVal = test + tempVal;
-              }
-              temp(row1,rescol) = tempVal;
-              tempVal = Complex(0,0);
-        }
-      }
-      return temp;
+        DoubleMatrix tmp(C);
+        gemm(alpha, A, B, beta, tmp);
+        C.swap(tmp);
+        return;
+    }
+
+    if (beta == 0.0)
+    {
+        C.resize(A.numRows(), B.numCols());
+    }
+    else if (C.numRows() != A.numRows() || C.numCols() != B.numCols())
+    {
+        throw("Matrix product not defined, incompatible sizes..\n");
+    }
+
+    integer m = B.numCols();
+    integer n = A.numRows();
+    integer k = A.numCols();
+
+    if (m == 0 || n == 0)
+    {
+        return;
+    }
+
+    integer lda = m;
+    integer ldb = k > 0 ? k : 1;
+    integer ldc = m;
+    char trans = 'N';
+
+    dgemm_(&trans, &trans, &m, &n, &k, &alpha,
+            const_cast<double*>(B[0]), &lda, const_cast<double*>(A[0]), &ldb,
+            &beta, C[0], &ldc);
+}
+
+void gemm(const Complex& alpha, const ComplexMatrix& A, const ComplexMatrix& B,
+        const Complex& beta, ComplexMatrix& C)
+{
+    if (A.numCols() != B.numRows())
+    {
+        throw("Matrix product not defined, incompatible sizes..\n");
+    }
+
+    if (&C == &A || &C == &B)
+    {
+        ComplexMatrix tmp(C);
+        gemm(alpha, A, B, beta, tmp);
+        C.swap(tmp);
+        return;
+    }
+
+    if (beta == Complex(0.0, 0.0))
+    {
+        C.resize(A.numRows(), B.numCols());
+    }
+    else if (C.numRows() != A.numRows() || C.numCols() != B.numCols())
+    {
+        throw("Matrix product not defined, incompatible sizes..\n");
+    }
+
+    integer m = B.numCols();
+    integer n = A.numRows();
+    integer k = A.numCols();
+
+    if (m == 0 || n == 0)
+    {
+        return;
+    }
+
+    integer lda = m;
+    integer ldb = k > 0 ? k : 1;
+    integer ldc = m;
+    char trans = 'N';
+
+    // std::complex<double> has the same layout as doublecomplex
+    doublecomplex a = {alpha.real(), alpha.imag()};
+    doublecomplex b = {beta.real(), beta.imag()};
+
+    zgemm_(&trans, &trans, &m, &n, &k, &a,
+            (doublecomplex*)(B[0]), &lda, (doublecomplex*)(A[0]), &ldb,
+            &b, (doublecomplex*)C[0], &ldc);
+}
+
+void mult(const DoubleMatrix& m1, const DoubleMatrix& m2, DoubleMatrix& result)
+{
+    gemm(1.0, m1, m2, 0.0, result);
+}
+
+void mult(const ComplexMatrix& m1, const ComplexMatrix& m2, ComplexMatrix& result)
+{
+    gemm(Complex(1.0, 0.0), m1, m2, Complex(0.0, 0.0), result);
 }
 
 
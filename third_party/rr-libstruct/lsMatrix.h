@@ -13,6 +13,10 @@
 #include <complex>
 #include "lsExporter.h"
 
+// compilers with rvalue references get a move constructor and assignment
+#if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__) || (defined(_MSC_VER) && _MSC_VER >= 1600)
+#define LS_RVALUE_REFERENCES 1
+#endif
 
 namespace ls
 {
@@ -42,6 +46,11 @@ class Matrix
                                     Matrix(const Matrix< double >& src);
                                     Matrix(const Matrix< Complex >& src, bool real = true);
 
+#ifdef LS_RVALUE_REFERENCES
+                                    //! Move constructor, takes over the data of src, which is left empty
+                                    Matrix(Matrix< T >&& src);
+#endif
+
                                     //! Constructor taking a matrix mapped to a vector and reconstructing the 2D form
                                     Matrix( T* &oRawData, int nRows, int nCols, bool transpose = true);
 
@@ -82,9 +91,26 @@ class Matrix
                                     //! creates a new matrix holding the transpose
         Matrix<T>*                  getTranspose();
 
-                                    //! assignment operator
+                                    //! assignment operator, re-uses the existing data if the size matches
         Matrix<T>&                  operator = (const Matrix <T>& rhs);
 
+#ifdef LS_RVALUE_REFERENCES
+                                    //! move assignment operator, takes over the data of rhs
+        Matrix<T>&                  operator = (Matrix <T>&& rhs);
+#endif
+
+                                    //! exchanges the data with other without copying
+        void                        swap(Matrix<T>& other);
+
+                                    //! in-place element wise addition, the sizes must match
+        Matrix<T>&                  operator += (const Matrix <T>& rhs);
+
+                                    //! in-place element wise subtraction, the sizes must match
+        Matrix<T>&                  operator -= (const Matrix <T>& rhs);
+
+                                    //! in-place scaling
+        Matrix<T>&                  operator *= (const T & value);
+
                                     //! scalar assignment operator
         Matrix<T>&                  operator = (const T & value);
 
@@ -129,6 +155,17 @@ LIB_EXTERN DoubleMatrix             mult(DoubleMatrix& m1, ComplexMatrix& m2);
 
 LIB_EXTERN ComplexMatrix             subtract(ComplexMatrix& x, ComplexMatrix& y);
 LIB_EXTERN ComplexMatrix               mult(ComplexMatrix& m1, ComplexMatrix& m2);
+
+//! result = m1 m2, with BLAS. result re-uses its data if it already has the right size, and may be m1 or m2.
+LIB_EXTERN void                     mult(const DoubleMatrix& m1, const DoubleMatrix& m2, DoubleMatrix& result);
+LIB_EXTERN void                     mult(const ComplexMatrix& m1, const ComplexMatrix& m2, ComplexMatrix& result);
+
+//! C = alpha A B + beta C, with BLAS dgemm / zgemm. If beta is zero, C is resized to the
+//! size of the product, otherwise it must already have that size.
+LIB_EXTERN void                     gemm(double alpha, const DoubleMatrix& A, const DoubleMatrix& B,
+                                         double beta, DoubleMatrix& C);
+LIB_EXTERN void                     gemm(const Complex& alpha, const ComplexMatrix& A, const ComplexMatrix& B,
+                                         const Complex& beta, ComplexMatrix& C);
 LIB_EXTERN bool                     sameDimensions(ComplexMatrix& x, ComplexMatrix& y);
 
 
@@ -268,6 +305,19 @@ _Array(NULL)
     }
 }
 
+#ifdef LS_RVALUE_REFERENCES
+template<class T>
+inline Matrix<T>::Matrix(Matrix<T>&& src) :
+_Rows(src._Rows),
+_Cols(src._Cols),
+_Array(src._Array)
+{
+    src._Rows = 0;
+    src._Cols = 0;
+    src._Array = NULL;
+}
+#endif
+
 template<class T>
 inline Matrix<T>::Matrix( T* &oRawData, int nRows, int nCols, bool transpose) :
     _Rows(nRows),
@@ -476,6 +526,81 @@ Matrix<T>& Matrix<T>::operator = (const Matrix <T>& rhs)
   return *this;
 }
 
+#ifdef LS_RVALUE_REFERENCES
+template<class T>
+Matrix<T>& Matrix<T>::operator = (Matrix <T>&& rhs)
+{
+    if (this != &rhs)
+    {
+        delete [] _Array;
+        _Rows = rhs._Rows;
+        _Cols = rhs._Cols;
+        _Array = rhs._Array;
+        rhs._Rows = 0;
+        rhs._Cols = 0;
+        rhs._Array = NULL;
+    }
+    return *this;
+}
+#endif
+
+template<class T>
+void Matrix<T>::swap(Matrix<T>& other)
+{
+    unsigned int rows = _Rows;
+    unsigned int cols = _Cols;
+    T* array = _Array;
+    _Rows = other._Rows;
+    _Cols = other._Cols;
+    _Array = other._Array;
+    other._Rows = rows;
+    other._Cols = cols;
+    other._Array = array;
+}
+
+template<class T>
+Matrix<T>& Matrix<T>::operator += (const Matrix <T>& rhs)
+{
+    if (_Rows != rhs._Rows || _Cols != rhs._Cols)
+    {
+        throw ("Matrices must be the same dimension to perform addition");
+    }
+
+    unsigned int i, imax = _Rows * _Cols;
+    for (i = 0; i < imax; i++)
+    {
+        _Array[i] += rhs._Array[i];
+    }
+    return *this;
+}
+
+template<class T>
+Matrix<T>& Matrix<T>::operator -= (const Matrix <T>& rhs)
+{
+    if (_Rows != rhs._Rows || _Cols != rhs._Cols)
+    {
+        throw ("Matrices must be the same dimension to perform subtraction");
+    }
+
+    unsigned int i, imax = _Rows * _Cols;
+    for (i = 0; i < imax; i++)
+    {
+        _Array[i] -= rhs._Array[i];
+    }
+    return *this;
+}
+
+template<class T>
+Matrix<T>& Matrix<T>::operator *= (const T & value)
+{
+    unsigned int i, imax = _Rows * _Cols;
+    for (i = 0; i < imax; i++)
+    {
+        _Array[i] *= value;
+    }
+    return *this;
+}
+
 //template<class T>
 //Matrix<T>& Matrix<T>::operator = (const Matrix<double>& rhs)
 //{
@@ -1206,6 +1206,124 @@ RRStringArrayPtr rrcCallConv getSteadyStateSelectionList(RRHandle handle)
     catch_ptr_macro
 }
 
+/**
+ * the parameters of a fit, with optional bounds.
+ */
+static vector<FitParameter> toFitParameters(const char* parameters,
+        const RRVectorPtr lowerBounds, const RRVectorPtr upperBounds, bool logScale)
+{
+    StringList ids(parameters, " ,");
+
+    if ((lowerBounds && lowerBounds->Count != ids.Count())
+            || (upperBounds && upperBounds->Count != ids.Count()))
+    {
+        throw CoreException("Parameter fits need a bound for each parameter");
+    }
+
+    vector<FitParameter> fitParameters;
+    for (int i = 0; i < ids.Count(); ++i)
+    {
+        FitParameter p(ids[i]);
+        p.lower = lowerBounds ? lowerBounds->Data[i] : p.lower;
+        p.upper = upperBounds ? upperBounds->Data[i] : p.upper;
+        p.logScale = logScale;
+        fitParameters.push_back(p);
+    }
+    return fitParameters;
+}
+
+/**
+ * copies the C data sets of a fit, with their weights.
+ */
+static vector<RoadRunnerData> toFitData(const RRCDataPtr* data, int nData)
+{
+    vector<RoadRunnerData> fitData(nData);
+    for (int d = 0; d < nData; ++d)
+    {
+        const RRCData& in = *data[d];
+        RoadRunnerData& out = fitData[d];
+
+        vector<string> names;
+        for (int j = 0; j < in.CSize; ++j)
+        {
+            names.push_back(in.ColumnHeaders[j]);
+        }
+
+        out.reSize(in.RSize, in.CSize);
+        out.setColumnNames(names);
+        if (in.Weights)
+        {
+            out.allocateWeights();
+        }
+
+        for (int i = 0; i < in.RSize; ++i)
+        {
+            for (int j = 0; j < in.CSize; ++j)
+            {
+                out(i, j) = in.Data[i * in.CSize + j];
+                if (in.Weights)
+                {
+                    out.setWeight(i, j, in.Weights[i * in.CSize + j]);
+                }
+            }
+        }
+    }
+    return fitData;
+}
+
+RRVectorPtr rrcCallConv fitParameters(RRHandle handle, const RRCDataPtr* data,
+        int nData, const char* parameters, const RRVectorPtr lowerBounds,
+        const RRVectorPtr upperBounds, bool logScale, int nThreads, double* chiSquare)
+{
+    start_try
+        RoadRunner* rri = castToRoadRunner(handle);
+
+        FitOptions options;
+        options.nThreads = nThreads;
+
+        FitResult result = rri->fitParameters(toFitData(data, nData),
+                toFitParameters(parameters, lowerBounds, upperBounds, logScale),
+                &options);
+
+        if (chiSquare)
+        {
+            *chiSquare = result.chiSquare;
+        }
+
+        return rrc::createVector(result.values);
+    catch_ptr_macro
+}
+
+RRVectorPtr rrcCallConv globalFitParameters(RRHandle handle, const RRCDataPtr* data,
+        int nData, const char* parameters, const RRVectorPtr lowerBounds,
+        const RRVectorPtr upperBounds, bool logScale, int maxGenerations,
+        int nThreads, double* chiSquare)
+{
+    start_try
+        RoadRunner* rri = castToRoadRunner(handle);
+
+        if (!lowerBounds || !upperBounds)
+        {
+            throw CoreException("globalFitParameters needs lower and upper bounds");
+        }
+
+        GlobalFitOptions options;
+        options.maxGenerations = maxGenerations;
+        options.nThreads = nThreads;
+
+        FitResult result = rri->globalFitParameters(toFitData(data, nData),
+                toFitParameters(parameters, lowerBounds, upperBounds, logScale),
+                &options);
+
+        if (chiSquare)
+        {
+            *chiSquare = result.chiSquare;
+        }
+
+        return rrc::createVector(result.values);
+    catch_ptr_macro
+}
+
 RRDoubleMatrixPtr rrcCallConv getFullJacobian(RRHandle handle)
 {
     start_try
@@ -686,6 +686,71 @@ C_DECL_SPEC bool rrcCallConv setSteadyStateSelectionList(RRHandle handle, const
 */
 C_DECL_SPEC RRStringArrayPtr rrcCallConv getSteadyStateSelectionList(RRHandle handle);
 
+// --------------------------------------------------------------------------------
+// Parameter estimation
+// --------------------------------------------------------------------------------
+
+/*!
+ \brief Estimate global parameters from experimental time courses
+
+ Each data set needs a "time" column, the other column headers are symbols such as
+ "S1" or "[S1]". NaN values are missing observations, and if the data set has weights,
+ each residual is multiplied by its weight. The residuals are evaluated in parallel on
+ copies of the model, and the fitted values are set in the model.
+
+ Example:
+
+ \code
+ RRVectorPtr values = fitParameters (rrHandle, &data, 1, "k1, k2", NULL, NULL, false, 0, &chiSquare);
+ \endcode
+
+ \param[in] handle Handle to a RoadRunner instance
+ \param[in] data Array of nData experimental data sets
+ \param[in] nData Number of data sets
+ \param[in] parameters Comma or space separated list of global parameter ids
+ \param[in] lowerBounds Lower bound of each parameter, or NULL for no lower bounds
+ \param[in] upperBounds Upper bound of each parameter, or NULL for no upper bounds
+ \param[in] logScale Estimate the log of the parameters, they must then be positive
+ \param[in] nThreads Number of threads, one per processor if zero
+ \param[out] chiSquare The sum of the squared weighted residuals at the solution, may be NULL
+ \return Returns the fitted parameter values, or null if an error occured
+ \ingroup parameters
+*/
+C_DECL_SPEC RRVectorPtr rrcCallConv fitParameters(RRHandle handle, const RRCDataPtr* data,
+        int nData, const char* parameters, const RRVectorPtr lowerBounds,
+        const RRVectorPtr upperBounds, bool logScale, int nThreads, double* chiSquare);
+
+/*!
+ \brief Estimate global parameters with a differential evolution search within their bounds
+
+ The data sets are as in fitParameters. The current parameter values are one member of
+ the initial population, the population is evaluated in parallel on copies of the model,
+ and the best member is refined with a local fit. The fitted values are set in the model.
+
+ Example:
+
+ \code
+ RRVectorPtr values = globalFitParameters (rrHandle, &data, 1, "k1, k2", lower, upper, true, 1000, 0, &chiSquare);
+ \endcode
+
+ \param[in] handle Handle to a RoadRunner instance
+ \param[in] data Array of nData experimental data sets
+ \param[in] nData Number of data sets
+ \param[in] parameters Comma or space separated list of global parameter ids
+ \param[in] lowerBounds Finite lower bound of each parameter
+ \param[in] upperBounds Finite upper bound of each parameter
+ \param[in] logScale Search the log of the parameters, the lower bounds must then be positive
+ \param[in] maxGenerations Maximum number of generations of the population
+ \param[in] nThreads Number of threads, one per processor if zero
+ \param[out] chiSquare The sum of the squared weighted residuals at the solution, may be NULL
+ \return Returns the fitted parameter values, or null if an error occured
+ \ingroup parameters
+*/
+C_DECL_SPEC RRVectorPtr rrcCallConv globalFitParameters(RRHandle handle, const RRCDataPtr* data,
+        int nData, const char* parameters, const RRVectorPtr lowerBounds,
+        const RRVectorPtr upperBounds, bool logScale, int maxGenerations,
+        int nThreads, double* chiSquare);
+
 
 // --------------------------------------------------------------------------------
 // Get and Set Routines
@@ -31,11 +31,13 @@
     #include <rrExecutableModel.h>
     #include <rrRoadRunnerOptions.h>
     #include <rrRoadRunner.h>
+    #include <rrEnsembleStatistics.h>
     #include <rrLogger.h>
     #include <rrConfig.h>
     #include <conservation/ConservationExtension.h>
     #include "conservation/ConservedMoietyConverter.h"
     #include <cstddef>
+    #include <stdexcept>
     #include <map>
     #include <rrVersionInfo.h>
     #include <rrException.h>
@@ -319,6 +321,132 @@ static std::string strvec_to_pystring(const std::vector<std::string>& strvec) {
 }
 
 
+/**
+ * copy any sequence of numbers into a vector, rows is set to the number of
+ * rows if it is two dimensional.
+ */
+static std::vector<double> _PyObject_toDoubles(PyObject *obj, const char* what,
+                                               int *rows = 0) {
+    PyObject *array = PyArray_FROM_OTF(obj, NPY_DOUBLE, NPY_IN_ARRAY);
+
+    if (!array || PyArray_NDIM((PyArrayObject*)array) > (rows ? 2 : 1)) {
+        Py_XDECREF(array);
+        PyErr_Clear();
+        throw std::invalid_argument(std::string(what) + " has the wrong shape");
+    }
+
+    if (rows) {
+        *rows = PyArray_NDIM((PyArrayObject*)array) == 2 ?
+                PyArray_DIMS((PyArrayObject*)array)[0] : 1;
+    }
+
+    const double *data = (const double*)PyArray_DATA((PyArrayObject*)array);
+    std::vector<double> result(data, data + PyArray_SIZE((PyArrayObject*)array));
+    Py_DECREF(array);
+
+    return result;
+}
+
+/**
+ * the parameters of a fit, lower, upper and logScale have a value for each.
+ */
+static std::vector<rr::FitParameter> _PyObject_toFitParameters(
+        const std::vector<std::string>& parameters, PyObject *lower,
+        PyObject *upper, PyObject *logScale) {
+    std::vector<double> lo = _PyObject_toDoubles(lower, "lower");
+    std::vector<double> hi = _PyObject_toDoubles(upper, "upper");
+    std::vector<double> logs = _PyObject_toDoubles(logScale, "logScale");
+
+    if (lo.size() != parameters.size() || hi.size() != parameters.size()
+            || logs.size() != parameters.size()) {
+        throw std::invalid_argument("lower, upper and logScale need a value for each parameter");
+    }
+
+    std::vector<rr::FitParameter> fitParameters;
+    for (unsigned j = 0; j < parameters.size(); ++j) {
+        fitParameters.push_back(rr::FitParameter(parameters[j], lo[j], hi[j], logs[j] != 0));
+    }
+
+    return fitParameters;
+}
+
+/**
+ * data is a list of (column names, values, weights or None) tuples.
+ */
+static std::vector<rr::RoadRunnerData> _PyObject_toFitData(PyObject *data) {
+    if (!PyList_Check(data)) {
+        throw std::invalid_argument("data must be a list of data sets");
+    }
+
+    std::vector<rr::RoadRunnerData> fitData(PyList_Size(data));
+
+    for (unsigned d = 0; d < fitData.size(); ++d) {
+        PyObject *item = PyList_GetItem(data, d);
+        PyObject *names = 0, *values = 0, *weights = 0;
+
+        if (!PyArg_ParseTuple(item, "OOO", &names, &values, &weights)) {
+            PyErr_Clear();
+            throw std::invalid_argument("each data set must be a (columns, values, weights) tuple");
+        }
+
+        std::vector<std::string> columns;
+        for (Py_ssize_t j = 0; j < PySequence_Size(names); ++j) {
+            PyObject *name = PySequence_GetItem(names, j);
+            columns.push_back(name && PyString_Check(name) ? PyString_AsString(name) : "");
+            Py_XDECREF(name);
+        }
+
+        int rows = 0;
+        std::vector<double> v = _PyObject_toDoubles(values, "values", &rows);
+
+        if (v.size() != rows * columns.size()) {
+            throw std::invalid_argument("the data values need a column for each name");
+        }
+
+        rr::RoadRunnerData& out = fitData[d];
+        out.reSize(rows, columns.size());
+        out.setColumnNames(columns);
+        for (unsigned k = 0; k < v.size(); ++k) {
+            out(k / columns.size(), k % columns.size()) = v[k];
+        }
+
+        if (weights != Py_None) {
+            std::vector<double> w = _PyObject_toDoubles(weights, "weights", &rows);
+
+            if (w.size() != v.size()) {
+                throw std::invalid_argument("the weights must have the shape of the values");
+            }
+
+            out.allocateWeights();
+            for (unsigned k = 0; k < w.size(); ++k) {
+                out.setWeight(k / columns.size(), k % columns.size(), w[k]);
+            }
+        }
+    }
+
+    return fitData;
+}
+
+/**
+ * the fit result as a dict.
+ */
+static PyObject *_FitResult_toPyObject(const rr::FitResult& result) {
+    npy_intp m = result.values.size();
+    PyObject *values = PyArray_SimpleNew(1, &m, NPY_DOUBLE);
+    std::copy(result.values.begin(), result.values.end(),
+            (double*)PyArray_DATA((PyArrayObject*)values));
+
+    PyObject *errors = PyArray_SimpleNew(1, &m, NPY_DOUBLE);
+    std::copy(result.standardErrors.begin(), result.standardErrors.end(),
+            (double*)PyArray_DATA((PyArrayObject*)errors));
+
+    return Py_BuildValue("{s:N,s:N,s:d,s:i,s:i,s:N}", "values", values,
+            "standardErrors", errors, "chiSquare", result.chiSquare,
+            "iterations", result.iterations, "evaluations", result.evaluations,
+            "converged", PyBool_FromLong(result.converged));
+}
+
+
 
 // make a python obj out of the C++ ExecutableModel, this is used by the PyEventListener
 // class. This function is defined later in this compilation unit.
@@ -474,6 +602,11 @@ PyObject *Integrator_NewPythonObj(rr::Integrator* i) {
 //%ignore rr::RoadRunner::getUnscaledFluxControlCoefficientMatrix;
 //%ignore rr::RoadRunner::setValue;
 %ignore rr::RoadRunner::getEigenvaluesCpx;
+%ignore rr::RoadRunner::getTransferFunction;
+%ignore rr::RoadRunner::findSteadyStates;
+%ignore rr::RoadRunner::continueSteadyState;
+%ignore rr::RoadRunner::fitParameters;
+%ignore rr::RoadRunner::globalFitParameters;
 %ignore rr::RoadRunner::getNumberOfIndependentSpecies;
 //%ignore rr::RoadRunner::getUnscaledSpeciesElasticity;
 //%ignore rr::RoadRunner::simulate;
@@ -577,6 +710,10 @@ PyObject *Integrator_NewPythonObj(rr::Integrator* i) {
 %ignore rr::ExecutableModel::computeAllRatesOfChange;
 %ignore rr::ExecutableModel::getStateVectorRate(double time, const double *y, double* dydt);
 %ignore rr::ExecutableModel::getStateVectorRate(double time, const double *y);
+%ignore rr::ExecutableModel::getStateVectorJacobian;
+%ignore rr::ExecutableModel::getStateVectorConstraints;
+%ignore rr::ExecutableModel::saveState;
+%ignore rr::ExecutableModel::loadState;
 %ignore rr::ExecutableModel::testConstraints;
 %ignore rr::ExecutableModel::print;
 //%ignore rr::ExecutableModel::getNumEvents;
@@ -677,6 +814,7 @@ namespace std { class ostream{}; }
 %include <rrExecutableModel.h>
 %include <ModelGenerator.h>
 %include <rrVersionInfo.h>
+%include <rrEnsembleStatistics.h>
 
 %thread;
 %include <rrRoadRunner.h>
@@ -901,6 +1039,219 @@ namespace std { class ostream{}; }
 
 
 
+    /**
+     * the transfer function as a frequencies x variables x parameters
+     * complex array.
+     */
+    PyObject *_getTransferFunction(PyObject *frequencies,
+            const std::vector<std::string>& variables,
+            const std::vector<std::string>& parameters, int nThreads) {
+
+        PyObject *array = PyArray_FROM_OTF(frequencies, NPY_DOUBLE, NPY_IN_ARRAY);
+
+        if (!array || PyArray_NDIM((PyArrayObject*)array) > 1) {
+            Py_XDECREF(array);
+            PyErr_Clear();
+            throw std::invalid_argument("frequencies must be a one dimensional sequence of numbers");
+        }
+
+        const double *data = (const double*)PyArray_DATA((PyArrayObject*)array);
+        std::vector<double> w(data, data + PyArray_SIZE((PyArrayObject*)array));
+        Py_DECREF(array);
+
+        std::vector<ls::ComplexMatrix> tf = ($self)->getTransferFunction(w,
+                variables, parameters, nThreads);
+
+        npy_intp dims[3] = {(npy_intp)w.size(), (npy_intp)variables.size(),
+                (npy_intp)parameters.size()};
+
+        PyObject *result = PyArray_SimpleNew(3, dims, NPY_CDOUBLE);
+
+        if (!result) {
+            return 0;
+        }
+
+        const unsigned size = variables.size() * parameters.size();
+        ls::Complex *out = (ls::Complex*)PyArray_DATA((PyArrayObject*)result);
+
+        for (unsigned i = 0; i < tf.size(); ++i) {
+            std::copy(tf[i].getArray(), tf[i].getArray() + size, out + i * size);
+        }
+
+        return result;
+    }
+
+    /**
+     * the steady states as a list of dicts, the starts are the rows of
+     * initialStates, or a Latin hypercube of nStarts points if it is None.
+     */
+    PyObject *_findSteadyStates(int nStarts, PyObject *initialStates,
+            double maxValue, unsigned long seed, int nThreads) {
+
+        std::vector<rr::SteadyStateRoot> roots;
+
+        if (initialStates == Py_None) {
+            roots = ($self)->findSteadyStates(nStarts, maxValue, seed, nThreads);
+        } else {
+            PyObject *array = PyArray_FROM_OTF(initialStates, NPY_DOUBLE, NPY_IN_ARRAY);
+
+            if (!array || PyArray_NDIM((PyArrayObject*)array) != 2) {
+                Py_XDECREF(array);
+                PyErr_Clear();
+                throw std::invalid_argument("initialStates must be a two dimensional array");
+            }
+
+            npy_intp *dims = PyArray_DIMS((PyArrayObject*)array);
+            const double *data = (const double*)PyArray_DATA((PyArrayObject*)array);
+
+            ls::DoubleMatrix starts(dims[0], dims[1]);
+            std::copy(data, data + dims[0] * dims[1], starts.getArray());
+            Py_DECREF(array);
+
+            roots = ($self)->findSteadyStates(starts, nThreads);
+        }
+
+        PyObject *result = PyList_New(roots.size());
+
+        for (unsigned i = 0; i < roots.size(); ++i) {
+            const rr::SteadyStateRoot& root = roots[i];
+
+            npy_intp n = root.stateVector.size();
+            PyObject *stateVector = PyArray_SimpleNew(1, &n, NPY_DOUBLE);
+            std::copy(root.stateVector.begin(), root.stateVector.end(),
+                    (double*)PyArray_DATA((PyArrayObject*)stateVector));
+
+            npy_intp m = root.floatingSpeciesConcentrations.size();
+            PyObject *concentrations = PyArray_SimpleNew(1, &m, NPY_DOUBLE);
+            std::copy(root.floatingSpeciesConcentrations.begin(),
+                    root.floatingSpeciesConcentrations.end(),
+                    (double*)PyArray_DATA((PyArrayObject*)concentrations));
+
+            npy_intp k = root.eigenvalues.size();
+            PyObject *eigenvalues = PyArray_SimpleNew(1, &k, NPY_CDOUBLE);
+            std::copy(root.eigenvalues.begin(), root.eigenvalues.end(),
+                    (ls::Complex*)PyArray_DATA((PyArrayObject*)eigenvalues));
+
+            PyObject *stable = PyBool_FromLong(root.stable);
+
+            PyObject *dict = PyDict_New();
+            PyDict_SetItemString(dict, "stateVector", stateVector);
+            PyDict_SetItemString(dict, "concentrations", concentrations);
+            PyDict_SetItemString(dict, "eigenvalues", eigenvalues);
+            PyDict_SetItemString(dict, "stable", stable);
+            PyObject *hits = PyInt_FromLong(root.hits);
+            PyDict_SetItemString(dict, "hits", hits);
+
+            // SetItemString does not steal the references
+            Py_DECREF(stateVector);
+            Py_DECREF(concentrations);
+            Py_DECREF(eigenvalues);
+            Py_DECREF(stable);
+            Py_DECREF(hits);
+
+            PyList_SET_ITEM(result, i, dict);
+        }
+
+        return result;
+    }
+
+    /**
+     * the branch as an array, and the bifurcations as a list of dicts.
+     */
+    PyObject *_continueSteadyState(const std::string& parameterId,
+            double start, double end, double initialStep, double minStep,
+            double maxStep, int maxPoints) {
+
+        rr::ContinuationOptions opt;
+        opt.initialStep = initialStep;
+        opt.minStep = minStep;
+        opt.maxStep = maxStep;
+        opt.maxPoints = maxPoints;
+
+        std::vector<rr::BifurcationPoint> bifurcations;
+        ls::DoubleMatrix branch = ($self)->continueSteadyState(parameterId,
+                start, end, &opt, &bifurcations);
+
+        npy_intp dims[2] = {(npy_intp)branch.numRows(), (npy_intp)branch.numCols()};
+        PyObject *array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+        std::copy(branch.getArray(), branch.getArray() + dims[0] * dims[1],
+                (double*)PyArray_DATA((PyArrayObject*)array));
+
+        PyObject *points = PyList_New(bifurcations.size());
+
+        for (unsigned i = 0; i < bifurcations.size(); ++i) {
+            const rr::BifurcationPoint& b = bifurcations[i];
+
+            npy_intp n = b.stateVector.size();
+            PyObject *stateVector = PyArray_SimpleNew(1, &n, NPY_DOUBLE);
+            std::copy(b.stateVector.begin(), b.stateVector.end(),
+                    (double*)PyArray_DATA((PyArrayObject*)stateVector));
+
+            PyObject *type = PyString_FromString(
+                    b.type == rr::BifurcationPoint::FOLD ? "fold" : "hopf");
+            PyObject *row = PyInt_FromLong(b.row);
+            PyObject *parameter = PyFloat_FromDouble(b.parameter);
+
+            PyObject *dict = PyDict_New();
+            PyDict_SetItemString(dict, "type", type);
+            PyDict_SetItemString(dict, "row", row);
+            PyDict_SetItemString(dict, "parameter", parameter);
+            PyDict_SetItemString(dict, "stateVector", stateVector);
+
+            Py_DECREF(type);
+            Py_DECREF(row);
+            Py_DECREF(parameter);
+            Py_DECREF(stateVector);
+
+            PyList_SET_ITEM(points, i, dict);
+        }
+
+        return Py_BuildValue("(NN)", array, points);
+    }
+
+    /**
+     * data is a list of (column names, values, weights or None) tuples,
+     * returns the fit result as a dict.
+     */
+    PyObject *_fitParameters(PyObject *data,
+            const std::vector<std::string>& parameters, PyObject *lower,
+            PyObject *upper, PyObject *logScale, int maxIterations,
+            double tolerance, int nThreads) {
+
+        std::vector<rr::FitParameter> fitParameters =
+                _PyObject_toFitParameters(parameters, lower, upper, logScale);
+        std::vector<rr::RoadRunnerData> fitData = _PyObject_toFitData(data);
+
+        rr::FitOptions opt;
+        opt.maxIterations = maxIterations;
+        opt.tolerance = tolerance;
+        opt.nThreads = nThreads;
+
+        rr::FitResult result = ($self)->fitParameters(fitData, fitParameters, &opt);
+        return _FitResult_toPyObject(result);
+    }
+
+    PyObject *_globalFitParameters(PyObject *data,
+            const std::vector<std::string>& parameters, PyObject *lower,
+            PyObject *upper, PyObject *logScale, int populationSize,
+            int maxGenerations, unsigned long seed, bool polish, int nThreads) {
+
+        std::vector<rr::FitParameter> fitParameters =
+                _PyObject_toFitParameters(parameters, lower, upper, logScale);
+        std::vector<rr::RoadRunnerData> fitData = _PyObject_toFitData(data);
+
+        rr::GlobalFitOptions opt;
+        opt.populationSize = populationSize;
+        opt.maxGenerations = maxGenerations;
+        opt.seed = seed;
+        opt.polish = polish;
+        opt.nThreads = nThreads;
+
+        rr::FitResult result = ($self)->globalFitParameters(fitData, fitParameters, &opt);
+        return _FitResult_toPyObject(result);
+    }
+
+
    %pythoncode %{
         def getModel(self):
             if self.options.disablePythonDynamicProperties:
@@ -927,6 +1278,151 @@ namespace std { class ostream{}; }
             integrator = property(getIntegrator)
 
 
+        def getTransferFunction(self, frequencies, variables, parameters, nThreads=0):
+            """
+            Compute the transfer function from a list of parameters to a list of
+            variables at the steady state.
+
+            :param frequencies: sequence of angular frequencies in rad/sec.
+            :param variables: ids of floating species or reactions.
+            :param parameters: ids of global parameters or boundary species.
+            :param nThreads: number of threads the frequencies are evaluated on,
+                             one per processor if zero.
+            :returns: a complex array of shape (frequencies, variables, parameters).
+            """
+            return self._getTransferFunction(frequencies, variables, parameters, nThreads)
+
+        def findSteadyStates(self, nStarts=100, initialStates=None, maxValue=0, seed=0, nThreads=0):
+            """
+            Search for all the steady states of a multistable model with Newton
+            iterations from many starting points, run in parallel. Models with
+            conservation laws must have conserved moiety analysis enabled.
+
+            :param nStarts: number of Latin hypercube starting points.
+            :param initialStates: optional array with a state vector in each row,
+                                  used as the starting points instead.
+            :param maxValue: upper bound of the starting values, ten times the
+                             largest current state vector value if zero.
+            :param seed: random seed of the Latin hypercube.
+            :param nThreads: number of threads, one per processor if zero.
+            :returns: a list of dicts with the keys 'stateVector',
+                      'concentrations', 'eigenvalues', 'stable' and 'hits',
+                      the number of starts which converged to the steady state.
+            """
+            return self._findSteadyStates(nStarts, initialStates, maxValue, seed, nThreads)
+
+        def continueSteadyState(self, parameterId, start, end, initialStep=0.01,
+                                minStep=1e-6, maxStep=1.0, maxPoints=1000):
+            """
+            Trace the branch of steady states through the current state with
+            pseudo-arclength continuation in a global parameter.
+
+            :param parameterId: id of a global parameter.
+            :param start: parameter value the branch starts at.
+            :param end: parameter value the branch is traced towards.
+            :param initialStep: first arclength step.
+            :param minStep: the continuation stops if the step gets smaller.
+            :param maxStep: largest arclength step.
+            :param maxPoints: maximum number of points on the branch.
+            :returns: a tuple of an array with a row for each point, the
+                      parameter, the floating species concentrations and the
+                      number of unstable eigenvalues, and a list of dicts of
+                      the folds and Hopf points, with the keys 'type', 'row',
+                      'parameter' and 'stateVector'.
+            """
+            return self._continueSteadyState(parameterId, start, end, initialStep,
+                                             minStep, maxStep, maxPoints)
+
+        def fitParameters(self, data, parameters, lower=None, upper=None, logScale=False,
+                          maxIterations=100, tolerance=1e-6, nThreads=0):
+            """
+            Estimate global parameters from experimental time courses with a
+            Levenberg-Marquardt least squares fit. The fitted values are set in
+            the model.
+
+            :param data: a data set or a list of data sets, each either a structured
+                         array with a 'time' field, such as the result of simulate, or
+                         a (columns, values) or (columns, values, weights) tuple. The
+                         columns are 'time' and selections such as 'S1' or '[S1]', nan
+                         values are missing observations, and the residuals are
+                         multiplied by the weights.
+            :param parameters: ids of the global parameters to estimate.
+            :param lower: lower bounds, a number or one for each parameter.
+            :param upper: upper bounds, a number or one for each parameter.
+            :param logScale: estimate the log of the parameters, a bool or one for
+                             each parameter.
+            :param nThreads: number of threads, one per processor if zero.
+            :returns: a dict with the keys 'values', 'standardErrors', 'chiSquare',
+                      'iterations', 'evaluations' and 'converged'.
+            """
+            sets, parameters, lower, upper, logScale = self._fitArguments(
+                data, parameters, lower, upper, logScale)
+
+            return self._fitParameters(sets, parameters, lower, upper, logScale,
+                                       maxIterations, tolerance, nThreads)
+
+        def globalFitParameters(self, data, parameters, lower, upper, logScale=False,
+                                populationSize=0, maxGenerations=1000, seed=0,
+                                polish=True, nThreads=0):
+            """
+            Estimate global parameters with a differential evolution search
+            within their bounds, for fits where fitParameters gets stuck in a
+            local minimum. The current values are one member of the initial
+            population. The fitted values are set in the model.
+
+            :param data: the data sets, as in fitParameters.
+            :param parameters: ids of the global parameters to estimate.
+            :param lower: finite lower bounds, a number or one for each parameter.
+            :param upper: finite upper bounds, a number or one for each parameter.
+            :param logScale: search the log of the parameters, a bool or one for
+                             each parameter.
+            :param populationSize: number of members, ten per parameter if zero.
+            :param maxGenerations: maximum number of generations.
+            :param seed: seed of the random number generator.
+            :param polish: refine the best member with a Levenberg-Marquardt fit,
+                           which also gives the standard errors.
+            :param nThreads: number of threads, one per processor if zero.
+            :returns: a dict with the keys of fitParameters, 'iterations' is the
+                      number of generations.
+            """
+            sets, parameters, lower, upper, logScale = self._fitArguments(
+                data, parameters, lower, upper, logScale)
+
+            return self._globalFitParameters(sets, parameters, lower, upper, logScale,
+                                             populationSize, maxGenerations, seed,
+                                             polish, nThreads)
+
+        def _fitArguments(self, data, parameters, lower, upper, logScale):
+            """
+            the data sets as a list of (columns, values, weights or None)
+            tuples, and the bounds and scales with a value per parameter.
+            """
+            import numpy as np
+
+            if isinstance(parameters, str):
+                parameters = [parameters]
+
+            if not isinstance(data, list):
+                data = [data]
+
+            sets = []
+            for d in data:
+                if isinstance(d, np.ndarray) and d.dtype.names:
+                    names = list(d.dtype.names)
+                    values = np.array([d[n] for n in names], dtype=float).T
+                    sets.append((names, values, None))
+                elif len(d) == 2:
+                    sets.append((list(d[0]), d[1], None))
+                else:
+                    sets.append((list(d[0]), d[1], d[2]))
+
+            n = len(parameters)
+            lower = np.resize(-np.inf if lower is None else np.asarray(lower, dtype=float), n)
+            upper = np.resize(np.inf if upper is None else np.asarray(upper, dtype=float), n)
+            logScale = np.resize(np.asarray(logScale, dtype=float), n)
+
+            return sets, parameters, lower, upper, logScale
+
         def keys(self, types=_roadrunner.SelectionRecord_ALL):
             return self.getIds(types)
 
@@ -1014,8 +1510,13 @@ namespace std { class ostream{}; }
 
             integrator
                 A text string specifying which integrator to use. Currently supports "cvode"
-                for deterministic simulation (default) and "gillespie" for stochastic 
-                simulation.
+                for deterministic simulation (default), "gillespie" for stochastic
+                simulation, "tauleaping" for approximate, much faster stochastic
+                simulation of models with large molecule counts, "hybrid" for
+                models that mix low copy number species with abundant ones,
+                "rk45" for fast deterministic simulation of non-stiff models,
+                "rosenbrock" for small stiff models, and "ida" for models with
+                algebraic rules or fast reactions.
 
             sel or selections
                 A list of strings specifying what values to display in the output. 
@@ -1062,6 +1563,20 @@ namespace std { class ostream{}; }
                 with the regular integrator. The stiff integrator is slower than the conventional 
                 integrator.
 
+            denseOutput
+                True or False
+                Let the CVODE integrator take its natural steps and interpolate the output
+                values, a large number of output points then costs almost nothing extra.
+
+            times
+                A non-decreasing sequence of output times for a deterministic simulation,
+                this overrides start, end and steps.
+
+            steadyStateTermination
+                True or False
+                Stop integrating once the model has reached a steady state, the
+                remaining rows are filled with the steady state values.
+
             multiStep
                 True or False
                 Perform a multi step integration.
@@ -1158,6 +1673,16 @@ namespace std { class ostream{}; }
                 if k == "integrator" and type(v) == str:
                     if v.lower() == "gillespie":
                         o.integrator = SimulateOptions.GILLESPIE
+                    elif v.lower() == "tauleaping":
+                        o.integrator = SimulateOptions.TAU_LEAPING
+                    elif v.lower() == "hybrid":
+                        o.integrator = SimulateOptions.HYBRID
+                    elif v.lower() == "rk45":
+                        o.integrator = SimulateOptions.RK45
+                    elif v.lower() == "rosenbrock":
+                        o.integrator = SimulateOptions.ROSENBROCK
+                    elif v.lower() == "ida":
+                        o.integrator = SimulateOptions.IDA
                     elif v.lower() == "cvode":
                         o.integrator = SimulateOptions.CVODE
                     else:
@@ -1307,6 +1832,9 @@ namespace std { class ostream{}; }
     bool multiStep;
     bool structuredResult;
     bool variableStep;
+    bool denseOutput;
+    bool steadyStateTermination;
+    PyObject *times;
     rr::SimulateOptions::Integrator integrator;
 
     std::string __repr__() {
@@ -1408,6 +1936,63 @@ namespace std { class ostream{}; }
         }
     }
 
+    bool rr_SimulateOptions_denseOutput_get(SimulateOptions* opt) {
+        return opt->integratorFlags & SimulateOptions::DENSE_OUTPUT;
+    }
+
+    void rr_SimulateOptions_denseOutput_set(SimulateOptions* opt, bool value) {
+        if (value) {
+            opt->integratorFlags |= SimulateOptions::DENSE_OUTPUT;
+        } else {
+            opt->integratorFlags &= ~SimulateOptions::DENSE_OUTPUT;
+        }
+    }
+
+    bool rr_SimulateOptions_steadyStateTermination_get(SimulateOptions* opt) {
+        return opt->flags & SimulateOptions::STEADY_STATE_TERMINATION;
+    }
+
+    void rr_SimulateOptions_steadyStateTermination_set(SimulateOptions* opt, bool value) {
+        if (value) {
+            opt->flags |= SimulateOptions::STEADY_STATE_TERMINATION;
+        } else {
+            opt->flags &= ~SimulateOptions::STEADY_STATE_TERMINATION;
+        }
+    }
+
+    PyObject *rr_SimulateOptions_times_get(SimulateOptions* opt) {
+        npy_intp dims[1] = {(npy_intp)opt->times.size()};
+
+        PyObject *array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+
+        if (array && opt->times.size()) {
+            memcpy(PyArray_DATA((PyArrayObject*)array), &opt->times[0],
+                    sizeof(double) * opt->times.size());
+        }
+
+        return array;
+    }
+
+    void rr_SimulateOptions_times_set(SimulateOptions* opt, PyObject *value) {
+        if (value == Py_None) {
+            opt->times.clear();
+            return;
+        }
+
+        PyObject *array = PyArray_FROM_OTF(value, NPY_DOUBLE, NPY_IN_ARRAY);
+
+        if (!array || PyArray_NDIM((PyArrayObject*)array) > 1) {
+            Py_XDECREF(array);
+            PyErr_Clear();
+            throw std::invalid_argument("times must be a one dimensional sequence of numbers");
+        }
+
+        const double *data = (const double*)PyArray_DATA((PyArrayObject*)array);
+        opt->times.assign(data, data + PyArray_SIZE((PyArrayObject*)array));
+
+        Py_DECREF(array);
+    }
+
     rr::SimulateOptions::Integrator rr_SimulateOptions_integrator_get(SimulateOptions* opt) {
         return opt->integrator;
     }
@@ -1470,6 +2055,9 @@ namespace std { class ostream{}; }
     bool noDefaultSelections;
     bool readOnly;
     bool recompile;
+    bool fastMath;
+    bool compact;
+    bool optimizeNative;
 }
 
 
@@ -1539,6 +2127,45 @@ namespace std { class ostream{}; }
         }
 
     }
+
+    bool rr_LoadSBMLOptions_fastMath_get(rr::LoadSBMLOptions* opt) {
+        return opt->modelGeneratorOpt & rr::LoadSBMLOptions::FAST_MATH;
+    }
+
+
+    void rr_LoadSBMLOptions_fastMath_set(rr::LoadSBMLOptions* opt, bool value) {
+        if (value) {
+            opt->modelGeneratorOpt |= rr::LoadSBMLOptions::FAST_MATH;
+        } else {
+            opt->modelGeneratorOpt &= ~rr::LoadSBMLOptions::FAST_MATH;
+        }
+    }
+
+    bool rr_LoadSBMLOptions_compact_get(rr::LoadSBMLOptions* opt) {
+        return opt->modelGeneratorOpt & rr::LoadSBMLOptions::COMPACT;
+    }
+
+
+    void rr_LoadSBMLOptions_compact_set(rr::LoadSBMLOptions* opt, bool value) {
+        if (value) {
+            opt->modelGeneratorOpt |= rr::LoadSBMLOptions::COMPACT;
+        } else {
+            opt->modelGeneratorOpt &= ~rr::LoadSBMLOptions::COMPACT;
+        }
+    }
+
+    bool rr_LoadSBMLOptions_optimizeNative_get(rr::LoadSBMLOptions* opt) {
+        return opt->modelGeneratorOpt & rr::LoadSBMLOptions::OPTIMIZE_NATIVE;
+    }
+
+
+    void rr_LoadSBMLOptions_optimizeNative_set(rr::LoadSBMLOptions* opt, bool value) {
+        if (value) {
+            opt->modelGeneratorOpt |= rr::LoadSBMLOptions::OPTIMIZE_NATIVE;
+        } else {
+            opt->modelGeneratorOpt &= ~rr::LoadSBMLOptions::OPTIMIZE_NATIVE;
+        }
+    }
 %}
 
 
@@ -1010,6 +1010,60 @@ This simulation will use the previous values.
 
 
 
+%feature("docstring") rr::RoadRunner::simulateEnsemble "
+RoadRunner.simulateEnsemble(nTrajectories, seed, options=None, nThreads=0)
+
+Run an ensemble of stochastic simulations of the current model on several
+threads.
+
+Each trajectory starts from the current model state and is simulated with
+fixed steps using the stochastic integrator in the given `SimulateOptions`,
+or the current options if None. Trajectory k uses random stream k of the
+seed, so the results are reproducible, and the same for any number of
+threads. A single trajectory can be reproduced with simulate by setting the
+``seed`` and ``trajectory`` keys of the simulate options::
+
+  o = r.simulateOptions
+  o.integrator = 'gillespie'
+  o.setValue('seed', 1234)
+  o.setValue('trajectory', 7)
+  r.simulate(o)
+
+The current model is left in the state it was in before the ensemble.
+
+:param int nTrajectories: number of trajectories
+:param int seed: random seed of the ensemble
+:param SimulateOptions options: simulate options
+:param int nThreads: number of threads, the number of processor cores if 0
+:returns: an array of nTrajectories * (steps + 1) rows, with a column for each
+          selection. Trajectory k is in rows k * (steps + 1) to
+          (k + 1) * (steps + 1) - 1.
+:rtype: numpy.ndarray
+";
+
+
+
+%feature("docstring") rr::RoadRunner::simulateEnsembleStatistics "
+RoadRunner.simulateEnsembleStatistics(nTrajectories, seed, statistics, options=None, nThreads=0)
+
+Same as simulateEnsemble, but only accumulate the mean, variance and quantiles
+of each selection at each time point into an `EnsembleStatistics` object. The
+memory used does not depend on the number of trajectories. Each thread has its
+own accumulators, which are merged when the ensemble is done.
+
+The trajectories are added to statistics, which is cleared first if its number of
+time points or selections are different, so an ensemble may be run in several
+batches with different seeds.
+
+:param int nTrajectories: number of trajectories
+:param int seed: random seed of the ensemble
+:param EnsembleStatistics statistics: the trajectories are accumulated into this
+:param SimulateOptions options: simulate options
+:param int nThreads: number of threads, the number of processor cores if 0
+";
+
+
+
 %feature("docstring") rr::RoadRunner::simulateOptions "
 :annotation: None
 
@@ -2440,6 +2494,63 @@ original JIT engine. Does NOT work on LLVM 3.1
 
 
 
+%feature("docstring") rr::Config::LOADSBMLOPTIONS_FAST_MATH "
+:annotation: bool
+
+Generate floating point code with relaxed IEEE semantics. The optimizer may
+re-associate arithmetic, use the LLVM exp, log and pow intrinsics and
+vectorize independent expressions.
+
+Defaults to false.
+
+Results may differ from the strict code in the last few bits. Requires
+LLVM 3.3 or later, ignored otherwise.
+";
+
+
+
+%feature("docstring") rr::Config::LOADSBMLOPTIONS_OPTIMIZE_ASSIGNMENT_RULES "
+:annotation: bool
+
+Evaluate each assignment rule that a generated model function (reaction
+rates, rate rules, jacobian, event assignments, ...) depends on once per
+call, in dependency order, instead of re-generating the rule expression
+everywhere the symbol is used. Rules only used in the branches of a
+piecewise are still evaluated in their branch.
+
+Defaults to false.
+";
+
+
+
+%feature("docstring") rr::Config::LOADSBMLOPTIONS_COMPACT "
+:annotation: bool
+
+Once the model is compiled to native code, release the LLVM IR that
+would otherwise be kept for the life time of the model. Only the native
+code and the symbol tables are kept, which can considerably reduce the
+memory used by each loaded model. The model's getInfo() output includes
+a memory usage report.
+
+Defaults to false.
+";
+
+
+
+%feature("docstring") rr::Config::LOADSBMLOPTIONS_OPTIMIZE_NATIVE "
+:annotation: bool
+
+Legacy C back end only, build the model with the system C compiler at
+-O3 instead of compiling it in memory with libtcc. Compiling takes
+longer, but the model runs faster, which pays off for long simulations.
+The compiled library is cached, so this is only paid once for each model.
+Ignored by the LLVM back end.
+
+Defaults to false.
+";
+
+
+
 %feature("docstring") rr::Config::SIMULATEOPTIONS_STEPS "
 :annotation: int
 
@@ -2600,6 +2711,93 @@ which is 2 and 0b01 & 0b10 is 0b11 which is 3 in decimal.
 
 
 
+%feature("docstring") rr::Config::LLVM_MODEL_CACHE_SIZE "
+:annotation: int
+
+The number of most recently used compiled models that are kept in memory
+after the last RoadRunner object using them is deleted. Re-loading one of
+these models re-uses the compiled code instead of compiling the sbml again.
+
+0 means no count limit. If both this and LLVM_MODEL_CACHE_MEMORY are 0,
+compiled models are only shared between models that are in use.
+
+Defaults to 0.
+";
+
+
+
+%feature("docstring") rr::Config::LLVM_MODEL_CACHE_MEMORY "
+:annotation: int
+
+Upper limit, in megabytes, of the estimated memory used by the retained
+compiled models, the least recently used models are released first.
+
+0 means no memory limit, only LLVM_MODEL_CACHE_SIZE applies.
+
+Defaults to 0.
+";
+
+
+
+%feature("docstring") rr::Config::LLVM_CODEGEN_THREADS "
+:annotation: int
+
+Number of threads used to generate and optimize the functions of a
+single model. Each additional thread builds its functions in its own
+temporary LLVM context, which is linked into the model's module and
+released before the functions are compiled to native code on the calling
+thread, so the loaded model uses no more memory than with a single thread.
+This can reduce the load time of large models, especially with the
+OPTIMIZE options.
+
+A value of 0 uses one thread per processor. Requires an LLVM built with
+thread support, otherwise a single thread is used.
+
+Defaults to 1, all functions are generated sequentially.
+";
+
+
+
+%feature("docstring") rr::Config::ROADRUNNER_SPARSE_STRUCTURAL_THRESHOLD "
+:annotation: int
+
+Models with at least this many floating species use a sparse structural
+analysis for the conserved moiety conversion and for the link, Nr, L0 and
+conservation matrices, instead of the dense QR factorization. The species
+keep their model order within the independent and dependent groups.
+
+A value of 0 or less always uses the dense analysis.
+
+Defaults to 100.
+";
+
+
+
+%feature("docstring") rr::RoadRunner::getModelCacheHits "
+RoadRunner.getModelCacheHits()
+
+Number of model loads that re-used an already compiled model.
+";
+
+
+
+%feature("docstring") rr::RoadRunner::getModelCacheMisses "
+RoadRunner.getModelCacheMisses()
+
+Number of model loads that had to compile the sbml.
+";
+
+
+
+%feature("docstring") rr::RoadRunner::purgeModelCache "
+RoadRunner.purgeModelCache()
+
+Release all the compiled models retained by the model cache. Models that are
+in use are not affected.
+";
+
+
+
 %feature("docstring") rr::PyConservedMoietyConverter::setDocument "
 PyConservedMoietyConverter.setDocument(sbmlOrURI)
 